@@ -0,0 +1,79 @@
+//***************************************************************************************
+// Benchmark.h
+//
+// Shared by the benchmarks of the Common modules, one file each, which Benchmarks.cpp
+// runs by name.  Everything here runs on the CPU without a device, so the numbers can
+// be compared across machines and before and after a change.
+//
+// A benchmark returns false when one of its checks fails, and the runner then exits
+// with 1, so the same target doubles as a quick regression check.
+//***************************************************************************************
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace Benchmark
+{
+    ///<summary>
+    /// Milliseconds of the fastest of runs calls of func.
+    ///</summary>
+    template<typename F>
+    double BestOf(int runs, F&& func)
+    {
+        double best = 0.0;
+        for(int run = 0; run < runs; ++run)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            func();
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+            if(run == 0 || elapsed.count() < best)
+                best = elapsed.count();
+        }
+        return best;
+    }
+
+    // A fixed sequence, so every run and every machine sees the same inputs.
+    class Random
+    {
+    public:
+        explicit Random(std::uint32_t seed = 1) : mSeed(seed) {}
+
+        std::uint32_t Next()
+        {
+            mSeed = mSeed * 1664525u + 1013904223u;
+            return mSeed >> 8;
+        }
+
+        // In [lo, hi).
+        float Float(float lo, float hi)
+        {
+            return lo + (hi - lo) * (float)Next() / (float)(1u << 24);
+        }
+
+    private:
+        std::uint32_t mSeed;
+    };
+
+    // Bytes allocated with operator new and not deleted yet, on any thread.
+    size_t HeapBytes();
+
+    // High-water mark of HeapBytes() since the last ResetPeakHeapBytes().
+    size_t PeakHeapBytes();
+    void ResetPeakHeapBytes();
+}
+
+// Defined in <Module>Benchmark.cpp; false if a check failed.
+bool BlockCompressionBenchmark();
+bool ChunkedTerrainBenchmark();
+bool ClusteredLightingBenchmark();
+bool GeometryPackerBenchmark();
+bool HeightfieldBenchmark();
+bool LightingModelBenchmark();
+bool ResourceHeapPolicyBenchmark();
+bool TextureLoadQueueBenchmark();
+bool TexturePackerBenchmark();
+bool TextureResidencyBenchmark();
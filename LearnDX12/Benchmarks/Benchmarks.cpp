@@ -0,0 +1,164 @@
+//***************************************************************************************
+// Benchmarks.cpp
+//
+// Runs the benchmarks named on the command line, or all of them, and prints their
+// results.  Replaces the global operator new and delete to count the heap in use, so
+// benchmarks can report peak memory along with their timings.
+//***************************************************************************************
+
+#include "Benchmark.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace
+{
+    std::atomic<size_t> gHeapBytes{ 0 };
+    std::atomic<size_t> gPeakHeapBytes{ 0 };
+
+    // In front of every allocation, keeping its size; large enough to keep the
+    // alignment malloc gives.
+    const size_t HeaderSize = 16;
+
+    void* Allocate(size_t size)
+    {
+        char* block = (char*)std::malloc(size + HeaderSize);
+        if(block == nullptr)
+            return nullptr;
+
+        *(size_t*)block = size;
+
+        const size_t bytes = gHeapBytes.fetch_add(size, std::memory_order_relaxed) + size;
+        size_t peak = gPeakHeapBytes.load(std::memory_order_relaxed);
+        while(bytes > peak && !gPeakHeapBytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed))
+        {
+        }
+
+        return block + HeaderSize;
+    }
+
+    void Free(void* ptr)
+    {
+        if(ptr == nullptr)
+            return;
+
+        char* block = (char*)ptr - HeaderSize;
+        gHeapBytes.fetch_sub(*(size_t*)block, std::memory_order_relaxed);
+        std::free(block);
+    }
+
+    struct Entry
+    {
+        const char* Name;
+        bool (*Run)();
+    };
+
+    const Entry Benchmarks[] =
+    {
+        { "GeometryPacker", GeometryPackerBenchmark },
+        { "ChunkedTerrain", ChunkedTerrainBenchmark },
+        { "Heightfield", HeightfieldBenchmark },
+        { "LightingModel", LightingModelBenchmark },
+        { "ClusteredLighting", ClusteredLightingBenchmark },
+        { "BlockCompression", BlockCompressionBenchmark },
+        { "TexturePacker", TexturePackerBenchmark },
+        { "TextureLoadQueue", TextureLoadQueueBenchmark },
+        { "ResourceHeapPolicy", ResourceHeapPolicyBenchmark },
+        { "TextureResidency", TextureResidencyBenchmark },
+    };
+}
+
+void* operator new(size_t size)
+{
+    void* ptr = Allocate(size);
+    if(ptr == nullptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return Allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return Allocate(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    Free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    Free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    Free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    Free(ptr);
+}
+
+size_t Benchmark::HeapBytes()
+{
+    return gHeapBytes.load(std::memory_order_relaxed);
+}
+
+size_t Benchmark::PeakHeapBytes()
+{
+    return gPeakHeapBytes.load(std::memory_order_relaxed);
+}
+
+void Benchmark::ResetPeakHeapBytes()
+{
+    gPeakHeapBytes.store(gHeapBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+int main(int argc, char* argv[])
+{
+    // Benchmarks [name...]
+    bool passed = true;
+    int ran = 0;
+    for(const Entry& entry : Benchmarks)
+    {
+        bool selected = argc < 2;
+        for(int i = 1; i < argc; ++i)
+            selected = selected || std::strcmp(argv[i], entry.Name) == 0;
+        if(!selected)
+            continue;
+
+        std::printf("== %s ==\n", entry.Name);
+        if(!entry.Run())
+        {
+            std::printf("%s: FAILED\n", entry.Name);
+            passed = false;
+        }
+        std::printf("\n");
+        ++ran;
+    }
+
+    if(ran == 0)
+    {
+        std::printf("Usage: Benchmarks [name...]\nBenchmarks:");
+        for(const Entry& entry : Benchmarks)
+            std::printf(" %s", entry.Name);
+        std::printf("\n");
+        return 1;
+    }
+
+    return passed ? 0 : 1;
+}
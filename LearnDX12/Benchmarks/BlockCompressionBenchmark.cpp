@@ -0,0 +1,322 @@
+//***************************************************************************************
+// BlockCompressionBenchmark.cpp
+//
+// Decodes known blocks and compares every texel with the answer, then times Encode()
+// and Decode() of a 2048 x 2048 test image with smooth gradients, hard edges and noise
+// for each BC format, and measures what the round trip loses.  BC2 and BC7 are only
+// decoded, from random blocks.
+//***************************************************************************************
+
+#include "Benchmark.h"
+#include "../Common/BlockCompression.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    using uint8 = BlockCompression::uint8;
+    using uint32 = BlockCompression::uint32;
+
+    const uint32 ImageSize = 2048;
+
+    // Well below what the encoder reaches on the test image (30 dB for BC1, the worst);
+    // a drop under it means the encoder broke rather than got a little worse.
+    const double MinPsnr = 25.0;
+
+    // Blocks assembled field by field, with the texels the BC7 and BC2-BC5 specs give
+    // for them.  The BC7 blocks cover every mode, the partitions and anchors of two and
+    // three subsets, both kinds of p-bit, rotation and index selection.
+    struct KnownBlock
+    {
+        uint32 Format;
+        const char* What;
+        uint8 Block[16];
+        uint8 Rgba[64];
+    };
+
+    const KnownBlock KnownBlocks[] =
+    {
+        {
+            DdsFile::FormatBC7Unorm, "mode 0: three subsets, partition 13, a p-bit per endpoint",
+            { 0xfb, 0xed, 0x5a, 0xbd, 0xfa, 0x4d, 0x28, 0x71, 0xd3, 0xac, 0xab, 0x6e, 0xab, 0xdd, 0x79, 0x43 },
+            {
+                233, 107, 153, 255, 194, 149, 165, 255, 223,  62, 100, 255, 215,  59, 101, 255,
+                143, 179, 139, 255, 137, 234, 184, 255, 215,  59, 101, 255, 223,  62, 100, 255,
+                121, 197, 135, 255, 194, 149, 165, 255, 197,  52, 104, 255, 223,  62, 100, 255,
+                189, 142, 146, 255, 165, 193, 175, 255, 173,  41, 107, 255, 181,  45, 106, 255
+            }
+        },
+        {
+            DdsFile::FormatBC7Unorm, "mode 1: two subsets, partition 35, a shared p-bit per subset",
+            { 0x8e, 0x42, 0xdd, 0xb9, 0xa1, 0xe3, 0x45, 0xa8, 0xba, 0x67, 0x47, 0xb7, 0x97, 0x5c, 0x22, 0xe8 },
+            {
+                 39, 124, 164, 255, 129,  90, 168, 255, 177,  77, 121, 255, 168,  85, 141, 255,
+                157,  80, 169, 255, 215,  58, 171, 255, 137, 107, 200, 255, 137, 107, 200, 255,
+                137, 107, 200, 255, 147, 100, 181, 255,  39, 124, 164, 255,  39, 124, 164, 255,
+                137, 107, 200, 255, 118, 122, 239, 255,  68, 113, 165, 255, 215,  58, 171, 255
+            }
+        },
+        {
+            DdsFile::FormatBC7Unorm, "mode 2: three subsets, partition 46 (anchors 15 and 6)",
+            { 0x74, 0x5f, 0x79, 0x9e, 0x4d, 0xcb, 0xfa, 0x26, 0xd1, 0x49, 0xa8, 0x27, 0xca, 0xb5, 0x94, 0x21 },
+            {
+                 96, 154, 126, 255, 123, 239, 132, 255,  41,  99, 148, 255, 164, 233, 159, 255,
+                118,  68, 126, 255, 156, 140,  66, 255,  99,  33, 156, 255, 118,  68, 126, 255,
+                137, 105,  96, 255, 137, 105,  96, 255,  99,  33, 156, 255, 156, 140,  66, 255,
+                123, 181, 115, 255, 123, 239, 132, 255,  96, 154, 126, 255, 123, 239, 132, 255
+            }
+        },
+        {
+            DdsFile::FormatBC7Unorm, "mode 3: two subsets, partition 17 (anchor 2), a p-bit per endpoint",
+            { 0x18, 0x81, 0x58, 0x2a, 0x50, 0x8d, 0x97, 0xd2, 0x58, 0xf8, 0x96, 0x03, 0x51, 0x50, 0xdd, 0xfa },
+            {
+                 64, 106,  44, 255,  71,  62,  24, 255,  85,  83,  45, 255,  78,  73,  35, 255,
+                 64, 106,  44, 255,  64, 106,  44, 255,  72, 111, 111, 255,  78,  73,  35, 255,
+                 72, 111, 111, 255,  88, 120, 248, 255,  72, 111, 111, 255,  88, 120, 248, 255,
+                 80, 115, 181, 255,  80, 115, 181, 255,  88, 120, 248, 255,  88, 120, 248, 255
+            }
+        },
+        {
+            DdsFile::FormatBC7Unorm, "mode 4: rotation 1 (alpha and red), 2 bit indices for colour",
+            { 0x30, 0x0d, 0xe5, 0xc6, 0x55, 0x7d, 0x2e, 0x07, 0x69, 0x7a, 0x2e, 0x4a, 0x2d, 0x8e, 0x84, 0x92 },
+            {
+                191, 174, 182,  94, 174, 174, 182,  94, 215, 174, 182,  94, 174, 139, 131,  79,
+                182, 107,  82,  66, 199, 206, 231, 107, 191, 206, 231, 107, 207, 139, 131,  79,
+                166, 206, 231, 107, 207, 174, 182,  94, 199, 107,  82,  66, 199, 206, 231, 107,
+                215, 174, 182,  94, 174, 107,  82,  66, 182, 107,  82,  66, 182, 206, 231, 107
+            }
+        },
+        {
+            DdsFile::FormatBC7Unorm, "mode 4: rotation 3 (alpha and blue), index selection: 3 bit indices for colour",
+            { 0xf0, 0x7f, 0xab, 0x7f, 0xe9, 0x4e, 0x01, 0x0f, 0xc6, 0xb0, 0x70, 0x68, 0x0d, 0x99, 0x7d, 0x8d },
+            {
+                255,  82, 239, 189, 227, 231, 239, 168, 250, 106, 239, 186, 236, 182, 133, 175,
+                227, 231,  81, 168, 246, 131, 187, 182, 241, 155, 239, 179, 255,  82, 239, 189,
+                250, 106,  81, 186, 241, 155, 239, 179, 227, 231, 133, 168, 227, 231, 187, 168,
+                222, 255, 239, 165, 246, 131, 133, 182, 241, 155, 187, 179, 236, 182, 187, 175
+            }
+        },
+        {
+            DdsFile::FormatBC7Unorm, "mode 5: rotation 2 (alpha and green)",
+            { 0xa0, 0xc6, 0xf3, 0xb6, 0x3c, 0x47, 0xe6, 0x88, 0xca, 0x5e, 0x1b, 0xcf, 0x69, 0xb4, 0xb6, 0x2d },
+            {
+                141,  57, 231, 183, 163, 128, 203, 190, 185, 128, 173, 196, 163,  91, 203, 190,
+                207,  57, 145, 203, 207,  91, 145, 203, 185, 162, 173, 196, 185, 128, 173, 196,
+                163, 128, 203, 190, 207,  91, 145, 203, 141, 162, 231, 183, 185, 128, 173, 196,
+                207,  91, 145, 203, 163, 162, 203, 190, 185, 128, 173, 196, 207,  57, 145, 203
+            }
+        },
+        {
+            DdsFile::FormatBC7Unorm, "mode 6: 4 bit indices, a p-bit per endpoint",
+            { 0x40, 0x30, 0x1b, 0x22, 0x15, 0xc1, 0x32, 0x93, 0x68, 0x5d, 0xf6, 0x28, 0x3e, 0x83, 0xc4, 0x73 },
+            {
+                199,  68,  76,  48, 202,  86,  80,  46, 213, 146,  92,  40, 201,  76,  78,  47,
+                202,  86,  80,  46, 216, 164,  96,  38, 205, 103,  83,  44, 196,  51,  73,  49,
+                215, 156,  94,  39, 198,  60,  74,  48, 198,  60,  74,  48, 205, 103,  83,  44,
+                199,  68,  76,  48, 211, 137,  91,  41, 198,  60,  74,  48, 204,  94,  82,  45
+            }
+        },
+        {
+            DdsFile::FormatBC7Unorm, "mode 7: two subsets with alpha, partition 19 (anchor 2)",
+            { 0x80, 0xd3, 0xc3, 0x3a, 0x28, 0x53, 0xa3, 0x44, 0x15, 0xa3, 0xfa, 0x50, 0x59, 0x25, 0x3c, 0xa7 },
+            {
+                125,  85, 150,  69,   8, 138, 195,  65, 215, 174, 174, 125, 147, 162, 181, 105,
+                148,  73, 122, 102, 148,  73, 122, 102,  76, 150, 188,  85, 215, 174, 174, 125,
+                125,  85, 150,  69, 195,  48,  65, 170, 195,  48,  65, 170, 215, 174, 174, 125,
+                195,  48,  65, 170, 148,  73, 122, 102, 172,  60,  93, 137, 172,  60,  93, 137
+            }
+        },
+        {
+            DdsFile::FormatBC7Unorm, "reserved mode 8: transparent black",
+            { 0x00, 0xec, 0xb1, 0x95, 0xf6, 0xe5, 0x10, 0x91, 0x5f, 0xc4, 0xfd, 0xb8, 0xf8, 0xba, 0x50, 0x21 },
+            {
+                  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+                  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+                  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+                  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0
+            }
+        },
+        {
+            DdsFile::FormatBC2Unorm, "BC2: explicit alpha, four colours although colour 0 < colour 1",
+            { 0x89, 0x64, 0x5d, 0xe1, 0xee, 0xa7, 0x03, 0x48, 0x4a, 0x2b, 0xb7, 0xd3, 0x3a, 0xd8, 0x19, 0x90 },
+            {
+                 99, 109, 118, 153,  99, 109, 118, 136, 156, 113, 153,  68,  41, 105,  82, 102,
+                 41, 105,  82, 221,  99, 109, 118,  85, 214, 117, 189,  17, 156, 113, 153, 238,
+                214, 117, 189, 238,  99, 109, 118, 238, 214, 117, 189, 119,  41, 105,  82, 170,
+                 41, 105,  82,  51,  41, 105,  82,   0, 214, 117, 189, 136,  99, 109, 118,  68
+            }
+        },
+        {
+            DdsFile::FormatBC4Snorm, "BC4 SNORM: red 0 > red 1, six interpolated values",
+            { 0x5a, 0x9c, 0x88, 0xc6, 0xfa, 0xc9, 0xbf, 0x95 },
+            {
+                218,   0,   0, 255,  27,   0,   0, 255, 191,   0,   0, 255, 163,   0,   0, 255,
+                136,   0,   0, 255, 109,   0,   0, 255,  82,   0,   0, 255,  54,   0,   0, 255,
+                 27,   0,   0, 255,  27,   0,   0, 255,  54,   0,   0, 255,  54,   0,   0, 255,
+                163,   0,   0, 255, 163,   0,   0, 255, 109,   0,   0, 255, 136,   0,   0, 255
+            }
+        },
+        {
+            DdsFile::FormatBC4Snorm, "BC4 SNORM: red 0 = -128, read as -127, <= red 1, so -1 and 1 at indices 6 and 7",
+            { 0x80, 0x33, 0x88, 0xc6, 0xfa, 0x27, 0xf6, 0xb1 },
+            {
+                  0,   0,   0, 255, 179,   0,   0, 255,  36,   0,   0, 255,  71,   0,   0, 255,
+                107,   0,   0, 255, 143,   0,   0, 255,   0,   0,   0, 255, 255,   0,   0, 255,
+                255,   0,   0, 255, 107,   0,   0, 255,   0,   0,   0, 255,  71,   0,   0, 255,
+                255,   0,   0, 255,  71,   0,   0, 255, 107,   0,   0, 255, 143,   0,   0, 255
+            }
+        },
+        {
+            DdsFile::FormatBC5Snorm, "BC5 SNORM: red 0 > red 1, green 0 <= green 1",
+            { 0x70, 0xe0, 0x88, 0xc6, 0xfa, 0x2c, 0xc4, 0x56, 0xc4, 0x12, 0x88, 0xc6, 0xfa, 0x28, 0xda, 0x89 },
+            {
+                240,  67,   0, 255,  95, 146,   0, 255, 219,  83,   0, 255, 199,  99,   0, 255,
+                178, 114,   0, 255, 157, 130,   0, 255, 137,   0,   0, 255, 116, 255,   0, 255,
+                178,  67,   0, 255, 157, 130,   0, 255, 240,  67,   0, 255, 219, 130,   0, 255,
+                178, 130,   0, 255, 157,  99,   0, 255, 157,  83,   0, 255, 219, 114,   0, 255
+            }
+        }
+    };
+
+    // Prints the blocks that do not decode exactly to their answer.
+    uint32 CountWrongKnownBlocks()
+    {
+        uint32 wrong = 0;
+        for(const KnownBlock& known : KnownBlocks)
+        {
+            uint8 rgba[64];
+            if(!BlockCompression::Decode(known.Format, known.Block, 4, 4, rgba) ||
+                std::memcmp(rgba, known.Rgba, sizeof(rgba)) != 0)
+            {
+                std::printf("  wrong: %s\n", known.What);
+                ++wrong;
+            }
+        }
+        return wrong;
+    }
+
+    // A noisy gradient in red, a diagonal ramp in green, hard edged tiles with noise in
+    // blue and a gradient in alpha.
+    std::vector<uint8> CreateImage(uint32 size, Benchmark::Random& random)
+    {
+        std::vector<uint8> image((size_t)size * size * 4);
+        for(uint32 y = 0; y < size; ++y)
+        {
+            for(uint32 x = 0; x < size; ++x)
+            {
+                uint8* texel = &image[((size_t)y * size + x) * 4];
+                texel[0] = (uint8)(224 * x / size + (random.Next() & 31));
+                texel[1] = (uint8)(255 * ((x + y) / 2) / size);
+                texel[2] = (uint8)((((x / 37) + (y / 23)) & 1) * 192 + (random.Next() & 63));
+                texel[3] = (uint8)(255 * y / size);
+            }
+        }
+        return image;
+    }
+
+    // Of decoded against source, over the channels the format stores.
+    double Psnr(const std::vector<uint8>& source, const std::vector<uint8>& decoded, uint32 channels)
+    {
+        double squaredError = 0.0;
+        for(size_t i = 0; i < decoded.size(); i += 4)
+        {
+            for(uint32 c = 0; c < channels; ++c)
+            {
+                const double d = (double)decoded[i + c] - source[i + c];
+                squaredError += d * d;
+            }
+        }
+
+        const double mse = squaredError / ((double)(decoded.size() / 4) * channels);
+        return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+    }
+}
+
+bool BlockCompressionBenchmark()
+{
+    const uint32 formats[] =
+    {
+        DdsFile::FormatBC1Unorm, DdsFile::FormatBC2Unorm, DdsFile::FormatBC3Unorm,
+        DdsFile::FormatBC4Unorm, DdsFile::FormatBC5Unorm, DdsFile::FormatBC7Unorm
+    };
+
+    const uint32 knownCount = (uint32)(sizeof(KnownBlocks) / sizeof(KnownBlocks[0]));
+    const uint32 wrongKnown = CountWrongKnownBlocks();
+    std::printf("known blocks: %u of %u decoded exactly%s\n", knownCount - wrongKnown, knownCount,
+        wrongKnown == 0 ? "" : "  FAILED");
+    bool passed = wrongKnown == 0;
+
+    Benchmark::Random random(12345);
+    const std::vector<uint8> image = CreateImage(ImageSize, random);
+
+    // BC1's alpha is a single bit; it is measured on the opaque image.
+    std::vector<uint8> opaque = image;
+    for(size_t i = 3; i < opaque.size(); i += 4)
+        opaque[i] = 255;
+
+    const double megapixels = (double)ImageSize * ImageSize / 1.0e6;
+    const uint32 blocksWide = (ImageSize + 3) / 4;
+    std::vector<uint8> decoded(image.size());
+
+    for(uint32 format : formats)
+    {
+        const bool bc1 = format == DdsFile::FormatBC1Unorm;
+        const std::vector<uint8>& source = bc1 ? opaque : image;
+        const uint32 blockSize = BlockCompression::BlockSize(format);
+        std::vector<uint8> blocks((size_t)blocksWide * blocksWide * blockSize);
+
+        double encodeMs = 0.0;
+        if(BlockCompression::CanEncode(format))
+        {
+            encodeMs = Benchmark::BestOf(3, [&]()
+            {
+                BlockCompression::Encode(format, source.data(), ImageSize, ImageSize, blocks.data());
+            });
+        }
+        else
+        {
+            // Random blocks, with the BC7 modes spread evenly.
+            for(uint8& b : blocks)
+                b = (uint8)(random.Next() >> 16);
+            if(format == DdsFile::FormatBC7Unorm)
+            {
+                for(size_t i = 0; i < blocks.size(); i += blockSize)
+                {
+                    const uint32 mode = (uint32)(i / blockSize) % 8;
+                    blocks[i] = (uint8)((blocks[i] << (mode + 1)) | (1u << mode));
+                }
+            }
+        }
+
+        bool decodedAll = true;
+        const double decodeMs = Benchmark::BestOf(3, [&]()
+        {
+            decodedAll &= BlockCompression::Decode(format, blocks.data(), ImageSize, ImageSize, decoded.data());
+        });
+
+        std::printf("format %2u: decode %8.1f MP/s", format, megapixels / decodeMs * 1000.0);
+        if(!decodedAll)
+        {
+            std::printf("  FAILED to decode\n");
+            passed = false;
+            continue;
+        }
+
+        if(!BlockCompression::CanEncode(format))
+        {
+            std::printf("\n");
+            continue;
+        }
+
+        const uint32 channels = format == DdsFile::FormatBC4Unorm ? 1 : format == DdsFile::FormatBC5Unorm ? 2 : bc1 ? 3 : 4;
+        const double psnr = Psnr(source, decoded, channels);
+        std::printf(", encode %8.1f MP/s, %.2f dB%s\n", megapixels / encodeMs * 1000.0, psnr, psnr >= MinPsnr ? "" : "  FAILED");
+        if(psnr < MinPsnr)
+            passed = false;
+    }
+
+    return passed;
+}
@@ -0,0 +1,99 @@
+//***************************************************************************************
+// ChunkedTerrainBenchmark.cpp
+//
+// Times ChunkedTerrain on the hills of LandAndWaves for several world sizes: how fast
+// chunks are generated while a view loads, and what Update() costs once everything
+// it selects is resident, which is culling and LOD selection alone.
+//***************************************************************************************
+
+#include "Benchmark.h"
+#include "../Common/ChunkedTerrain.h"
+#include <cmath>
+#include <cstdio>
+
+using namespace DirectX;
+
+namespace
+{
+    float HillHeight(float x, float z)
+    {
+        return 0.3f*(z*std::sin(0.1f*x) + x*std::cos(0.1f*z));
+    }
+
+    XMFLOAT4X4 ViewProj(const XMFLOAT3& eye, const XMFLOAT3& target)
+    {
+        XMMATRIX view = XMMatrixLookAtLH(XMLoadFloat3(&eye), XMLoadFloat3(&target), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+        XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f*XM_PI, 16.0f/9.0f, 1.0f, 4000.0f);
+
+        XMFLOAT4X4 viewProj;
+        XMStoreFloat4x4(&viewProj, XMMatrixMultiply(view, proj));
+        return viewProj;
+    }
+
+    bool Run(float worldSize, ChunkedTerrain::uint32 maxDepth)
+    {
+        TerrainDesc desc;
+        desc.WorldSize = worldSize;
+        desc.MaxDepth = maxDepth;
+        desc.MaxResidentChunks = 1024;
+        desc.MaxPendingChunks = 64;
+        desc.Height = HillHeight;
+
+        ChunkedTerrain terrain(desc);
+        if(terrain.CompletedSlots().size() != 1)
+        {
+            std::printf("the root chunk is not reported as completed\n");
+            return false;
+        }
+        terrain.ClearCompletedSlots();
+
+        const XMFLOAT3 eye(0.0f, 60.0f, -100.0f);
+        const XMFLOAT4X4 viewProj = ViewProj(eye, XMFLOAT3(0.0f, 0.0f, 200.0f));
+
+        // Load the view: update until nothing is requested or pending any more.
+        ChunkedTerrain::uint32 generated = 0;
+        const double loadMs = Benchmark::BestOf(1, [&]()
+        {
+            do
+            {
+                terrain.Update(eye, viewProj);
+                generated += terrain.Stats().ChunksCompleted;
+            } while(terrain.Stats().ChunksRequested > 0 || terrain.Stats().ChunksPending > 0);
+        });
+
+        for(const TerrainDrawChunk& chunk : terrain.VisibleChunks())
+        {
+            if(chunk.Slot >= terrain.SlotCount())
+            {
+                std::printf("visible chunk without a slot\n");
+                return false;
+            }
+        }
+
+        // Everything selected is resident now, so Update() only culls and selects.
+        const int frames = 1000;
+        const double selectMs = Benchmark::BestOf(3, [&]()
+        {
+            for(int frame = 0; frame < frames; ++frame)
+                terrain.Update(eye, viewProj);
+        });
+
+        const TerrainStats& stats = terrain.Stats();
+        std::printf("world %6.0f depth %u: load %7.2f ms (%4u chunks, %7.1f chunks/s)  "
+            "Update %6.2f us  visited %4u culled %4u drawn %4u\n",
+            worldSize, maxDepth, loadMs, generated, generated/(loadMs/1000.0),
+            1000.0*selectMs/frames, stats.NodesVisited, stats.NodesCulled, stats.ChunksDrawn);
+        return true;
+    }
+}
+
+bool ChunkedTerrainBenchmark()
+{
+    // Same leaf size each time: a bigger world only adds levels above the view.
+    bool passed = true;
+    passed = Run(512.0f, 5) && passed;
+    passed = Run(2048.0f, 7) && passed;
+    passed = Run(8192.0f, 9) && passed;
+    passed = Run(32768.0f, 11) && passed;
+    return passed;
+}
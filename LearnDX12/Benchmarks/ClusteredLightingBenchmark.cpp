@@ -0,0 +1,94 @@
+//***************************************************************************************
+// ClusteredLightingBenchmark.cpp
+//
+// Times LightClusterBuilder::Build() with small point and spot lights spread through
+// the first 300 units of the default grid's frustum, half of them spots, and checks
+// that the cluster holding each light's position lists it.
+//***************************************************************************************
+
+#include "Benchmark.h"
+#include "../Common/ClusteredLighting.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+    std::vector<ShadingLight> CreateLights(const ClusterGridDesc& grid, std::uint32_t count, Benchmark::Random& random)
+    {
+        const float tanHalfY = std::tan(0.5f * grid.FovY);
+
+        std::vector<ShadingLight> lights(count);
+        for(ShadingLight& L : lights)
+        {
+            const float z = grid.NearZ + random.Float(0.0f, 300.0f);
+            L.Position = XMFLOAT3(random.Float(-1.0f, 1.0f) * z * tanHalfY * grid.Aspect,
+                random.Float(-1.0f, 1.0f) * z * tanHalfY, z);
+            L.FalloffStart = 0.5f;
+            L.FalloffEnd = random.Float(1.0f, 5.0f);
+
+            XMFLOAT3 d(random.Float(-0.5f, 0.5f), -1.0f, random.Float(-0.5f, 0.5f));
+            XMStoreFloat3(&L.Direction, XMVector3Normalize(XMLoadFloat3(&d)));
+            L.SpotPower = random.Float(4.0f, 64.0f);
+        }
+        return lights;
+    }
+
+    // Every light lies inside its own range, so whatever the culling, the cluster at its
+    // position has to list it.  The view is the identity, so positions are view space.
+    size_t CountMissing(const LightClusterBuilder& builder, const std::vector<ShadingLight>& lights)
+    {
+        size_t missing = 0;
+        for(std::uint32_t i = 0; i < (std::uint32_t)lights.size(); ++i)
+        {
+            const std::uint32_t cluster = builder.ClusterOf(lights[i].Position);
+            if(cluster == UINT32_MAX)
+                continue;
+
+            const LightClusterBuilder::Range& range = builder.Ranges()[cluster];
+            const auto first = builder.LightIndices().begin() + range.Offset;
+            if(std::find(first, first + range.Count, i) == first + range.Count)
+                ++missing;
+        }
+        return missing;
+    }
+}
+
+bool ClusteredLightingBenchmark()
+{
+    LightClusterBuilder builder;
+    const ClusterGridDesc& grid = builder.Grid();
+
+    XMFLOAT4X4 view;
+    XMStoreFloat4x4(&view, XMMatrixIdentity());
+
+    std::printf("%u x %u x %u clusters\n", grid.TilesX, grid.TilesY, grid.Slices);
+
+    Benchmark::Random random(12345);
+    bool passed = true;
+    for(std::uint32_t count : { 64u, 256u, 1024u, 4096u })
+    {
+        const std::vector<ShadingLight> lights = CreateLights(grid, count, random);
+        const std::uint32_t numPointLights = count / 2;
+
+        const double ms = Benchmark::BestOf(3, [&]()
+        {
+            builder.Build(view, lights.data(), numPointLights, count - numPointLights);
+        });
+
+        const size_t missing = CountMissing(builder, lights);
+        std::printf("%5u lights: %8.3f ms, %8zu indices, at most %u per cluster%s\n", count, ms,
+            builder.LightIndices().size(), builder.MaxLightsPerCluster(), missing == 0 ? "" : "  FAILED");
+
+        if(missing != 0)
+        {
+            std::printf("  %zu lights missing from their own cluster\n", missing);
+            passed = false;
+        }
+    }
+
+    return passed;
+}
@@ -0,0 +1,161 @@
+//***************************************************************************************
+// GeometryPackerBenchmark.cpp
+//
+// Packs 1,000 generated meshes into one vertex and one index buffer, with the
+// GeometryPacker and with the hand written concatenation the samples used before it,
+// and reports the time and the peak heap of each.
+//***************************************************************************************
+
+#include "Benchmark.h"
+#include "../Common/GeometryPacker.h"
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+    typedef GeometryGenerator::MeshData MeshData;
+
+    const int MeshCount = 1000;
+
+    // The vertex of the lit samples.
+    struct Vertex
+    {
+        XMFLOAT3 Pos;
+        XMFLOAT3 Normal;
+    };
+
+    std::vector<MeshData> CreateMeshes()
+    {
+        GeometryGenerator geoGen;
+        Benchmark::Random random(27);
+
+        std::vector<MeshData> meshes;
+        meshes.reserve(MeshCount);
+        for(int i = 0; i < MeshCount; ++i)
+        {
+            const GeometryGenerator::uint32 detail = 8 + random.Next() % 24;
+            switch(i % 4)
+            {
+            case 0: meshes.push_back(geoGen.CreateBox(1.0f, 1.0f, 1.0f, detail % 4)); break;
+            case 1: meshes.push_back(geoGen.CreateSphere(0.5f, detail, detail)); break;
+            case 2: meshes.push_back(geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, detail, detail)); break;
+            case 3: meshes.push_back(geoGen.CreateGrid(20.0f, 30.0f, detail, detail)); break;
+            }
+        }
+        return meshes;
+    }
+
+    struct Packed
+    {
+        std::vector<std::uint8_t> Vertices;
+        std::vector<std::uint8_t> Indices;
+    };
+
+    void PackWithPacker(const std::vector<MeshData>& meshes, Packed& packed)
+    {
+        GeometryPacker packer({ { VertexAttribute::Position, offsetof(Vertex, Pos) },
+                                { VertexAttribute::Normal, offsetof(Vertex, Normal) } }, sizeof(Vertex));
+        for(size_t i = 0; i < meshes.size(); ++i)
+            packer.Add("mesh" + std::to_string(i), meshes[i]);
+
+        // Stand-ins for the CPU blobs, written once.
+        packed.Vertices.resize(packer.VertexBufferByteSize());
+        packed.Indices.resize(packer.IndexBufferByteSize());
+        packer.Write(packed.Vertices.data(), packed.Indices.data());
+    }
+
+    // What BuildShapeGeometry did: a vertex vector, a 16-bit index vector grown mesh by
+    // mesh, and copies of both for the blobs.
+    void PackByHand(const std::vector<MeshData>& meshes, Packed& packed)
+    {
+        size_t totalVertexCount = 0;
+        for(const MeshData& mesh : meshes)
+            totalVertexCount += mesh.Vertices.size();
+
+        std::vector<Vertex> vertices(totalVertexCount);
+        std::vector<std::uint16_t> indices;
+        std::vector<std::string> names;
+
+        size_t k = 0;
+        for(size_t i = 0; i < meshes.size(); ++i)
+        {
+            for(const GeometryGenerator::Vertex& v : meshes[i].Vertices)
+            {
+                vertices[k].Pos = v.Position;
+                vertices[k].Normal = v.Normal;
+                ++k;
+            }
+
+            // GetIndices16() of a fresh mesh.
+            const std::vector<std::uint16_t> indices16(meshes[i].Indices32.begin(), meshes[i].Indices32.end());
+            indices.insert(indices.end(), indices16.begin(), indices16.end());
+
+            names.push_back("mesh" + std::to_string(i));
+        }
+
+        const size_t vbByteSize = vertices.size()*sizeof(Vertex);
+        const size_t ibByteSize = indices.size()*sizeof(std::uint16_t);
+
+        packed.Vertices.resize(vbByteSize);
+        std::memcpy(packed.Vertices.data(), vertices.data(), vbByteSize);
+        packed.Indices.resize(ibByteSize);
+        std::memcpy(packed.Indices.data(), indices.data(), ibByteSize);
+    }
+
+    // Milliseconds, best of three, and the heap above what was in use before.
+    template<typename Pack>
+    void Measure(const char* name, const std::vector<MeshData>& meshes, Pack pack, Packed& packed)
+    {
+        const size_t before = Benchmark::HeapBytes();
+        Benchmark::ResetPeakHeapBytes();
+        {
+            Packed first;
+            pack(meshes, first);
+        }
+        const size_t peak = Benchmark::PeakHeapBytes() - before;
+
+        const double ms = Benchmark::BestOf(3, [&]()
+        {
+            Packed run;
+            pack(meshes, run);
+            packed = std::move(run);
+        });
+
+        std::printf("%-8s %8.2f ms %10.2f MB peak\n", name, ms, peak / (1024.0*1024.0));
+    }
+}
+
+bool GeometryPackerBenchmark()
+{
+    const std::vector<MeshData> meshes = CreateMeshes();
+
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+    for(const MeshData& mesh : meshes)
+    {
+        vertexCount += mesh.Vertices.size();
+        indexCount += mesh.Indices32.size();
+    }
+    std::printf("%d meshes, %zu vertices, %zu indices, %u pool threads\n",
+        MeshCount, vertexCount, indexCount, ThreadPool::Default().ThreadCount());
+
+    Packed packed;
+    Packed byHand;
+    Measure("packer", meshes, PackWithPacker, packed);
+    Measure("by hand", meshes, PackByHand, byHand);
+
+    const size_t outputBytes = packed.Vertices.size() + packed.Indices.size();
+    std::printf("output   %10.2f MB\n", outputBytes / (1024.0*1024.0));
+
+    if(packed.Vertices != byHand.Vertices || packed.Indices != byHand.Indices)
+    {
+        std::printf("packer output differs from the hand written concatenation\n");
+        return false;
+    }
+    return true;
+}
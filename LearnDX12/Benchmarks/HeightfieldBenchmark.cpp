@@ -0,0 +1,131 @@
+//***************************************************************************************
+// HeightfieldBenchmark.cpp
+//
+// Checks the four-wide HillsHeightfield batches against the point queries, which call
+// sinf/cosf, at the error bounds documented in Heightfield.h, and times both.
+//***************************************************************************************
+
+#include "Benchmark.h"
+#include "../Common/Heightfield.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+    // Heightfield.h: heights within 1e-7*(|x| + |z|), normals within 5e-7 per
+    // component, for |x|, |z| up to 80000.
+    const float HeightTolerance = 1e-7f;
+    const float NormalTolerance = 5e-7f;
+    const float MaxCoordinate = 80000.0f;
+
+    struct Points
+    {
+        std::vector<float> X;
+        std::vector<float> Z;
+    };
+
+    // A grid around the origin, where the samples go in the demos, and random points
+    // over the whole documented range.  Odd counts leave a partial quad at the end.
+    Points CreatePoints()
+    {
+        Points points;
+
+        const int n = 1023;
+        for(int i = 0; i < n; ++i)
+        {
+            for(int j = 0; j < n; ++j)
+            {
+                points.X.push_back(-512.0f + j + 0.25f);
+                points.Z.push_back(-512.0f + i + 0.5f);
+            }
+        }
+
+        Benchmark::Random random(33);
+        for(int i = 0; i < 1000001; ++i)
+        {
+            points.X.push_back(random.Float(-MaxCoordinate, MaxCoordinate));
+            points.Z.push_back(random.Float(-MaxCoordinate, MaxCoordinate));
+        }
+        return points;
+    }
+
+    bool Check(const HillsHeightfield& hills, const Points& points, const std::vector<float>& y, const std::vector<XMFLOAT3>& n)
+    {
+        // Worst error as a fraction of what the bound allows at that point.
+        double heightRatio = 0.0;
+        double normalRatio = 0.0;
+        size_t failures = 0;
+        for(size_t i = 0; i < y.size(); ++i)
+        {
+            const float x = points.X[i];
+            const float z = points.Z[i];
+
+            const float h = hills.Height(x, z);
+            const double heightBound = std::max(HeightTolerance*(std::fabs(x) + std::fabs(z)), 1e-30f);
+            const double heightError = std::fabs(y[i] - h);
+            heightRatio = std::max(heightRatio, heightError/heightBound);
+
+            const XMFLOAT3 m = hills.Normal(x, z);
+            const double normalError = std::max(std::fabs(n[i].x - m.x), std::max(std::fabs(n[i].y - m.y), std::fabs(n[i].z - m.z)));
+            normalRatio = std::max(normalRatio, normalError/NormalTolerance);
+
+            if(heightError > heightBound || normalError > NormalTolerance)
+            {
+                if(failures++ < 10)
+                {
+                    std::printf("(%g, %g): height %.9g, expected %.9g; normal (%.9g, %.9g, %.9g), expected (%.9g, %.9g, %.9g)\n",
+                        x, z, y[i], h, n[i].x, n[i].y, n[i].z, m.x, m.y, m.z);
+                }
+            }
+        }
+
+        std::printf("worst error / bound: heights %.3f, normals %.3f\n", heightRatio, normalRatio);
+        return failures == 0;
+    }
+}
+
+bool HeightfieldBenchmark()
+{
+    const Points points = CreatePoints();
+    const size_t count = points.X.size();
+
+    HillsHeightfield hills;
+    std::vector<float> y(count);
+    std::vector<XMFLOAT3> n(count);
+
+    const double pointMs = Benchmark::BestOf(3, [&]()
+    {
+        for(size_t i = 0; i < count; ++i)
+        {
+            y[i] = hills.Height(points.X[i], points.Z[i]);
+            n[i] = hills.Normal(points.X[i], points.Z[i]);
+        }
+    });
+
+    // Slices of BatchGrain points stay on the calling thread, so this compares the
+    // four-wide path with the point queries, not the thread count.
+    const double serialMs = Benchmark::BestOf(3, [&]()
+    {
+        for(size_t i = 0; i < count; i += Heightfield::BatchGrain)
+        {
+            const size_t slice = std::min(Heightfield::BatchGrain, count - i);
+            hills.Heights(&points.X[i], &points.Z[i], &y[i], slice);
+            hills.Normals(&points.X[i], &points.Z[i], &n[i], slice);
+        }
+    });
+
+    const double batchMs = Benchmark::BestOf(3, [&]()
+    {
+        hills.Heights(points.X.data(), points.Z.data(), y.data(), count);
+        hills.Normals(points.X.data(), points.Z.data(), n.data(), count);
+    });
+
+    std::printf("%zu heights and normals: points %.2f ms, batch on 1 thread %.2f ms, batch on the pool (%u workers) %.2f ms\n",
+        count, pointMs, serialMs, ThreadPool::Default().ThreadCount(), batchMs);
+
+    return Check(hills, points, y, n);
+}
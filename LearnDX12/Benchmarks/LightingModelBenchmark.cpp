@@ -0,0 +1,113 @@
+//***************************************************************************************
+// LightingModelBenchmark.cpp
+//
+// Shades random points against a typical light set (three directional, four point and
+// four spot lights) with the scalar reference, the batches on one thread and the
+// batches on the pool, and checks the batches against the reference.
+//***************************************************************************************
+
+#include "Benchmark.h"
+#include "../Common/LightingModel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+    // The batches compute pow() from log2 and exp2 estimates; colors are within this
+    // of the reference, relative to max(1, reference).
+    const float Tolerance = 1e-4f;
+
+    XMFLOAT3 Normalize(const XMFLOAT3& v)
+    {
+        const float length = std::sqrt(v.x*v.x + v.y*v.y + v.z*v.z);
+        return XMFLOAT3(v.x/length, v.y/length, v.z/length);
+    }
+}
+
+bool LightingModelBenchmark()
+{
+    const size_t pointCount = 1 << 18;
+
+    ShadingLight lights[11];
+    lights[0].Direction = { 0.57735f, -0.57735f, 0.57735f };
+    lights[0].Strength = { 0.6f, 0.6f, 0.6f };
+    lights[1].Direction = { -0.57735f, -0.57735f, 0.57735f };
+    lights[1].Strength = { 0.3f, 0.3f, 0.3f };
+    lights[2].Direction = { 0.0f, -0.707f, -0.707f };
+    lights[2].Strength = { 0.15f, 0.15f, 0.15f };
+    for(int i = 0; i < 8; ++i)
+    {
+        ShadingLight& L = lights[3 + i];
+        const float angle = i * 0.785398f;
+        L.Position = { 8.0f * std::cos(angle), 4.0f, 8.0f * std::sin(angle) };
+        L.Direction = { 0.0f, -1.0f, 0.0f };
+        L.Strength = { 0.8f, 0.7f, 0.5f };
+        L.FalloffStart = 2.0f;
+        L.FalloffEnd = 12.0f;
+        L.SpotPower = 16.0f;
+    }
+    LightingModel model(lights, 3, 4, 4);
+
+    ShadingMaterial mat;
+    mat.DiffuseAlbedo = { 0.8f, 0.6f, 0.4f, 1.0f };
+    mat.FresnelR0 = { 0.05f, 0.05f, 0.05f };
+    mat.Shininess = 0.7f;
+
+    // Points on a 20x20 patch with normals tilted at random.
+    Benchmark::Random random(12345);
+    std::vector<XMFLOAT3> positions(pointCount);
+    std::vector<XMFLOAT3> normals(pointCount);
+    for(size_t i = 0; i < pointCount; ++i)
+    {
+        positions[i] = XMFLOAT3(random.Float(-10.0f, 10.0f), random.Float(0.0f, 2.0f), random.Float(-10.0f, 10.0f));
+        normals[i] = Normalize(XMFLOAT3(random.Float(-0.5f, 0.5f), 1.0f, random.Float(-0.5f, 0.5f)));
+    }
+    const XMFLOAT3 eyePos(0.0f, 10.0f, -15.0f);
+
+    std::vector<XMFLOAT3> reference(pointCount);
+    std::vector<XMFLOAT3> colors(pointCount);
+
+    const double scalarMs = Benchmark::BestOf(3, [&]()
+    {
+        for(size_t i = 0; i < pointCount; ++i)
+        {
+            const XMFLOAT3 toEye = Normalize(XMFLOAT3(eyePos.x - positions[i].x, eyePos.y - positions[i].y, eyePos.z - positions[i].z));
+            reference[i] = model.Shade(mat, positions[i], normals[i], toEye);
+        }
+    });
+
+    const double serialMs = Benchmark::BestOf(3, [&]()
+    {
+        model.ShadeSerial(mat, positions.data(), normals.data(), eyePos, colors.data(), pointCount);
+    });
+
+    const double threadedMs = Benchmark::BestOf(3, [&]()
+    {
+        model.Shade(mat, positions.data(), normals.data(), eyePos, colors.data(), pointCount);
+    });
+
+    std::printf("%zu points, %s lanes: scalar %.2f ms, batch on 1 thread %.2f ms, batch on the pool (%u workers) %.2f ms\n",
+        pointCount, LightingModel::UsesAvx() ? "AVX" : "DirectXMath", scalarMs, serialMs,
+        ThreadPool::Default().ThreadCount(), threadedMs);
+
+    float worst = 0.0f;
+    size_t failures = 0;
+    for(size_t i = 0; i < pointCount; ++i)
+    {
+        const XMFLOAT3& c = colors[i];
+        const XMFLOAT3& r = reference[i];
+        const float error = std::max(std::fabs(c.x - r.x) / std::max(1.0f, r.x),
+            std::max(std::fabs(c.y - r.y) / std::max(1.0f, r.y), std::fabs(c.z - r.z) / std::max(1.0f, r.z)));
+        worst = std::max(worst, error);
+
+        if(error > Tolerance && failures++ < 10)
+            std::printf("point %zu: (%.7g, %.7g, %.7g), expected (%.7g, %.7g, %.7g)\n", i, c.x, c.y, c.z, r.x, r.y, r.z);
+    }
+
+    std::printf("worst relative error %.3g (tolerance %g)\n", worst, Tolerance);
+    return failures == 0;
+}
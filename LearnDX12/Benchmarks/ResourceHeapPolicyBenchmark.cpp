@@ -0,0 +1,157 @@
+//***************************************************************************************
+// ResourceHeapPolicyBenchmark.cpp
+//
+// Churns 200,000 allocations and frees of buffers and textures, 64KB to 16MB with
+// small sizes the most common and some 4MB aligned, for a few heap sizes; then runs
+// one Defragment() per type allowed to move half of what is in use.  After the churn
+// and after the moves, the live allocations are checked for overlaps, alignment and
+// heap types.
+//***************************************************************************************
+
+#include "Benchmark.h"
+#include "../Common/ResourceHeapPolicy.h"
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    using uint32 = ResourceHeapPolicy::uint32;
+    using uint64 = ResourceHeapPolicy::uint64;
+    using Allocation = ResourceHeapPolicy::Allocation;
+
+    const uint32 Operations = 200000;
+
+    // A random walk around a couple of thousand live resources, the same every call.
+    void Churn(ResourceHeapPolicy& policy, std::vector<Allocation>& live)
+    {
+        Benchmark::Random random(12345);
+        for(uint32 op = 0; op < Operations; ++op)
+        {
+            const bool allocate = live.size() < 1000 || (live.size() < 3000 && (random.Next() & 1));
+            if(allocate)
+            {
+                const uint32 kind = random.Next() % 10;
+                const ResourceHeapPolicy::Type type = kind < 5 ? ResourceHeapPolicy::Buffers :
+                    kind < 9 ? ResourceHeapPolicy::Textures : ResourceHeapPolicy::RenderTargets;
+                const uint64 alignment = type == ResourceHeapPolicy::RenderTargets ?
+                    ResourceHeapPolicy::LargeAlignment : ResourceHeapPolicy::SmallAlignment;
+
+                // Mostly small: 64KB times 1 to 256, cubed towards the low end.
+                const double r = (random.Next() & 0xffff) / 65536.0;
+                const uint64 size = ResourceHeapPolicy::SmallAlignment * (1 + (uint64)(r * r * r * 255));
+                live.push_back(policy.Allocate(type, size, alignment));
+            }
+            else
+            {
+                const size_t i = random.Next() % live.size();
+                policy.Free(live[i]);
+                live[i] = live.back();
+                live.pop_back();
+            }
+        }
+    }
+
+    // Allocations that overlap another one, sit in a released heap or one of another
+    // type, run past their heap, or miss their alignment.
+    size_t CountBroken(const ResourceHeapPolicy& policy, const std::vector<Allocation>& live)
+    {
+        size_t broken = 0;
+
+        std::vector<const Allocation*> sorted;
+        for(const Allocation& a : live)
+        {
+            const uint64 alignment = a.Kind == ResourceHeapPolicy::RenderTargets ?
+                ResourceHeapPolicy::LargeAlignment : ResourceHeapPolicy::SmallAlignment;
+            if(!a.Valid() || !policy.HeapLive(a.Heap) || policy.HeapType(a.Heap) != a.Kind ||
+                a.Offset + a.Size > policy.HeapSize(a.Heap) || a.Offset % alignment != 0)
+            {
+                ++broken;
+                continue;
+            }
+            sorted.push_back(&a);
+        }
+
+        std::sort(sorted.begin(), sorted.end(), [](const Allocation* a, const Allocation* b)
+        {
+            return a->Heap != b->Heap ? a->Heap < b->Heap : a->Offset < b->Offset;
+        });
+        for(size_t i = 1; i < sorted.size(); ++i)
+        {
+            if(sorted[i]->Heap == sorted[i - 1]->Heap && sorted[i - 1]->Offset + sorted[i - 1]->Size > sorted[i]->Offset)
+                ++broken;
+        }
+
+        if(policy.GetStats(ResourceHeapPolicy::TypeCount).AllocationCount != live.size())
+            ++broken;
+        return broken;
+    }
+}
+
+bool ResourceHeapPolicyBenchmark()
+{
+    bool passed = true;
+    for(uint64 heapSize : { 32ull << 20, 64ull << 20, 256ull << 20 })
+    {
+        ResourceHeapPolicy::Config config;
+        config.HeapSize = heapSize;
+
+        std::unique_ptr<ResourceHeapPolicy> policy;
+        std::vector<Allocation> live;
+        const double ms = Benchmark::BestOf(3, [&]()
+        {
+            policy.reset(new ResourceHeapPolicy(config));
+            live.clear();
+            Churn(*policy, live);
+        });
+
+        const ResourceHeapPolicy::Stats before = policy->GetStats(ResourceHeapPolicy::TypeCount);
+        const size_t brokenBefore = CountBroken(*policy, live);
+
+        // Carry out the moves at once, as if every copy had already executed.
+        std::map<std::pair<uint32, uint64>, size_t> liveIndex;
+        for(size_t i = 0; i < live.size(); ++i)
+            liveIndex[std::make_pair(live[i].Heap, live[i].Offset)] = i;
+
+        uint64 movedBytes = 0;
+        uint32 releasedHeaps = 0;
+        size_t unknownMoves = 0;
+        for(uint32 t = 0; t < ResourceHeapPolicy::TypeCount; ++t)
+        {
+            const ResourceHeapPolicy::Type type = (ResourceHeapPolicy::Type)t;
+            for(const ResourceHeapPolicy::Move& move : policy->Defragment(type, policy->GetStats(type).UsedBytes / 2))
+            {
+                auto it = liveIndex.find(std::make_pair(move.From.Heap, move.From.Offset));
+                if(it == liveIndex.end())
+                {
+                    ++unknownMoves;
+                    continue;
+                }
+                live[it->second] = move.To;
+
+                movedBytes += move.From.Size;
+                if(policy->Free(move.From))
+                    releasedHeaps++;
+            }
+        }
+        const ResourceHeapPolicy::Stats after = policy->GetStats(ResourceHeapPolicy::TypeCount);
+        const size_t broken = brokenBefore + unknownMoves + CountBroken(*policy, live);
+
+        std::printf("%4llu MB heaps: %6.1f ns/op, %u allocations in %u heaps, %.1f%% used, fragmentation %.3f; "
+            "defragment moved %llu MB, released %u heaps, %.1f%% used, fragmentation %.3f%s\n",
+            (unsigned long long)(heapSize >> 20), ms * 1e6 / Operations, before.AllocationCount, before.HeapCount,
+            100.0 * before.Utilization(), before.Fragmentation(), (unsigned long long)(movedBytes >> 20), releasedHeaps,
+            100.0 * after.Utilization(), after.Fragmentation(), broken == 0 ? "" : "  FAILED");
+
+        if(broken != 0)
+        {
+            std::printf("  %zu broken allocations or moves\n", broken);
+            passed = false;
+        }
+    }
+
+    return passed;
+}
@@ -0,0 +1,183 @@
+//***************************************************************************************
+// TextureLoadQueueBenchmark.cpp
+//
+// Writes 300 BC1 DDS files of 64 to 1024 texels with full mip chains to a scratch
+// directory, then submits them with random priorities, along with 10 paths that do
+// not exist, raises or lowers a third of them and cancels a tenth while they wait,
+// and drains the completions as a frame loop would.  Reports files and megabytes per
+// second and the queue latency from GetStats().
+//
+// The files were just written, so they are read from the file cache: this measures
+// the queue and the mapping rather than the disk.  Every ticket has to come back from
+// Poll() exactly once unless it was cancelled, and the stats have to add up.
+//***************************************************************************************
+
+#include "Benchmark.h"
+#include "../Common/TextureLoadQueue.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    using uint8 = std::uint8_t;
+    using uint32 = TextureLoadQueue::uint32;
+    using uint64 = TextureLoadQueue::uint64;
+
+    const uint32 FileCount = 300;
+    const uint32 MissingCount = 10;
+    const char* Directory = "TextureLoadQueueBenchmark.tmp";
+
+    void MakeDirectory(const std::string& path)
+    {
+#ifdef _WIN32
+        _mkdir(path.c_str());
+#else
+        mkdir(path.c_str(), 0755);
+#endif
+    }
+
+    void RemoveEmptyDirectory(const std::string& path)
+    {
+#ifdef _WIN32
+        _rmdir(path.c_str());
+#else
+        rmdir(path.c_str());
+#endif
+    }
+
+    // Writes the files and returns their paths, or nothing if one could not be written.
+    std::vector<std::string> WriteFiles(Benchmark::Random& random)
+    {
+        std::vector<std::string> paths;
+        std::vector<uint8> data;
+        for(uint32 i = 0; i < FileCount; ++i)
+        {
+            DdsFile::Info info;
+            info.Width = 64u << (random.Next() % 5);
+            info.Height = 64u << (random.Next() % 5);
+            info.Format = DdsFile::FormatBC1Unorm;
+            info.MipCount = 1;
+            while((info.Width >> info.MipCount) > 0 || (info.Height >> info.MipCount) > 0)
+                info.MipCount++;
+
+            data.assign((size_t)DdsFile::DataSize(info), (uint8)i);
+            paths.push_back(std::string(Directory) + "/" + std::to_string(i) + ".dds");
+            if(!DdsFile::Save(paths.back(), info, data.data()))
+            {
+                std::printf("  could not write %s\n", paths.back().c_str());
+                return std::vector<std::string>();
+            }
+        }
+        return paths;
+    }
+}
+
+bool TextureLoadQueueBenchmark()
+{
+    Benchmark::Random random(12345);
+    MakeDirectory(Directory);
+    const std::vector<std::string> paths = WriteFiles(random);
+    if(paths.empty())
+        return false;
+
+    // What each ticket should come back as: true for a file that exists.
+    std::unordered_map<uint32, bool> outstanding;
+    uint32 cancelled = 0;
+    uint32 reprioritised = 0;
+    uint32 polled = 0;
+    uint32 failures = 0;
+    uint64 submitted = 0;
+
+    TextureLoadQueue::Stats stats;
+    const auto start = std::chrono::steady_clock::now();
+    {
+        TextureLoadQueue queue;
+
+        std::vector<uint32> tickets;
+        for(uint32 i = 0; i < FileCount + MissingCount; ++i)
+        {
+            const bool exists = i < FileCount;
+            const std::string path = exists ? paths[i] : std::string(Directory) + "/missing" + std::to_string(i) + ".dds";
+            const uint32 ticket = queue.Submit(path, random.Float(0.0f, 1000.0f));
+            if(outstanding.count(ticket) != 0)
+                ++failures;
+            outstanding[ticket] = exists;
+            tickets.push_back(ticket);
+            ++submitted;
+        }
+
+        // As the camera moves: some requests matter more, some less, some no longer.
+        for(uint32 ticket : tickets)
+        {
+            const uint32 roll = random.Next() % 30;
+            if(roll < 10 && queue.SetPriority(ticket, random.Float(0.0f, 1000.0f)))
+                ++reprioritised;
+            else if(roll >= 27 && queue.Cancel(ticket))
+            {
+                outstanding.erase(ticket);
+                ++cancelled;
+            }
+        }
+
+        // Drain once a millisecond until every ticket is back, for at most a minute.
+        std::vector<TextureLoadQueue::LoadedFile> completed;
+        while(!outstanding.empty() && std::chrono::steady_clock::now() - start < std::chrono::seconds(60))
+        {
+            completed.clear();
+            if(queue.Poll(completed) == 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+            for(const TextureLoadQueue::LoadedFile& file : completed)
+            {
+                auto it = outstanding.find(file.Ticket);
+                if(it == outstanding.end() || it->second != file.Succeeded)
+                    ++failures;
+                else
+                    outstanding.erase(it);
+                ++polled;
+            }
+        }
+
+        failures += (uint32)outstanding.size() + queue.OutstandingCount();
+        stats = queue.GetStats();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for(const std::string& path : paths)
+        std::remove(path.c_str());
+    RemoveEmptyDirectory(Directory);
+
+    // Every request is accounted for once, and as the loads came back.
+    const uint64 loads = stats.Completed + stats.Failed;
+    if(stats.Submitted != submitted || loads + stats.Cancelled != stats.Submitted ||
+        stats.Cancelled != cancelled || loads != polled)
+        ++failures;
+
+    std::printf("%llu files: %.0f files/s, %.1f MB/s; queue latency mean %.3f ms, max %.3f ms; load mean %.3f ms; "
+        "%u reprioritised, %u cancelled, %llu failed%s\n",
+        (unsigned long long)submitted, stats.Completed / seconds, stats.BytesRead / seconds / (1 << 20),
+        loads > 0 ? 1e3 * stats.TotalQueueSeconds / loads : 0.0, 1e3 * stats.MaxQueueSeconds,
+        loads > 0 ? 1e3 * stats.TotalLoadSeconds / loads : 0.0, reprioritised, cancelled,
+        (unsigned long long)stats.Failed, failures == 0 ? "" : "  FAILED");
+
+    if(failures != 0)
+    {
+        std::printf("  %u tickets lost, duplicated or wrong; submitted %llu, completed %llu, failed %llu, cancelled %llu\n",
+            failures, (unsigned long long)stats.Submitted, (unsigned long long)stats.Completed,
+            (unsigned long long)stats.Failed, (unsigned long long)stats.Cancelled);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,122 @@
+//***************************************************************************************
+// TexturePackerBenchmark.cpp
+//
+// Packs 500 RGBA8 textures of random sizes from 16 to 512 texels into atlases only,
+// with each algorithm, and composes the pages.  Every texture is filled with its own
+// index, so the composed pages show whether each one landed where its Placement says.
+//***************************************************************************************
+
+#include "Benchmark.h"
+#include "../Common/TexturePacker.h"
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    using uint8 = TexturePacker::uint8;
+    using uint32 = TexturePacker::uint32;
+
+    const uint32 TextureCount = 500;
+
+    // Sizes from 16 to 512 in steps of 16, skewed towards small ones as UI and decal
+    // textures are, with full mip chains.
+    std::vector<TexturePacker::Texture> CreateTextures(Benchmark::Random& random)
+    {
+        std::vector<TexturePacker::Texture> textures(TextureCount);
+        for(TexturePacker::Texture& texture : textures)
+        {
+            DdsFile::Info& info = texture.Info;
+            const uint32 a = random.Next() % 32, b = random.Next() % 32;
+            const uint32 c = random.Next() % 32, d = random.Next() % 32;
+            info.Width = 16 * (1 + a * b / 31);
+            info.Height = 16 * (1 + c * d / 31);
+            info.Format = DdsFile::FormatR8G8B8A8Unorm;
+            info.MipCount = 1;
+            while((info.Width >> info.MipCount) > 0 || (info.Height >> info.MipCount) > 0)
+                info.MipCount++;
+        }
+        return textures;
+    }
+
+    // Textures on page whose mip 0 corners do not hold their index, or that hang over
+    // the page.
+    uint32 CountMisplaced(const TexturePacker::Result& result, uint32 page, const std::vector<TexturePacker::Texture>& textures,
+        const std::vector<uint8>& surfaces)
+    {
+        const DdsFile::Info& info = result.Pages[page].Info;
+
+        uint32 misplaced = 0;
+        for(uint32 t : result.Pages[page].Textures)
+        {
+            const TexturePacker::Placement& placement = result.Placements[t];
+            const uint32 right = placement.X + textures[t].Info.Width - 1;
+            const uint32 bottom = placement.Y + textures[t].Info.Height - 1;
+            if(placement.Page != page || right >= info.Width || bottom >= info.Height)
+            {
+                ++misplaced;
+                continue;
+            }
+
+            const uint8 topLeft = surfaces[((size_t)placement.Y * info.Width + placement.X) * 4];
+            const uint8 bottomRight = surfaces[((size_t)bottom * info.Width + right) * 4];
+            if(topLeft != (uint8)t || bottomRight != (uint8)t)
+                ++misplaced;
+        }
+        return misplaced;
+    }
+}
+
+bool TexturePackerBenchmark()
+{
+    Benchmark::Random random(12345);
+    const std::vector<TexturePacker::Texture> textures = CreateTextures(random);
+
+    std::vector<std::vector<uint8>> surfaces(TextureCount);
+    std::vector<const uint8*> sources(TextureCount);
+    for(uint32 i = 0; i < TextureCount; ++i)
+    {
+        surfaces[i].assign((size_t)DdsFile::DataSize(textures[i].Info), (uint8)i);
+        sources[i] = surfaces[i].data();
+    }
+
+    bool passed = true;
+    for(TexturePacker::Algorithm method : { TexturePacker::Skyline, TexturePacker::MaxRects })
+    {
+        TexturePacker::Options options;
+        options.Method = method;
+        options.UseArrays = false;
+
+        TexturePacker::Result result;
+        const double packMs = Benchmark::BestOf(3, [&]()
+        {
+            result = TexturePacker::Pack(textures, options);
+        });
+
+        std::vector<uint8> page;
+        const double composeMs = Benchmark::BestOf(3, [&]()
+        {
+            for(uint32 p = 0; p < result.Pages.size(); ++p)
+                TexturePacker::Compose(result, p, textures, sources, page);
+        });
+
+        uint32 misplaced = 0;
+        for(uint32 p = 0; p < result.Pages.size(); ++p)
+        {
+            TexturePacker::Compose(result, p, textures, sources, page);
+            misplaced += CountMisplaced(result, p, textures, page);
+        }
+
+        std::printf("%-8s: %u textures on %zu pages, %.1f%% occupied, unpacked %u; pack %7.3f ms, compose %7.1f MP/s%s\n",
+            method == TexturePacker::Skyline ? "Skyline" : "MaxRects", TextureCount, result.Pages.size(),
+            100.0 * result.Occupancy(), result.Unpacked, packMs, result.AtlasTexels / 1e3 / composeMs,
+            misplaced == 0 ? "" : "  FAILED");
+
+        if(misplaced != 0)
+        {
+            std::printf("  %u textures not where their placement says\n", misplaced);
+            passed = false;
+        }
+    }
+
+    return passed;
+}
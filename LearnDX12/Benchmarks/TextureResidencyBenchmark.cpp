@@ -0,0 +1,215 @@
+//***************************************************************************************
+// TextureResidencyBenchmark.cpp
+//
+// Drives a camera back and forth over a field of 1,681 objects, each with its own BC1
+// texture of 512 to 4096 texels, under a 96 MB budget.  Every frame the visible
+// textures are requested at the mip their distance calls for, Update() runs, and its
+// loads complete one to four frames later, one in fifty failing.
+//
+// A copy of what the actions say is resident is kept alongside, and every frame it
+// checks that the resident bytes stay within the budget and match the sum over the
+// mips, that no mip is evicted while its texture has a load in flight, and that each
+// load is the next finer mip of a texture with nothing in flight, so coarse mips are
+// loaded before fine ones.
+//***************************************************************************************
+
+#include "Benchmark.h"
+#include "../Common/TextureResidency.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    using uint32 = TextureResidency::uint32;
+    using uint64 = TextureResidency::uint64;
+
+    const uint32 GridSize = 41;
+    const float Spacing = 10.0f;
+    const uint32 Frames = 2000;
+
+    // The tails of the mips under 64 KB take about 70 MB of it, so the rest is contested.
+    const uint64 Budget = 96ull << 20;
+
+    // Tiling once every ten units, seen through a 1080 pixel tall 45 degree view.
+    const float UvPerUnit = 0.1f;
+    const float FovY = 0.25f * 3.14159265f;
+    const float ViewportHeight = 1080.0f;
+    const float ViewDistance = 200.0f;
+
+    struct Object
+    {
+        float X = 0.0f;
+        float Z = 0.0f;
+        uint32 Size = 0;
+        uint32 Texture = 0;
+    };
+
+    // What the actions and completions so far say about a texture.
+    struct Shadow
+    {
+        std::vector<uint64> MipBytes;
+
+        // Finest mip resident or loading, as in TextureResidency.
+        uint32 FinestMip = 0;
+
+        bool InFlight = false;
+        uint32 DueFrame = 0;
+        bool Fails = false;
+    };
+
+    struct Failures
+    {
+        uint32 OverBudget = 0;
+        uint32 BytesMismatch = 0;
+        uint32 EvictedInFlight = 0;
+        uint32 OutOfOrderLoads = 0;
+
+        uint32 Total()const { return OverBudget + BytesMismatch + EvictedInFlight + OutOfOrderLoads; }
+    };
+
+    uint64 ShadowBytes(const std::vector<Shadow>& shadows)
+    {
+        uint64 bytes = 0;
+        for(const Shadow& s : shadows)
+        {
+            for(uint32 mip = s.FinestMip; mip < s.MipBytes.size(); ++mip)
+                bytes += s.MipBytes[mip];
+        }
+        return bytes;
+    }
+
+    // Checks the actions of one Update() against the shadows and applies them.
+    void ApplyActions(const std::vector<TextureResidency::Action>& actions, uint32 frame, Benchmark::Random& random,
+        std::vector<Shadow>& shadows, Failures& failures)
+    {
+        for(const TextureResidency::Action& action : actions)
+        {
+            Shadow& s = shadows[action.Texture];
+            if(action.Kind == TextureResidency::Action::Evict)
+            {
+                if(s.InFlight)
+                    failures.EvictedInFlight++;
+                s.FinestMip = action.Mip + 1;
+            }
+            else
+            {
+                if(s.InFlight || action.Mip + 1 != s.FinestMip)
+                    failures.OutOfOrderLoads++;
+                s.FinestMip = action.Mip;
+                s.InFlight = true;
+                s.DueFrame = frame + 1 + random.Next() % 4;
+                s.Fails = random.Next() % 50 == 0;
+            }
+        }
+    }
+}
+
+bool TextureResidencyBenchmark()
+{
+    TextureResidency::Config config;
+    config.Budget = Budget;
+    TextureResidency residency(config);
+
+    Benchmark::Random random(12345);
+    std::vector<Object> objects(GridSize * GridSize);
+    std::vector<Shadow> shadows;
+    for(uint32 i = 0; i < objects.size(); ++i)
+    {
+        Object& object = objects[i];
+        object.X = (i % GridSize) * Spacing;
+        object.Z = ((float)(i / GridSize) - GridSize / 2) * Spacing;
+        object.Size = 512u << (random.Next() % 4);
+
+        DdsFile::Info info;
+        info.Width = object.Size;
+        info.Height = object.Size;
+        info.Format = DdsFile::FormatBC1Unorm;
+        info.MipCount = 1;
+        while((object.Size >> info.MipCount) > 0)
+            info.MipCount++;
+        object.Texture = residency.AddTexture(info);
+
+        Shadow shadow;
+        for(uint32 mip = 0; mip < info.MipCount; ++mip)
+            shadow.MipBytes.push_back(DdsFile::MipSize(info, mip));
+        shadow.FinestMip = residency.ResidentMip(object.Texture);
+        shadows.push_back(shadow);
+    }
+
+    Failures failures;
+    double updateMs = 0.0;
+    uint64 requested = 0;
+    uint64 satisfied = 0;
+    for(uint32 frame = 0; frame < Frames; ++frame)
+    {
+        // Back and forth along x, looking the way it moves, two units a frame.
+        const float travel = 2.0f * (frame % 400);
+        const bool forward = travel < 400.0f;
+        const float cameraX = forward ? travel : 800.0f - travel;
+        const float facing = forward ? 1.0f : -1.0f;
+
+        for(const Object& object : objects)
+        {
+            const float dx = object.X - cameraX;
+            const float distance = std::sqrt(dx * dx + object.Z * object.Z);
+            if(distance > ViewDistance || dx * facing < 0.5f * distance)
+                continue;
+
+            const float mip = TextureResidency::DesiredMip(UvPerUnit, object.Size, distance, FovY, ViewportHeight);
+            residency.Request(object.Texture, mip, 1.0f / std::max(distance, 1.0f));
+        }
+
+        const std::vector<TextureResidency::Action>* actions = nullptr;
+        updateMs += Benchmark::BestOf(1, [&]()
+        {
+            actions = &residency.Update();
+        });
+        ApplyActions(*actions, frame, random, shadows, failures);
+
+        // Loads due this frame complete, in texture order.
+        for(uint32 id = 0; id < shadows.size(); ++id)
+        {
+            Shadow& s = shadows[id];
+            if(!s.InFlight || s.DueFrame != frame)
+                continue;
+
+            s.InFlight = false;
+            if(s.Fails)
+            {
+                residency.LoadFailed(id, s.FinestMip);
+                s.FinestMip++;
+            }
+            else
+            {
+                residency.Loaded(id, s.FinestMip);
+            }
+        }
+
+        const TextureResidency::Stats stats = residency.GetStats();
+        requested += stats.RequestedTextures;
+        satisfied += stats.SatisfiedTextures;
+        if(stats.ResidentBytes > stats.Budget)
+            failures.OverBudget++;
+        if(stats.ResidentBytes != ShadowBytes(shadows))
+            failures.BytesMismatch++;
+    }
+
+    const TextureResidency::Stats stats = residency.GetStats();
+    std::printf("%u frames: %7.2f us/update, %u loads, %u evictions, %u denied, peak %llu of %llu MB, "
+        "%.1f%% of requests at their mip%s\n",
+        Frames, updateMs * 1e3 / Frames, stats.Loads, stats.Evictions, stats.DeniedLoads,
+        (unsigned long long)(stats.PeakResidentBytes >> 20), (unsigned long long)(stats.Budget >> 20),
+        100.0 * satisfied / std::max(requested, (uint64)1), failures.Total() == 0 ? "" : "  FAILED");
+
+    if(failures.Total() != 0)
+    {
+        std::printf("  frames over budget %u, with resident bytes off the mip sum %u; evictions in flight %u, "
+            "loads out of order %u\n", failures.OverBudget, failures.BytesMismatch, failures.EvictedInFlight,
+            failures.OutOfOrderLoads);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,346 @@
+//***************************************************************************************
+// AsyncTextureLoader.cpp
+//***************************************************************************************
+
+#include "AsyncTextureLoader.h"
+#include <algorithm>
+
+using Microsoft::WRL::ComPtr;
+
+const UINT64 AsyncTextureLoader::DefaultCopyBudget;
+const UINT AsyncTextureLoader::DefaultUnmapDelay;
+const UINT AsyncTextureLoader::NoMip;
+
+AsyncTextureLoader::AsyncTextureLoader(ID3D12Device* device, UINT64 uploadRingSize, unsigned ioThreadCount)
+    : mDevice(device),
+    mRing(device, uploadRingSize),
+    mFiles(ioThreadCount)
+{
+    D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+    queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+    queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+    ThrowIfFailed(device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&mCopyQueue)));
+
+    ThrowIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mCopyFence)));
+
+    CopyAllocator copyAllocator;
+    ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY,
+        IID_PPV_ARGS(copyAllocator.Allocator.GetAddressOf())));
+    mCopyAllocators.push_back(copyAllocator);
+
+    ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY,
+        copyAllocator.Allocator.Get(), nullptr, IID_PPV_ARGS(mCopyList.GetAddressOf())));
+
+    // Update() resets the list before recording.
+    mCopyList->Close();
+}
+
+AsyncTextureLoader::~AsyncTextureLoader()
+{
+    if(mCopyFence->GetCompletedValue() < mCopyFenceValue)
+    {
+        HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
+        ThrowIfFailed(mCopyFence->SetEventOnCompletion(mCopyFenceValue, eventHandle));
+        WaitForSingleObject(eventHandle, INFINITE);
+        CloseHandle(eventHandle);
+    }
+}
+
+AsyncTextureLoader::Ticket AsyncTextureLoader::Load(const std::string& path, float priority, size_t maxsize)
+{
+    const Ticket ticket = mFiles.Submit(path, priority);
+
+    Entry& entry = mTextures[ticket];
+    entry.Priority = priority;
+    entry.MaxSize = maxsize;
+    return ticket;
+}
+
+void AsyncTextureLoader::SetPriority(Ticket ticket, float priority)
+{
+    auto it = mTextures.find(ticket);
+    if(it == mTextures.end())
+        return;
+
+    it->second.Priority = priority;
+    mFiles.SetPriority(ticket, priority);
+}
+
+bool AsyncTextureLoader::EnableResidency(const TextureResidency::Config& config, UINT unmapDelay)
+{
+    D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+    if(FAILED(mDevice->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options))) ||
+        options.TiledResourcesTier == D3D12_TILED_RESOURCES_TIER_NOT_SUPPORTED)
+        return false;
+
+    mResidency.reset(new TextureResidency(config));
+    mUnmapDelay = unmapDelay;
+    return true;
+}
+
+void AsyncTextureLoader::Request(Ticket ticket, float desiredMip, float priority)
+{
+    auto it = mTextures.find(ticket);
+    if(it == mTextures.end() || it->second.ResidencyId == TextureResidency::NoTexture)
+        return;
+
+    mResidency->Request(it->second.ResidencyId, desiredMip, priority);
+}
+
+ID3D12CommandAllocator* AsyncTextureLoader::NextAllocator(UINT64 completedFence)
+{
+    // An allocator can be reset once the copies recorded with it have executed.
+    for(CopyAllocator& copyAllocator : mCopyAllocators)
+    {
+        if(copyAllocator.Fence <= completedFence)
+        {
+            copyAllocator.Fence = mCopyFenceValue + 1;
+            return copyAllocator.Allocator.Get();
+        }
+    }
+
+    CopyAllocator copyAllocator;
+    ThrowIfFailed(mDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY,
+        IID_PPV_ARGS(copyAllocator.Allocator.GetAddressOf())));
+    copyAllocator.Fence = mCopyFenceValue + 1;
+    mCopyAllocators.push_back(copyAllocator);
+    return mCopyAllocators.back().Allocator.Get();
+}
+
+ComPtr<ID3D12Heap> AsyncTextureLoader::CreateTileHeap(UINT tileCount)
+{
+    CD3DX12_HEAP_DESC heapDesc(UINT64(tileCount) * D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES,
+        D3D12_HEAP_TYPE_DEFAULT, 0, D3D12_HEAP_FLAG_DENY_BUFFERS | D3D12_HEAP_FLAG_DENY_RT_DS_TEXTURES);
+
+    ComPtr<ID3D12Heap> heap;
+    ThrowIfFailed(mDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(heap.GetAddressOf())));
+    d3dUtil::TrackMemory(heap.Get(), MemoryTracker::Textures, heapDesc.SizeInBytes);
+    return heap;
+}
+
+void AsyncTextureLoader::AddResident(Ticket ticket, Entry& entry)
+{
+    DirectX::DDSTextureStream& stream = *entry.Stream;
+    const UINT mipLevels = stream.MipLevels();
+
+    // The packed mips, or the last mip if every mip has tiles of its own, are mapped
+    // once and never leave; the policy pays for the tail at its first mip.
+    const UINT tailMip = stream.PackedMip() < mipLevels ? stream.PackedMip() : mipLevels - 1;
+
+    std::vector<TextureResidency::uint64> mipBytes(mipLevels, 0);
+    for(UINT mip = 0; mip <= tailMip; ++mip)
+        mipBytes[mip] = UINT64(stream.TileCount(mip)) * D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+
+    entry.Heaps.resize(mipLevels);
+    entry.Heaps[tailMip] = CreateTileHeap(stream.TileCount(tailMip));
+    stream.MapTiles(mCopyQueue.Get(), tailMip, entry.Heaps[tailMip].Get(), 0);
+    stream.SetStreamLimit(tailMip);
+
+    entry.ResidencyId = mResidency->AddTexture(mipBytes, tailMip);
+    if(entry.ResidencyId >= mResidencyTickets.size())
+        mResidencyTickets.resize(entry.ResidencyId + 1);
+    mResidencyTickets[entry.ResidencyId] = ticket;
+}
+
+bool AsyncTextureLoader::UpdateResidency()
+{
+    bool mapped = false;
+
+    // Frames recorded before the eviction no longer sample these mips.
+    for(size_t i = 0; i < mUnmaps.size();)
+    {
+        PendingUnmap& unmap = mUnmaps[i];
+        if(unmap.Update > mUpdateCount)
+        {
+            ++i;
+            continue;
+        }
+
+        mTextures[unmap.Texture].Stream->UnmapTiles(mCopyQueue.Get(), unmap.Mip);
+        mRetiredHeaps.push_back({ std::move(unmap.Heap), mCopyFenceValue + 1 });
+        mapped = true;
+
+        mUnmaps[i] = std::move(mUnmaps.back());
+        mUnmaps.pop_back();
+    }
+
+    // Evictions come before the loads they make room for.  An evicted mip keeps its
+    // tiles, and bytes, until its unmap is due; the policy counts them freed at once.
+    for(const TextureResidency::Action& action : mResidency->Update())
+    {
+        const Ticket ticket = mResidencyTickets[action.Texture];
+        Entry& entry = mTextures[ticket];
+        DirectX::DDSTextureStream& stream = *entry.Stream;
+
+        if(action.Kind == TextureResidency::Action::Evict)
+        {
+            stream.Evict(action.Mip);
+            mUnmaps.push_back({ ticket, action.Mip, mUpdateCount + mUnmapDelay, std::move(entry.Heaps[action.Mip]) });
+            continue;
+        }
+
+        // A mip evicted and wanted back before its unmap came due is still mapped.
+        auto pending = std::find_if(mUnmaps.begin(), mUnmaps.end(), [&](const PendingUnmap& unmap)
+        {
+            return unmap.Texture == ticket && unmap.Mip == action.Mip;
+        });
+        if(pending != mUnmaps.end())
+        {
+            entry.Heaps[action.Mip] = std::move(pending->Heap);
+            *pending = std::move(mUnmaps.back());
+            mUnmaps.pop_back();
+        }
+        else
+        {
+            entry.Heaps[action.Mip] = CreateTileHeap(stream.TileCount(action.Mip));
+            stream.MapTiles(mCopyQueue.Get(), action.Mip, entry.Heaps[action.Mip].Get(), 0);
+            mapped = true;
+        }
+
+        stream.SetStreamLimit(action.Mip);
+        entry.LoadingMip = action.Mip;
+    }
+    return mapped;
+}
+
+void AsyncTextureLoader::Update(UINT64 copyBudget)
+{
+    mUpdateCount++;
+
+    const UINT64 completedFence = mCopyFence->GetCompletedValue();
+    mRing.Reclaim(completedFence);
+
+    for(size_t i = 0; i < mRetiredHeaps.size();)
+    {
+        if(mRetiredHeaps[i].Fence <= completedFence)
+        {
+            mRetiredHeaps[i] = std::move(mRetiredHeaps.back());
+            mRetiredHeaps.pop_back();
+        }
+        else
+            ++i;
+    }
+
+    // Textures are created here so that TextureLoadQueue stays free of Direct3D.
+    mLoaded.clear();
+    mFiles.Poll(mLoaded);
+    for(TextureLoadQueue::LoadedFile& file : mLoaded)
+    {
+        Entry& entry = mTextures[file.Ticket];
+        if(!file.Succeeded)
+        {
+            entry.Failed = true;
+            continue;
+        }
+
+        // Only single 2D textures can be reserved; arrays, cubes, volumes and 1D
+        // textures stream in whole.
+        const DdsFile::Info& info = file.Info;
+        const bool reserved = mResidency && info.ArraySize == 1 && info.Depth == 1 && info.Height > 1;
+
+        entry.Stream.reset(new DirectX::DDSTextureStream());
+        const HRESULT hr = reserved ?
+            entry.Stream->OpenReserved(mDevice.Get(), std::move(file.File), entry.MaxSize) :
+            entry.Stream->Open(mDevice.Get(), std::move(file.File), entry.MaxSize);
+
+        if(FAILED(hr))
+        {
+            entry.Stream.reset();
+            entry.Failed = true;
+        }
+        else if(entry.Stream->Reserved())
+            AddResident(file.Ticket, entry);
+    }
+
+    const bool mapped = mResidency && UpdateResidency();
+
+    mStreaming.clear();
+    for(auto& texture : mTextures)
+    {
+        Entry& entry = texture.second;
+        if(entry.Stream && !entry.Failed && entry.Stream->Streaming())
+            mStreaming.push_back(&entry);
+    }
+    if(mStreaming.empty())
+    {
+        // Tile mappings still need a fence for their heaps to retire on.
+        if(mapped)
+            ThrowIfFailed(mCopyQueue->Signal(mCopyFence.Get(), ++mCopyFenceValue));
+        return;
+    }
+
+    std::stable_sort(mStreaming.begin(), mStreaming.end(),
+        [](const Entry* a, const Entry* b) { return a->Priority > b->Priority; });
+
+    ID3D12CommandAllocator* allocator = NextAllocator(completedFence);
+    ThrowIfFailed(allocator->Reset());
+    ThrowIfFailed(mCopyList->Reset(allocator, nullptr));
+
+    // Every texture's copies for the frame go into one list, so the copy queue sees
+    // a single submission however many textures are streaming.
+    UINT64 staged = 0;
+    for(Entry* entry : mStreaming)
+    {
+        if(staged >= copyBudget)
+            break;
+
+        const UINT64 usedBefore = mRing.Allocator().UsedSize();
+        const HRESULT hr = entry->Stream->Stream(mCopyList.Get(), mRing, copyBudget - staged);
+        staged += mRing.Allocator().UsedSize() - usedBefore;
+
+        // The texture stays alive: copies into it may already be in the list.
+        if(FAILED(hr))
+            entry->Failed = true;
+
+        // Loads the policy asked for are resident as soon as their copies are recorded,
+        // like everything else WaitForCopies() covers.
+        if(entry->LoadingMip != NoMip && (FAILED(hr) || entry->Stream->ResidentMip() <= entry->LoadingMip))
+        {
+            if(FAILED(hr))
+                mResidency->LoadFailed(entry->ResidencyId, entry->LoadingMip);
+            else
+                mResidency->Loaded(entry->ResidencyId, entry->LoadingMip);
+            entry->LoadingMip = NoMip;
+        }
+
+        if(hr == S_FALSE)
+            break;
+    }
+
+    ThrowIfFailed(mCopyList->Close());
+    ID3D12CommandList* cmdsLists[] = { mCopyList.Get() };
+    mCopyQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+
+    ThrowIfFailed(mCopyQueue->Signal(mCopyFence.Get(), ++mCopyFenceValue));
+    mRing.EndFrame(mCopyFenceValue);
+}
+
+void AsyncTextureLoader::WaitForCopies(ID3D12CommandQueue* queue)
+{
+    if(mCopyFenceValue > 0)
+        ThrowIfFailed(queue->Wait(mCopyFence.Get(), mCopyFenceValue));
+}
+
+bool AsyncTextureLoader::Ready(Ticket ticket)const
+{
+    const DirectX::DDSTextureStream* stream = Find(ticket);
+    return stream != nullptr && stream->ResidentMip() < stream->MipLevels();
+}
+
+bool AsyncTextureLoader::Done(Ticket ticket)const
+{
+    const DirectX::DDSTextureStream* stream = Find(ticket);
+    return stream != nullptr && stream->Done();
+}
+
+bool AsyncTextureLoader::Failed(Ticket ticket)const
+{
+    auto it = mTextures.find(ticket);
+    return it != mTextures.end() && it->second.Failed;
+}
+
+const DirectX::DDSTextureStream* AsyncTextureLoader::Find(Ticket ticket)const
+{
+    auto it = mTextures.find(ticket);
+    return it != mTextures.end() ? it->second.Stream.get() : nullptr;
+}
@@ -0,0 +1,170 @@
+//***************************************************************************************
+// AsyncTextureLoader.h
+//
+// Loads DDS textures without stalling the frame loop.  A TextureLoadQueue maps and
+// parses files on its I/O threads; Update(), called once per frame, drains what has
+// finished into DDSTextureStreams and records as many of their subresources as the
+// per-frame budget allows into one command list on a dedicated copy queue, coarsest
+// mips and highest priorities first.
+//
+// Textures are usable once Ready() (some mip is in) after the graphics queue has been
+// made to wait on the copies with WaitForCopies(); clamp their SRVs to ResidentMip()
+// until Done().  Each frame:
+//
+//     loader.Update(budget);
+//     ... record the frame ...
+//     loader.WaitForCopies(mCommandQueue.Get());
+//     mCommandQueue->ExecuteCommandLists(...);
+//
+// With EnableResidency(), 2D textures become reserved resources whose finer mips are
+// streamed in and evicted by a TextureResidency under a memory budget, as the frame
+// Request()s them; ResidentMip() then goes up as well as down.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "TextureLoadQueue.h"
+#include "TextureResidency.h"
+#include "UploadRing.h"
+#include <unordered_map>
+
+class AsyncTextureLoader
+{
+public:
+    using Ticket = TextureLoadQueue::uint32;
+
+    static const UINT64 DefaultCopyBudget = 16 * 1024 * 1024;
+
+    // Updates between evicting a mip and unmapping its tiles; covers the frames in
+    // flight that may still sample it.
+    static const UINT DefaultUnmapDelay = 4;
+
+    AsyncTextureLoader(ID3D12Device* device, UINT64 uploadRingSize, unsigned ioThreadCount = 0);
+    AsyncTextureLoader(const AsyncTextureLoader& rhs) = delete;
+    AsyncTextureLoader& operator=(const AsyncTextureLoader& rhs) = delete;
+
+    // Waits for the copy queue before the ring and the textures go away.
+    ~AsyncTextureLoader();
+
+    ///<summary>
+    /// Queues a DDS file; priority is usually TextureLoadQueue::ScreenSpacePriority()
+    /// of the largest object using it.
+    ///</summary>
+    Ticket Load(const std::string& path, float priority, size_t maxsize = 0);
+
+    // Reorders both the file loads still waiting and the uploads still streaming.
+    void SetPriority(Ticket ticket, float priority);
+
+    ///<summary>
+    /// Streams the single 2D textures opened from now on as reserved resources under
+    /// the budget of config: only their packed small-mip tail streams by itself, and
+    /// finer mips come and go with Request().  Returns false, changing nothing, if the
+    /// device has no tiled resources.
+    ///</summary>
+    bool EnableResidency(const TextureResidency::Config& config, UINT unmapDelay = DefaultUnmapDelay);
+
+    // The texture is visible this frame and wants desiredMip at priority, usually from
+    // TextureResidency::DesiredMip(); ignored for textures not under residency.
+    void Request(Ticket ticket, float desiredMip, float priority);
+
+    ///<summary>
+    /// Takes the files finished since the last call, then records and submits up to
+    /// copyBudget bytes of uploads on the copy queue.
+    ///</summary>
+    void Update(UINT64 copyBudget = DefaultCopyBudget);
+
+    // Makes queue wait on the GPU for every copy submitted so far.
+    void WaitForCopies(ID3D12CommandQueue* queue);
+
+    bool Ready(Ticket ticket)const;
+    bool Done(Ticket ticket)const;
+    bool Failed(Ticket ticket)const;
+
+    // nullptr until the file has been loaded.
+    const DirectX::DDSTextureStream* Find(Ticket ticket)const;
+
+    // Tickets handed out, and file loads not yet taken by Update().
+    size_t TextureCount()const { return mTextures.size(); }
+    TextureLoadQueue::uint32 PendingFileCount()const { return mFiles.OutstandingCount(); }
+
+    const TextureLoadQueue& Files()const { return mFiles; }
+    const UploadRing& Ring()const { return mRing; }
+
+    // nullptr until EnableResidency().
+    const TextureResidency* Residency()const { return mResidency.get(); }
+
+private:
+    static const UINT NoMip = 0xffffffff;
+
+    struct Entry
+    {
+        float Priority = 0.0f;
+        size_t MaxSize = 0;
+        bool Failed = false;
+        std::unique_ptr<DirectX::DDSTextureStream> Stream;
+
+        // Under residency: the policy's id, the mip it is loading if any, and the heap
+        // backing each mapped mip, the packed tail's under its first mip.
+        TextureResidency::uint32 ResidencyId = TextureResidency::NoTexture;
+        UINT LoadingMip = NoMip;
+        std::vector<Microsoft::WRL::ComPtr<ID3D12Heap>> Heaps;
+    };
+
+    struct PendingUnmap
+    {
+        Ticket Texture;
+        UINT Mip;
+        UINT64 Update;
+        Microsoft::WRL::ComPtr<ID3D12Heap> Heap;
+    };
+
+    // Heaps are released once the copy queue has executed their unmapping.
+    struct RetiredHeap
+    {
+        Microsoft::WRL::ComPtr<ID3D12Heap> Heap;
+        UINT64 Fence;
+    };
+
+    struct CopyAllocator
+    {
+        Microsoft::WRL::ComPtr<ID3D12CommandAllocator> Allocator;
+        UINT64 Fence = 0;
+    };
+
+    ID3D12CommandAllocator* NextAllocator(UINT64 completedFence);
+
+    Microsoft::WRL::ComPtr<ID3D12Heap> CreateTileHeap(UINT tileCount);
+
+    // Maps the tail of a freshly opened reserved texture and hands it to the policy.
+    void AddResident(Ticket ticket, Entry& entry);
+
+    // Carries out the policy's loads and evictions and the unmaps that are due;
+    // returns whether any tile mapping was queued.
+    bool UpdateResidency();
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12Device> mDevice;
+
+    Microsoft::WRL::ComPtr<ID3D12CommandQueue> mCopyQueue;
+    Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> mCopyList;
+    std::vector<CopyAllocator> mCopyAllocators;
+    Microsoft::WRL::ComPtr<ID3D12Fence> mCopyFence;
+    UINT64 mCopyFenceValue = 0;
+
+    UploadRing mRing;
+    TextureLoadQueue mFiles;
+
+    std::unordered_map<Ticket, Entry> mTextures;
+
+    std::unique_ptr<TextureResidency> mResidency;
+    std::vector<Ticket> mResidencyTickets;
+    std::vector<PendingUnmap> mUnmaps;
+    std::vector<RetiredHeap> mRetiredHeaps;
+    UINT mUnmapDelay = DefaultUnmapDelay;
+    UINT64 mUpdateCount = 0;
+
+    // Scratch for Update().
+    std::vector<TextureLoadQueue::LoadedFile> mLoaded;
+    std::vector<Entry*> mStreaming;
+};
@@ -0,0 +1,913 @@
+//***************************************************************************************
+// BlockCompression.cpp
+//***************************************************************************************
+
+#include "BlockCompression.h"
+#include <DirectXMath.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+    using uint8 = BlockCompression::uint8;
+    using uint32 = BlockCompression::uint32;
+    using uint64 = std::uint64_t;
+
+    //
+    // BC7 tables, from the format specification.
+    //
+
+    struct Bc7Mode
+    {
+        uint32 Subsets;
+        uint32 PartitionBits;
+        uint32 RotationBits;
+        uint32 IndexSelectionBits;
+        uint32 ColorBits;
+        uint32 AlphaBits;
+        uint32 EndpointPBits;       // one per endpoint
+        uint32 SharedPBits;         // one per subset
+        uint32 IndexBits;
+        uint32 SecondaryIndexBits;
+    };
+
+    const Bc7Mode Bc7Modes[8] =
+    {
+        { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+        { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+        { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+        { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+        { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+        { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+        { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+        { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+    };
+
+    // Bit i set when texel i is in the second subset.
+    const std::uint16_t Bc7Partitions2[64] =
+    {
+        0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+        0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+        0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+        0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+        0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+        0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+        0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+        0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22
+    };
+
+    // Two bits per texel, texel 0 lowest.
+    const uint32 Bc7Partitions3[64] =
+    {
+        0xaa685050, 0x6a5a5040, 0x5a5a4200, 0x5450a0a8, 0xa5a50000, 0xa0a05050, 0x5555a0a0, 0x5a5a5050,
+        0xaa550000, 0xaa555500, 0xaaaa5500, 0x90909090, 0x94949494, 0xa4a4a4a4, 0xa9a59450, 0x2a0a4250,
+        0xa5945040, 0x0a425054, 0xa5a5a500, 0x55a0a0a0, 0xa8a85454, 0x6a6a4040, 0xa4a45000, 0x1a1a0500,
+        0x0050a4a4, 0xaaa59090, 0x14696914, 0x69691400, 0xa08585a0, 0xaa821414, 0x50a4a450, 0x6a5a0200,
+        0xa9a58000, 0x5090a0a8, 0xa8a09050, 0x24242424, 0x00aa5500, 0x24924924, 0x24499224, 0x50a50a50,
+        0x500aa550, 0xaaaa4444, 0x66660000, 0xa5a0a5a0, 0x50a050a0, 0x69286928, 0x44aaaa44, 0x66666600,
+        0xaa444444, 0x54a854a8, 0x95809580, 0x96969600, 0xa85454a8, 0x80959580, 0xaa141414, 0x96960000,
+        0xaaaa1414, 0xa05050a0, 0xa0a5a5a0, 0x96000000, 0x40804080, 0xa9a8a9a8, 0xaaaaaa44, 0x2a4a5254
+    };
+
+    // Texels whose index is stored one bit short: texel 0 for the first subset, these
+    // for the others.
+    const uint8 Bc7Anchors2[64] =
+    {
+        15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+        15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+         6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+    };
+
+    const uint8 Bc7Anchors3Second[64] =
+    {
+         3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+         3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+         8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+         3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3
+    };
+
+    const uint8 Bc7Anchors3Third[64] =
+    {
+        15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+        15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+        15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+        15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8
+    };
+
+    const uint32 Bc7Weights2[4] = { 0, 21, 43, 64 };
+    const uint32 Bc7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+    const uint32 Bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    const uint32* Bc7Weights(uint32 bits)
+    {
+        return bits == 2 ? Bc7Weights2 : bits == 3 ? Bc7Weights3 : Bc7Weights4;
+    }
+
+    // Reads the 128 bit block from bit 0 up.
+    class BitReader
+    {
+    public:
+        explicit BitReader(const uint8* block)
+        {
+            std::memcpy(&mLow, block, 8);
+            std::memcpy(&mHigh, block + 8, 8);
+        }
+
+        uint32 Read(uint32 count)
+        {
+            uint64 bits;
+            if(mPosition >= 64)
+                bits = mHigh >> (mPosition - 64);
+            else if(mPosition + count <= 64)
+                bits = mLow >> mPosition;
+            else
+                bits = (mLow >> mPosition) | (mHigh << (64 - mPosition));
+
+            mPosition += count;
+            return (uint32)bits & ((1u << count) - 1);
+        }
+
+        void Skip(uint32 count) { mPosition += count; }
+
+    private:
+        uint64 mLow;
+        uint64 mHigh;
+        uint32 mPosition = 0;
+    };
+
+    //
+    // BC1-BC5 building blocks.
+    //
+
+    inline uint32 Expand5(uint32 v) { return (v << 3) | (v >> 2); }
+    inline uint32 Expand6(uint32 v) { return (v << 2) | (v >> 4); }
+
+    inline void Unpack565(uint32 c, uint32* rgb)
+    {
+        rgb[0] = Expand5(c >> 11);
+        rgb[1] = Expand6((c >> 5) & 63);
+        rgb[2] = Expand5(c & 31);
+    }
+
+    // The four palette entries of a colour block, RGBA8, as DecodeColor() builds them.
+    void ColorPalette(uint32 c0, uint32 c1, bool threeColor, uint8 palette[4][4])
+    {
+        uint32 e0[3], e1[3];
+        Unpack565(c0, e0);
+        Unpack565(c1, e1);
+
+        for(int c = 0; c < 3; ++c)
+        {
+            palette[0][c] = (uint8)e0[c];
+            palette[1][c] = (uint8)e1[c];
+            if(threeColor)
+            {
+                palette[2][c] = (uint8)((e0[c] + e1[c] + 1) / 2);
+                palette[3][c] = 0;
+            }
+            else
+            {
+                palette[2][c] = (uint8)((2 * e0[c] + e1[c] + 1) / 3);
+                palette[3][c] = (uint8)((e0[c] + 2 * e1[c] + 1) / 3);
+            }
+        }
+        palette[0][3] = palette[1][3] = palette[2][3] = 255;
+        palette[3][3] = threeColor ? 0 : 255;
+    }
+
+    // BC2 and BC3 always decode their colour block with four colours.
+    void DecodeColor(const uint8* block, uint8* rgba, bool allowThreeColor)
+    {
+        const uint32 c0 = block[0] | (block[1] << 8);
+        const uint32 c1 = block[2] | (block[3] << 8);
+
+        uint8 palette[4][4];
+        ColorPalette(c0, c1, allowThreeColor && c0 <= c1, palette);
+
+        uint32 indices;
+        std::memcpy(&indices, block + 4, 4);
+        for(int i = 0; i < 16; ++i, indices >>= 2)
+            std::memcpy(rgba + 4 * i, palette[indices & 3], 4);
+    }
+
+    // (n - i) / n of a plus i / n of b, rounded half away from zero.
+    inline int Interpolate(int a, int b, int i, int n)
+    {
+        const int sum = (n - i) * a + i * b;
+        return (sum + (sum >= 0 ? n / 2 : -(n / 2))) / n;
+    }
+
+    // The eight values of a BC4 UNORM block.
+    void AlphaPalette(int a0, int a1, int palette[8])
+    {
+        palette[0] = a0;
+        palette[1] = a1;
+        if(a0 > a1)
+        {
+            for(int i = 1; i <= 6; ++i)
+                palette[i + 1] = Interpolate(a0, a1, i, 7);
+        }
+        else
+        {
+            for(int i = 1; i <= 4; ++i)
+                palette[i + 1] = Interpolate(a0, a1, i, 5);
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+    }
+
+    // The eight values of a BC4 SNORM block, remapped from [-127, 127] to [0, 255].
+    // Each is interpolated exactly and rounded once; remapping rounded values would
+    // be off by one for some of them.
+    void SnormAlphaPalette(int a0, int a1, int palette[8])
+    {
+        // ((n - i) * a0 + i * a1) / n, rounded half up after the remap.
+        auto remap = [a0, a1](int i, int n)
+        {
+            const int sum = (n - i) * a0 + i * a1;
+            return ((sum + 127 * n) * 510 + 254 * n) / (508 * n);
+        };
+
+        palette[0] = remap(0, 1);
+        palette[1] = remap(1, 1);
+        if(a0 > a1)
+        {
+            for(int i = 1; i <= 6; ++i)
+                palette[i + 1] = remap(i, 7);
+        }
+        else
+        {
+            for(int i = 1; i <= 4; ++i)
+                palette[i + 1] = remap(i, 5);
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+    }
+
+    // Writes one channel, every fourth byte of out.
+    void DecodeAlpha(const uint8* block, uint8* out, bool snorm)
+    {
+        int palette[8];
+        if(snorm)
+        {
+            // -128 is read as -127.
+            const int a0 = std::max<int>((std::int8_t)block[0], -127);
+            const int a1 = std::max<int>((std::int8_t)block[1], -127);
+            SnormAlphaPalette(a0, a1, palette);
+        }
+        else
+        {
+            AlphaPalette(block[0], block[1], palette);
+        }
+
+        uint64 indices = 0;
+        std::memcpy(&indices, block + 2, 6);
+        for(int i = 0; i < 16; ++i, indices >>= 3)
+            out[4 * i] = (uint8)palette[indices & 7];
+    }
+
+    //
+    // Encoding.
+    //
+
+    inline XMVECTOR LoadQuad(const float* v)
+    {
+        return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(v));
+    }
+
+    // Picks for each of the 16 texels (in SoA channels) the nearest of the palette,
+    // four texels at a time, and returns the total squared error.
+    float SelectIndices(const float* const* channels, int channelCount,
+        const float (*palette)[4], int paletteCount, uint32* indices)
+    {
+        float error = 0.0f;
+        for(int group = 0; group < 16; group += 4)
+        {
+            XMVECTOR texel[4];
+            for(int c = 0; c < channelCount; ++c)
+                texel[c] = LoadQuad(channels[c] + group);
+
+            XMVECTOR best = XMVectorReplicate(FLT_MAX);
+            XMVECTOR bestIndex = XMVectorZero();
+            for(int k = 0; k < paletteCount; ++k)
+            {
+                XMVECTOR distance = XMVectorZero();
+                for(int c = 0; c < channelCount; ++c)
+                {
+                    const XMVECTOR d = XMVectorSubtract(texel[c], XMVectorReplicate(palette[k][c]));
+                    distance = XMVectorMultiplyAdd(d, d, distance);
+                }
+
+                const XMVECTOR closer = XMVectorLess(distance, best);
+                best = XMVectorSelect(best, distance, closer);
+                bestIndex = XMVectorSelect(bestIndex, XMVectorReplicate((float)k), closer);
+            }
+
+            XMFLOAT4 e, b;
+            XMStoreFloat4(&e, best);
+            XMStoreFloat4(&b, bestIndex);
+            error += e.x + e.y + e.z + e.w;
+            indices[group + 0] = (uint32)b.x;
+            indices[group + 1] = (uint32)b.y;
+            indices[group + 2] = (uint32)b.z;
+            indices[group + 3] = (uint32)b.w;
+        }
+        return error;
+    }
+
+    inline uint32 Quantize(float value, float scale)
+    {
+        return (uint32)(std::min(std::max(value, 0.0f), 255.0f) * scale + 0.5f);
+    }
+
+    inline uint32 Quantize565(const float* rgb)
+    {
+        return (Quantize(rgb[0], 31.0f / 255.0f) << 11) | (Quantize(rgb[1], 63.0f / 255.0f) << 5) |
+            Quantize(rgb[2], 31.0f / 255.0f);
+    }
+
+    struct ColorFit
+    {
+        uint32 C0;
+        uint32 C1;
+        uint32 Indices[16];
+        float Error;
+    };
+
+    // Indices and error of the endpoints c0 and c1 over the opaque texels.
+    void EvaluateColor(const float* const* channels, uint32 c0, uint32 c1, bool threeColor, ColorFit& fit)
+    {
+        uint8 palette8[4][4];
+        ColorPalette(c0, c1, threeColor, palette8);
+
+        float palette[4][4];
+        for(int k = 0; k < 4; ++k)
+            for(int c = 0; c < 3; ++c)
+                palette[k][c] = palette8[k][c];
+
+        fit.C0 = c0;
+        fit.C1 = c1;
+        fit.Error = SelectIndices(channels, 3, palette, threeColor ? 3 : 4, fit.Indices);
+    }
+
+    // Least squares endpoints for the palette weights the indices give each texel.
+    bool RefineColor(const float* const* channels, const uint32* indices, bool threeColor,
+        float* e0, float* e1)
+    {
+        static const float Weights4[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+        static const float Weights3[3] = { 0.0f, 1.0f, 0.5f };
+
+        float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+        float ax[3] = {}, bx[3] = {};
+        for(int i = 0; i < 16; ++i)
+        {
+            const float w = threeColor ? Weights3[indices[i]] : Weights4[indices[i]];
+            const float a = 1.0f - w;
+            aa += a * a;
+            bb += w * w;
+            ab += a * w;
+            for(int c = 0; c < 3; ++c)
+            {
+                ax[c] += a * channels[c][i];
+                bx[c] += w * channels[c][i];
+            }
+        }
+
+        const float det = aa * bb - ab * ab;
+        if(std::abs(det) < 1e-6f)
+            return false;
+
+        for(int c = 0; c < 3; ++c)
+        {
+            e0[c] = (bb * ax[c] - ab * bx[c]) / det;
+            e1[c] = (aa * bx[c] - ab * ax[c]) / det;
+        }
+        return true;
+    }
+
+    // BC1 colour block; with allowThreeColor, texels with alpha below 128 become
+    // transparent.  BC3 passes false, since its colour block is always four colour.
+    void EncodeColor(const uint8* rgba, uint8* block, bool allowThreeColor)
+    {
+        // Transparent texels are fitted as copies of the first opaque one, which leaves
+        // the axis alone; their indices are overwritten below.
+        bool transparent[16];
+        int opaque = -1;
+        for(int i = 0; i < 16; ++i)
+        {
+            transparent[i] = allowThreeColor && rgba[4 * i + 3] < 128;
+            if(!transparent[i] && opaque < 0)
+                opaque = i;
+        }
+
+        if(opaque < 0)
+        {
+            // c0 <= c1 with every index 3: all transparent black.
+            std::memset(block, 0, 4);
+            std::memset(block + 4, 0xff, 4);
+            return;
+        }
+
+        const bool threeColor = std::find(transparent, transparent + 16, true) != transparent + 16;
+
+        alignas(16) float r[16], g[16], b[16];
+        for(int i = 0; i < 16; ++i)
+        {
+            const uint8* texel = rgba + 4 * (transparent[i] ? opaque : i);
+            r[i] = texel[0];
+            g[i] = texel[1];
+            b[i] = texel[2];
+        }
+        const float* channels[3] = { r, g, b };
+
+        // Principal axis of the colours by power iteration on their covariance.
+        float mean[3] = {};
+        for(int i = 0; i < 16; ++i)
+        {
+            mean[0] += r[i];
+            mean[1] += g[i];
+            mean[2] += b[i];
+        }
+        for(float& m : mean)
+            m /= 16.0f;
+
+        float cov[6] = {};
+        for(int i = 0; i < 16; ++i)
+        {
+            const float d[3] = { r[i] - mean[0], g[i] - mean[1], b[i] - mean[2] };
+            cov[0] += d[0] * d[0];
+            cov[1] += d[0] * d[1];
+            cov[2] += d[0] * d[2];
+            cov[3] += d[1] * d[1];
+            cov[4] += d[1] * d[2];
+            cov[5] += d[2] * d[2];
+        }
+
+        float axis[3] = { 1.0f, 1.0f, 1.0f };
+        for(int iteration = 0; iteration < 4; ++iteration)
+        {
+            const float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+            const float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+            const float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+            const float length = std::max(std::max(std::abs(x), std::abs(y)), std::abs(z));
+            if(length < 1e-6f)
+                break;
+            const float scale = 1.0f / length;
+            axis[0] = x * scale;
+            axis[1] = y * scale;
+            axis[2] = z * scale;
+        }
+
+        float minT = FLT_MAX, maxT = -FLT_MAX;
+        for(int i = 0; i < 16; ++i)
+        {
+            const float t = (r[i] - mean[0]) * axis[0] + (g[i] - mean[1]) * axis[1] + (b[i] - mean[2]) * axis[2];
+            minT = std::min(minT, t);
+            maxT = std::max(maxT, t);
+        }
+
+        float e0[3], e1[3];
+        const float lengthSq = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+        for(int c = 0; c < 3; ++c)
+        {
+            e0[c] = mean[c] + axis[c] * maxT / lengthSq;
+            e1[c] = mean[c] + axis[c] * minT / lengthSq;
+        }
+
+        // Four colour mode needs c0 > c1, three colour mode c0 <= c1.
+        auto order = [threeColor](uint32& c0, uint32& c1)
+        {
+            if(threeColor ? c0 > c1 : c0 < c1)
+                std::swap(c0, c1);
+        };
+
+        uint32 c0 = Quantize565(e0);
+        uint32 c1 = Quantize565(e1);
+        order(c0, c1);
+
+        ColorFit best;
+        EvaluateColor(channels, c0, c1, threeColor, best);
+
+        if(c0 != c1 && RefineColor(channels, best.Indices, threeColor, e0, e1))
+        {
+            uint32 r0 = Quantize565(e0);
+            uint32 r1 = Quantize565(e1);
+            order(r0, r1);
+
+            ColorFit refined;
+            EvaluateColor(channels, r0, r1, threeColor, refined);
+            if(refined.Error < best.Error)
+                best = refined;
+        }
+
+        uint32 indices = 0;
+        for(int i = 15; i >= 0; --i)
+            indices = (indices << 2) | (transparent[i] ? 3 : best.Indices[i]);
+
+        block[0] = (uint8)best.C0;
+        block[1] = (uint8)(best.C0 >> 8);
+        block[2] = (uint8)best.C1;
+        block[3] = (uint8)(best.C1 >> 8);
+        std::memcpy(block + 4, &indices, 4);
+    }
+
+    // Unsigned BC4 block from one channel, every fourth byte of values.
+    void EncodeAlpha(const uint8* values, uint8* block)
+    {
+        alignas(16) float v[16];
+        int a0 = 0, a1 = 255;
+        for(int i = 0; i < 16; ++i)
+        {
+            v[i] = values[4 * i];
+            a0 = std::max<int>(a0, values[4 * i]);
+            a1 = std::min<int>(a1, values[4 * i]);
+        }
+
+        block[0] = (uint8)a0;
+        block[1] = (uint8)a1;
+        if(a0 == a1)
+        {
+            std::memset(block + 2, 0, 6);
+            return;
+        }
+
+        int palette8[8];
+        AlphaPalette(a0, a1, palette8);
+
+        float palette[8][4];
+        for(int k = 0; k < 8; ++k)
+            palette[k][0] = (float)palette8[k];
+
+        const float* channels[1] = { v };
+        uint32 indices[16];
+        SelectIndices(channels, 1, palette, 8, indices);
+
+        uint64 bits = 0;
+        for(int i = 15; i >= 0; --i)
+            bits = (bits << 3) | indices[i];
+        for(int i = 0; i < 6; ++i, bits >>= 8)
+            block[2 + i] = (uint8)bits;
+    }
+
+    void DecodeBlock(uint32 format, const uint8* block, uint8* rgba)
+    {
+        switch(format)
+        {
+        case DdsFile::FormatBC1Unorm:
+        case DdsFile::FormatBC1UnormSrgb:
+            BlockCompression::DecodeBC1(block, rgba);
+            break;
+        case DdsFile::FormatBC2Unorm:
+        case DdsFile::FormatBC2UnormSrgb:
+            BlockCompression::DecodeBC2(block, rgba);
+            break;
+        case DdsFile::FormatBC3Unorm:
+        case DdsFile::FormatBC3UnormSrgb:
+            BlockCompression::DecodeBC3(block, rgba);
+            break;
+        case DdsFile::FormatBC4Unorm:
+        case DdsFile::FormatBC4Snorm:
+            BlockCompression::DecodeBC4(block, rgba, format == DdsFile::FormatBC4Snorm);
+            break;
+        case DdsFile::FormatBC5Unorm:
+        case DdsFile::FormatBC5Snorm:
+            BlockCompression::DecodeBC5(block, rgba, format == DdsFile::FormatBC5Snorm);
+            break;
+        default:
+            BlockCompression::DecodeBC7(block, rgba);
+            break;
+        }
+    }
+
+    void EncodeBlock(uint32 format, const uint8* rgba, uint8* block)
+    {
+        switch(format)
+        {
+        case DdsFile::FormatBC1Unorm:
+        case DdsFile::FormatBC1UnormSrgb:
+            BlockCompression::EncodeBC1(rgba, block);
+            break;
+        case DdsFile::FormatBC3Unorm:
+        case DdsFile::FormatBC3UnormSrgb:
+            BlockCompression::EncodeBC3(rgba, block);
+            break;
+        case DdsFile::FormatBC4Unorm:
+            BlockCompression::EncodeBC4(rgba, block);
+            break;
+        default:
+            BlockCompression::EncodeBC5(rgba, block);
+            break;
+        }
+    }
+
+    // Rows of blocks per ParallelFor chunk: about a thousand blocks.
+    size_t BlockRowGrain(uint32 blocksWide)
+    {
+        return std::max<size_t>(1, 1024 / blocksWide);
+    }
+}
+
+BlockCompression::uint32 BlockCompression::BlockSize(uint32 format)
+{
+    return DdsFile::IsBlockCompressed(format) ? DdsFile::BitsPerPixel(format) * 2 : 0;
+}
+
+bool BlockCompression::CanDecode(uint32 format)
+{
+    switch(format)
+    {
+    case DdsFile::FormatBC1Unorm:
+    case DdsFile::FormatBC1UnormSrgb:
+    case DdsFile::FormatBC2Unorm:
+    case DdsFile::FormatBC2UnormSrgb:
+    case DdsFile::FormatBC3Unorm:
+    case DdsFile::FormatBC3UnormSrgb:
+    case DdsFile::FormatBC4Unorm:
+    case DdsFile::FormatBC4Snorm:
+    case DdsFile::FormatBC5Unorm:
+    case DdsFile::FormatBC5Snorm:
+    case DdsFile::FormatBC7Unorm:
+    case DdsFile::FormatBC7UnormSrgb:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool BlockCompression::CanEncode(uint32 format)
+{
+    switch(format)
+    {
+    case DdsFile::FormatBC1Unorm:
+    case DdsFile::FormatBC1UnormSrgb:
+    case DdsFile::FormatBC3Unorm:
+    case DdsFile::FormatBC3UnormSrgb:
+    case DdsFile::FormatBC4Unorm:
+    case DdsFile::FormatBC5Unorm:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void BlockCompression::DecodeBC1(const uint8* block, uint8* rgba)
+{
+    DecodeColor(block, rgba, true);
+}
+
+void BlockCompression::DecodeBC2(const uint8* block, uint8* rgba)
+{
+    DecodeColor(block + 8, rgba, false);
+
+    uint64 alpha;
+    std::memcpy(&alpha, block, 8);
+    for(int i = 0; i < 16; ++i, alpha >>= 4)
+        rgba[4 * i + 3] = (uint8)((alpha & 15) * 17);
+}
+
+void BlockCompression::DecodeBC3(const uint8* block, uint8* rgba)
+{
+    DecodeColor(block + 8, rgba, false);
+    DecodeAlpha(block, rgba + 3, false);
+}
+
+void BlockCompression::DecodeBC4(const uint8* block, uint8* rgba, bool snorm)
+{
+    DecodeAlpha(block, rgba, snorm);
+    for(int i = 0; i < 16; ++i)
+    {
+        rgba[4 * i + 1] = 0;
+        rgba[4 * i + 2] = 0;
+        rgba[4 * i + 3] = 255;
+    }
+}
+
+void BlockCompression::DecodeBC5(const uint8* block, uint8* rgba, bool snorm)
+{
+    DecodeAlpha(block, rgba, snorm);
+    DecodeAlpha(block + 8, rgba + 1, snorm);
+    for(int i = 0; i < 16; ++i)
+    {
+        rgba[4 * i + 2] = 0;
+        rgba[4 * i + 3] = 255;
+    }
+}
+
+void BlockCompression::DecodeBC7(const uint8* block, uint8* rgba)
+{
+    if(block[0] == 0)
+    {
+        std::memset(rgba, 0, 64);
+        return;
+    }
+
+    uint32 modeIndex = 0;
+    while(!(block[0] & (1u << modeIndex)))
+        ++modeIndex;
+    const Bc7Mode& mode = Bc7Modes[modeIndex];
+
+    BitReader bits(block);
+    bits.Skip(modeIndex + 1);
+
+    const uint32 partition = bits.Read(mode.PartitionBits);
+    const uint32 rotation = bits.Read(mode.RotationBits);
+    const uint32 indexSelection = bits.Read(mode.IndexSelectionBits);
+
+    // Endpoints as stored: all reds, then greens, blues and alphas.
+    const uint32 endpointCount = 2 * mode.Subsets;
+    uint32 endpoints[6][4];
+    for(uint32 c = 0; c < 3; ++c)
+        for(uint32 e = 0; e < endpointCount; ++e)
+            endpoints[e][c] = bits.Read(mode.ColorBits);
+    for(uint32 e = 0; e < endpointCount; ++e)
+        endpoints[e][3] = mode.AlphaBits ? bits.Read(mode.AlphaBits) : 255;
+
+    uint32 pBits[6] = {};
+    if(mode.EndpointPBits)
+    {
+        for(uint32 e = 0; e < endpointCount; ++e)
+            pBits[e] = bits.Read(1);
+    }
+    else if(mode.SharedPBits)
+    {
+        for(uint32 s = 0; s < mode.Subsets; ++s)
+            pBits[2 * s] = pBits[2 * s + 1] = bits.Read(1);
+    }
+
+    // Unquantize: append the p-bit, then replicate the high bits into the low ones.
+    const bool hasPBit = mode.EndpointPBits || mode.SharedPBits;
+    for(uint32 e = 0; e < endpointCount; ++e)
+    {
+        for(uint32 c = 0; c < 4; ++c)
+        {
+            const uint32 stored = c < 3 ? mode.ColorBits : mode.AlphaBits;
+            if(stored == 0)
+                continue;
+
+            uint32 value = endpoints[e][c];
+            uint32 precision = stored;
+            if(hasPBit)
+            {
+                value = (value << 1) | pBits[e];
+                precision++;
+            }
+            endpoints[e][c] = (value << (8 - precision)) | (value >> (2 * precision - 8));
+        }
+    }
+
+    uint32 subsets[16];
+    bool anchor[16] = {};
+    anchor[0] = true;
+    for(uint32 i = 0; i < 16; ++i)
+    {
+        if(mode.Subsets == 2)
+            subsets[i] = (Bc7Partitions2[partition] >> i) & 1;
+        else if(mode.Subsets == 3)
+            subsets[i] = (Bc7Partitions3[partition] >> (2 * i)) & 3;
+        else
+            subsets[i] = 0;
+    }
+    if(mode.Subsets == 2)
+        anchor[Bc7Anchors2[partition]] = true;
+    else if(mode.Subsets == 3)
+    {
+        anchor[Bc7Anchors3Second[partition]] = true;
+        anchor[Bc7Anchors3Third[partition]] = true;
+    }
+
+    uint32 indices[16];
+    for(uint32 i = 0; i < 16; ++i)
+        indices[i] = bits.Read(mode.IndexBits - (anchor[i] ? 1 : 0));
+
+    uint32 secondary[16];
+    if(mode.SecondaryIndexBits)
+    {
+        for(uint32 i = 0; i < 16; ++i)
+            secondary[i] = bits.Read(mode.SecondaryIndexBits - (i == 0 ? 1 : 0));
+    }
+
+    // Mode 4's index selection bit gives colour the secondary indices.
+    const uint32* colorIndices = indices;
+    const uint32* alphaIndices = mode.SecondaryIndexBits ? secondary : indices;
+    uint32 colorBits = mode.IndexBits;
+    uint32 alphaBits = mode.SecondaryIndexBits ? mode.SecondaryIndexBits : mode.IndexBits;
+    if(indexSelection)
+    {
+        std::swap(colorIndices, alphaIndices);
+        std::swap(colorBits, alphaBits);
+    }
+    const uint32* colorWeights = Bc7Weights(colorBits);
+    const uint32* alphaWeights = Bc7Weights(alphaBits);
+
+    for(uint32 i = 0; i < 16; ++i)
+    {
+        const uint32* e0 = endpoints[2 * subsets[i]];
+        const uint32* e1 = endpoints[2 * subsets[i] + 1];
+        const uint32 cw = colorWeights[colorIndices[i]];
+        const uint32 aw = alphaWeights[alphaIndices[i]];
+
+        uint8* texel = rgba + 4 * i;
+        for(uint32 c = 0; c < 3; ++c)
+            texel[c] = (uint8)(((64 - cw) * e0[c] + cw * e1[c] + 32) >> 6);
+        texel[3] = (uint8)(((64 - aw) * e0[3] + aw * e1[3] + 32) >> 6);
+
+        // Rotation swaps alpha with red, green or blue.
+        if(rotation)
+            std::swap(texel[3], texel[rotation - 1]);
+    }
+}
+
+void BlockCompression::EncodeBC1(const uint8* rgba, uint8* block)
+{
+    EncodeColor(rgba, block, true);
+}
+
+void BlockCompression::EncodeBC3(const uint8* rgba, uint8* block)
+{
+    EncodeAlpha(rgba + 3, block);
+    EncodeColor(rgba, block + 8, false);
+}
+
+void BlockCompression::EncodeBC4(const uint8* rgba, uint8* block)
+{
+    EncodeAlpha(rgba, block);
+}
+
+void BlockCompression::EncodeBC5(const uint8* rgba, uint8* block)
+{
+    EncodeAlpha(rgba, block);
+    EncodeAlpha(rgba + 1, block + 8);
+}
+
+bool BlockCompression::Decode(uint32 format, const uint8* src, uint32 width, uint32 height, uint8* rgba,
+    ThreadPool& pool)
+{
+    if(!CanDecode(format))
+        return false;
+
+    const uint32 blockSize = BlockSize(format);
+    const uint32 blocksWide = std::max(1u, (width + 3) / 4);
+    const uint32 blocksHigh = std::max(1u, (height + 3) / 4);
+
+    pool.ParallelFor(blocksHigh, BlockRowGrain(blocksWide), [&](size_t begin, size_t end)
+    {
+        uint8 texels[64];
+        for(size_t by = begin; by < end; ++by)
+        {
+            const uint8* row = src + by * blocksWide * blockSize;
+            const uint32 rows = std::min(4u, height - (uint32)by * 4);
+            for(uint32 bx = 0; bx < blocksWide; ++bx)
+            {
+                DecodeBlock(format, row + bx * blockSize, texels);
+
+                // Blocks over the edge are cut down to the texels inside.
+                const uint32 columns = std::min(4u, width - bx * 4);
+                for(uint32 y = 0; y < rows; ++y)
+                {
+                    uint8* dst = rgba + ((by * 4 + y) * width + bx * 4) * 4;
+                    std::memcpy(dst, texels + y * 16, columns * 4);
+                }
+            }
+        }
+    });
+    return true;
+}
+
+bool BlockCompression::Encode(uint32 format, const uint8* rgba, uint32 width, uint32 height, uint8* dst,
+    ThreadPool& pool)
+{
+    if(!CanEncode(format))
+        return false;
+
+    const uint32 blockSize = BlockSize(format);
+    const uint32 blocksWide = std::max(1u, (width + 3) / 4);
+    const uint32 blocksHigh = std::max(1u, (height + 3) / 4);
+
+    pool.ParallelFor(blocksHigh, BlockRowGrain(blocksWide), [&](size_t begin, size_t end)
+    {
+        uint8 texels[64];
+        for(size_t by = begin; by < end; ++by)
+        {
+            uint8* row = dst + by * blocksWide * blockSize;
+            for(uint32 bx = 0; bx < blocksWide; ++bx)
+            {
+                for(uint32 y = 0; y < 4; ++y)
+                {
+                    const uint32 sy = std::min((uint32)by * 4 + y, height - 1);
+                    for(uint32 x = 0; x < 4; ++x)
+                    {
+                        const uint32 sx = std::min(bx * 4 + x, width - 1);
+                        std::memcpy(texels + (y * 4 + x) * 4, rgba + (sy * width + sx) * 4, 4);
+                    }
+                }
+                EncodeBlock(format, texels, row + bx * blockSize);
+            }
+        }
+    });
+    return true;
+}
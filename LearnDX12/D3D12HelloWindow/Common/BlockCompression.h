@@ -0,0 +1,73 @@
+//***************************************************************************************
+// BlockCompression.h
+//
+// CPU decoding and encoding of the BC formats, for tools, thumbnails and fallbacks
+// that have to read compressed textures, and for compressing textures generated at
+// run time.
+//
+//   - Decode: BC1, BC2, BC3, BC4, BC5 and BC7 (every mode) to RGBA8.
+//   - Encode: BC1, BC3, BC4 and BC5 from RGBA8.  The encoder is built for speed: the
+//     colour endpoints are the extremes of the block along its principal axis, refined
+//     once by least squares, and indices are picked for four texels at a time.
+//
+// Surfaces are split into rows of blocks that run in parallel on a ThreadPool.  The
+// sRGB formats are handled like their UNORM twins: the bytes are the same, only the
+// sampling hardware treats them differently.
+//***************************************************************************************
+
+#pragma once
+
+#include "DdsFile.h"
+#include "ThreadPool.h"
+#include <cstdint>
+#include <vector>
+
+class BlockCompression
+{
+public:
+    using uint8 = std::uint8_t;
+    using uint32 = std::uint32_t;
+
+    // Bytes of a 4x4 block: 8 for BC1 and BC4, 16 for the others.
+    static uint32 BlockSize(uint32 format);
+
+    static bool CanDecode(uint32 format);
+    static bool CanEncode(uint32 format);
+
+    ///<summary>
+    /// Decodes one block to 16 RGBA8 texels in rows of four.  BC4 and BC5 fill red
+    /// (and green) with blue 0 and alpha 255; their SNORM values are remapped from
+    /// [-1, 1] to [0, 255].  Reserved BC7 modes decode to transparent black.
+    ///</summary>
+    static void DecodeBC1(const uint8* block, uint8* rgba);
+    static void DecodeBC2(const uint8* block, uint8* rgba);
+    static void DecodeBC3(const uint8* block, uint8* rgba);
+    static void DecodeBC4(const uint8* block, uint8* rgba, bool snorm);
+    static void DecodeBC5(const uint8* block, uint8* rgba, bool snorm);
+    static void DecodeBC7(const uint8* block, uint8* rgba);
+
+    ///<summary>
+    /// Encodes 16 RGBA8 texels in rows of four to one block.  BC1 switches to its
+    /// three colour mode, with transparent texels, when any alpha is below 128; BC4
+    /// reads red and BC5 red and green, both as UNORM.
+    ///</summary>
+    static void EncodeBC1(const uint8* rgba, uint8* block);
+    static void EncodeBC3(const uint8* rgba, uint8* block);
+    static void EncodeBC4(const uint8* rgba, uint8* block);
+    static void EncodeBC5(const uint8* rgba, uint8* block);
+
+    ///<summary>
+    /// Decodes a width x height surface laid out as DdsFile::SurfaceSize() describes
+    /// into width * 4 byte rows of RGBA8.  Returns false for formats not decoded here.
+    ///</summary>
+    static bool Decode(uint32 format, const uint8* src, uint32 width, uint32 height, uint8* rgba,
+        ThreadPool& pool = ThreadPool::Default());
+
+    ///<summary>
+    /// Encodes width * 4 byte rows of RGBA8 into a surface of format.  Blocks that hang
+    /// over the right or bottom edge repeat the edge texels.  Returns false for formats
+    /// not encoded here.
+    ///</summary>
+    static bool Encode(uint32 format, const uint8* rgba, uint32 width, uint32 height, uint8* dst,
+        ThreadPool& pool = ThreadPool::Default());
+};
@@ -0,0 +1,483 @@
+//***************************************************************************************
+// ChunkedTerrain.cpp
+//***************************************************************************************
+
+#include "ChunkedTerrain.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <iterator>
+
+using namespace DirectX;
+
+namespace
+{
+    const std::uint32_t LevelShift = 58;
+    const std::uint32_t CoordBits = 29;
+    const std::uint64_t CoordMask = (1ull << CoordBits) - 1;
+
+    // Nodes that are neither resident nor pending are forgotten after this many
+    // unused frames; they are rebuilt from their parent if needed again.
+    const std::uint64_t NodeForgetFrames = 256;
+
+    // Grid index of the k-th vertex along skirt edge 0 (+z), 1 (-z), 2 (-x) or 3 (+x)
+    // of a chunk with r quads per edge.
+    std::uint32_t EdgeGridIndex(std::uint32_t edge, std::uint32_t k, std::uint32_t r)
+    {
+        const std::uint32_t n = r + 1;
+        switch(edge)
+        {
+        case 0: return k;
+        case 1: return r*n + k;
+        case 2: return k*n;
+        default: return k*n + r;
+        }
+    }
+
+    // Frustum planes (a, b, c, d), inside where a*x + b*y + c*z + d >= 0, from a
+    // row-vector view-projection matrix with D3D's [0, 1] clip depth.
+    void ExtractFrustumPlanes(const XMFLOAT4X4& m, XMFLOAT4* planes)
+    {
+        auto column = [&m](int c) { return XMFLOAT4(m(0, c), m(1, c), m(2, c), m(3, c)); };
+        XMFLOAT4 c0 = column(0), c1 = column(1), c2 = column(2), c3 = column(3);
+
+        planes[0] = XMFLOAT4(c3.x + c0.x, c3.y + c0.y, c3.z + c0.z, c3.w + c0.w); // left
+        planes[1] = XMFLOAT4(c3.x - c0.x, c3.y - c0.y, c3.z - c0.z, c3.w - c0.w); // right
+        planes[2] = XMFLOAT4(c3.x + c1.x, c3.y + c1.y, c3.z + c1.z, c3.w + c1.w); // bottom
+        planes[3] = XMFLOAT4(c3.x - c1.x, c3.y - c1.y, c3.z - c1.z, c3.w - c1.w); // top
+        planes[4] = c2;                                                          // near
+        planes[5] = XMFLOAT4(c3.x - c2.x, c3.y - c2.y, c3.z - c2.z, c3.w - c2.w); // far
+    }
+
+    bool BoxInFrustum(const XMFLOAT4* planes, const XMFLOAT3& boxMin, const XMFLOAT3& boxMax)
+    {
+        for(int i = 0; i < 6; ++i)
+        {
+            const XMFLOAT4& p = planes[i];
+
+            // Test the corner furthest along the plane normal.
+            float x = p.x >= 0.0f ? boxMax.x : boxMin.x;
+            float y = p.y >= 0.0f ? boxMax.y : boxMin.y;
+            float z = p.z >= 0.0f ? boxMax.z : boxMin.z;
+            if(p.x*x + p.y*y + p.z*z + p.w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+
+    float DistanceToBox(const XMFLOAT3& p, const XMFLOAT3& boxMin, const XMFLOAT3& boxMax)
+    {
+        float dx = std::max(std::max(boxMin.x - p.x, p.x - boxMax.x), 0.0f);
+        float dy = std::max(std::max(boxMin.y - p.y, p.y - boxMax.y), 0.0f);
+        float dz = std::max(std::max(boxMin.z - p.z, p.z - boxMax.z), 0.0f);
+        return std::sqrt(dx*dx + dy*dy + dz*dz);
+    }
+}
+
+const ChunkedTerrain::uint32 ChunkedTerrain::NoSlot;
+const ChunkedTerrain::uint64 ChunkedTerrain::NoKey;
+
+ChunkedTerrain::ChunkedTerrain(const TerrainDesc& desc, ThreadPool& pool) :
+    mDesc(desc),
+    mPool(pool)
+{
+    assert(mDesc.Height);
+    assert(mDesc.MaxResidentChunks > 0);
+    assert(mDesc.MaxDepth < 32 - 3);
+
+    const uint32 n = mDesc.Resolution + 1;
+    mVerticesPerChunk = n*n + 4*n;
+    assert(mVerticesPerChunk <= 0x10000);
+
+    BuildIndices();
+
+    mSlotVertices.resize(mDesc.MaxResidentChunks);
+    mSlotOwner.resize(mDesc.MaxResidentChunks, NoKey);
+    for(uint32 i = mDesc.MaxResidentChunks; i > 0; --i)
+        mFreeSlots.push_back(i - 1);
+
+    // The root is always resident so the selection never comes up empty.
+    Result root;
+    root.Key = MakeKey(0, 0, 0);
+    GenerateChunk(root.Key, root);
+    Integrate(root);
+}
+
+ChunkedTerrain::~ChunkedTerrain()
+{
+    // Workers hold a pointer to this object.
+    for(auto& job : mJobs)
+        job.wait();
+}
+
+ChunkedTerrain::uint64 ChunkedTerrain::MakeKey(uint32 level, uint32 x, uint32 z)
+{
+    return (uint64(level) << LevelShift) | (uint64(x) << CoordBits) | uint64(z);
+}
+
+void ChunkedTerrain::NodeRect(uint32 level, uint32 x, uint32 z, float& minX, float& minZ, float& size)const
+{
+    size = mDesc.WorldSize/float(1u << level);
+    minX = -0.5f*mDesc.WorldSize + x*size;
+    minZ = -0.5f*mDesc.WorldSize + z*size;
+}
+
+void ChunkedTerrain::BuildIndices()
+{
+    const uint32 r = mDesc.Resolution;
+    const uint32 n = r + 1;
+
+    mIndices.clear();
+    mIndices.reserve(6*r*r + 4*6*r);
+
+    // Same layout and winding as GeometryGenerator::CreateGrid: row i runs along +x
+    // at z = maxZ - i*step.
+    for(uint32 i = 0; i < r; ++i)
+    {
+        for(uint32 j = 0; j < r; ++j)
+        {
+            mIndices.push_back(std::uint16_t(i*n + j));
+            mIndices.push_back(std::uint16_t(i*n + j + 1));
+            mIndices.push_back(std::uint16_t((i + 1)*n + j));
+
+            mIndices.push_back(std::uint16_t((i + 1)*n + j));
+            mIndices.push_back(std::uint16_t(i*n + j + 1));
+            mIndices.push_back(std::uint16_t((i + 1)*n + j + 1));
+        }
+    }
+
+    //
+    // Skirts: edge e copies grid vertex EdgeGridIndex(e, k) to n*n + e*n + k, lowered
+    // by SkirtDepth.  The winding of each strip is picked so it faces out of the chunk,
+    // using grid coordinates (x = j, z = -i) to evaluate the orientation.
+    //
+
+    const float outward[4][2] = { { 0.0f, 1.0f }, { 0.0f, -1.0f }, { -1.0f, 0.0f }, { 1.0f, 0.0f } };
+
+    for(uint32 edge = 0; edge < 4; ++edge)
+    {
+        // Horizontal edge direction (dx, dz) between consecutive vertices in grid units.
+        uint32 a = EdgeGridIndex(edge, 0, r);
+        uint32 b = EdgeGridIndex(edge, 1, r);
+        float dx = float(int(b % n) - int(a % n));
+        float dz = -float(int(b / n) - int(a / n));
+
+        // Normal of (g0, g1, s0) is cross((dx, 0, dz), (0, -1, 0)) = (dz, 0, -dx).
+        bool flip = dz*outward[edge][0] - dx*outward[edge][1] < 0.0f;
+
+        for(uint32 k = 0; k < r; ++k)
+        {
+            std::uint16_t g0 = std::uint16_t(EdgeGridIndex(edge, k, r));
+            std::uint16_t g1 = std::uint16_t(EdgeGridIndex(edge, k + 1, r));
+            std::uint16_t s0 = std::uint16_t(n*n + edge*n + k);
+            std::uint16_t s1 = std::uint16_t(s0 + 1);
+
+            if(flip)
+            {
+                std::uint16_t tri[6] = { g0, s0, g1, s0, s1, g1 };
+                mIndices.insert(mIndices.end(), tri, tri + 6);
+            }
+            else
+            {
+                std::uint16_t tri[6] = { g0, g1, s0, s0, g1, s1 };
+                mIndices.insert(mIndices.end(), tri, tri + 6);
+            }
+        }
+    }
+}
+
+void ChunkedTerrain::GenerateChunk(uint64 key, Result& result)const
+{
+    const uint32 level = uint32(key >> LevelShift);
+    const uint32 x = uint32((key >> CoordBits) & CoordMask);
+    const uint32 z = uint32(key & CoordMask);
+
+    const uint32 r = mDesc.Resolution;
+    const uint32 n = r + 1;
+
+    // Vertices are placed on the lattice of the finest level, so a vertex shared by
+    // chunks of any levels is computed from the same integer and matches exactly.
+    const uint32 scale = 1u << (mDesc.MaxDepth - level);
+    const float leafStep = mDesc.WorldSize/float((1u << mDesc.MaxDepth)*r);
+    const float h = 0.5f*leafStep*scale;
+
+    result.Vertices.resize(mVerticesPerChunk);
+    result.MinY = FLT_MAX;
+    result.MaxY = -FLT_MAX;
+
+    // Positions first, so heights and normals can be evaluated as whole arrays.
+    std::vector<float> px(n*n);
+    std::vector<float> pz(n*n);
+    std::vector<float> py(n*n);
+    for(uint32 i = 0; i < n; ++i)
+    {
+        for(uint32 j = 0; j < n; ++j)
+        {
+            // Row i is at z = maxZ - i*step, as in GeometryGenerator::CreateGrid.
+            std::int64_t gx = (std::int64_t(x)*r + j)*scale;
+            std::int64_t gz = (std::int64_t(z + 1)*r - i)*scale;
+            px[i*n + j] = -0.5f*mDesc.WorldSize + gx*leafStep;
+            pz[i*n + j] = -0.5f*mDesc.WorldSize + gz*leafStep;
+        }
+    }
+
+    if(mDesc.Heights)
+    {
+        mDesc.Heights(px.data(), pz.data(), py.data(), py.size());
+    }
+    else
+    {
+        for(size_t k = 0; k < py.size(); ++k)
+            py[k] = mDesc.Height(px[k], pz[k]);
+    }
+
+    std::vector<XMFLOAT3> normals;
+    if(mDesc.Normals)
+    {
+        normals.resize(n*n);
+        mDesc.Normals(px.data(), pz.data(), normals.data(), normals.size());
+    }
+
+    for(uint32 k = 0; k < n*n; ++k)
+    {
+        TerrainVertex& v = result.Vertices[k];
+        v.Pos = XMFLOAT3(px[k], py[k], pz[k]);
+
+        if(mDesc.Normals)
+        {
+            v.Normal = normals[k];
+        }
+        else if(mDesc.Normal)
+        {
+            v.Normal = mDesc.Normal(px[k], pz[k]);
+        }
+        else
+        {
+            float dhdx = (mDesc.Height(px[k] + h, pz[k]) - mDesc.Height(px[k] - h, pz[k]))/(2.0f*h);
+            float dhdz = (mDesc.Height(px[k], pz[k] + h) - mDesc.Height(px[k], pz[k] - h))/(2.0f*h);
+            XMStoreFloat3(&v.Normal, XMVector3Normalize(XMVectorSet(-dhdx, 1.0f, -dhdz, 0.0f)));
+        }
+
+        result.MinY = std::min(result.MinY, v.Pos.y);
+        result.MaxY = std::max(result.MaxY, v.Pos.y);
+    }
+
+    for(uint32 edge = 0; edge < 4; ++edge)
+    {
+        for(uint32 k = 0; k < n; ++k)
+        {
+            TerrainVertex& s = result.Vertices[n*n + edge*n + k];
+            s = result.Vertices[EdgeGridIndex(edge, k, r)];
+            s.Pos.y -= mDesc.SkirtDepth;
+        }
+    }
+
+    result.MinY -= mDesc.SkirtDepth;
+}
+
+ChunkedTerrain::uint32 ChunkedTerrain::AcquireSlot()
+{
+    if(!mFreeSlots.empty())
+    {
+        uint32 slot = mFreeSlots.back();
+        mFreeSlots.pop_back();
+        return slot;
+    }
+
+    // Evict the least recently drawn chunk the GPU can no longer be reading.
+    const uint64 rootKey = MakeKey(0, 0, 0);
+    uint32 victim = NoSlot;
+    uint64 oldest = mFrame;
+    for(uint32 slot = 0; slot < mDesc.MaxResidentChunks; ++slot)
+    {
+        if(mSlotOwner[slot] == rootKey)
+            continue;
+
+        const Node& node = mNodes.at(mSlotOwner[slot]);
+        if(node.LastUsedFrame + mDesc.FramesInFlight <= mFrame && node.LastUsedFrame < oldest)
+        {
+            oldest = node.LastUsedFrame;
+            victim = slot;
+        }
+    }
+
+    if(victim != NoSlot)
+    {
+        mNodes.at(mSlotOwner[victim]).Slot = NoSlot;
+        ++mStats.ChunksEvicted;
+    }
+    return victim;
+}
+
+bool ChunkedTerrain::Integrate(Result& result)
+{
+    uint32 slot = AcquireSlot();
+    if(slot == NoSlot)
+        return false;
+
+    Node& node = mNodes[result.Key];
+    node.Pending = false;
+
+    mSlotVertices[slot] = std::move(result.Vertices);
+    mSlotOwner[slot] = result.Key;
+
+    node.Slot = slot;
+    node.MinY = result.MinY;
+    node.MaxY = result.MaxY;
+    node.LastUsedFrame = mFrame;
+
+    mCompleted.push_back(slot);
+    ++mStats.ChunksCompleted;
+    return true;
+}
+
+void ChunkedTerrain::Select(uint32 level, uint32 x, uint32 z, const XMFLOAT3& eyePos, const XMFLOAT4* planes)
+{
+    Node& node = mNodes[MakeKey(level, x, z)];
+    node.LastUsedFrame = mFrame;
+    ++mStats.NodesVisited;
+
+    float minX, minZ, size;
+    NodeRect(level, x, z, minX, minZ, size);
+
+    XMFLOAT3 boxMin(minX, node.MinY, minZ);
+    XMFLOAT3 boxMax(minX + size, node.MaxY, minZ + size);
+    if(!BoxInFrustum(planes, boxMin, boxMax))
+    {
+        ++mStats.NodesCulled;
+        return;
+    }
+
+    float distance = DistanceToBox(eyePos, boxMin, boxMax);
+    if(level < mDesc.MaxDepth && distance < mDesc.SplitDistance*size)
+    {
+        // Refine only once all four children can be drawn; until then this node
+        // covers their area and the missing ones are queued.
+        bool ready = true;
+        for(uint32 c = 0; c < 4; ++c)
+        {
+            uint64 childKey = MakeKey(level + 1, 2*x + (c & 1), 2*z + (c >> 1));
+
+            auto it = mNodes.find(childKey);
+            if(it == mNodes.end())
+            {
+                it = mNodes.emplace(childKey, Node()).first;
+                it->second.MinY = node.MinY;
+                it->second.MaxY = node.MaxY;
+            }
+
+            Node& child = it->second;
+            child.LastUsedFrame = mFrame;
+
+            if(child.Slot == NoSlot)
+            {
+                ready = false;
+                if(!child.Pending)
+                    mRequests.push_back(std::make_pair(distance, childKey));
+            }
+        }
+
+        if(ready)
+        {
+            for(uint32 c = 0; c < 4; ++c)
+                Select(level + 1, 2*x + (c & 1), 2*z + (c >> 1), eyePos, planes);
+            return;
+        }
+    }
+
+    mVisible.push_back({ node.Slot, level });
+    ++mStats.ChunksDrawn;
+}
+
+void ChunkedTerrain::Update(const XMFLOAT3& eyePos, const XMFLOAT4X4& viewProj)
+{
+    ++mFrame;
+
+    mVisible.clear();
+    mRequests.clear();
+    mStats.NodesVisited = 0;
+    mStats.NodesCulled = 0;
+    mStats.ChunksDrawn = 0;
+    mStats.ChunksRequested = 0;
+    mStats.ChunksCompleted = 0;
+    mStats.ChunksEvicted = 0;
+
+    // Chunks that waited for a slot go before the ones that just arrived.
+    std::vector<std::unique_ptr<Result>> results;
+    results.swap(mWaiting);
+    {
+        std::lock_guard<std::mutex> lock(mResultMutex);
+        results.insert(results.end(), std::make_move_iterator(mResults.begin()), std::make_move_iterator(mResults.end()));
+        mResults.clear();
+    }
+    for(auto& result : results)
+    {
+        if(Integrate(*result))
+        {
+            --mPendingCount;
+            continue;
+        }
+
+        // Every slot is in use.  Keep the chunk while the last selection still
+        // wanted it, rather than generating it again once a slot frees up.
+        Node& node = mNodes[result->Key];
+        if(node.LastUsedFrame + 1 >= mFrame)
+        {
+            mWaiting.push_back(std::move(result));
+        }
+        else
+        {
+            node.Pending = false;
+            --mPendingCount;
+        }
+    }
+
+    mJobs.erase(std::remove_if(mJobs.begin(), mJobs.end(), [](const std::future<void>& job)
+    {
+        return job.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }), mJobs.end());
+
+    XMFLOAT4 planes[6];
+    ExtractFrustumPlanes(viewProj, planes);
+    Select(0, 0, 0, eyePos, planes);
+
+    // Nearest chunks first; whatever does not fit the budget is asked for again
+    // next frame.
+    std::sort(mRequests.begin(), mRequests.end());
+    for(const auto& request : mRequests)
+    {
+        if(mPendingCount >= mDesc.MaxPendingChunks)
+            break;
+
+        const uint64 key = request.second;
+        mNodes[key].Pending = true;
+        ++mPendingCount;
+        ++mStats.ChunksRequested;
+
+        mJobs.push_back(mPool.Submit([this, key]()
+        {
+            std::unique_ptr<Result> result(new Result());
+            result->Key = key;
+            GenerateChunk(key, *result);
+
+            std::lock_guard<std::mutex> lock(mResultMutex);
+            mResults.push_back(std::move(result));
+        }));
+    }
+
+    if(mFrame % NodeForgetFrames == 0)
+    {
+        for(auto it = mNodes.begin(); it != mNodes.end();)
+        {
+            const Node& node = it->second;
+            if(node.Slot == NoSlot && !node.Pending && node.LastUsedFrame + NodeForgetFrames < mFrame)
+                it = mNodes.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    mStats.ChunksResident = mDesc.MaxResidentChunks - (uint32)mFreeSlots.size();
+    mStats.ChunksPending = mPendingCount;
+}
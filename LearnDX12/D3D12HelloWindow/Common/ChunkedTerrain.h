@@ -0,0 +1,198 @@
+//***************************************************************************************
+// ChunkedTerrain.h
+//
+// Quadtree of fixed resolution terrain patches.  Every node, whatever its level, is a
+// (Resolution+1)^2 vertex grid plus a skirt hanging from its four edges, so neighbours
+// of different levels never show cracks and all chunks share one index buffer.
+//
+// Each frame Update() walks the tree from the root, frustum culls nodes by their
+// bounds and splits the ones that are close to the eye.  A node is only split once all
+// four children are resident; missing children are generated on the thread pool and
+// the parent keeps drawing until they arrive.  The per-frame cost therefore follows
+// the visible detail, not the size of the world.
+//
+// Resident chunks live in a fixed number of slots.  The renderer keeps one vertex
+// buffer with Resolution-sized regions per slot, copies CompletedSlots() into it and
+// draws VisibleChunks() with BaseVertexLocation = slot*VerticesPerChunk().  A slot is
+// only reused once it has not been drawn for FramesInFlight frames, so the GPU is never
+// reading a region that is being overwritten.
+//***************************************************************************************
+
+#pragma once
+
+#include "ThreadPool.h"
+#include <DirectXMath.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct TerrainDesc
+{
+    // The terrain covers [-WorldSize/2, WorldSize/2] in x and z.
+    float WorldSize = 320.0f;
+
+    // Quads per chunk edge.  (Resolution+1)^2 + 4*(Resolution+1) must fit 16-bit indices.
+    std::uint32_t Resolution = 32;
+
+    // Levels below the root; leaves are WorldSize/2^MaxDepth wide.
+    std::uint32_t MaxDepth = 4;
+
+    // A node splits when the eye is closer to its bounds than SplitDistance*width.
+    float SplitDistance = 1.5f;
+
+    // How far the skirts hang below the chunk edges.
+    float SkirtDepth = 4.0f;
+
+    // Resident chunk slots, and how many frames a slot must go undrawn before reuse.
+    std::uint32_t MaxResidentChunks = 256;
+    std::uint32_t FramesInFlight = 3;
+
+    // Chunks being generated or waiting for a slot at once; more requests wait for a
+    // later frame.
+    std::uint32_t MaxPendingChunks = 16;
+
+    // Height at (x, z).  Called from worker threads.
+    std::function<float(float, float)> Height;
+
+    // Unit normal at (x, z).  Optional; central differences of Height otherwise.
+    std::function<DirectX::XMFLOAT3(float, float)> Normal;
+
+    // Optional batch forms, y[i] = Height(x[i], z[i]) and n[i] = Normal(x[i], z[i]).
+    // When set they are called once per chunk instead of once per vertex.
+    std::function<void(const float*, const float*, float*, size_t)> Heights;
+    std::function<void(const float*, const float*, DirectX::XMFLOAT3*, size_t)> Normals;
+};
+
+struct TerrainVertex
+{
+    DirectX::XMFLOAT3 Pos;
+    DirectX::XMFLOAT3 Normal;
+};
+
+struct TerrainDrawChunk
+{
+    std::uint32_t Slot;
+    std::uint32_t Level;
+};
+
+struct TerrainStats
+{
+    std::uint32_t NodesVisited = 0;
+    std::uint32_t NodesCulled = 0;
+    std::uint32_t ChunksDrawn = 0;
+    std::uint32_t ChunksRequested = 0;
+    std::uint32_t ChunksCompleted = 0;
+    std::uint32_t ChunksEvicted = 0;
+    std::uint32_t ChunksResident = 0;
+    std::uint32_t ChunksPending = 0;
+};
+
+class ChunkedTerrain
+{
+public:
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+    // Generates the root chunk before returning, so there is always something to draw.
+    explicit ChunkedTerrain(const TerrainDesc& desc, ThreadPool& pool = ThreadPool::Default());
+    ChunkedTerrain(const ChunkedTerrain& rhs) = delete;
+    ChunkedTerrain& operator=(const ChunkedTerrain& rhs) = delete;
+    ~ChunkedTerrain();
+
+    const TerrainDesc& Desc()const { return mDesc; }
+
+    uint32 VerticesPerChunk()const { return mVerticesPerChunk; }
+    uint32 SlotCount()const { return mDesc.MaxResidentChunks; }
+
+    // Triangle list shared by every chunk: the grid followed by the skirts.
+    const std::vector<std::uint16_t>& Indices()const { return mIndices; }
+
+    ///<summary>
+    /// Takes finished chunks into slots, selects and culls the nodes to draw from the
+    /// eye position and the (row-vector) view-projection matrix, and queues the chunks
+    /// the selection is missing.
+    ///</summary>
+    void Update(const DirectX::XMFLOAT3& eyePos, const DirectX::XMFLOAT4X4& viewProj);
+
+    const std::vector<TerrainDrawChunk>& VisibleChunks()const { return mVisible; }
+
+    // Slots filled since the last ClearCompletedSlots(), starting with the root's;
+    // their vertices must be copied to the GPU before VisibleChunks() are drawn.
+    const std::vector<uint32>& CompletedSlots()const { return mCompleted; }
+
+    // Call once the renderer has copied CompletedSlots().
+    void ClearCompletedSlots() { mCompleted.clear(); }
+
+    // VerticesPerChunk() vertices of a resident slot.
+    const TerrainVertex* SlotVertices(uint32 slot)const { return mSlotVertices[slot].data(); }
+
+    const TerrainStats& Stats()const { return mStats; }
+
+private:
+    struct Node
+    {
+        uint32 Slot = NoSlot;
+        bool Pending = false;
+        uint64 LastUsedFrame = 0;
+
+        // Height range of the chunk including skirts.  Until the chunk exists this
+        // is the parent's range.
+        float MinY = 0.0f;
+        float MaxY = 0.0f;
+    };
+
+    struct Result
+    {
+        uint64 Key;
+        std::vector<TerrainVertex> Vertices;
+        float MinY;
+        float MaxY;
+    };
+
+    static const uint32 NoSlot = 0xffffffff;
+    static const uint64 NoKey = 0xffffffffffffffffull;
+
+    static uint64 MakeKey(uint32 level, uint32 x, uint32 z);
+    void NodeRect(uint32 level, uint32 x, uint32 z, float& minX, float& minZ, float& size)const;
+
+    void BuildIndices();
+    void GenerateChunk(uint64 key, Result& result)const;
+    bool Integrate(Result& result);
+    uint32 AcquireSlot();
+
+    void Select(uint32 level, uint32 x, uint32 z, const DirectX::XMFLOAT3& eyePos, const DirectX::XMFLOAT4* planes);
+
+private:
+    TerrainDesc mDesc;
+    ThreadPool& mPool;
+
+    uint32 mVerticesPerChunk = 0;
+    std::vector<std::uint16_t> mIndices;
+
+    std::unordered_map<uint64, Node> mNodes;
+    std::vector<std::vector<TerrainVertex>> mSlotVertices;
+    std::vector<uint64> mSlotOwner;
+    std::vector<uint32> mFreeSlots;
+
+    uint64 mFrame = 0;
+    std::vector<TerrainDrawChunk> mVisible;
+    std::vector<uint32> mCompleted;
+    TerrainStats mStats;
+
+    // Requests found by this frame's selection, issued nearest first.
+    std::vector<std::pair<float, uint64>> mRequests;
+
+    // Finished by workers, taken by the next Update().
+    std::mutex mResultMutex;
+    std::vector<std::unique_ptr<Result>> mResults;
+
+    // Finished chunks that found every slot in use, retried each Update() for as long
+    // as the selection still asks for them.  They count as pending, so the request
+    // budget also bounds how many wait.
+    std::vector<std::unique_ptr<Result>> mWaiting;
+    uint32 mPendingCount = 0;
+    std::vector<std::future<void>> mJobs;
+};
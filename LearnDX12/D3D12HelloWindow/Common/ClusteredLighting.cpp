@@ -0,0 +1,307 @@
+//***************************************************************************************
+// ClusteredLighting.cpp
+//***************************************************************************************
+
+#include "ClusteredLighting.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace DirectX;
+
+const float LightClusterBuilder::SpotCutoff = 1.0f / 256.0f;
+
+namespace
+{
+    inline XMVECTOR LoadQuad(const std::vector<float>& v, size_t i)
+    {
+        return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&v[i]));
+    }
+}
+
+void LightClusterBuilder::LightSoA::Clear()
+{
+    X.clear(); Y.clear(); Z.clear(); Radius.clear();
+    DirX.clear(); DirY.clear(); DirZ.clear(); CosAngle.clear(); SinAngle.clear();
+    Index.clear();
+}
+
+void LightClusterBuilder::LightSoA::Append(const LightSoA& src, size_t i)
+{
+    X.push_back(src.X[i]);
+    Y.push_back(src.Y[i]);
+    Z.push_back(src.Z[i]);
+    Radius.push_back(src.Radius[i]);
+    DirX.push_back(src.DirX[i]);
+    DirY.push_back(src.DirY[i]);
+    DirZ.push_back(src.DirZ[i]);
+    CosAngle.push_back(src.CosAngle[i]);
+    SinAngle.push_back(src.SinAngle[i]);
+    Index.push_back(src.Index[i]);
+}
+
+void LightClusterBuilder::LightSoA::Pad()
+{
+    // Padding lights sit far behind the camera with no radius, so no box contains them.
+    while(Index.size() % 4 != 0)
+    {
+        X.push_back(0.0f);
+        Y.push_back(0.0f);
+        Z.push_back(-1e30f);
+        Radius.push_back(0.0f);
+        DirX.push_back(0.0f);
+        DirY.push_back(0.0f);
+        DirZ.push_back(0.0f);
+        CosAngle.push_back(-1.0f);
+        SinAngle.push_back(0.0f);
+        Index.push_back(UINT32_MAX);
+    }
+}
+
+LightClusterBuilder::LightClusterBuilder(const ClusterGridDesc& desc)
+{
+    SetGrid(desc);
+}
+
+void LightClusterBuilder::SetGrid(const ClusterGridDesc& desc)
+{
+    assert(desc.TilesX > 0 && desc.TilesY > 0 && desc.Slices > 0);
+    assert(desc.NearZ > 0.0f && desc.FarZ > desc.NearZ);
+
+    mDesc = desc;
+    mTanHalfY = std::tan(0.5f * desc.FovY);
+    mTanHalfX = mTanHalfY * desc.Aspect;
+    mLogDepthScale = desc.Slices / std::log(desc.FarZ / desc.NearZ);
+
+    mSliceDepths.resize(desc.Slices + 1);
+    for(uint32 k = 0; k <= desc.Slices; ++k)
+        mSliceDepths[k] = desc.NearZ * std::pow(desc.FarZ / desc.NearZ, (float)k / desc.Slices);
+
+    mClusterBoxes.resize(ClusterCount());
+    mRowBoxes.resize(desc.Slices * desc.TilesY);
+    mSliceBoxes.resize(desc.Slices);
+
+    for(uint32 slice = 0; slice < desc.Slices; ++slice)
+    {
+        const float zn = mSliceDepths[slice];
+        const float zf = mSliceDepths[slice + 1];
+
+        Box& sliceBox = mSliceBoxes[slice];
+        sliceBox.Min = XMFLOAT3(-zf * mTanHalfX, -zf * mTanHalfY, zn);
+        sliceBox.Max = XMFLOAT3(zf * mTanHalfX, zf * mTanHalfY, zf);
+
+        for(uint32 y = 0; y < desc.TilesY; ++y)
+        {
+            // Tile rows run top to bottom, like the screen.
+            const float top = 1.0f - 2.0f * y / desc.TilesY;
+            const float bottom = 1.0f - 2.0f * (y + 1) / desc.TilesY;
+            const float minY = std::min(bottom * zn, bottom * zf) * mTanHalfY;
+            const float maxY = std::max(top * zn, top * zf) * mTanHalfY;
+
+            Box& rowBox = mRowBoxes[slice * desc.TilesY + y];
+            rowBox.Min = XMFLOAT3(sliceBox.Min.x, minY, zn);
+            rowBox.Max = XMFLOAT3(sliceBox.Max.x, maxY, zf);
+
+            for(uint32 x = 0; x < desc.TilesX; ++x)
+            {
+                const float left = -1.0f + 2.0f * x / desc.TilesX;
+                const float right = -1.0f + 2.0f * (x + 1) / desc.TilesX;
+
+                Box& box = mClusterBoxes[ClusterIndex(x, y, slice)];
+                box.Min = XMFLOAT3(std::min(left * zn, left * zf) * mTanHalfX, minY, zn);
+                box.Max = XMFLOAT3(std::max(right * zn, right * zf) * mTanHalfX, maxY, zf);
+            }
+        }
+    }
+
+    mScratch.resize(desc.Slices);
+    mRanges.assign(ClusterCount(), Range());
+}
+
+LightClusterBuilder::uint32 LightClusterBuilder::ClusterOf(const XMFLOAT3& viewPos)const
+{
+    if(viewPos.z < mDesc.NearZ || viewPos.z >= mDesc.FarZ)
+        return UINT32_MAX;
+
+    const float ndcX = viewPos.x / (viewPos.z * mTanHalfX);
+    const float ndcY = viewPos.y / (viewPos.z * mTanHalfY);
+    if(ndcX < -1.0f || ndcX >= 1.0f || ndcY <= -1.0f || ndcY > 1.0f)
+        return UINT32_MAX;
+
+    const uint32 x = std::min((uint32)((ndcX + 1.0f) * 0.5f * mDesc.TilesX), mDesc.TilesX - 1);
+    const uint32 y = std::min((uint32)((1.0f - ndcY) * 0.5f * mDesc.TilesY), mDesc.TilesY - 1);
+    const uint32 slice = std::min((uint32)(std::log(viewPos.z / mDesc.NearZ) * mLogDepthScale), mDesc.Slices - 1);
+
+    return ClusterIndex(x, y, slice);
+}
+
+void LightClusterBuilder::Build(const XMFLOAT4X4& view, const ShadingLight* lights, uint32 numPointLights,
+    uint32 numSpotLights, ThreadPool& pool)
+{
+    const uint32 numLights = numPointLights + numSpotLights;
+
+    //
+    // Lights to view space.  Point lights get an all-round cone (cos = -1), which the
+    // cone test never rejects.
+    //
+    mLights.Clear();
+    for(uint32 i = 0; i < numLights; ++i)
+    {
+        const ShadingLight& L = lights[i];
+        const XMFLOAT3& p = L.Position;
+
+        mLights.X.push_back(p.x * view(0, 0) + p.y * view(1, 0) + p.z * view(2, 0) + view(3, 0));
+        mLights.Y.push_back(p.x * view(0, 1) + p.y * view(1, 1) + p.z * view(2, 1) + view(3, 1));
+        mLights.Z.push_back(p.x * view(0, 2) + p.y * view(1, 2) + p.z * view(2, 2) + view(3, 2));
+        mLights.Radius.push_back(L.FalloffEnd);
+        mLights.Index.push_back(i);
+
+        if(i >= numPointLights && L.SpotPower > 0.0f)
+        {
+            const XMFLOAT3& d = L.Direction;
+            mLights.DirX.push_back(d.x * view(0, 0) + d.y * view(1, 0) + d.z * view(2, 0));
+            mLights.DirY.push_back(d.x * view(0, 1) + d.y * view(1, 1) + d.z * view(2, 1));
+            mLights.DirZ.push_back(d.x * view(0, 2) + d.y * view(1, 2) + d.z * view(2, 2));
+
+            // pow(cos, SpotPower) = SpotCutoff; the shader clamps cos at 0, so at most 90 degrees.
+            const float cosAngle = std::max(std::pow(SpotCutoff, 1.0f / L.SpotPower), 0.0f);
+            mLights.CosAngle.push_back(cosAngle);
+            mLights.SinAngle.push_back(std::sqrt(1.0f - cosAngle * cosAngle));
+        }
+        else
+        {
+            mLights.DirX.push_back(0.0f);
+            mLights.DirY.push_back(0.0f);
+            mLights.DirZ.push_back(0.0f);
+            mLights.CosAngle.push_back(-1.0f);
+            mLights.SinAngle.push_back(0.0f);
+        }
+    }
+    mLights.Pad();
+
+    pool.ParallelFor(mDesc.Slices, 1, [this](size_t begin, size_t end)
+    {
+        for(size_t slice = begin; slice < end; ++slice)
+            BinSlice((uint32)slice);
+    });
+
+    // Concatenate the slices' lists and turn the offsets global.
+    size_t total = 0;
+    for(const SliceScratch& scratch : mScratch)
+        total += scratch.Indices.size();
+
+    mLightIndices.resize(total);
+    mMaxLightsPerCluster = 0;
+
+    const uint32 clustersPerSlice = mDesc.TilesX * mDesc.TilesY;
+    uint32 offset = 0;
+    for(uint32 slice = 0; slice < mDesc.Slices; ++slice)
+    {
+        const std::vector<uint32>& indices = mScratch[slice].Indices;
+        std::copy(indices.begin(), indices.end(), mLightIndices.begin() + offset);
+
+        for(uint32 c = slice * clustersPerSlice; c < (slice + 1) * clustersPerSlice; ++c)
+        {
+            mRanges[c].Offset += offset;
+            mMaxLightsPerCluster = std::max(mMaxLightsPerCluster, mRanges[c].Count);
+        }
+
+        offset += (uint32)indices.size();
+    }
+}
+
+void LightClusterBuilder::BinSlice(uint32 slice)
+{
+    SliceScratch& scratch = mScratch[slice];
+    scratch.Indices.clear();
+
+    scratch.SliceLights.Clear();
+    Cull(mLights, mSliceBoxes[slice], false, &scratch.SliceLights, nullptr);
+    scratch.SliceLights.Pad();
+
+    for(uint32 y = 0; y < mDesc.TilesY; ++y)
+    {
+        scratch.RowLights.Clear();
+        if(scratch.SliceLights.Size() > 0)
+        {
+            Cull(scratch.SliceLights, mRowBoxes[slice * mDesc.TilesY + y], false, &scratch.RowLights, nullptr);
+            scratch.RowLights.Pad();
+        }
+
+        for(uint32 x = 0; x < mDesc.TilesX; ++x)
+        {
+            Range& range = mRanges[ClusterIndex(x, y, slice)];
+            range.Offset = (uint32)scratch.Indices.size();
+            Cull(scratch.RowLights, mClusterBoxes[ClusterIndex(x, y, slice)], true, nullptr, &scratch.Indices);
+            range.Count = (uint32)scratch.Indices.size() - range.Offset;
+        }
+    }
+}
+
+void LightClusterBuilder::Cull(const LightSoA& src, const Box& box, bool coneTest, LightSoA* dst,
+    std::vector<uint32>* indices)
+{
+    const XMVECTOR zero = XMVectorZero();
+    const XMVECTOR minX = XMVectorReplicate(box.Min.x);
+    const XMVECTOR minY = XMVectorReplicate(box.Min.y);
+    const XMVECTOR minZ = XMVectorReplicate(box.Min.z);
+    const XMVECTOR maxX = XMVectorReplicate(box.Max.x);
+    const XMVECTOR maxY = XMVectorReplicate(box.Max.y);
+    const XMVECTOR maxZ = XMVectorReplicate(box.Max.z);
+
+    // Bounding sphere of the box for the cone test.
+    const XMFLOAT3 half(0.5f * (box.Max.x - box.Min.x), 0.5f * (box.Max.y - box.Min.y), 0.5f * (box.Max.z - box.Min.z));
+    const XMVECTOR centerX = XMVectorReplicate(box.Min.x + half.x);
+    const XMVECTOR centerY = XMVectorReplicate(box.Min.y + half.y);
+    const XMVECTOR centerZ = XMVectorReplicate(box.Min.z + half.z);
+    const XMVECTOR boxRadius = XMVectorReplicate(std::sqrt(half.x * half.x + half.y * half.y + half.z * half.z));
+
+    for(size_t i = 0; i < src.Size(); i += 4)
+    {
+        XMVECTOR x = LoadQuad(src.X, i);
+        XMVECTOR y = LoadQuad(src.Y, i);
+        XMVECTOR z = LoadQuad(src.Z, i);
+        XMVECTOR r = LoadQuad(src.Radius, i);
+
+        // Distance from the light to the box, per axis.
+        XMVECTOR dx = XMVectorMax(XMVectorMax(XMVectorSubtract(minX, x), XMVectorSubtract(x, maxX)), zero);
+        XMVECTOR dy = XMVectorMax(XMVectorMax(XMVectorSubtract(minY, y), XMVectorSubtract(y, maxY)), zero);
+        XMVECTOR dz = XMVectorMax(XMVectorMax(XMVectorSubtract(minZ, z), XMVectorSubtract(z, maxZ)), zero);
+        XMVECTOR distSq = XMVectorMultiplyAdd(dx, dx, XMVectorMultiplyAdd(dy, dy, XMVectorMultiply(dz, dz)));
+        XMVECTOR hit = XMVectorLessOrEqual(distSq, XMVectorMultiply(r, r));
+
+        if(coneTest)
+        {
+            // Cone against the box's bounding sphere: rejected if the sphere is outside
+            // the cone's angle, beyond its range or behind its apex.
+            XMVECTOR vx = XMVectorSubtract(centerX, x);
+            XMVECTOR vy = XMVectorSubtract(centerY, y);
+            XMVECTOR vz = XMVectorSubtract(centerZ, z);
+            XMVECTOR lenSq = XMVectorMultiplyAdd(vx, vx, XMVectorMultiplyAdd(vy, vy, XMVectorMultiply(vz, vz)));
+            XMVECTOR axial = XMVectorMultiplyAdd(vx, LoadQuad(src.DirX, i),
+                XMVectorMultiplyAdd(vy, LoadQuad(src.DirY, i), XMVectorMultiply(vz, LoadQuad(src.DirZ, i))));
+            XMVECTOR radial = XMVectorSqrt(XMVectorMax(XMVectorNegativeMultiplySubtract(axial, axial, lenSq), zero));
+            XMVECTOR closest = XMVectorNegativeMultiplySubtract(axial, LoadQuad(src.SinAngle, i),
+                XMVectorMultiply(LoadQuad(src.CosAngle, i), radial));
+
+            XMVECTOR culled = XMVectorGreater(closest, boxRadius);
+            culled = XMVectorOrInt(culled, XMVectorGreater(axial, XMVectorAdd(boxRadius, r)));
+            culled = XMVectorOrInt(culled, XMVectorLess(axial, XMVectorNegate(boxRadius)));
+            hit = XMVectorAndCInt(hit, culled);
+        }
+
+        XMUINT4 mask;
+        XMStoreUInt4(&mask, hit);
+        const uint32 lanes[4] = { mask.x, mask.y, mask.z, mask.w };
+        for(size_t lane = 0; lane < 4; ++lane)
+        {
+            if(lanes[lane] == 0)
+                continue;
+
+            if(dst != nullptr)
+                dst->Append(src, i + lane);
+            else
+                indices->push_back(src.Index[i + lane]);
+        }
+    }
+}
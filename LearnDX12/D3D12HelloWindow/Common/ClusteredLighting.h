@@ -0,0 +1,133 @@
+//***************************************************************************************
+// ClusteredLighting.h
+//
+// Bins point and spot lights into a froxel grid: the view frustum split into
+// TilesX x TilesY screen tiles and Slices depth slices, exponentially spaced between the
+// near and far planes.  Build() produces one (offset, count) range per cluster into a
+// compact list of light indices, so a pixel shader only loops over the lights whose
+// range reaches its cluster instead of over every light in the pass.
+//
+// The slices are binned in parallel.  Per slice the lights are narrowed in three steps,
+// each testing four lights at a time: the slice's depth range, the bounds of each tile
+// row, then sphere-vs-box against each cluster plus, for spot lights, a cone-vs-sphere
+// test against the cluster's bounding sphere.  All tests are conservative.
+//
+// The ranges and indices are laid out to be copied into structured buffers as-is
+// (uint2 and uint).
+//***************************************************************************************
+
+#pragma once
+
+#include "LightingModel.h"
+#include "ThreadPool.h"
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+struct ClusterGridDesc
+{
+    std::uint32_t TilesX = 16;
+    std::uint32_t TilesY = 9;
+    std::uint32_t Slices = 24;
+
+    // Matches the camera's projection.
+    float FovY = 0.25f * DirectX::XM_PI;
+    float Aspect = 16.0f / 9.0f;
+    float NearZ = 1.0f;
+    float FarZ = 1000.0f;
+};
+
+class LightClusterBuilder
+{
+public:
+    using uint32 = std::uint32_t;
+
+    // One per cluster, indexing LightIndices().
+    struct Range
+    {
+        uint32 Offset = 0;
+        uint32 Count = 0;
+    };
+
+    // A spot light's cone ends where its spot factor drops below this.
+    static const float SpotCutoff;
+
+    explicit LightClusterBuilder(const ClusterGridDesc& desc = ClusterGridDesc());
+
+    // Call when the projection changes (e.g. on resize).
+    void SetGrid(const ClusterGridDesc& desc);
+    const ClusterGridDesc& Grid()const { return mDesc; }
+
+    // Slices per unit of log(z / NearZ); a shader finds a pixel's slice with it.
+    float LogDepthScale()const { return mLogDepthScale; }
+
+    uint32 ClusterCount()const { return mDesc.TilesX * mDesc.TilesY * mDesc.Slices; }
+    uint32 ClusterIndex(uint32 x, uint32 y, uint32 slice)const { return (slice * mDesc.TilesY + y) * mDesc.TilesX + x; }
+
+    // Cluster holding a view space point, or UINT32_MAX outside the frustum.
+    uint32 ClusterOf(const DirectX::XMFLOAT3& viewPos)const;
+
+    ///<summary>
+    /// Bins the lights for one frame.  The first numPointLights of lights are point
+    /// lights and the next numSpotLights spot lights, both in world space; the indices
+    /// produced refer to positions in this array.  Both reach FalloffEnd, as in
+    /// LightingUtil.hlsl.
+    ///</summary>
+    void Build(const DirectX::XMFLOAT4X4& view, const ShadingLight* lights, uint32 numPointLights,
+        uint32 numSpotLights, ThreadPool& pool = ThreadPool::Default());
+
+    const std::vector<Range>& Ranges()const { return mRanges; }
+    const std::vector<uint32>& LightIndices()const { return mLightIndices; }
+    uint32 MaxLightsPerCluster()const { return mMaxLightsPerCluster; }
+
+private:
+    struct Box
+    {
+        DirectX::XMFLOAT3 Min;
+        DirectX::XMFLOAT3 Max;
+    };
+
+    // View space lights, one array per component, padded to a multiple of four.
+    struct LightSoA
+    {
+        std::vector<float> X, Y, Z, Radius;
+        std::vector<float> DirX, DirY, DirZ, CosAngle, SinAngle;
+        std::vector<uint32> Index;
+
+        void Clear();
+        size_t Size()const { return Index.size(); }
+        void Append(const LightSoA& src, size_t i);
+        void Pad();
+    };
+
+    struct SliceScratch
+    {
+        LightSoA SliceLights;
+        LightSoA RowLights;
+        std::vector<uint32> Indices;
+    };
+
+    void BinSlice(uint32 slice);
+
+    // Appends the lights of src overlapping box (and passing the cone test when
+    // coneTest is set) to dst, or their indices to indices when dst is null.
+    static void Cull(const LightSoA& src, const Box& box, bool coneTest, LightSoA* dst, std::vector<uint32>* indices);
+
+private:
+    ClusterGridDesc mDesc;
+    float mTanHalfX = 0.0f;
+    float mTanHalfY = 0.0f;
+    float mLogDepthScale = 0.0f;
+
+    std::vector<float> mSliceDepths;    // Slices + 1 boundaries
+    std::vector<Box> mSliceBoxes;
+    std::vector<Box> mRowBoxes;         // per slice and tile row
+    std::vector<Box> mClusterBoxes;
+
+    LightSoA mLights;
+    std::vector<SliceScratch> mScratch;
+
+    std::vector<Range> mRanges;
+    std::vector<uint32> mLightIndices;
+    uint32 mMaxLightsPerCluster = 0;
+};
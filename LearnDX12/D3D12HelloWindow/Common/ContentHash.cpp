@@ -0,0 +1,114 @@
+//***************************************************************************************
+// ContentHash.cpp
+//***************************************************************************************
+
+#include "ContentHash.h"
+#include <cstdint>
+#include <cstdio>
+
+namespace
+{
+    std::uint64_t RotateLeft(std::uint64_t x, int r)
+    {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    std::uint64_t Mix(std::uint64_t k)
+    {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdull;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ull;
+        k ^= k >> 33;
+        return k;
+    }
+
+    std::uint64_t ReadLittleEndian64(const std::uint8_t* p)
+    {
+        std::uint64_t v = 0;
+        for(int i = 7; i >= 0; --i)
+            v = (v << 8) | p[i];
+        return v;
+    }
+
+    // MurmurHash3 x64 128, written against bytes rather than loaded words so the
+    // digest is the same on every platform.
+    std::string Hash128(const void* data, size_t length)
+    {
+        const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+        const size_t blockCount = length / 16;
+
+        const std::uint64_t c1 = 0x87c37b91114253d5ull;
+        const std::uint64_t c2 = 0x4cf5ad432745937full;
+        std::uint64_t h1 = 0;
+        std::uint64_t h2 = 0;
+
+        for(size_t i = 0; i < blockCount; ++i)
+        {
+            std::uint64_t k1 = ReadLittleEndian64(bytes + i*16);
+            std::uint64_t k2 = ReadLittleEndian64(bytes + i*16 + 8);
+
+            k1 *= c1; k1 = RotateLeft(k1, 31); k1 *= c2; h1 ^= k1;
+            h1 = RotateLeft(h1, 27); h1 += h2; h1 = h1*5 + 0x52dce729;
+
+            k2 *= c2; k2 = RotateLeft(k2, 33); k2 *= c1; h2 ^= k2;
+            h2 = RotateLeft(h2, 31); h2 += h1; h2 = h2*5 + 0x38495ab5;
+        }
+
+        const std::uint8_t* tail = bytes + blockCount*16;
+        const size_t tailLength = length & 15;
+        std::uint64_t k1 = 0;
+        std::uint64_t k2 = 0;
+        for(size_t i = tailLength; i > 8; --i)
+            k2 = (k2 << 8) | tail[i - 1];
+        for(size_t i = tailLength < 8 ? tailLength : 8; i > 0; --i)
+            k1 = (k1 << 8) | tail[i - 1];
+
+        if(tailLength > 8)
+        {
+            k2 *= c2; k2 = RotateLeft(k2, 33); k2 *= c1; h2 ^= k2;
+        }
+        if(tailLength > 0)
+        {
+            k1 *= c1; k1 = RotateLeft(k1, 31); k1 *= c2; h1 ^= k1;
+        }
+
+        h1 ^= length;
+        h2 ^= length;
+        h1 += h2;
+        h2 += h1;
+        h1 = Mix(h1);
+        h2 = Mix(h2);
+        h1 += h2;
+        h2 += h1;
+
+        char hex[33];
+        std::snprintf(hex, sizeof(hex), "%016llx%016llx", (unsigned long long)h1, (unsigned long long)h2);
+        return hex;
+    }
+}
+
+ContentHasher& ContentHasher::Add(const std::string& field)
+{
+    char length[24];
+    std::snprintf(length, sizeof(length), "%zu:", field.size());
+    mBuffer += length;
+    mBuffer += field;
+    return *this;
+}
+
+ContentHasher& ContentHasher::AddBytes(const void* data, size_t size)
+{
+    mBuffer.append(static_cast<const char*>(data), size);
+    return *this;
+}
+
+std::string ContentHasher::Digest()const
+{
+    return Hash128(mBuffer.data(), mBuffer.size());
+}
+
+std::string ContentHasher::Hash(const void* data, size_t size)
+{
+    return Hash128(data, size);
+}
@@ -0,0 +1,36 @@
+//***************************************************************************************
+// ContentHash.h
+//
+// 128-bit content hashes for cache keys.  Values are appended to a ContentHasher and
+// Digest() returns a MurmurHash3 x64 128 of everything appended, as 32 hex digits that
+// are the same on every platform and safe to use as a file name.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+class ContentHasher
+{
+public:
+    // Length-prefixed, so no two different sequences of strings hash alike.
+    ContentHasher& Add(const std::string& field);
+
+    // Raw bytes, for fixed-size values.
+    ContentHasher& AddBytes(const void* data, size_t size);
+
+    template<typename T>
+    ContentHasher& AddPod(const T& value)
+    {
+        return AddBytes(&value, sizeof(T));
+    }
+
+    std::string Digest()const;
+
+    // Digest of a single buffer.
+    static std::string Hash(const void* data, size_t size);
+
+private:
+    std::string mBuffer;
+};
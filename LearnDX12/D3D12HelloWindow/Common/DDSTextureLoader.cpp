@@ -24,6 +24,7 @@
 #include <wrl.h>
 
 #include "DDSTextureLoader.h" 
+#include "UploadRing.h"
 
 using namespace Microsoft::WRL;
 
@@ -124,12 +125,6 @@ struct DDS_HEADER_DXT10
 namespace
 {
 
-struct handle_closer { void operator()(HANDLE h) { if (h) CloseHandle(h); } };
-
-typedef public std::unique_ptr<void, handle_closer> ScopedHandle;
-
-inline HANDLE safe_handle( HANDLE h ) { return (h == INVALID_HANDLE_VALUE) ? 0 : h; }
-
 template<UINT TNameLength>
 inline void SetDebugObjectName(_In_ ID3D11DeviceChild* resource, _In_ const char (&name)[TNameLength])
 {
@@ -144,98 +139,32 @@ inline void SetDebugObjectName(_In_ ID3D11DeviceChild* resource, _In_ const char
 };
 
 //--------------------------------------------------------------------------------------
-static HRESULT LoadTextureDataFromFile( _In_z_ const wchar_t* fileName,
-                                        std::unique_ptr<uint8_t[]>& ddsData,
-                                        DDS_HEADER** header,
-                                        uint8_t** bitData,
-                                        size_t* bitSize
-                                      )
+static HRESULT GetTextureData( _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+                               uint64_t ddsDataSize,
+                               const DDS_HEADER** header,
+                               const uint8_t** bitData,
+                               size_t* bitSize
+                             )
 {
     if (!header || !bitData || !bitSize)
     {
         return E_POINTER;
     }
 
-    // open the file
-#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
-    ScopedHandle hFile( safe_handle( CreateFile2( fileName,
-                                                  GENERIC_READ,
-                                                  FILE_SHARE_READ,
-                                                  OPEN_EXISTING,
-                                                  nullptr ) ) );
-#else
-    ScopedHandle hFile( safe_handle( CreateFileW( fileName,
-                                                  GENERIC_READ,
-                                                  FILE_SHARE_READ,
-                                                  nullptr,
-                                                  OPEN_EXISTING,
-                                                  FILE_ATTRIBUTE_NORMAL,
-                                                  nullptr ) ) );
-#endif
-
-    if ( !hFile )
-    {
-        return HRESULT_FROM_WIN32( GetLastError() );
-    }
-
-    // Get the file size
-    LARGE_INTEGER FileSize = { 0 };
-
-#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
-    FILE_STANDARD_INFO fileInfo;
-    if ( !GetFileInformationByHandleEx( hFile.get(), FileStandardInfo, &fileInfo, sizeof(fileInfo) ) )
-    {
-        return HRESULT_FROM_WIN32( GetLastError() );
-    }
-    FileSize = fileInfo.EndOfFile;
-#else
-    GetFileSizeEx( hFile.get(), &FileSize );
-#endif
-
-    // File is too big for 32-bit allocation, so reject read
-    if (FileSize.HighPart > 0)
-    {
-        return E_FAIL;
-    }
-
     // Need at least enough data to fill the header and magic number to be a valid DDS
-    if (FileSize.LowPart < ( sizeof(DDS_HEADER) + sizeof(uint32_t) ) )
-    {
-        return E_FAIL;
-    }
-
-    // create enough space for the file data
-    ddsData.reset( new (std::nothrow) uint8_t[ FileSize.LowPart ] );
-    if (!ddsData)
-    {
-        return E_OUTOFMEMORY;
-    }
-
-    // read the data in
-    DWORD BytesRead = 0;
-    if (!ReadFile( hFile.get(),
-                   ddsData.get(),
-                   FileSize.LowPart,
-                   &BytesRead,
-                   nullptr
-                 ))
-    {
-        return HRESULT_FROM_WIN32( GetLastError() );
-    }
-
-    if (BytesRead < FileSize.LowPart)
+    if (!ddsData || ddsDataSize < ( sizeof(DDS_HEADER) + sizeof(uint32_t) ) )
     {
         return E_FAIL;
     }
 
     // DDS files always start with the same magic number ("DDS ")
-    uint32_t dwMagicNumber = *( const uint32_t* )( ddsData.get() );
+    uint32_t dwMagicNumber = *( const uint32_t* )( ddsData );
     if (dwMagicNumber != DDS_MAGIC)
     {
         return E_FAIL;
     }
 
-    auto hdr = reinterpret_cast<DDS_HEADER*>( ddsData.get() + sizeof( uint32_t ) );
+    auto hdr = reinterpret_cast<const DDS_HEADER*>( ddsData + sizeof( uint32_t ) );
 
     // Verify header to validate DDS file
     if (hdr->size != sizeof(DDS_HEADER) ||
@@ -250,7 +179,7 @@ static HRESULT LoadTextureDataFromFile( _In_z_ const wchar_t* fileName,
         (MAKEFOURCC( 'D', 'X', '1', '0' ) == hdr->ddspf.fourCC))
     {
         // Must be long enough for both headers and magic value
-        if (FileSize.LowPart < ( sizeof(DDS_HEADER) + sizeof(uint32_t) + sizeof(DDS_HEADER_DXT10) ) )
+        if (ddsDataSize < ( sizeof(DDS_HEADER) + sizeof(uint32_t) + sizeof(DDS_HEADER_DXT10) ) )
         {
             return E_FAIL;
         }
@@ -262,12 +191,32 @@ static HRESULT LoadTextureDataFromFile( _In_z_ const wchar_t* fileName,
     *header = hdr;
     ptrdiff_t offset = sizeof( uint32_t ) + sizeof( DDS_HEADER )
                        + (bDXT10Header ? sizeof( DDS_HEADER_DXT10 ) : 0);
-    *bitData = ddsData.get() + offset;
-    *bitSize = FileSize.LowPart - offset;
+    *bitData = ddsData + offset;
+    *bitSize = static_cast<size_t>( ddsDataSize - offset );
 
     return S_OK;
 }
 
+//--------------------------------------------------------------------------------------
+static HRESULT LoadTextureDataFromFile( _In_z_ const wchar_t* fileName,
+                                        MappedFile& ddsFile,
+                                        const DDS_HEADER** header,
+                                        const uint8_t** bitData,
+                                        size_t* bitSize
+                                      )
+{
+    // Map the file rather than reading it: the header is parsed in place and the
+    // texels are handed to the GPU copy straight from the mapping, so no heap copy of
+    // the file is ever made.  The mapping has to outlive every use of the pointers.
+    if (!ddsFile.Open( std::wstring( fileName ) ))
+    {
+        DWORD error = GetLastError();
+        return error ? HRESULT_FROM_WIN32( error ) : E_FAIL;
+    }
+
+    return GetTextureData( ddsFile.Data(), ddsFile.Size(), header, bitData, bitSize );
+}
+
 
 //--------------------------------------------------------------------------------------
 // Return the BPP for a particular format
@@ -1230,16 +1179,8 @@ static HRESULT CreateD3DResources( _In_ ID3D11Device* d3dDevice,
 static HRESULT CreateD3DResources12(
 	ID3D12Device* device,
 	ID3D12GraphicsCommandList* cmdList,
-	_In_ uint32_t resDim,
-	_In_ size_t width,
-	_In_ size_t height,
-	_In_ size_t depth,
-	_In_ size_t mipCount,
-	_In_ size_t arraySize,
-	_In_ DXGI_FORMAT format,
-	_In_ bool forceSRGB,
-	_In_ bool isCubeMap,
-	_In_reads_opt_(mipCount*arraySize) D3D12_SUBRESOURCE_DATA* initData,
+	_In_ const D3D12_RESOURCE_DESC& texDesc,
+	_In_reads_(texDesc.MipLevels*texDesc.DepthOrArraySize) D3D12_SUBRESOURCE_DATA* initData,
 	ComPtr<ID3D12Resource>& texture,
 	ComPtr<ID3D12Resource>& textureUploadHeap
 	)
@@ -1247,73 +1188,49 @@ static HRESULT CreateD3DResources12(
 	if (device == nullptr)
 		return E_POINTER;
 
-	if (forceSRGB)
-		format = MakeSRGB(format);
+	HRESULT hr = device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&texDesc,
+		D3D12_RESOURCE_STATE_COMMON,
+		nullptr,
+		IID_PPV_ARGS(&texture)
+		);
 
-	HRESULT hr = E_FAIL;
-	switch (resDim)
+	if (FAILED(hr))
 	{
-	case D3D12_RESOURCE_DIMENSION_TEXTURE2D:
+		texture = nullptr;
+		return hr;
+	}
+
+	const UINT numSubresources = (texDesc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D)
+		? texDesc.MipLevels : texDesc.DepthOrArraySize * texDesc.MipLevels;
+	const UINT64 uploadBufferSize = GetRequiredIntermediateSize(texture.Get(), 0, numSubresources);
+
+	hr = device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&textureUploadHeap));
+	if (FAILED(hr))
 	{
-		D3D12_RESOURCE_DESC texDesc;
-		ZeroMemory(&texDesc, sizeof(D3D12_RESOURCE_DESC));
-		texDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-		texDesc.Alignment = 0;
-		texDesc.Width = width;
-		texDesc.Height = (uint32_t)height;
-		texDesc.DepthOrArraySize = (depth > 1) ? (uint16_t)depth : (uint16_t)arraySize;
-		texDesc.MipLevels = (uint16_t)mipCount;
-		texDesc.Format = format;
-		texDesc.SampleDesc.Count = 1;
-		texDesc.SampleDesc.Quality = 0;
-		texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
-		texDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+		texture = nullptr;
+		return hr;
+	}
 
-		hr = device->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-			D3D12_HEAP_FLAG_NONE,
-			&texDesc,
-			D3D12_RESOURCE_STATE_COMMON,
-			nullptr,
-			IID_PPV_ARGS(&texture)
-			);
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texture.Get(),
+		D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST));
 
-		if (FAILED(hr))
-		{
-			texture = nullptr;
-			return hr;
-		}
-		else
-		{
-			const UINT num2DSubresources = texDesc.DepthOrArraySize * texDesc.MipLevels;
-			const UINT64 uploadBufferSize = GetRequiredIntermediateSize(texture.Get(), 0, num2DSubresources);
-
-			hr = device->CreateCommittedResource(
-				&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-				D3D12_HEAP_FLAG_NONE,
-				&CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize),
-				D3D12_RESOURCE_STATE_GENERIC_READ,
-				nullptr,
-				IID_PPV_ARGS(&textureUploadHeap));
-			if (FAILED(hr))
-			{
-				texture = nullptr;
-				return hr;
-			}
-			else
-			{
-				cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texture.Get(),
-					D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST));
+	// Use Heap-allocating UpdateSubresources implementation for variable number of subresources (which is the case for textures).
+	UpdateSubresources(cmdList, texture.Get(), textureUploadHeap.Get(), 0, 0, numSubresources, initData);
 
-				// Use Heap-allocating UpdateSubresources implementation for variable number of subresources (which is the case for textures).
-				UpdateSubresources(cmdList, texture.Get(), textureUploadHeap.Get(), 0, 0, num2DSubresources, initData);
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texture.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
 
-				cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texture.Get(),
-					D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
-			}
-		}
-	} break;
-	}
+	d3dUtil::TrackMemory(device, texture.Get(), MemoryTracker::Textures);
+	d3dUtil::TrackMemory(textureUploadHeap.Get(), MemoryTracker::UploadBuffers, uploadBufferSize);
 
 	return hr;
 }
@@ -1669,16 +1586,18 @@ static HRESULT CreateTextureFromDDS( _In_ ID3D11Device* d3dDevice,
     return hr;
 }
 
-static HRESULT CreateTextureFromDDS12(
-	_In_ ID3D12Device* device,
-	_In_opt_ ID3D12GraphicsCommandList* cmdList,
+//--------------------------------------------------------------------------------------
+// Validates the header and works out the texture to create and where each of its
+// subresources lies in bitData, without copying a single texel.
+//--------------------------------------------------------------------------------------
+static HRESULT GetTextureLayout12(
 	_In_ const DDS_HEADER* header,
 	_In_reads_bytes_(bitSize) const uint8_t* bitData,
 	_In_ size_t bitSize,
 	_In_ size_t maxsize,
 	_In_ bool forceSRGB,
-	ComPtr<ID3D12Resource>& texture,
-	ComPtr<ID3D12Resource>& textureUploadHeap)
+	_Out_ D3D12_RESOURCE_DESC& texDesc,
+	_Out_ std::vector<D3D12_SUBRESOURCE_DATA>& initData)
 {
 	HRESULT hr = S_OK;
 
@@ -1835,15 +1754,8 @@ static HRESULT CreateTextureFromDDS12(
 		return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
 	}
 
-	// Create the texture
-	std::unique_ptr<D3D12_SUBRESOURCE_DATA[]> initData(
-		new (std::nothrow) D3D12_SUBRESOURCE_DATA[mipCount * arraySize]
-		);
-
-	if (!initData)
-	{
-		return E_OUTOFMEMORY;
-	}
+	// Point a subresource at each surface in the file
+	initData.resize(mipCount * arraySize);
 
 	size_t skipMip = 0;
 	size_t twidth = 0;
@@ -1852,27 +1764,56 @@ static HRESULT CreateTextureFromDDS12(
 
 	hr = FillInitData12(
 		width, height, depth, mipCount, arraySize, format, maxsize, bitSize, bitData,
-		twidth, theight, tdepth, skipMip, initData.get()
+		twidth, theight, tdepth, skipMip, initData.data()
 		);
-
-	if (SUCCEEDED(hr))
+	if (FAILED(hr))
 	{
-		hr = CreateD3DResources12(
-			device, cmdList,
-			resDim, twidth, theight, tdepth,
-			mipCount - skipMip,
-			arraySize,
-			format,
-			false, // forceSRGB
-			isCubeMap,
-			initData.get(),
-			texture, 
-			textureUploadHeap);
+		return hr;
 	}
 
+	initData.resize((mipCount - skipMip) * arraySize);
+
+	if (forceSRGB)
+		format = MakeSRGB(format);
+
+	ZeroMemory(&texDesc, sizeof(D3D12_RESOURCE_DESC));
+	texDesc.Dimension = static_cast<D3D12_RESOURCE_DIMENSION>(resDim);
+	texDesc.Alignment = 0;
+	texDesc.Width = twidth;
+	texDesc.Height = (uint32_t)theight;
+	texDesc.DepthOrArraySize = (resDim == D3D12_RESOURCE_DIMENSION_TEXTURE3D) ? (uint16_t)tdepth : (uint16_t)arraySize;
+	texDesc.MipLevels = (uint16_t)(mipCount - skipMip);
+	texDesc.Format = format;
+	texDesc.SampleDesc.Count = 1;
+	texDesc.SampleDesc.Quality = 0;
+	texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+	texDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
 	return hr;
 }
 
+static HRESULT CreateTextureFromDDS12(
+	_In_ ID3D12Device* device,
+	_In_opt_ ID3D12GraphicsCommandList* cmdList,
+	_In_ const DDS_HEADER* header,
+	_In_reads_bytes_(bitSize) const uint8_t* bitData,
+	_In_ size_t bitSize,
+	_In_ size_t maxsize,
+	_In_ bool forceSRGB,
+	ComPtr<ID3D12Resource>& texture,
+	ComPtr<ID3D12Resource>& textureUploadHeap)
+{
+	D3D12_RESOURCE_DESC texDesc;
+	std::vector<D3D12_SUBRESOURCE_DATA> initData;
+	HRESULT hr = GetTextureLayout12(header, bitData, bitSize, maxsize, forceSRGB, texDesc, initData);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	return CreateD3DResources12(device, cmdList, texDesc, initData.data(), texture, textureUploadHeap);
+}
+
 //--------------------------------------------------------------------------------------
 static DDS_ALPHA_MODE GetAlphaMode( _In_ const DDS_HEADER* header )
 {
@@ -2160,12 +2101,13 @@ HRESULT DirectX::CreateDDSTextureFromFile12(_In_ ID3D12Device* device,
 		return E_INVALIDARG;
 	}
 
-	DDS_HEADER* header = nullptr;
-	uint8_t* bitData = nullptr;
+	const DDS_HEADER* header = nullptr;
+	const uint8_t* bitData = nullptr;
 	size_t bitSize = 0;
 
-	std::unique_ptr<uint8_t[]> ddsData;
-	HRESULT hr = LoadTextureDataFromFile(szFileName, ddsData, &header, &bitData, &bitSize);
+	// Stays mapped until UpdateSubresources has copied the texels to the upload heap.
+	MappedFile ddsFile;
+	HRESULT hr = LoadTextureDataFromFile(szFileName, ddsFile, &header, &bitData, &bitSize);
 	if (FAILED(hr))
 	{
 		return hr;
@@ -2292,13 +2234,13 @@ HRESULT DirectX::CreateDDSTextureFromFileEx( ID3D11Device* d3dDevice,
         return E_INVALIDARG;
     }
 
-    DDS_HEADER* header = nullptr;
-    uint8_t* bitData = nullptr;
+    const DDS_HEADER* header = nullptr;
+    const uint8_t* bitData = nullptr;
     size_t bitSize = 0;
 
-    std::unique_ptr<uint8_t[]> ddsData;
+    MappedFile ddsFile;
     HRESULT hr = LoadTextureDataFromFile( fileName,
-                                          ddsData,
+                                          ddsFile,
                                           &header,
                                           &bitData,
                                           &bitSize
@@ -2365,3 +2307,322 @@ HRESULT DirectX::CreateDDSTextureFromFileEx( ID3D11Device* d3dDevice,
 
     return hr;
 }
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::DDSTextureStream::Open(ID3D12Device* device,
+	const wchar_t* szFileName,
+	size_t maxsize)
+{
+	Close();
+
+	if (!device || !szFileName)
+	{
+		return E_INVALIDARG;
+	}
+
+	std::unique_ptr<MappedFile> file(new MappedFile());
+	if (!file->Open(std::wstring(szFileName)))
+	{
+		DWORD error = GetLastError();
+		return error ? HRESULT_FROM_WIN32(error) : E_FAIL;
+	}
+
+	return Open(device, std::move(file), maxsize);
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::DDSTextureStream::Open(ID3D12Device* device,
+	std::unique_ptr<MappedFile> file,
+	size_t maxsize)
+{
+	return Create(device, std::move(file), maxsize, false);
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::DDSTextureStream::OpenReserved(ID3D12Device* device,
+	std::unique_ptr<MappedFile> file,
+	size_t maxsize)
+{
+	return Create(device, std::move(file), maxsize, true);
+}
+
+HRESULT DirectX::DDSTextureStream::Create(ID3D12Device* device,
+	std::unique_ptr<MappedFile> file,
+	size_t maxsize,
+	bool reserved)
+{
+	Close();
+
+	if (!device || !file || !file->IsOpen())
+	{
+		return E_INVALIDARG;
+	}
+
+	mFile = std::move(file);
+
+	const DDS_HEADER* header = nullptr;
+	const uint8_t* bitData = nullptr;
+	size_t bitSize = 0;
+
+	HRESULT hr = GetTextureData(mFile->Data(), mFile->Size(), &header, &bitData, &bitSize);
+	if (SUCCEEDED(hr))
+	{
+		hr = GetTextureLayout12(header, bitData, bitSize, maxsize, false, mDesc, mSubresources);
+	}
+
+	// Tiles are mapped per mip, so only textures with one tile run per mip can be
+	// reserved: no arrays, cubes or volumes.
+	if (SUCCEEDED(hr) && reserved &&
+		(mDesc.Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D || mDesc.DepthOrArraySize != 1))
+	{
+		hr = HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+	}
+
+	if (SUCCEEDED(hr) && reserved)
+	{
+		mDesc.Layout = D3D12_TEXTURE_LAYOUT_64KB_UNDEFINED_SWIZZLE;
+		hr = device->CreateReservedResource(
+			&mDesc,
+			D3D12_RESOURCE_STATE_COPY_DEST,
+			nullptr,
+			IID_PPV_ARGS(&mTexture));
+	}
+	else if (SUCCEEDED(hr))
+	{
+		// Created ready for the first copies; the other states only come once they have
+		// been recorded.
+		hr = device->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+			D3D12_HEAP_FLAG_NONE,
+			&mDesc,
+			D3D12_RESOURCE_STATE_COPY_DEST,
+			nullptr,
+			IID_PPV_ARGS(&mTexture));
+	}
+
+	if (FAILED(hr))
+	{
+		Close();
+		return hr;
+	}
+
+	// Reserved textures take no memory of their own; their tile heaps are counted.
+	if (!reserved)
+		d3dUtil::TrackMemory(device, mTexture.Get(), MemoryTracker::Textures);
+
+	mDevice = device;
+	mState = D3D12_RESOURCE_STATE_COPY_DEST;
+	mAlphaMode = GetAlphaMode(header);
+	mReserved = reserved;
+	mPackedMip = mDesc.MipLevels;
+	mStreamLimit = 0;
+
+	if (reserved)
+	{
+		UINT numTiles = 0;
+		D3D12_TILE_SHAPE tileShape = {};
+		UINT numTilings = mDesc.MipLevels;
+		mTilings.resize(numTilings);
+		device->GetResourceTiling(mTexture.Get(), &numTiles, &mPackedMipInfo, &tileShape,
+			&numTilings, 0, mTilings.data());
+
+		if (mPackedMipInfo.NumPackedMips > 0)
+		{
+			mPackedMip = mPackedMipInfo.NumStandardMips;
+		}
+		mStreamLimit = mDesc.MipLevels;
+	}
+	return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::DDSTextureStream::Stream(ID3D12GraphicsCommandList* cmdList,
+	UploadRing& ring,
+	UINT64 maxBytes)
+{
+	if (!cmdList)
+	{
+		return E_INVALIDARG;
+	}
+	if (!mTexture)
+	{
+		return E_UNEXPECTED;
+	}
+
+	const UINT mipLevels = mDesc.MipLevels;
+	const UINT arraySize = static_cast<UINT>(mSubresources.size() / mipLevels);
+
+	// Copy queues cannot transition to shader states.  There the texture is promoted to
+	// COPY_DEST by the first copy, decays to COMMON once the copies have executed and
+	// is promoted to PIXEL_SHADER_RESOURCE by the first graphics queue read.
+	const bool copyQueue = cmdList->GetType() == D3D12_COMMAND_LIST_TYPE_COPY;
+
+	HRESULT hr = S_OK;
+	UINT64 staged = 0;
+	bool copied = false;
+	while (Streaming())
+	{
+		const UINT mip = mipLevels - 1 - static_cast<UINT>(mNextSubresource / arraySize);
+		const UINT slice = static_cast<UINT>(mNextSubresource % arraySize);
+		const UINT subresource = D3D12CalcSubresource(mip, slice, 0, mipLevels, arraySize);
+
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT layout;
+		UINT numRows = 0;
+		UINT64 rowSizeInBytes = 0;
+		UINT64 totalBytes = 0;
+		mDevice->GetCopyableFootprints(&mDesc, subresource, 1, 0, &layout, &numRows, &rowSizeInBytes, &totalBytes);
+
+		// Always take at least one subresource so a budget smaller than the largest mip
+		// still makes progress.
+		if (staged > 0 && staged + totalBytes > maxBytes)
+			break;
+
+		UploadRing::Allocation allocation = ring.Allocate(totalBytes, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+		if (!allocation.Valid())
+		{
+			if (totalBytes > ring.Allocator().Capacity())
+				hr = E_OUTOFMEMORY;
+			break;
+		}
+
+		if (!copyQueue && mState != D3D12_RESOURCE_STATE_COPY_DEST)
+		{
+			cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mTexture.Get(),
+				mState, D3D12_RESOURCE_STATE_COPY_DEST));
+			mState = D3D12_RESOURCE_STATE_COPY_DEST;
+		}
+
+		// Rows go from the mapping to the ring at the footprint's pitch; this is the
+		// only copy the CPU makes.
+		D3D12_MEMCPY_DEST dest = { allocation.CpuAddress, layout.Footprint.RowPitch,
+			SIZE_T(layout.Footprint.RowPitch) * numRows };
+		MemcpySubresource(&dest, &mSubresources[subresource], static_cast<SIZE_T>(rowSizeInBytes),
+			numRows, layout.Footprint.Depth);
+
+		layout.Offset = allocation.Offset;
+		CD3DX12_TEXTURE_COPY_LOCATION dst(mTexture.Get(), subresource);
+		CD3DX12_TEXTURE_COPY_LOCATION src(allocation.Resource, layout);
+		cmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+
+		staged += totalBytes;
+		copied = true;
+		mNextSubresource++;
+	}
+
+	if (copied && copyQueue)
+	{
+		mState = D3D12_RESOURCE_STATE_COMMON;
+	}
+	else if (copied)
+	{
+		cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mTexture.Get(),
+			D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+		mState = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+	}
+
+	// Every texel is in the ring now, so the file is no longer needed, unless an
+	// evicted mip may have to be read again.
+	if (Done() && !mReserved)
+	{
+		mFile.reset();
+	}
+
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+	return Streaming() ? S_FALSE : S_OK;
+}
+
+void DirectX::DDSTextureStream::Close()
+{
+	mFile.reset();
+	mSubresources.clear();
+	mNextSubresource = 0;
+	mStreamLimit = 0;
+	mTexture = nullptr;
+	mDevice = nullptr;
+	mDesc = {};
+	mAlphaMode = DDS_ALPHA_MODE_UNKNOWN;
+	mReserved = false;
+	mPackedMip = 0;
+	mPackedMipInfo = {};
+	mTilings.clear();
+}
+
+UINT DirectX::DDSTextureStream::TileCount(UINT mip)const
+{
+	if (!mReserved || mip >= MipLevels())
+	{
+		return 0;
+	}
+	if (mip >= mPackedMip)
+	{
+		return mPackedMipInfo.NumTilesForPackedMips;
+	}
+
+	const D3D12_SUBRESOURCE_TILING& tiling = mTilings[mip];
+	return tiling.WidthInTiles * tiling.HeightInTiles * tiling.DepthInTiles;
+}
+
+_Use_decl_annotations_
+void DirectX::DDSTextureStream::MapTiles(ID3D12CommandQueue* queue,
+	UINT mip,
+	ID3D12Heap* heap,
+	UINT heapStartTile)
+{
+	// The packed tail is addressed through its first mip.
+	D3D12_TILED_RESOURCE_COORDINATE coordinate = {};
+	coordinate.Subresource = std::min<UINT>(mip, mPackedMip);
+
+	D3D12_TILE_REGION_SIZE region = {};
+	region.NumTiles = TileCount(mip);
+	region.UseBox = FALSE;
+
+	const D3D12_TILE_RANGE_FLAGS flags = D3D12_TILE_RANGE_FLAG_NONE;
+	const UINT rangeTiles = region.NumTiles;
+	queue->UpdateTileMappings(mTexture.Get(), 1, &coordinate, &region, heap,
+		1, &flags, &heapStartTile, &rangeTiles, D3D12_TILE_MAPPING_FLAG_NONE);
+}
+
+_Use_decl_annotations_
+void DirectX::DDSTextureStream::UnmapTiles(ID3D12CommandQueue* queue, UINT mip)
+{
+	D3D12_TILED_RESOURCE_COORDINATE coordinate = {};
+	coordinate.Subresource = std::min<UINT>(mip, mPackedMip);
+
+	D3D12_TILE_REGION_SIZE region = {};
+	region.NumTiles = TileCount(mip);
+	region.UseBox = FALSE;
+
+	const D3D12_TILE_RANGE_FLAGS flags = D3D12_TILE_RANGE_FLAG_NULL;
+	const UINT rangeTiles = region.NumTiles;
+	queue->UpdateTileMappings(mTexture.Get(), 1, &coordinate, &region, nullptr,
+		1, &flags, nullptr, &rangeTiles, D3D12_TILE_MAPPING_FLAG_NONE);
+}
+
+_Use_decl_annotations_
+void DirectX::DDSTextureStream::Evict(UINT mip)
+{
+	// Only the finest resident mip can go, one slice per mip for reserved textures,
+	// and the packed tail never does.
+	if (!mReserved || mip != ResidentMip() || mip >= mPackedMip)
+	{
+		return;
+	}
+
+	mNextSubresource--;
+	mStreamLimit = std::max<UINT>(mStreamLimit, mip + 1);
+}
+
+UINT DirectX::DDSTextureStream::ResidentMip()const
+{
+	if (mSubresources.empty())
+	{
+		return MipLevels();
+	}
+
+	const size_t arraySize = mSubresources.size() / MipLevels();
+	return MipLevels() - static_cast<UINT>(mNextSubresource / arraySize);
+}
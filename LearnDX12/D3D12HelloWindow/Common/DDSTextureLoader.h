@@ -24,7 +24,12 @@
 
 #include <wrl.h>
 #include <d3d11_1.h>
+#include <memory>
+#include <vector>
 #include "d3dx12.h"
+#include "MappedFile.h"
+
+class UploadRing;
 
 #pragma warning(push)
 #pragma warning(disable : 4005)
@@ -92,6 +97,126 @@ namespace DirectX
 		                               _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
 		                               );
 
+	// Streams a DDS file into a texture through an UploadRing, coarsest mip first.  The
+	// file stays memory mapped until the last subresource is recorded and each one is
+	// copied from the mapping straight into the ring at its GPU footprint, so the only
+	// staging memory is the ring and no heap copy of the file is made.
+	class DDSTextureStream
+	{
+	public:
+		DDSTextureStream() = default;
+		DDSTextureStream(const DDSTextureStream& rhs) = delete;
+		DDSTextureStream& operator=(const DDSTextureStream& rhs) = delete;
+
+		///<summary>
+		/// Maps and validates the file and creates the texture, with nothing copied yet.
+		///</summary>
+		HRESULT Open(_In_ ID3D12Device* device,
+		             _In_z_ const wchar_t* szFileName,
+		             _In_ size_t maxsize = 0);
+
+		// Same, from a file already mapped, e.g. by a TextureLoadQueue I/O thread.
+		HRESULT Open(_In_ ID3D12Device* device,
+		             _In_ std::unique_ptr<MappedFile> file,
+		             _In_ size_t maxsize = 0);
+
+		///<summary>
+		/// Opens a single 2D texture as a reserved resource whose mips are backed by
+		/// tiles the caller maps with MapTiles(), so mips can be evicted and streamed
+		/// in again.  The file stays mapped until Close().  Nothing is streamed until
+		/// SetStreamLimit() is lowered from MipLevels().
+		///</summary>
+		HRESULT OpenReserved(_In_ ID3D12Device* device,
+		                     _In_ std::unique_ptr<MappedFile> file,
+		                     _In_ size_t maxsize = 0);
+
+		///<summary>
+		/// Records the copies of as many remaining subresources as the ring has room for,
+		/// stopping once maxBytes have been staged.  Returns S_OK when every mip up to
+		/// the stream limit is in, S_FALSE when more remains for a later call, or
+		/// E_OUTOFMEMORY if a single subresource is larger than the whole ring.  On a
+		/// direct command list the texture is left in PIXEL_SHADER_RESOURCE state after
+		/// every call that copied something; on a copy command list no barriers are
+		/// recorded.
+		///</summary>
+		HRESULT Stream(_In_ ID3D12GraphicsCommandList* cmdList,
+		               _In_ UploadRing& ring,
+		               _In_ UINT64 maxBytes = UINT64_MAX);
+
+		// Unmaps the file and releases the texture.
+		void Close();
+
+		bool Done()const { return mNextSubresource == mSubresources.size(); }
+
+		// Stream() copies no mip finer than mip; 0 by default, MipLevels() for
+		// reserved textures until raised.
+		void SetStreamLimit(UINT mip) { mStreamLimit = mip; }
+		UINT StreamLimit()const { return mStreamLimit; }
+
+		// ResidentMip() has not reached the stream limit yet.
+		bool Streaming()const { return ResidentMip() > mStreamLimit; }
+
+		bool Reserved()const { return mReserved; }
+
+		// First mip of a reserved texture's packed tail, which is mapped as one unit;
+		// MipLevels() when every mip has tiles of its own.
+		UINT PackedMip()const { return mPackedMip; }
+
+		// 64KB tiles backing mip, or the whole packed tail for PackedMip().
+		UINT TileCount(UINT mip)const;
+
+		///<summary>
+		/// Points mip's tiles (the whole tail for PackedMip()) at TileCount(mip) tiles of
+		/// heap from heapStartTile on, or at nothing.  The mapping is queued on queue
+		/// ahead of anything executed on it afterwards.
+		///</summary>
+		void MapTiles(_In_ ID3D12CommandQueue* queue, _In_ UINT mip,
+		              _In_ ID3D12Heap* heap, _In_ UINT heapStartTile);
+		void UnmapTiles(_In_ ID3D12CommandQueue* queue, _In_ UINT mip);
+
+		///<summary>
+		/// Forgets the resident mip ResidentMip() of a reserved texture so that Stream()
+		/// would copy it again, and raises the stream limit past it.  Its tiles stay
+		/// mapped; unmap them once no frame in flight samples the mip.
+		///</summary>
+		void Evict(_In_ UINT mip);
+
+		// Most detailed mip copied for every array slice, for the SRV's
+		// ResourceMinLODClamp; MipLevels() until the first mip is in.
+		UINT ResidentMip()const;
+		UINT MipLevels()const { return mDesc.MipLevels; }
+
+		ID3D12Resource* Texture()const { return mTexture.Get(); }
+		const D3D12_RESOURCE_DESC& Desc()const { return mDesc; }
+		DDS_ALPHA_MODE AlphaMode()const { return mAlphaMode; }
+
+	private:
+		HRESULT Create(ID3D12Device* device, std::unique_ptr<MappedFile> file,
+		               size_t maxsize, bool reserved);
+
+	private:
+		Microsoft::WRL::ComPtr<ID3D12Device> mDevice;
+		Microsoft::WRL::ComPtr<ID3D12Resource> mTexture;
+		D3D12_RESOURCE_DESC mDesc = {};
+		D3D12_RESOURCE_STATES mState = D3D12_RESOURCE_STATE_COPY_DEST;
+		DDS_ALPHA_MODE mAlphaMode = DDS_ALPHA_MODE_UNKNOWN;
+
+		std::unique_ptr<MappedFile> mFile;
+
+		// Surfaces in the mapping, in subresource order.
+		std::vector<D3D12_SUBRESOURCE_DATA> mSubresources;
+
+		// Subresources are streamed mip by mip from the coarsest, all slices of a mip
+		// before the next; this counts how many are done.
+		size_t mNextSubresource = 0;
+		UINT mStreamLimit = 0;
+
+		bool mReserved = false;
+		UINT mPackedMip = 0;
+		D3D12_PACKED_MIP_INFO mPackedMipInfo = {};
+		std::vector<D3D12_SUBRESOURCE_TILING> mTilings;
+	};
+
     // Standard version with optional auto-gen mipmap support
     HRESULT CreateDDSTextureFromMemory( _In_ ID3D11Device* d3dDevice,
                                         _In_opt_ ID3D11DeviceContext* d3dContext,
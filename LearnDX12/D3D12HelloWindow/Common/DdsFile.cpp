@@ -0,0 +1,344 @@
+//***************************************************************************************
+// DdsFile.cpp
+//***************************************************************************************
+
+#include "DdsFile.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+    const std::uint32_t DdsMagic = 0x20534444; // "DDS "
+    const std::uint32_t HeaderSize = 124;
+    const std::uint32_t PixelFormatSize = 32;
+    const std::uint32_t Dx10HeaderSize = 20;
+
+    // Byte offsets in the header, which follows the magic number.
+    const std::uint32_t HeaderFlagsOffset = 4;
+    const std::uint32_t HeightOffset = 8;
+    const std::uint32_t WidthOffset = 12;
+    const std::uint32_t DepthOffset = 20;
+    const std::uint32_t MipCountOffset = 24;
+    const std::uint32_t PixelFormatOffset = 72;
+    const std::uint32_t Caps2Offset = 108;
+
+    const std::uint32_t PitchOffset = 16;
+    const std::uint32_t CapsOffset = 104;
+
+    const std::uint32_t FlagFourCC = 0x4;
+    const std::uint32_t FlagRgb = 0x40;
+    const std::uint32_t HeaderFlagCaps = 0x1;
+    const std::uint32_t HeaderFlagHeight = 0x2;
+    const std::uint32_t HeaderFlagWidth = 0x4;
+    const std::uint32_t HeaderFlagPitch = 0x8;
+    const std::uint32_t HeaderFlagPixelFormat = 0x1000;
+    const std::uint32_t HeaderFlagMipCount = 0x20000;
+    const std::uint32_t HeaderFlagLinearSize = 0x80000;
+    const std::uint32_t HeaderFlagVolume = 0x800000;
+    const std::uint32_t CapsComplex = 0x8;
+    const std::uint32_t CapsTexture = 0x1000;
+    const std::uint32_t CapsMipMap = 0x400000;
+    const std::uint32_t Caps2CubeMap = 0x200;
+    const std::uint32_t Caps2AllFaces = 0xfc00;
+    const std::uint32_t Caps2Volume = 0x200000;
+
+    const std::uint32_t Dx10Texture2D = 3;
+    const std::uint32_t Dx10Texture3D = 4;
+    const std::uint32_t Dx10MiscTextureCube = 0x4;
+
+    // Direct3D 12's limits; larger headers are not trusted.
+    const std::uint32_t MaxDimension = 16384;
+    const std::uint32_t MaxArraySize = 2048;
+
+    std::uint32_t ReadU32(const std::uint8_t* p)
+    {
+        std::uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    void WriteU32(std::uint8_t* p, std::uint32_t value)
+    {
+        std::memcpy(p, &value, sizeof(value));
+    }
+
+    std::uint32_t FourCC(char a, char b, char c, char d)
+    {
+        return (std::uint32_t)(std::uint8_t)a | ((std::uint32_t)(std::uint8_t)b << 8) |
+            ((std::uint32_t)(std::uint8_t)c << 16) | ((std::uint32_t)(std::uint8_t)d << 24);
+    }
+
+    // Format of a header without the DX10 extension.
+    std::uint32_t LegacyFormat(const std::uint8_t* pf)
+    {
+        const std::uint32_t flags = ReadU32(pf + 4);
+        const std::uint32_t fourCC = ReadU32(pf + 8);
+
+        if(flags & FlagFourCC)
+        {
+            if(fourCC == FourCC('D', 'X', 'T', '1')) return DdsFile::FormatBC1Unorm;
+            if(fourCC == FourCC('D', 'X', 'T', '2') || fourCC == FourCC('D', 'X', 'T', '3')) return DdsFile::FormatBC2Unorm;
+            if(fourCC == FourCC('D', 'X', 'T', '4') || fourCC == FourCC('D', 'X', 'T', '5')) return DdsFile::FormatBC3Unorm;
+            if(fourCC == FourCC('A', 'T', 'I', '1') || fourCC == FourCC('B', 'C', '4', 'U')) return DdsFile::FormatBC4Unorm;
+            if(fourCC == FourCC('B', 'C', '4', 'S')) return DdsFile::FormatBC4Snorm;
+            if(fourCC == FourCC('A', 'T', 'I', '2') || fourCC == FourCC('B', 'C', '5', 'U')) return DdsFile::FormatBC5Unorm;
+            if(fourCC == FourCC('B', 'C', '5', 'S')) return DdsFile::FormatBC5Snorm;
+
+            // D3DFORMAT values stored as the FourCC.
+            if(fourCC == 113) return DdsFile::FormatR16G16B16A16Float;
+            if(fourCC == 114) return DdsFile::FormatR32Float;
+            if(fourCC == 116) return DdsFile::FormatR32G32B32A32Float;
+            return DdsFile::FormatUnknown;
+        }
+
+        if((flags & FlagRgb) && ReadU32(pf + 12) == 32)
+        {
+            const std::uint32_t r = ReadU32(pf + 16);
+            const std::uint32_t g = ReadU32(pf + 20);
+            const std::uint32_t b = ReadU32(pf + 24);
+            const std::uint32_t a = ReadU32(pf + 28);
+            if(r == 0x000000ff && g == 0x0000ff00 && b == 0x00ff0000 && a == 0xff000000)
+                return DdsFile::FormatR8G8B8A8Unorm;
+            if(r == 0x00ff0000 && g == 0x0000ff00 && b == 0x000000ff && a == 0xff000000)
+                return DdsFile::FormatB8G8R8A8Unorm;
+        }
+        return DdsFile::FormatUnknown;
+    }
+}
+
+bool DdsFile::ParseHeader(const std::uint8_t* data, uint64 size, Info& info)
+{
+    info = Info();
+    if(data == nullptr || size < 4 + HeaderSize || ReadU32(data) != DdsMagic)
+        return false;
+
+    const std::uint8_t* header = data + 4;
+    const std::uint8_t* pf = header + PixelFormatOffset;
+    if(ReadU32(header) != HeaderSize || ReadU32(pf) != PixelFormatSize)
+        return false;
+
+    const uint32 flags = ReadU32(header + HeaderFlagsOffset);
+    info.Width = ReadU32(header + WidthOffset);
+    info.Height = std::max(ReadU32(header + HeightOffset), 1u);
+    info.Depth = 1;
+    info.MipCount = std::max(ReadU32(header + MipCountOffset), 1u);
+    info.DataOffset = 4 + HeaderSize;
+
+    const bool dx10 = (ReadU32(pf + 4) & FlagFourCC) && ReadU32(pf + 8) == FourCC('D', 'X', '1', '0');
+    if(dx10)
+    {
+        if(size < 4 + HeaderSize + Dx10HeaderSize)
+            return false;
+
+        const std::uint8_t* ext = header + HeaderSize;
+        info.Format = ReadU32(ext);
+        const uint32 dimension = ReadU32(ext + 4);
+        const uint32 miscFlag = ReadU32(ext + 8);
+        info.ArraySize = ReadU32(ext + 12);
+        info.DataOffset += Dx10HeaderSize;
+
+        if(info.ArraySize == 0)
+            return false;
+        if(dimension == Dx10Texture3D)
+        {
+            info.IsVolume = true;
+            info.Depth = std::max(ReadU32(header + DepthOffset), 1u);
+        }
+        else if(dimension == Dx10Texture2D && (miscFlag & Dx10MiscTextureCube))
+        {
+            info.IsCubeMap = true;
+            info.ArraySize *= 6;
+        }
+    }
+    else
+    {
+        info.Format = LegacyFormat(pf);
+
+        const uint32 caps2 = ReadU32(header + Caps2Offset);
+        if(flags & HeaderFlagVolume)
+        {
+            info.IsVolume = true;
+            info.Depth = std::max(ReadU32(header + DepthOffset), 1u);
+        }
+        else if(caps2 & Caps2CubeMap)
+        {
+            // Partial cube maps are not supported by Direct3D 10 and later.
+            if((caps2 & Caps2AllFaces) != Caps2AllFaces)
+                return false;
+            info.IsCubeMap = true;
+            info.ArraySize = 6;
+        }
+    }
+
+    if(info.Width == 0 || info.Width > MaxDimension || info.Height > MaxDimension ||
+        info.Depth > MaxDimension || info.ArraySize > MaxArraySize || info.MipCount > 15)
+        return false;
+    if(BitsPerPixel(info.Format) == 0)
+        return false;
+
+    return size - info.DataOffset >= DataSize(info);
+}
+
+std::vector<std::uint8_t> DdsFile::WriteHeader(const Info& info)
+{
+    std::vector<std::uint8_t> bytes(4 + HeaderSize + Dx10HeaderSize, 0);
+    WriteU32(&bytes[0], DdsMagic);
+
+    // Always the DX10 extension: it is the only way to name every format here.
+    std::uint8_t* header = &bytes[4];
+    std::uint8_t* pf = header + PixelFormatOffset;
+    std::uint8_t* ext = header + HeaderSize;
+
+    uint64 rowBytes;
+    uint32 rowCount;
+    const uint64 surfaceSize = SurfaceSize(info.Format, info.Width, info.Height, &rowBytes, &rowCount);
+
+    uint32 flags = HeaderFlagCaps | HeaderFlagHeight | HeaderFlagWidth | HeaderFlagPixelFormat | HeaderFlagMipCount;
+    flags |= IsBlockCompressed(info.Format) ? HeaderFlagLinearSize : HeaderFlagPitch;
+    if(info.IsVolume)
+        flags |= HeaderFlagVolume;
+
+    uint32 caps = CapsTexture;
+    if(info.MipCount > 1)
+        caps |= CapsMipMap | CapsComplex;
+    if(info.IsCubeMap || info.IsVolume)
+        caps |= CapsComplex;
+
+    WriteU32(header, HeaderSize);
+    WriteU32(header + HeaderFlagsOffset, flags);
+    WriteU32(header + HeightOffset, info.Height);
+    WriteU32(header + WidthOffset, info.Width);
+    WriteU32(header + PitchOffset, (uint32)(IsBlockCompressed(info.Format) ? surfaceSize : rowBytes));
+    WriteU32(header + DepthOffset, info.IsVolume ? info.Depth : 0);
+    WriteU32(header + MipCountOffset, info.MipCount);
+    WriteU32(header + CapsOffset, caps);
+    WriteU32(header + Caps2Offset, info.IsCubeMap ? Caps2CubeMap | Caps2AllFaces : info.IsVolume ? Caps2Volume : 0);
+
+    WriteU32(pf, PixelFormatSize);
+    WriteU32(pf + 4, FlagFourCC);
+    WriteU32(pf + 8, FourCC('D', 'X', '1', '0'));
+
+    WriteU32(ext, info.Format);
+    WriteU32(ext + 4, info.IsVolume ? Dx10Texture3D : Dx10Texture2D);
+    WriteU32(ext + 8, info.IsCubeMap ? Dx10MiscTextureCube : 0);
+    WriteU32(ext + 12, info.IsCubeMap ? info.ArraySize / 6 : info.ArraySize);
+    return bytes;
+}
+
+bool DdsFile::Save(const std::string& path, const Info& info, const void* data)
+{
+    const std::vector<std::uint8_t> header = WriteHeader(info);
+
+    const std::string temp = path + ".tmp";
+    {
+        std::ofstream fout(temp, std::ios::binary | std::ios::trunc);
+        if(!fout)
+            return false;
+
+        fout.write(reinterpret_cast<const char*>(header.data()), header.size());
+        fout.write(reinterpret_cast<const char*>(data), (std::streamsize)DataSize(info));
+
+        if(!fout)
+        {
+            fout.close();
+            std::remove(temp.c_str());
+            return false;
+        }
+    }
+
+    std::remove(path.c_str());
+    if(std::rename(temp.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+DdsFile::uint32 DdsFile::BitsPerPixel(uint32 format)
+{
+    switch(format)
+    {
+    case FormatR32G32B32A32Float:
+        return 128;
+    case FormatR16G16B16A16Float:
+        return 64;
+    case FormatR8G8B8A8Unorm:
+    case FormatR8G8B8A8UnormSrgb:
+    case FormatR32Float:
+    case FormatB8G8R8A8Unorm:
+    case FormatB8G8R8A8UnormSrgb:
+        return 32;
+    case FormatBC1Unorm:
+    case FormatBC1UnormSrgb:
+    case FormatBC4Unorm:
+    case FormatBC4Snorm:
+        return 4;
+    case FormatBC2Unorm:
+    case FormatBC2UnormSrgb:
+    case FormatBC3Unorm:
+    case FormatBC3UnormSrgb:
+    case FormatBC5Unorm:
+    case FormatBC5Snorm:
+    case FormatBC6HUf16:
+    case FormatBC6HSf16:
+    case FormatBC7Unorm:
+    case FormatBC7UnormSrgb:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+bool DdsFile::IsBlockCompressed(uint32 format)
+{
+    // Every format here under 32 bits per pixel is a BC one.
+    const uint32 bits = BitsPerPixel(format);
+    return bits != 0 && bits < 32;
+}
+
+DdsFile::uint64 DdsFile::SurfaceSize(uint32 format, uint32 width, uint32 height,
+    uint64* rowBytes, uint32* rowCount)
+{
+    uint64 bytesPerRow;
+    uint32 rows;
+    if(IsBlockCompressed(format))
+    {
+        // 8 bytes per 4x4 block at 4 bits per pixel, 16 at 8.
+        const uint64 blockBytes = BitsPerPixel(format) * 2;
+        bytesPerRow = std::max(1u, (width + 3) / 4) * blockBytes;
+        rows = std::max(1u, (height + 3) / 4);
+    }
+    else
+    {
+        bytesPerRow = ((uint64)width * BitsPerPixel(format) + 7) / 8;
+        rows = height;
+    }
+
+    if(rowBytes != nullptr)
+        *rowBytes = bytesPerRow;
+    if(rowCount != nullptr)
+        *rowCount = rows;
+    return bytesPerRow * rows;
+}
+
+DdsFile::uint32 DdsFile::MipDimension(uint32 size, uint32 mip)
+{
+    return mip < 32 ? std::max(size >> mip, 1u) : 1u;
+}
+
+DdsFile::uint64 DdsFile::MipSize(const Info& info, uint32 mip)
+{
+    return SurfaceSize(info.Format, MipDimension(info.Width, mip), MipDimension(info.Height, mip)) *
+        MipDimension(info.Depth, mip);
+}
+
+DdsFile::uint64 DdsFile::DataSize(const Info& info)
+{
+    uint64 sliceSize = 0;
+    for(uint32 mip = 0; mip < info.MipCount; ++mip)
+        sliceSize += MipSize(info, mip);
+    return sliceSize * info.ArraySize;
+}
@@ -0,0 +1,104 @@
+//***************************************************************************************
+// DdsFile.h
+//
+// The DDS container without Direct3D or windows.h: header parsing and writing, and the
+// surface layout of the formats the CPU side texture tools deal with.  Format values are the
+// DXGI_FORMAT ones, so they can be handed to Direct3D unchanged.
+//
+// Surfaces follow the header in the file's order: for each array slice (six per cube),
+// every mip from the largest, each mip holding all of its depth slices.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class DdsFile
+{
+public:
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+    // The DXGI_FORMAT values known here.
+    enum Format : uint32
+    {
+        FormatUnknown = 0,
+        FormatR32G32B32A32Float = 2,
+        FormatR16G16B16A16Float = 10,
+        FormatR8G8B8A8Unorm = 28,
+        FormatR8G8B8A8UnormSrgb = 29,
+        FormatR32Float = 41,
+        FormatBC1Unorm = 71,
+        FormatBC1UnormSrgb = 72,
+        FormatBC2Unorm = 74,
+        FormatBC2UnormSrgb = 75,
+        FormatBC3Unorm = 77,
+        FormatBC3UnormSrgb = 78,
+        FormatBC4Unorm = 80,
+        FormatBC4Snorm = 81,
+        FormatBC5Unorm = 83,
+        FormatBC5Snorm = 84,
+        FormatB8G8R8A8Unorm = 87,
+        FormatB8G8R8A8UnormSrgb = 91,
+        FormatBC6HUf16 = 95,
+        FormatBC6HSf16 = 96,
+        FormatBC7Unorm = 98,
+        FormatBC7UnormSrgb = 99
+    };
+
+    struct Info
+    {
+        uint32 Width = 0;
+        uint32 Height = 0;
+        uint32 Depth = 1;
+        uint32 MipCount = 1;
+
+        // Cube maps count six slices per cube.
+        uint32 ArraySize = 1;
+
+        uint32 Format = FormatUnknown;
+        bool IsCubeMap = false;
+        bool IsVolume = false;
+
+        // Where the first surface starts in the file.
+        uint64 DataOffset = 0;
+    };
+
+    ///<summary>
+    /// Reads the header of the size byte DDS file at data.  Fails on anything that is
+    /// not a DDS file, uses a format not listed above, or is too short for its surfaces.
+    ///</summary>
+    static bool ParseHeader(const std::uint8_t* data, uint64 size, Info& info);
+
+    ///<summary>
+    /// Magic number, header and DX10 extension of a file holding the surfaces of info,
+    /// which ParseHeader() reads back as info.  DataOffset is ignored.
+    ///</summary>
+    static std::vector<std::uint8_t> WriteHeader(const Info& info);
+
+    // Writes the header and the DataSize(info) bytes at data to path, through a
+    // temporary file so that readers never see half of it.
+    static bool Save(const std::string& path, const Info& info, const void* data);
+
+    // 0 for formats not listed above.
+    static uint32 BitsPerPixel(uint32 format);
+    static bool IsBlockCompressed(uint32 format);
+
+    ///<summary>
+    /// Bytes of one width x height surface, with the bytes per row and the number of
+    /// rows (of 4x4 blocks for the BC formats).
+    ///</summary>
+    static uint64 SurfaceSize(uint32 format, uint32 width, uint32 height,
+        uint64* rowBytes = nullptr, uint32* rowCount = nullptr);
+
+    // Size of mip level mip, 1 at the least.
+    static uint32 MipDimension(uint32 size, uint32 mip);
+
+    // Bytes of one mip of one array slice, all of its depth slices included.
+    static uint64 MipSize(const Info& info, uint32 mip);
+
+    // Bytes of every surface.
+    static uint64 DataSize(const Info& info);
+};
@@ -0,0 +1,98 @@
+//***************************************************************************************
+// DescriptorAllocator.cpp
+//***************************************************************************************
+
+#include "DescriptorAllocator.h"
+#include <algorithm>
+
+const DescriptorAllocator::uint32 DescriptorAllocator::NoIndex;
+
+DescriptorAllocator::DescriptorAllocator(uint32 persistentCapacity, uint32 transientCapacity)
+    : mPersistent(persistentCapacity),
+    mTransient(transientCapacity)
+{
+}
+
+DescriptorAllocator::Allocation DescriptorAllocator::AllocatePersistent(uint32 count)
+{
+    return mPersistent.Allocate(count);
+}
+
+void DescriptorAllocator::FreePersistent(const Allocation& allocation)
+{
+    if(allocation.Valid())
+        mOpenFrees.push_back(allocation);
+}
+
+DescriptorAllocator::uint32 DescriptorAllocator::AllocateTransient(uint32 count)
+{
+    const FencedRingAllocator::uint64 offset = mTransient.Allocate(count);
+    if(offset == FencedRingAllocator::NoOffset)
+        return NoIndex;
+
+    return PersistentCapacity() + (uint32)offset;
+}
+
+void DescriptorAllocator::QueueCopy(uint32 source, uint32 destination, uint32 count)
+{
+    if(count > 0)
+        mQueuedCopies.push_back({ source, destination, count });
+}
+
+const std::vector<DescriptorAllocator::Copy>& DescriptorAllocator::TakeCopies()
+{
+    std::stable_sort(mQueuedCopies.begin(), mQueuedCopies.end(),
+        [](const Copy& a, const Copy& b) { return a.Destination < b.Destination; });
+
+    mCopies.clear();
+    for(const Copy& copy : mQueuedCopies)
+    {
+        if(!mCopies.empty())
+        {
+            Copy& last = mCopies.back();
+            const uint32 lastEnd = last.Destination + last.Count;
+
+            // The same descriptors queued twice.
+            if(copy.Destination == last.Destination && copy.Source == last.Source)
+            {
+                last.Count = std::max(last.Count, copy.Count);
+                continue;
+            }
+
+            // Continues the previous run on both sides.
+            if(copy.Destination == lastEnd && copy.Source == last.Source + last.Count)
+            {
+                last.Count += copy.Count;
+                continue;
+            }
+        }
+        mCopies.push_back(copy);
+    }
+    mQueuedCopies.clear();
+
+    for(const Copy& copy : mCopies)
+        mCopiedDescriptors += copy.Count;
+    mCopyRanges += mCopies.size();
+
+    return mCopies;
+}
+
+void DescriptorAllocator::EndFrame(uint64 fence)
+{
+    mTransient.EndFrame(fence);
+
+    for(const Allocation& allocation : mOpenFrees)
+        mDeferredFrees.push_back({ fence, allocation });
+    mOpenFrees.clear();
+}
+
+void DescriptorAllocator::Reclaim(uint64 completedFence)
+{
+    mTransient.Reclaim(completedFence);
+
+    while(!mDeferredFrees.empty() && mDeferredFrees.front().Fence <= completedFence)
+    {
+        mPersistent.Free(mDeferredFrees.front().Range);
+        mDeferredFrees.pop_front();
+    }
+}
@@ -0,0 +1,119 @@
+//***************************************************************************************
+// DescriptorAllocator.h
+//
+// Index bookkeeping for one shader-visible descriptor heap, split in two regions:
+//
+//   [0, persistentCapacity)            long-lived descriptors (TlsfAllocator).  They
+//                                      are written to a CPU-only staging heap at the
+//                                      same index and copied over in batches.
+//   [persistentCapacity, +transient)   per-frame tables (FencedRingAllocator), written
+//                                      directly or copied from staging, and recycled
+//                                      once the frame's fence has completed.
+//
+// Freed persistent ranges are held back until the frame that freed them has completed,
+// since commands in flight may still reference them.  Copies are queued as
+// (source, destination, count) runs and merged where both sides are contiguous, so a
+// frame's worth of updates turns into a few CopyDescriptors ranges.
+//
+// DescriptorHeapManager is the D3D12 front end.
+//***************************************************************************************
+
+#pragma once
+
+#include "FencedRingAllocator.h"
+#include "TlsfAllocator.h"
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+class DescriptorAllocator
+{
+public:
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+    using Allocation = TlsfAllocator::Allocation;
+
+    static const uint32 NoIndex = 0xffffffff;
+
+    struct Copy
+    {
+        uint32 Source;      // staging heap index
+        uint32 Destination; // shader-visible heap index
+        uint32 Count;
+    };
+
+    DescriptorAllocator(uint32 persistentCapacity, uint32 transientCapacity);
+    DescriptorAllocator(const DescriptorAllocator& rhs) = delete;
+    DescriptorAllocator& operator=(const DescriptorAllocator& rhs) = delete;
+
+    ///<summary>
+    /// count contiguous persistent descriptors; not Valid() if the region is full.
+    ///</summary>
+    Allocation AllocatePersistent(uint32 count);
+
+    ///<summary>
+    /// Frees a persistent range once the current frame has completed on the GPU.
+    ///</summary>
+    void FreePersistent(const Allocation& allocation);
+
+    ///<summary>
+    /// count contiguous descriptors valid for the current frame only; returns their
+    /// heap index, or NoIndex if the frames in flight use up the transient region.
+    ///</summary>
+    uint32 AllocateTransient(uint32 count);
+
+    ///<summary>
+    /// Queues a staging to shader-visible copy of count descriptors.  Persistent
+    /// descriptors are staged at their own index, so Stage(a.Offset, a.Size) publishes
+    /// an allocation after its descriptors were written.
+    ///</summary>
+    void QueueCopy(uint32 source, uint32 destination, uint32 count);
+    void Stage(uint32 index, uint32 count) { QueueCopy(index, index, count); }
+
+    ///<summary>
+    /// The queued copies, sorted by destination and merged, and clears the queue.
+    ///</summary>
+    const std::vector<Copy>& TakeCopies();
+
+    ///<summary>
+    /// Closes the current frame, which the GPU signals with fence when done.
+    ///</summary>
+    void EndFrame(uint64 fence);
+
+    ///<summary>
+    /// Recycles the transient ranges and deferred frees of completed frames.
+    ///</summary>
+    void Reclaim(uint64 completedFence);
+
+    uint32 PersistentCapacity()const { return mPersistent.Capacity(); }
+    uint32 TransientCapacity()const { return (uint32)mTransient.Capacity(); }
+    uint32 HeapSize()const { return PersistentCapacity() + TransientCapacity(); }
+
+    const TlsfAllocator& Persistent()const { return mPersistent; }
+    const FencedRingAllocator& Transient()const { return mTransient; }
+
+    // Descriptors copied and CopyDescriptors ranges produced by TakeCopies() so far.
+    uint64 CopiedDescriptors()const { return mCopiedDescriptors; }
+    uint64 CopyRanges()const { return mCopyRanges; }
+
+private:
+    struct DeferredFree
+    {
+        uint64 Fence;
+        Allocation Range;
+    };
+
+private:
+    TlsfAllocator mPersistent;
+    FencedRingAllocator mTransient;
+
+    // Frees of the open frame, and of closed frames waiting for their fence.
+    std::vector<Allocation> mOpenFrees;
+    std::deque<DeferredFree> mDeferredFrees;
+
+    std::vector<Copy> mQueuedCopies;
+    std::vector<Copy> mCopies;
+
+    uint64 mCopiedDescriptors = 0;
+    uint64 mCopyRanges = 0;
+};
@@ -0,0 +1,66 @@
+//***************************************************************************************
+// DescriptorHeap.cpp
+//***************************************************************************************
+
+#include "DescriptorHeap.h"
+
+DescriptorHeapManager::DescriptorHeapManager(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type,
+    UINT persistentCapacity, UINT transientCapacity)
+    : mDevice(device),
+    mType(type),
+    mAllocator(persistentCapacity, transientCapacity)
+{
+    mDescriptorSize = device->GetDescriptorHandleIncrementSize(type);
+
+    // Copy sources have to be in a heap the CPU can read, which rules out the
+    // shader-visible one.
+    D3D12_DESCRIPTOR_HEAP_DESC stagingDesc;
+    stagingDesc.NumDescriptors = persistentCapacity;
+    stagingDesc.Type = type;
+    stagingDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+    stagingDesc.NodeMask = 0;
+    ThrowIfFailed(device->CreateDescriptorHeap(&stagingDesc, IID_PPV_ARGS(&mStagingHeap)));
+    d3dUtil::TrackMemory(device, mStagingHeap.Get());
+
+    D3D12_DESCRIPTOR_HEAP_DESC visibleDesc = stagingDesc;
+    visibleDesc.NumDescriptors = persistentCapacity + transientCapacity;
+    visibleDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+    ThrowIfFailed(device->CreateDescriptorHeap(&visibleDesc, IID_PPV_ARGS(&mShaderVisibleHeap)));
+    d3dUtil::TrackMemory(device, mShaderVisibleHeap.Get());
+}
+
+CD3DX12_CPU_DESCRIPTOR_HANDLE DescriptorHeapManager::StagingHandle(UINT index)const
+{
+    return CD3DX12_CPU_DESCRIPTOR_HANDLE(mStagingHeap->GetCPUDescriptorHandleForHeapStart(), index, mDescriptorSize);
+}
+
+CD3DX12_CPU_DESCRIPTOR_HANDLE DescriptorHeapManager::CpuHandle(UINT index)const
+{
+    return CD3DX12_CPU_DESCRIPTOR_HANDLE(mShaderVisibleHeap->GetCPUDescriptorHandleForHeapStart(), index, mDescriptorSize);
+}
+
+CD3DX12_GPU_DESCRIPTOR_HANDLE DescriptorHeapManager::GpuHandle(UINT index)const
+{
+    return CD3DX12_GPU_DESCRIPTOR_HANDLE(mShaderVisibleHeap->GetGPUDescriptorHandleForHeapStart(), index, mDescriptorSize);
+}
+
+void DescriptorHeapManager::FlushCopies()
+{
+    const std::vector<DescriptorAllocator::Copy>& copies = mAllocator.TakeCopies();
+    if(copies.empty())
+        return;
+
+    mCopySources.clear();
+    mCopyDestinations.clear();
+    mCopySizes.clear();
+    for(const DescriptorAllocator::Copy& copy : copies)
+    {
+        mCopySources.push_back(StagingHandle(copy.Source));
+        mCopyDestinations.push_back(CpuHandle(copy.Destination));
+        mCopySizes.push_back(copy.Count);
+    }
+
+    const UINT rangeCount = (UINT)copies.size();
+    mDevice->CopyDescriptors(rangeCount, mCopyDestinations.data(), mCopySizes.data(),
+        rangeCount, mCopySources.data(), mCopySizes.data(), mType);
+}
@@ -0,0 +1,79 @@
+//***************************************************************************************
+// DescriptorHeap.h
+//
+// One shader-visible descriptor heap shared by everything in a scene, sized once and
+// suballocated by DescriptorAllocator, so adding objects never rebuilds it:
+//
+//   - persistent descriptors are written to a CPU-only staging heap (StagingHandle),
+//     published with Stage() and copied to the shader-visible heap by FlushCopies();
+//   - transient descriptors live for one frame and are written straight into the
+//     shader-visible heap (CpuHandle) or copied from staging (CopyToTransient).
+//
+// Call Reclaim() once a frame resource's fence has been waited on and EndFrame() after
+// signalling the fence for the frame just recorded.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "DescriptorAllocator.h"
+
+class DescriptorHeapManager
+{
+public:
+    using Allocation = DescriptorAllocator::Allocation;
+
+    DescriptorHeapManager(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type,
+        UINT persistentCapacity, UINT transientCapacity);
+    DescriptorHeapManager(const DescriptorHeapManager& rhs) = delete;
+    DescriptorHeapManager& operator=(const DescriptorHeapManager& rhs) = delete;
+
+    Allocation AllocatePersistent(UINT count) { return mAllocator.AllocatePersistent(count); }
+    void FreePersistent(const Allocation& allocation) { mAllocator.FreePersistent(allocation); }
+
+    // Where persistent descriptors are written before Stage().
+    CD3DX12_CPU_DESCRIPTOR_HANDLE StagingHandle(UINT index)const;
+
+    // Queues the copy of a written persistent range to the shader-visible heap.
+    void Stage(const Allocation& allocation) { mAllocator.Stage(allocation.Offset, allocation.Size); }
+
+    ///<summary>
+    /// count descriptors in the shader-visible heap for the current frame; returns
+    /// their index, or DescriptorAllocator::NoIndex if the transient region is full.
+    ///</summary>
+    UINT AllocateTransient(UINT count) { return mAllocator.AllocateTransient(count); }
+
+    // Queues a copy from the staging heap into a transient range.
+    void CopyToTransient(UINT source, UINT destination, UINT count) { mAllocator.QueueCopy(source, destination, count); }
+
+    ///<summary>
+    /// Issues every queued copy with one CopyDescriptors call.  Copies happen on the
+    /// CPU timeline, so this only has to run before the command list executes.
+    ///</summary>
+    void FlushCopies();
+
+    void EndFrame(UINT64 fence) { mAllocator.EndFrame(fence); }
+    void Reclaim(UINT64 completedFence) { mAllocator.Reclaim(completedFence); }
+
+    // Handles into the shader-visible heap.
+    CD3DX12_CPU_DESCRIPTOR_HANDLE CpuHandle(UINT index)const;
+    CD3DX12_GPU_DESCRIPTOR_HANDLE GpuHandle(UINT index)const;
+
+    ID3D12DescriptorHeap* Heap()const { return mShaderVisibleHeap.Get(); }
+    const DescriptorAllocator& Allocator()const { return mAllocator; }
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12Device> mDevice;
+    D3D12_DESCRIPTOR_HEAP_TYPE mType;
+    UINT mDescriptorSize = 0;
+
+    Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mStagingHeap;
+    Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mShaderVisibleHeap;
+
+    DescriptorAllocator mAllocator;
+
+    // Scratch for FlushCopies().
+    std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> mCopySources;
+    std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> mCopyDestinations;
+    std::vector<UINT> mCopySizes;
+};
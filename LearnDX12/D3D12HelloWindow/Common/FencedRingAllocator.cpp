@@ -0,0 +1,89 @@
+//***************************************************************************************
+// FencedRingAllocator.cpp
+//***************************************************************************************
+
+#include "FencedRingAllocator.h"
+#include <algorithm>
+#include <cassert>
+
+const FencedRingAllocator::uint64 FencedRingAllocator::NoOffset;
+
+FencedRingAllocator::FencedRingAllocator(uint64 capacity)
+{
+    Reset(capacity);
+}
+
+void FencedRingAllocator::Reset(uint64 capacity)
+{
+    mCapacity = capacity;
+    mHead = 0;
+    mTail = 0;
+    mUsedSize = 0;
+    mOpenFrameSize = 0;
+    mFrames.clear();
+}
+
+FencedRingAllocator::uint64 FencedRingAllocator::Allocate(uint64 size, uint64 alignment)
+{
+    assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+    uint64 offset = NoOffset;
+    if(size > 0 && mUsedSize < mCapacity)
+    {
+        const uint64 aligned = (mHead + alignment - 1) & ~(alignment - 1);
+        if(mHead >= mTail)
+        {
+            // Free space is [head, capacity) and [0, tail).
+            if(aligned + size <= mCapacity)
+                offset = aligned;
+            else if(size <= mTail)
+                offset = 0;
+        }
+        else if(aligned + size <= mTail)
+        {
+            offset = aligned;
+        }
+    }
+
+    if(offset == NoOffset)
+    {
+        mFailedAllocations++;
+        return NoOffset;
+    }
+
+    // Skipped units count as used until the frame is reclaimed.
+    const uint64 end = offset + size;
+    const uint64 taken = offset >= mHead ? end - mHead : (mCapacity - mHead) + end;
+
+    mHead = end == mCapacity ? 0 : end;
+    mUsedSize += taken;
+    mOpenFrameSize += taken;
+    mPeakUsedSize = std::max(mPeakUsedSize, mUsedSize);
+    return offset;
+}
+
+void FencedRingAllocator::EndFrame(uint64 fence)
+{
+    assert(mFrames.empty() || mFrames.back().Fence <= fence);
+
+    mFrames.push_back({ fence, mHead, mOpenFrameSize });
+    mOpenFrameSize = 0;
+}
+
+void FencedRingAllocator::Reclaim(uint64 completedFence)
+{
+    while(!mFrames.empty() && mFrames.front().Fence <= completedFence)
+    {
+        mUsedSize -= mFrames.front().Size;
+        mTail = mFrames.front().End;
+        mFrames.pop_front();
+    }
+
+    // Nothing in flight or open: start over at 0 so the next frame gets the longest
+    // contiguous run.
+    if(mUsedSize == 0 && mFrames.empty())
+    {
+        mHead = 0;
+        mTail = 0;
+    }
+}
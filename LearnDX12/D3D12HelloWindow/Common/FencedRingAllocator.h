@@ -0,0 +1,79 @@
+//***************************************************************************************
+// FencedRingAllocator.h
+//
+// Ring of units (descriptors, bytes of an upload buffer, ...) handed out linearly and
+// given back a whole frame at a time.  Allocations made between two EndFrame() calls
+// belong to that frame; once the fence value it was closed with has completed,
+// Reclaim() returns them all at once.  Each allocation is contiguous, so a request
+// that does not fit before the end of the ring skips the rest and wraps to 0.
+//
+// Fence values are plain numbers; UploadRing and DescriptorAllocator pair them with
+// the queue's fence.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+class FencedRingAllocator
+{
+public:
+    using uint64 = std::uint64_t;
+
+    static const uint64 NoOffset = ~0ull;
+
+    explicit FencedRingAllocator(uint64 capacity = 0);
+
+    ///<summary>
+    /// Forgets every allocation, including those of frames still in flight.
+    ///</summary>
+    void Reset(uint64 capacity);
+
+    ///<summary>
+    /// Returns the offset of size units aligned to alignment (a power of two), or
+    /// NoOffset if the frames in flight leave no room.
+    ///</summary>
+    uint64 Allocate(uint64 size, uint64 alignment = 1);
+
+    ///<summary>
+    /// Closes the current frame; its allocations come back once fence has completed.
+    ///</summary>
+    void EndFrame(uint64 fence);
+
+    ///<summary>
+    /// Returns the allocations of every closed frame whose fence is at most
+    /// completedFence.  Frames are reclaimed in the order they were closed.
+    ///</summary>
+    void Reclaim(uint64 completedFence);
+
+    uint64 Capacity()const { return mCapacity; }
+
+    // Units in use, including those skipped for alignment or wrapping.
+    uint64 UsedSize()const { return mUsedSize; }
+    uint64 PeakUsedSize()const { return mPeakUsedSize; }
+    uint64 FramesInFlight()const { return mFrames.size(); }
+
+    // Failed Allocate() calls; a sign the ring is too small for the frame latency.
+    uint64 FailedAllocations()const { return mFailedAllocations; }
+
+private:
+    struct Frame
+    {
+        uint64 Fence;
+        uint64 End;     // head when the frame was closed
+        uint64 Size;    // units taken by the frame, padding included
+    };
+
+private:
+    uint64 mCapacity = 0;
+    uint64 mHead = 0;
+    uint64 mTail = 0;
+    uint64 mUsedSize = 0;
+    uint64 mOpenFrameSize = 0;
+
+    std::deque<Frame> mFrames;
+
+    uint64 mPeakUsedSize = 0;
+    uint64 mFailedAllocations = 0;
+};
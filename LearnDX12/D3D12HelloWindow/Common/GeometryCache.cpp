@@ -0,0 +1,348 @@
+//***************************************************************************************
+// GeometryCache.cpp
+//***************************************************************************************
+
+#include "GeometryCache.h"
+#include "MemoryTracker.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+    // Bump whenever GeometryGenerator's output or the file layout changes.
+    const std::uint32_t CacheVersion = 1;
+
+    // A cached mesh and the handle reporting its bytes, in one allocation: the bytes
+    // are counted once, for as long as the cache or anyone it handed the mesh to
+    // holds it.
+    struct TrackedMesh
+    {
+        GeometryGenerator::MeshData Mesh;
+        MemoryTracker::Handle Memory;
+    };
+    const char CacheMagic[4] = { 'G', 'M', 'S', 'H' };
+
+    // Parameters go into the key as raw bits so different floats never alias.
+    class KeyBuilder
+    {
+    public:
+        explicit KeyBuilder(const char* shape) : mKey(shape) {}
+
+        KeyBuilder& operator<<(float f)
+        {
+            std::uint32_t bits;
+            std::memcpy(&bits, &f, sizeof(bits));
+            return *this << bits;
+        }
+
+        KeyBuilder& operator<<(std::uint32_t u)
+        {
+            char buf[16];
+            std::snprintf(buf, sizeof(buf), "|%08x", u);
+            mKey += buf;
+            return *this;
+        }
+
+        const std::string& Str()const { return mKey; }
+
+    private:
+        std::string mKey;
+    };
+
+    std::uint64_t Fnv1a(const std::string& s)
+    {
+        std::uint64_t h = 14695981039346656037ull;
+        for(unsigned char c : s)
+        {
+            h ^= c;
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    void MakeDirectory(const std::string& path)
+    {
+#ifdef _WIN32
+        _mkdir(path.c_str());
+#else
+        mkdir(path.c_str(), 0755);
+#endif
+    }
+
+    template<typename T>
+    bool ReadPod(std::ifstream& fin, T& value)
+    {
+        return (bool)fin.read(reinterpret_cast<char*>(&value), sizeof(T));
+    }
+
+    std::streamoff RemainingBytes(std::ifstream& fin)
+    {
+        const std::streampos pos = fin.tellg();
+        fin.seekg(0, std::ios::end);
+        const std::streamoff remaining = fin.tellg() - pos;
+        fin.seekg(pos);
+        return remaining;
+    }
+
+    template<typename T>
+    void WritePod(std::ofstream& fout, const T& value)
+    {
+        fout.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+}
+
+GeometryCache& GeometryCache::Default()
+{
+    static GeometryCache cache;
+    return cache;
+}
+
+void GeometryCache::SetDirectory(const std::string& directory)
+{
+    if(!directory.empty())
+        MakeDirectory(directory);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mDirectory = directory;
+}
+
+void GeometryCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mEntries.clear();
+}
+
+template<typename Generate>
+GeometryCache::MeshPtr GeometryCache::Find(const std::string& key, Generate generate)
+{
+    std::promise<MeshPtr> promise;
+    std::string directory;
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        auto it = mEntries.find(key);
+        if(it != mEntries.end())
+        {
+            std::shared_future<MeshPtr> entry = it->second;
+            lock.unlock();
+
+            ++mMemoryHits;
+            return entry.get();
+        }
+
+        mEntries[key] = promise.get_future().share();
+        directory = mDirectory;
+    }
+
+    try
+    {
+        const std::string path = directory.empty() ? std::string() : PathForKey(directory, key);
+
+        auto tracked = std::make_shared<TrackedMesh>();
+        GeometryGenerator::MeshData& mesh = tracked->Mesh;
+        if(!path.empty() && LoadFromDisk(path, key, mesh))
+        {
+            ++mDiskHits;
+        }
+        else
+        {
+            mesh = generate();
+            ++mGenerated;
+
+            if(!path.empty())
+                SaveToDisk(path, key, mesh);
+        }
+
+        tracked->Memory.Reset(MemoryTracker::MeshData,
+            mesh.Vertices.capacity() * sizeof(GeometryGenerator::Vertex) +
+            mesh.Indices32.capacity() * sizeof(uint32));
+
+        MeshPtr result(tracked, &mesh);
+        promise.set_value(result);
+        return result;
+    }
+    catch(...)
+    {
+        // Requests already waiting see the exception; later ones try again.  After a
+        // Clear() this may drop another request's entry, which costs a regeneration.
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mEntries.erase(key);
+        }
+
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+}
+
+std::string GeometryCache::PathForKey(const std::string& directory, const std::string& key)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.mesh", (unsigned long long)Fnv1a(key));
+    return directory + "/" + name;
+}
+
+bool GeometryCache::LoadFromDisk(const std::string& path, const std::string& key, GeometryGenerator::MeshData& mesh)
+{
+    std::ifstream fin(path, std::ios::binary);
+    if(!fin)
+        return false;
+
+    char magic[4];
+    std::uint32_t version = 0, vertexSize = 0, keyLength = 0;
+    if(!fin.read(magic, 4) || std::memcmp(magic, CacheMagic, 4) != 0 ||
+       !ReadPod(fin, version) || version != CacheVersion ||
+       !ReadPod(fin, vertexSize) || vertexSize != sizeof(GeometryGenerator::Vertex) ||
+       !ReadPod(fin, keyLength) || keyLength != key.size())
+        return false;
+
+    // The full key is stored so a hash collision reads as a miss.
+    std::string storedKey(keyLength, '\0');
+    if(!fin.read(&storedKey[0], keyLength) || storedKey != key)
+        return false;
+
+    std::uint32_t vertexCount = 0, indexCount = 0;
+    if(!ReadPod(fin, vertexCount) || !ReadPod(fin, indexCount) || indexCount % 3 != 0)
+        return false;
+
+    // Check the counts against the file before allocating for them.
+    const std::streamoff dataSize =
+        std::streamoff(vertexCount)*sizeof(GeometryGenerator::Vertex) + std::streamoff(indexCount)*sizeof(uint32);
+    if(RemainingBytes(fin) != dataSize)
+        return false;
+
+    mesh.Vertices.resize(vertexCount);
+    mesh.Indices32.resize(indexCount);
+    if(!fin.read(reinterpret_cast<char*>(mesh.Vertices.data()), std::streamsize(vertexCount)*sizeof(GeometryGenerator::Vertex)) ||
+       !fin.read(reinterpret_cast<char*>(mesh.Indices32.data()), std::streamsize(indexCount)*sizeof(uint32)))
+    {
+        mesh.Vertices.clear();
+        mesh.Indices32.clear();
+        return false;
+    }
+
+    // A damaged file must not hand out indices past the vertices; regenerate instead.
+    for(uint32 index : mesh.Indices32)
+    {
+        if(index >= vertexCount)
+        {
+            mesh.Vertices.clear();
+            mesh.Indices32.clear();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void GeometryCache::SaveToDisk(const std::string& path, const std::string& key, const GeometryGenerator::MeshData& mesh)
+{
+    // Write to a temporary and rename so a concurrent launch never reads half a file.
+    const std::string temp = path + ".tmp";
+    {
+        std::ofstream fout(temp, std::ios::binary | std::ios::trunc);
+        if(!fout)
+            return;
+
+        fout.write(CacheMagic, 4);
+        WritePod(fout, CacheVersion);
+        WritePod(fout, std::uint32_t(sizeof(GeometryGenerator::Vertex)));
+        WritePod(fout, std::uint32_t(key.size()));
+        fout.write(key.data(), key.size());
+        WritePod(fout, std::uint32_t(mesh.Vertices.size()));
+        WritePod(fout, std::uint32_t(mesh.Indices32.size()));
+        fout.write(reinterpret_cast<const char*>(mesh.Vertices.data()), mesh.Vertices.size()*sizeof(GeometryGenerator::Vertex));
+        fout.write(reinterpret_cast<const char*>(mesh.Indices32.data()), mesh.Indices32.size()*sizeof(uint32));
+
+        if(!fout)
+        {
+            fout.close();
+            std::remove(temp.c_str());
+            return;
+        }
+    }
+
+    std::remove(path.c_str());
+    if(std::rename(temp.c_str(), path.c_str()) != 0)
+        std::remove(temp.c_str());
+}
+
+GeometryCache::MeshPtr GeometryCache::CreateBox(float width, float height, float depth, uint32 numSubdivisions)
+{
+    KeyBuilder key("box");
+    key << width << height << depth << numSubdivisions;
+
+    return Find(key.Str(), [=]()
+    {
+        GeometryGenerator geoGen;
+        return geoGen.CreateBox(width, height, depth, numSubdivisions);
+    });
+}
+
+GeometryCache::MeshPtr GeometryCache::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount)
+{
+    KeyBuilder key("sphere");
+    key << radius << sliceCount << stackCount;
+
+    return Find(key.Str(), [=]()
+    {
+        GeometryGenerator geoGen;
+        return geoGen.CreateSphere(radius, sliceCount, stackCount);
+    });
+}
+
+GeometryCache::MeshPtr GeometryCache::CreateGeosphere(float radius, uint32 numSubdivisions)
+{
+    KeyBuilder key("geosphere");
+    key << radius << numSubdivisions;
+
+    return Find(key.Str(), [=]()
+    {
+        GeometryGenerator geoGen;
+        return geoGen.CreateGeosphere(radius, numSubdivisions);
+    });
+}
+
+GeometryCache::MeshPtr GeometryCache::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount)
+{
+    KeyBuilder key("cylinder");
+    key << bottomRadius << topRadius << height << sliceCount << stackCount;
+
+    return Find(key.Str(), [=]()
+    {
+        GeometryGenerator geoGen;
+        return geoGen.CreateCylinder(bottomRadius, topRadius, height, sliceCount, stackCount);
+    });
+}
+
+GeometryCache::MeshPtr GeometryCache::CreateGrid(float width, float depth, uint32 m, uint32 n)
+{
+    KeyBuilder key("grid");
+    key << width << depth << m << n;
+
+    return Find(key.Str(), [=]()
+    {
+        GeometryGenerator geoGen;
+        return geoGen.CreateGrid(width, depth, m, n);
+    });
+}
+
+GeometryCache::MeshPtr GeometryCache::CreateQuad(float x, float y, float w, float h, float depth)
+{
+    KeyBuilder key("quad");
+    key << x << y << w << h << depth;
+
+    return Find(key.Str(), [=]()
+    {
+        GeometryGenerator geoGen;
+        return geoGen.CreateQuad(x, y, w, h, depth);
+    });
+}
@@ -0,0 +1,72 @@
+//***************************************************************************************
+// GeometryCache.h
+//
+// Process-wide memoization of the GeometryGenerator shapes.  Each shape is generated
+// once per (shape, parameters) and handed out as shared immutable MeshData.  With a
+// cache directory set, generated meshes are also written to disk so later launches
+// only read them back.  Cached meshes count as MemoryTracker::MeshData for as long
+// as they are held.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+class GeometryCache
+{
+public:
+    using uint32 = GeometryGenerator::uint32;
+    using MeshPtr = std::shared_ptr<const GeometryGenerator::MeshData>;
+
+    GeometryCache() = default;
+    GeometryCache(const GeometryCache& rhs) = delete;
+    GeometryCache& operator=(const GeometryCache& rhs) = delete;
+
+    static GeometryCache& Default();
+
+    // Directory for the on-disk copies, created if missing.  Empty keeps the cache
+    // in memory only (the default).
+    void SetDirectory(const std::string& directory);
+
+    // Same parameters as the GeometryGenerator functions of the same name.
+    MeshPtr CreateBox(float width, float height, float depth, uint32 numSubdivisions);
+    MeshPtr CreateSphere(float radius, uint32 sliceCount, uint32 stackCount);
+    MeshPtr CreateGeosphere(float radius, uint32 numSubdivisions);
+    MeshPtr CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount);
+    MeshPtr CreateGrid(float width, float depth, uint32 m, uint32 n);
+    MeshPtr CreateQuad(float x, float y, float w, float h, float depth);
+
+    // Drops the in-memory entries.  Meshes already handed out stay valid.
+    void Clear();
+
+    // Lookups served from memory, from disk, and by running the generator.
+    uint32 MemoryHits()const { return mMemoryHits; }
+    uint32 DiskHits()const { return mDiskHits; }
+    uint32 Generated()const { return mGenerated; }
+
+private:
+    template<typename Generate>
+    MeshPtr Find(const std::string& key, Generate generate);
+
+    static std::string PathForKey(const std::string& directory, const std::string& key);
+    static bool LoadFromDisk(const std::string& path, const std::string& key, GeometryGenerator::MeshData& mesh);
+    static void SaveToDisk(const std::string& path, const std::string& key, const GeometryGenerator::MeshData& mesh);
+
+private:
+    std::mutex mMutex;
+
+    // Futures let concurrent requests for the same shape wait on one generation.
+    std::unordered_map<std::string, std::shared_future<MeshPtr>> mEntries;
+
+    std::string mDirectory;
+
+    std::atomic<uint32> mMemoryHits{0};
+    std::atomic<uint32> mDiskHits{0};
+    std::atomic<uint32> mGenerated{0};
+};
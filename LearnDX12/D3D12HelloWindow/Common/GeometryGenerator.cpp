@@ -3,10 +3,59 @@
 //***************************************************************************************
 
 #include "GeometryGenerator.h"
+#include "TangentSpace.h"
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
 
 using namespace DirectX;
 
+namespace
+{
+    const GeometryGenerator::uint32 NoVertex = 0xffffffff;
+
+    bool NearlyEqual(const XMFLOAT3& a, const XMFLOAT3& b, float epsilon)
+    {
+        return std::fabs(a.x - b.x) <= epsilon &&
+               std::fabs(a.y - b.y) <= epsilon &&
+               std::fabs(a.z - b.z) <= epsilon;
+    }
+
+    bool NearlyEqual(const XMFLOAT2& a, const XMFLOAT2& b, float epsilon)
+    {
+        return std::fabs(a.x - b.x) <= epsilon &&
+               std::fabs(a.y - b.y) <= epsilon;
+    }
+
+    bool NearlyEqual(const GeometryGenerator::Vertex& a, const GeometryGenerator::Vertex& b, float epsilon)
+    {
+        return NearlyEqual(a.Position, b.Position, epsilon) &&
+               NearlyEqual(a.Normal, b.Normal, epsilon) &&
+               NearlyEqual(a.TangentU, b.TangentU, epsilon) &&
+               NearlyEqual(a.TexC, b.TexC, epsilon);
+    }
+
+    // Cells whose keys collide just share a bucket and cost extra comparisons.
+    std::uint64_t CellKey(std::int64_t x, std::int64_t y, std::int64_t z)
+    {
+        return std::uint64_t(x)*0x9E3779B97F4A7C15ull ^
+               std::uint64_t(y)*0xC2B2AE3D27D4EB4Full ^
+               std::uint64_t(z)*0x165667B19E3779F9ull;
+    }
+
+    // With a zero epsilon every distinct position is its own cell.  Adding 0.0f
+    // turns -0 into +0 so both land in the same cell.
+    std::int64_t ExactCell(float f)
+    {
+        f += 0.0f;
+        std::uint32_t bits;
+        std::memcpy(&bits, &f, sizeof(bits));
+        return bits;
+    }
+}
+
 GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions)
 {
     MeshData meshData;
@@ -655,3 +704,165 @@ GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, floa
 
     return meshData;
 }
+
+GeometryGenerator::MeshData GeometryGenerator::LoadModel(const std::string& filename, float weldEpsilon, WeldStats* stats)
+{
+    if(stats != nullptr)
+        *stats = WeldStats();
+
+    std::ifstream fin(filename);
+    if(!fin)
+        return MeshData();
+
+    uint32 vcount = 0;
+    uint32 tcount = 0;
+    std::string ignore;
+
+    fin >> ignore >> vcount;
+    fin >> ignore >> tcount;
+    fin >> ignore >> ignore >> ignore >> ignore;
+
+    MeshData meshData;
+    meshData.Vertices.resize(vcount);
+    for(uint32 i = 0; i < vcount; ++i)
+    {
+        Vertex& v = meshData.Vertices[i];
+        fin >> v.Position.x >> v.Position.y >> v.Position.z;
+        fin >> v.Normal.x >> v.Normal.y >> v.Normal.z;
+
+        v.TangentU = XMFLOAT3(0.0f, 0.0f, 0.0f);
+        v.TexC = XMFLOAT2(0.0f, 0.0f);
+    }
+
+    fin >> ignore >> ignore >> ignore;
+
+    meshData.Indices32.resize(3*tcount);
+    for(uint32 i = 0; i < 3*tcount; ++i)
+        fin >> meshData.Indices32[i];
+
+    // A truncated file or an index past the vertex list would read garbage later.
+    if(!fin)
+        return MeshData();
+    for(uint32 index : meshData.Indices32)
+    {
+        if(index >= vcount)
+            return MeshData();
+    }
+
+    WeldStats weldStats = WeldVertices(meshData, weldEpsilon);
+    if(stats != nullptr)
+        *stats = weldStats;
+
+    // The files carry no tangents; build them so normal mapped shaders can use the model.
+    TangentSpace::ComputeTangents(meshData);
+
+    return meshData;
+}
+
+GeometryGenerator::WeldStats GeometryGenerator::WeldVertices(MeshData& meshData, float epsilon)
+{
+    const uint32 vertexCount = (uint32)meshData.Vertices.size();
+
+    WeldStats stats;
+    stats.VerticesBefore = vertexCount;
+
+    //
+    // Spatial hash over positions.  Each cell maps to the most recently kept vertex
+    // inside it and next[] chains to the others.  Cells are 4*epsilon wide, so the
+    // epsilon box around a position touches at most two cells per axis.
+    //
+
+    std::vector<Vertex> welded;
+    std::vector<uint32> next;
+    std::vector<uint32> remap(vertexCount);
+    std::unordered_map<std::uint64_t, uint32> cellHead;
+    welded.reserve(vertexCount);
+    next.reserve(vertexCount);
+    cellHead.reserve(vertexCount);
+
+    epsilon = std::max(epsilon, 0.0f);
+    const float invCellSize = epsilon > 0.0f ? 0.25f/epsilon : 0.0f;
+
+    auto cellOf = [&](float f) -> std::int64_t
+    {
+        return epsilon > 0.0f ? (std::int64_t)std::floor(f*invCellSize) : ExactCell(f);
+    };
+
+    auto findInCell = [&](std::uint64_t key, const Vertex& v) -> uint32
+    {
+        auto it = cellHead.find(key);
+        if(it == cellHead.end())
+            return NoVertex;
+
+        for(uint32 w = it->second; w != NoVertex; w = next[w])
+        {
+            if(NearlyEqual(welded[w], v, epsilon))
+                return w;
+        }
+        return NoVertex;
+    };
+
+    for(uint32 i = 0; i < vertexCount; ++i)
+    {
+        const Vertex& v = meshData.Vertices[i];
+        const XMFLOAT3& p = v.Position;
+
+        uint32 match = NoVertex;
+        if(epsilon > 0.0f)
+        {
+            const std::int64_t x0 = cellOf(p.x - epsilon), x1 = cellOf(p.x + epsilon);
+            const std::int64_t y0 = cellOf(p.y - epsilon), y1 = cellOf(p.y + epsilon);
+            const std::int64_t z0 = cellOf(p.z - epsilon), z1 = cellOf(p.z + epsilon);
+
+            for(std::int64_t x = x0; x <= x1 && match == NoVertex; ++x)
+                for(std::int64_t y = y0; y <= y1 && match == NoVertex; ++y)
+                    for(std::int64_t z = z0; z <= z1 && match == NoVertex; ++z)
+                        match = findInCell(CellKey(x, y, z), v);
+        }
+        else
+        {
+            match = findInCell(CellKey(cellOf(p.x), cellOf(p.y), cellOf(p.z)), v);
+        }
+
+        if(match == NoVertex)
+        {
+            // First vertex of its kind; later duplicates collapse onto it, so the
+            // welded vertices keep the order they first appear in.
+            match = (uint32)welded.size();
+            welded.push_back(v);
+
+            auto head = cellHead.emplace(CellKey(cellOf(p.x), cellOf(p.y), cellOf(p.z)), match);
+            next.push_back(head.second ? NoVertex : head.first->second);
+            head.first->second = match;
+        }
+
+        remap[i] = match;
+    }
+
+    // Remap the triangles and drop the ones that welding collapsed.
+    MeshData result;
+    result.Vertices = std::move(welded);
+    result.Indices32.reserve(meshData.Indices32.size());
+    for(size_t t = 0; t + 2 < meshData.Indices32.size(); t += 3)
+    {
+        uint32 i0 = remap[meshData.Indices32[t + 0]];
+        uint32 i1 = remap[meshData.Indices32[t + 1]];
+        uint32 i2 = remap[meshData.Indices32[t + 2]];
+
+        if(i0 == i1 || i1 == i2 || i2 == i0)
+        {
+            ++stats.TrianglesRemoved;
+            continue;
+        }
+
+        result.Indices32.push_back(i0);
+        result.Indices32.push_back(i1);
+        result.Indices32.push_back(i2);
+    }
+
+    stats.VerticesAfter = (uint32)result.Vertices.size();
+
+    // Assigning a fresh MeshData also drops any stale 16-bit index copy.
+    meshData = std::move(result);
+    return stats;
+}
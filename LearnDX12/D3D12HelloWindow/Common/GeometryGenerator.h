@@ -16,6 +16,7 @@
 
 #include <cstdint>
 #include <DirectXMath.h>
+#include <string>
 #include <vector>
 
 class GeometryGenerator
@@ -74,6 +75,13 @@ public:
 		std::vector<uint16> mIndices16;
 	};
 
+    struct WeldStats
+    {
+        uint32 VerticesBefore = 0;
+        uint32 VerticesAfter = 0;
+        uint32 TrianglesRemoved = 0;
+    };
+
 	///<summary>
 	/// Creates a box centered at the origin with the given dimensions, where each
     /// face has m rows and n columns of vertices.
@@ -110,6 +118,21 @@ public:
 	///</summary>
     MeshData CreateQuad(float x, float y, float w, float h, float depth);
 
+	///<summary>
+	/// Loads a model in the book's text format (VertexCount/TriangleCount header, a
+	/// "pos, normal" VertexList and a TriangleList) and welds duplicate vertices with
+	/// WeldVertices.  Tangents are generated with TangentSpace::ComputeTangents.
+	/// Returns an empty mesh if the file cannot be opened.
+	///</summary>
+    MeshData LoadModel(const std::string& filename, float weldEpsilon = 1e-5f, WeldStats* stats = nullptr);
+
+	///<summary>
+	/// Merges vertices whose position, normal, tangent and texture coordinates all lie
+	/// within epsilon of each other and remaps the indices.  Triangles that collapse
+	/// are removed.  An epsilon of zero only merges exact copies.
+	///</summary>
+    WeldStats WeldVertices(MeshData& meshData, float epsilon);
+
 private:
 	void Subdivide(MeshData& meshData);
     Vertex MidPoint(const Vertex& v0, const Vertex& v1);
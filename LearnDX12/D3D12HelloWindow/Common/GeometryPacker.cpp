@@ -0,0 +1,150 @@
+//***************************************************************************************
+// GeometryPacker.cpp
+//***************************************************************************************
+
+#include "GeometryPacker.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+    // Vertices or indices per parallel job.  Small meshes become one job each.
+    const GeometryGenerator::uint32 JobSize = 16*1024;
+
+    std::uint32_t AttributeByteSize(VertexAttribute attribute)
+    {
+        switch(attribute)
+        {
+        case VertexAttribute::Position:
+        case VertexAttribute::Normal:
+        case VertexAttribute::TangentU:
+            return sizeof(XMFLOAT3);
+        case VertexAttribute::TexC:
+            return sizeof(XMFLOAT2);
+        case VertexAttribute::Color:
+            return sizeof(XMFLOAT4);
+        }
+        return 0;
+    }
+
+    struct Job
+    {
+        size_t Submesh;
+        GeometryGenerator::uint32 First;
+        GeometryGenerator::uint32 Count;
+        bool Indices;
+    };
+}
+
+GeometryPacker::GeometryPacker(const std::vector<VertexElement>& layout, uint32 vertexByteStride) :
+    mLayout(layout),
+    mVertexByteStride(vertexByteStride)
+{
+    for(const auto& e : mLayout)
+    {
+        assert(e.ByteOffset + AttributeByteSize(e.Attribute) <= mVertexByteStride);
+        (void)e;
+    }
+}
+
+void GeometryPacker::Add(const std::string& name, const MeshData& mesh, const XMFLOAT4& color)
+{
+    Submesh submesh;
+    submesh.Name = name;
+    submesh.Mesh = &mesh;
+    submesh.Color = color;
+    submesh.IndexCount = (uint32)mesh.Indices32.size();
+    submesh.StartIndexLocation = mIndexCount;
+    submesh.BaseVertexLocation = (std::int32_t)mVertexCount;
+
+    mVertexCount += (uint32)mesh.Vertices.size();
+    mIndexCount += (uint32)mesh.Indices32.size();
+    mMaxMeshVertexCount = std::max(mMaxMeshVertexCount, (uint32)mesh.Vertices.size());
+
+    mSubmeshes.push_back(std::move(submesh));
+}
+
+void GeometryPacker::Write(void* vertexData, void* indexData, ThreadPool& pool)const
+{
+    std::uint8_t* vb = static_cast<std::uint8_t*>(vertexData);
+    std::uint8_t* ib = static_cast<std::uint8_t*>(indexData);
+    const bool use16 = Use16BitIndices();
+
+    // Split every mesh into vertex and index ranges so large meshes spread across
+    // threads while many small meshes still batch well.
+    std::vector<Job> jobs;
+    jobs.reserve(mSubmeshes.size()*2);
+    for(size_t s = 0; s < mSubmeshes.size(); ++s)
+    {
+        const uint32 vertexCount = (uint32)mSubmeshes[s].Mesh->Vertices.size();
+        for(uint32 first = 0; first < vertexCount; first += JobSize)
+            jobs.push_back({ s, first, std::min(JobSize, vertexCount - first), false });
+
+        const uint32 indexCount = mSubmeshes[s].IndexCount;
+        for(uint32 first = 0; first < indexCount; first += JobSize)
+            jobs.push_back({ s, first, std::min(JobSize, indexCount - first), true });
+    }
+
+    pool.ParallelFor(jobs.size(), 1, [&](size_t begin, size_t end)
+    {
+        for(size_t j = begin; j < end; ++j)
+        {
+            const Job& job = jobs[j];
+            const Submesh& submesh = mSubmeshes[job.Submesh];
+            const MeshData& mesh = *submesh.Mesh;
+
+            if(job.Indices)
+            {
+                const uint32* src = mesh.Indices32.data() + job.First;
+                size_t dstIndex = size_t(submesh.StartIndexLocation) + job.First;
+
+                if(use16)
+                {
+                    auto dst = reinterpret_cast<std::uint16_t*>(ib) + dstIndex;
+                    for(uint32 i = 0; i < job.Count; ++i)
+                        dst[i] = static_cast<std::uint16_t>(src[i]);
+                }
+                else
+                {
+                    std::memcpy(reinterpret_cast<uint32*>(ib) + dstIndex, src, job.Count*sizeof(uint32));
+                }
+                continue;
+            }
+
+            const GeometryGenerator::Vertex* src = mesh.Vertices.data() + job.First;
+            std::uint8_t* dst = vb + (size_t(submesh.BaseVertexLocation) + job.First)*mVertexByteStride;
+
+            // One strided sweep per element keeps the inner loop branch free.
+            for(const auto& e : mLayout)
+            {
+                std::uint8_t* out = dst + e.ByteOffset;
+                switch(e.Attribute)
+                {
+                case VertexAttribute::Position:
+                    for(uint32 i = 0; i < job.Count; ++i, out += mVertexByteStride)
+                        std::memcpy(out, &src[i].Position, sizeof(XMFLOAT3));
+                    break;
+                case VertexAttribute::Normal:
+                    for(uint32 i = 0; i < job.Count; ++i, out += mVertexByteStride)
+                        std::memcpy(out, &src[i].Normal, sizeof(XMFLOAT3));
+                    break;
+                case VertexAttribute::TangentU:
+                    for(uint32 i = 0; i < job.Count; ++i, out += mVertexByteStride)
+                        std::memcpy(out, &src[i].TangentU, sizeof(XMFLOAT3));
+                    break;
+                case VertexAttribute::TexC:
+                    for(uint32 i = 0; i < job.Count; ++i, out += mVertexByteStride)
+                        std::memcpy(out, &src[i].TexC, sizeof(XMFLOAT2));
+                    break;
+                case VertexAttribute::Color:
+                    for(uint32 i = 0; i < job.Count; ++i, out += mVertexByteStride)
+                        std::memcpy(out, &submesh.Color, sizeof(XMFLOAT4));
+                    break;
+                }
+            }
+        }
+    });
+}
@@ -0,0 +1,92 @@
+//***************************************************************************************
+// GeometryPacker.h
+//
+// Packs any number of named GeometryGenerator::MeshData into one vertex buffer and one
+// index buffer with a caller supplied vertex layout, replacing the hand written offset
+// bookkeeping and per-mesh copy loops of the samples' Build*Geometry functions.
+//
+// Usage:
+//   GeometryPacker packer({ {VertexAttribute::Position, offsetof(Vertex, Pos)},
+//                           {VertexAttribute::Normal, offsetof(Vertex, Normal)} }, sizeof(Vertex));
+//   packer.Add("box", box);
+//   packer.Add("grid", grid);
+//   BuildMeshGeometry(device, cmdList, packer, *geo);     // MeshGeometryBuilder.h
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include "ThreadPool.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class VertexAttribute
+{
+    Position,   // float3
+    Normal,     // float3
+    TangentU,   // float3
+    TexC,       // float2
+    Color       // float4, constant per mesh
+};
+
+struct VertexElement
+{
+    VertexAttribute Attribute;
+    std::uint32_t ByteOffset;
+};
+
+class GeometryPacker
+{
+public:
+    using MeshData = GeometryGenerator::MeshData;
+    using uint32 = GeometryGenerator::uint32;
+
+    struct Submesh
+    {
+        std::string Name;
+        const MeshData* Mesh = nullptr;
+        DirectX::XMFLOAT4 Color;
+
+        uint32 IndexCount = 0;
+        uint32 StartIndexLocation = 0;
+        std::int32_t BaseVertexLocation = 0;
+    };
+
+    GeometryPacker(const std::vector<VertexElement>& layout, uint32 vertexByteStride);
+
+    ///<summary>
+    /// Appends a mesh.  Only a pointer is kept, so the mesh must outlive Write().
+    /// color fills the VertexAttribute::Color element, if the layout has one.
+    ///</summary>
+    void Add(const std::string& name, const MeshData& mesh,
+        const DirectX::XMFLOAT4& color = DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f));
+
+    uint32 VertexCount()const { return mVertexCount; }
+    uint32 IndexCount()const { return mIndexCount; }
+    uint32 VertexByteStride()const { return mVertexByteStride; }
+    uint32 VertexBufferByteSize()const { return mVertexCount*mVertexByteStride; }
+    uint32 IndexBufferByteSize()const { return mIndexCount*(Use16BitIndices() ? 2 : 4); }
+
+    // Indices are relative to BaseVertexLocation, so 16-bit indices work whenever
+    // every single mesh has at most 65536 vertices.
+    bool Use16BitIndices()const { return mMaxMeshVertexCount <= 0x10000; }
+
+    const std::vector<Submesh>& Submeshes()const { return mSubmeshes; }
+
+    ///<summary>
+    /// Extracts the layout's attributes of every mesh straight into vertexData and
+    /// converts the indices into indexData, in one pass spread over the pool.  The
+    /// destinations must hold VertexBufferByteSize() and IndexBufferByteSize() bytes.
+    ///</summary>
+    void Write(void* vertexData, void* indexData, ThreadPool& pool = ThreadPool::Default())const;
+
+private:
+    std::vector<VertexElement> mLayout;
+    uint32 mVertexByteStride = 0;
+
+    std::vector<Submesh> mSubmeshes;
+    uint32 mVertexCount = 0;
+    uint32 mIndexCount = 0;
+    uint32 mMaxMeshVertexCount = 0;
+};
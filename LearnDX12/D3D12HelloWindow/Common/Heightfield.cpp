@@ -0,0 +1,434 @@
+//***************************************************************************************
+// Heightfield.cpp
+//***************************************************************************************
+
+#include "Heightfield.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+    XMFLOAT3 NormalFromSlopes(float dydx, float dydz)
+    {
+        XMFLOAT3 n(-dydx, 1.0f, -dydz);
+        XMVECTOR unitNormal = XMVector3Normalize(XMLoadFloat3(&n));
+        XMStoreFloat3(&n, unitNormal);
+        return n;
+    }
+
+    //
+    // sin and cos of four angles at once.
+    //
+    // The angle is reduced to r in [-pi/4, pi/4] by subtracting k*pi/2, with pi/2
+    // split in three (Cody-Waite) so the reduction stays exact for |k| < 2^16.  On
+    // that interval the Taylor polynomials below (degree 9 for sin, 10 for cos) are
+    // within 2e-9 of the true values, and the quadrant k mod 4 picks and negates them.
+    //
+    // Measured against double precision the results are within 9e-8 for
+    // |angle| <= 8000, against 3.3e-8 for sinf/cosf.
+    //
+    void SinCosEst(XMVECTOR* sinOut, XMVECTOR* cosOut, FXMVECTOR angle)
+    {
+        const XMVECTOR twoOverPi = XMVectorReplicate(0.63661977236758134f);
+        const XMVECTOR piOver2A = XMVectorReplicate(1.5703125f);
+        const XMVECTOR piOver2B = XMVectorReplicate(4.837512969970703125e-4f);
+        const XMVECTOR piOver2C = XMVectorReplicate(7.54978995489188216e-8f);
+
+        XMVECTOR k = XMVectorRound(XMVectorMultiply(angle, twoOverPi));
+        XMVECTOR r = XMVectorNegativeMultiplySubtract(k, piOver2A, angle);
+        r = XMVectorNegativeMultiplySubtract(k, piOver2B, r);
+        r = XMVectorNegativeMultiplySubtract(k, piOver2C, r);
+
+        XMVECTOR r2 = XMVectorMultiply(r, r);
+
+        // sin(r) = r*(1 - r^2/3! + r^4/5! - r^6/7! + r^8/9!)
+        XMVECTOR s = XMVectorReplicate(2.7557319e-6f);
+        s = XMVectorMultiplyAdd(s, r2, XMVectorReplicate(-1.9841270e-4f));
+        s = XMVectorMultiplyAdd(s, r2, XMVectorReplicate(8.3333333e-3f));
+        s = XMVectorMultiplyAdd(s, r2, XMVectorReplicate(-1.6666667e-1f));
+        s = XMVectorMultiplyAdd(s, r2, XMVectorReplicate(1.0f));
+        s = XMVectorMultiply(s, r);
+
+        // cos(r) = 1 - r^2/2! + r^4/4! - ... - r^10/10!
+        XMVECTOR c = XMVectorReplicate(-2.7557319e-7f);
+        c = XMVectorMultiplyAdd(c, r2, XMVectorReplicate(2.4801587e-5f));
+        c = XMVectorMultiplyAdd(c, r2, XMVectorReplicate(-1.3888889e-3f));
+        c = XMVectorMultiplyAdd(c, r2, XMVectorReplicate(4.1666667e-2f));
+        c = XMVectorMultiplyAdd(c, r2, XMVectorReplicate(-0.5f));
+        c = XMVectorMultiplyAdd(c, r2, XMVectorReplicate(1.0f));
+
+        // Quadrant q = k mod 4:  sin = s, c, -s, -c  and  cos = c, -s, -c, s.
+        XMVECTOR q = XMVectorSubtract(k, XMVectorScale(XMVectorFloor(XMVectorScale(k, 0.25f)), 4.0f));
+        XMVECTOR odd = XMVectorEqual(XMVectorSubtract(q, XMVectorScale(XMVectorFloor(XMVectorScale(q, 0.5f)), 2.0f)),
+            XMVectorReplicate(1.0f));
+        XMVECTOR sinNegative = XMVectorGreaterOrEqual(q, XMVectorReplicate(2.0f));
+        XMVECTOR cosNegative = XMVectorAndInt(XMVectorGreaterOrEqual(q, XMVectorReplicate(1.0f)),
+            XMVectorLessOrEqual(q, XMVectorReplicate(2.0f)));
+
+        const XMVECTOR signBit = XMVectorReplicate(-0.0f);
+        *sinOut = XMVectorXorInt(XMVectorSelect(s, c, odd), XMVectorAndInt(sinNegative, signBit));
+        *cosOut = XMVectorXorInt(XMVectorSelect(c, s, odd), XMVectorAndInt(cosNegative, signBit));
+    }
+
+    // Calls func(x, z, out, lanes) for groups of four points.  The last group is
+    // padded through a local copy so func can always load and store whole vectors.
+    template<typename T, typename F>
+    void ForEachQuad(const float* x, const float* z, T* out, size_t count, F func)
+    {
+        size_t i = 0;
+        for(; i + 4 <= count; i += 4)
+            func(x + i, z + i, out + i, 4);
+
+        if(i < count)
+        {
+            float tx[4] = {};
+            float tz[4] = {};
+            T tout[4];
+            for(size_t j = i; j < count; ++j)
+            {
+                tx[j - i] = x[j];
+                tz[j - i] = z[j];
+            }
+            func(tx, tz, tout, count - i);
+            for(size_t j = i; j < count; ++j)
+                out[j] = tout[j - i];
+        }
+    }
+
+    XMVECTOR LoadQuad(const float* p)
+    {
+        return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p));
+    }
+}
+
+const size_t Heightfield::BatchGrain;
+const TiledHeightmap::uint32 TiledHeightmap::TileCursor::Size;
+
+XMFLOAT3 Heightfield::Normal(float x, float z)const
+{
+    float d = SampleSpacing();
+    float dydx = (Height(x + d, z) - Height(x - d, z)) / (2.0f*d);
+    float dydz = (Height(x, z + d) - Height(x, z - d)) / (2.0f*d);
+    return NormalFromSlopes(dydx, dydz);
+}
+
+void Heightfield::Heights(const float* x, const float* z, float* y, size_t count, ThreadPool& pool)const
+{
+    pool.ParallelFor(count, BatchGrain, [=](size_t begin, size_t end)
+    {
+        HeightsSerial(x + begin, z + begin, y + begin, end - begin);
+    });
+}
+
+void Heightfield::Normals(const float* x, const float* z, XMFLOAT3* n, size_t count, ThreadPool& pool)const
+{
+    pool.ParallelFor(count, BatchGrain, [=](size_t begin, size_t end)
+    {
+        NormalsSerial(x + begin, z + begin, n + begin, end - begin);
+    });
+}
+
+void Heightfield::HeightsSerial(const float* x, const float* z, float* y, size_t count)const
+{
+    for(size_t i = 0; i < count; ++i)
+        y[i] = Height(x[i], z[i]);
+}
+
+void Heightfield::NormalsSerial(const float* x, const float* z, XMFLOAT3* n, size_t count)const
+{
+    for(size_t i = 0; i < count; ++i)
+        n[i] = Normal(x[i], z[i]);
+}
+
+float HillsHeightfield::Height(float x, float z)const
+{
+    return 0.3f*(z*sinf(0.1f*x) + x*cosf(0.1f*z));
+}
+
+XMFLOAT3 HillsHeightfield::Normal(float x, float z)const
+{
+    // n = (-df/dx, 1, -df/dz)
+    float dydx = 0.03f*z*cosf(0.1f*x) + 0.3f*cosf(0.1f*z);
+    float dydz = 0.3f*sinf(0.1f*x) - 0.03f*x*sinf(0.1f*z);
+    return NormalFromSlopes(dydx, dydz);
+}
+
+void HillsHeightfield::HeightsSerial(const float* x, const float* z, float* y, size_t count)const
+{
+    ForEachQuad(x, z, y, count, [](const float* px, const float* pz, float* py, size_t lanes)
+    {
+        XMVECTOR vx = LoadQuad(px);
+        XMVECTOR vz = LoadQuad(pz);
+
+        XMVECTOR sinX, cosX, sinZ, cosZ;
+        SinCosEst(&sinX, &cosX, XMVectorScale(vx, 0.1f));
+        SinCosEst(&sinZ, &cosZ, XMVectorScale(vz, 0.1f));
+
+        XMVECTOR h = XMVectorMultiplyAdd(vz, sinX, XMVectorMultiply(vx, cosZ));
+        h = XMVectorScale(h, 0.3f);
+
+        if(lanes == 4)
+        {
+            XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(py), h);
+        }
+        else
+        {
+            XMFLOAT4 tmp;
+            XMStoreFloat4(&tmp, h);
+            const float* t = &tmp.x;
+            for(size_t l = 0; l < lanes; ++l)
+                py[l] = t[l];
+        }
+    });
+}
+
+void HillsHeightfield::NormalsSerial(const float* x, const float* z, XMFLOAT3* n, size_t count)const
+{
+    ForEachQuad(x, z, n, count, [](const float* px, const float* pz, XMFLOAT3* pn, size_t lanes)
+    {
+        XMVECTOR vx = LoadQuad(px);
+        XMVECTOR vz = LoadQuad(pz);
+
+        XMVECTOR sinX, cosX, sinZ, cosZ;
+        SinCosEst(&sinX, &cosX, XMVectorScale(vx, 0.1f));
+        SinCosEst(&sinZ, &cosZ, XMVectorScale(vz, 0.1f));
+
+        // Slopes as in Normal(), four points per lane.
+        XMVECTOR dydx = XMVectorMultiplyAdd(XMVectorScale(vz, 0.03f), cosX, XMVectorScale(cosZ, 0.3f));
+        XMVECTOR dydz = XMVectorNegativeMultiplySubtract(XMVectorScale(vx, 0.03f), sinZ, XMVectorScale(sinX, 0.3f));
+
+        XMVECTOR lengthSq = XMVectorMultiplyAdd(dydx, dydx, XMVectorMultiplyAdd(dydz, dydz, XMVectorReplicate(1.0f)));
+        XMVECTOR invLength = XMVectorReciprocalSqrt(lengthSq);
+
+        XMFLOAT4 nx, ny, nz;
+        XMStoreFloat4(&nx, XMVectorNegate(XMVectorMultiply(dydx, invLength)));
+        XMStoreFloat4(&ny, invLength);
+        XMStoreFloat4(&nz, XMVectorNegate(XMVectorMultiply(dydz, invLength)));
+
+        const float* sx = &nx.x;
+        const float* sy = &ny.x;
+        const float* sz = &nz.x;
+        for(size_t l = 0; l < lanes; ++l)
+            pn[l] = XMFLOAT3(sx[l], sy[l], sz[l]);
+    });
+}
+
+bool TiledHeightmap::Open(const HeightmapDesc& desc)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTiles.clear();
+        mLru.clear();
+    }
+    mTileLoads = 0;
+    mDesc = desc;
+    mDesc.TileSize = std::max(desc.TileSize, 2u);
+    mDesc.MaxCachedTiles = std::max(desc.MaxCachedTiles, 4u);
+
+    if(!mFile.Open(desc.Path))
+        return false;
+
+    const std::uint64_t sampleCount = mFile.Size() / sizeof(std::uint16_t);
+    if(mDesc.Width == 0 && mDesc.Height == 0)
+    {
+        if(mDesc.Tiled)
+        {
+            // Only whole tiles are stored, so the exact size must be given.
+            mFile.Close();
+            return false;
+        }
+        mDesc.Width = mDesc.Height = (uint32)std::sqrt((double)sampleCount);
+    }
+    if(mDesc.Width < 2 || mDesc.Height < 2)
+    {
+        mFile.Close();
+        return false;
+    }
+
+    mTilesX = (mDesc.Width + mDesc.TileSize - 1) / mDesc.TileSize;
+    mTilesZ = (mDesc.Height + mDesc.TileSize - 1) / mDesc.TileSize;
+
+    std::uint64_t required = mDesc.Tiled ?
+        (std::uint64_t)mTilesX*mTilesZ*mDesc.TileSize*mDesc.TileSize :
+        (std::uint64_t)mDesc.Width*mDesc.Height;
+    if(sampleCount < required)
+    {
+        mFile.Close();
+        return false;
+    }
+
+    return true;
+}
+
+float TiledHeightmap::WorldSize()const
+{
+    return (std::max(mDesc.Width, mDesc.Height) - 1)*mDesc.SampleSpacing;
+}
+
+TiledHeightmap::uint32 TiledHeightmap::CachedTileCount()const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return (uint32)mTiles.size();
+}
+
+TiledHeightmap::TilePtr TiledHeightmap::DecodeTile(uint32 tileX, uint32 tileZ)const
+{
+    const uint32 T = mDesc.TileSize;
+    const uint32 col0 = tileX*T;
+    const uint32 row0 = tileZ*T;
+    const uint32 cols = std::min(T, mDesc.Width - col0);
+    const uint32 rows = std::min(T, mDesc.Height - row0);
+    const float scale = mDesc.HeightRange / 65535.0f;
+
+    auto heights = std::make_shared<std::vector<float>>((size_t)T*T, 0.0f);
+    const std::uint8_t* base = mFile.Data();
+
+    for(uint32 r = 0; r < rows; ++r)
+    {
+        std::uint64_t first = mDesc.Tiled ?
+            ((std::uint64_t)tileZ*mTilesX + tileX)*T*T + (std::uint64_t)r*T :
+            (std::uint64_t)(row0 + r)*mDesc.Width + col0;
+
+        const std::uint8_t* src = base + first*sizeof(std::uint16_t);
+        float* dst = heights->data() + (size_t)r*T;
+        for(uint32 c = 0; c < cols; ++c)
+        {
+            // Little-endian regardless of the host.
+            std::uint16_t s = (std::uint16_t)(src[2*c] | (src[2*c + 1] << 8));
+            dst[c] = mDesc.HeightOffset + s*scale;
+        }
+    }
+
+    ++mTileLoads;
+    return heights;
+}
+
+TiledHeightmap::TilePtr TiledHeightmap::FetchTile(uint32 tileX, uint32 tileZ)const
+{
+    const uint32 id = tileZ*mTilesX + tileX;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mTiles.find(id);
+        if(it != mTiles.end())
+        {
+            mLru.splice(mLru.begin(), mLru, it->second.second);
+            return it->second.first;
+        }
+    }
+
+    // Decode outside the lock so other threads keep sampling resident tiles.  Two
+    // threads may decode the same tile; the second result is simply dropped.
+    TilePtr tile = DecodeTile(tileX, tileZ);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mTiles.find(id);
+    if(it != mTiles.end())
+    {
+        mLru.splice(mLru.begin(), mLru, it->second.second);
+        return it->second.first;
+    }
+
+    while(mTiles.size() >= mDesc.MaxCachedTiles)
+    {
+        // Evicted tiles stay alive for samplers still holding them.
+        mTiles.erase(mLru.back());
+        mLru.pop_back();
+    }
+
+    mLru.push_front(id);
+    mTiles.emplace(id, std::make_pair(tile, mLru.begin()));
+    return tile;
+}
+
+float TiledHeightmap::Sample(uint32 col, uint32 row, TileCursor& cursor)const
+{
+    const uint32 T = mDesc.TileSize;
+    uint32 tx = col / T;
+    uint32 tz = row / T;
+    uint32 id = tz*mTilesX + tx;
+
+    const std::vector<float>* tile = nullptr;
+    for(uint32 i = 0; i < TileCursor::Size; ++i)
+    {
+        if(cursor.Tiles[i] != nullptr && cursor.Ids[i] == id)
+        {
+            tile = cursor.Tiles[i].get();
+            break;
+        }
+    }
+
+    if(tile == nullptr)
+    {
+        const uint32 i = cursor.Next;
+        cursor.Next = (cursor.Next + 1) % TileCursor::Size;
+        cursor.Tiles[i] = FetchTile(tx, tz);
+        cursor.Ids[i] = id;
+        tile = cursor.Tiles[i].get();
+    }
+    return (*tile)[(size_t)(row - tz*T)*T + (col - tx*T)];
+}
+
+float TiledHeightmap::Height(float x, float z)const
+{
+    TileCursor cursor;
+    return Height(x, z, cursor);
+}
+
+XMFLOAT3 TiledHeightmap::Normal(float x, float z)const
+{
+    TileCursor cursor;
+    return Normal(x, z, cursor);
+}
+
+void TiledHeightmap::HeightsSerial(const float* x, const float* z, float* y, size_t count)const
+{
+    TileCursor cursor;
+    for(size_t i = 0; i < count; ++i)
+        y[i] = Height(x[i], z[i], cursor);
+}
+
+void TiledHeightmap::NormalsSerial(const float* x, const float* z, XMFLOAT3* n, size_t count)const
+{
+    TileCursor cursor;
+    for(size_t i = 0; i < count; ++i)
+        n[i] = Normal(x[i], z[i], cursor);
+}
+
+float TiledHeightmap::Height(float x, float z, TileCursor& cursor)const
+{
+    if(!mFile.IsOpen())
+        return 0.0f;
+
+    // Sample (0, 0) is the -x, -z corner.
+    const float invSpacing = 1.0f / mDesc.SampleSpacing;
+    float u = x*invSpacing + 0.5f*(mDesc.Width - 1);
+    float v = z*invSpacing + 0.5f*(mDesc.Height - 1);
+    u = std::min(std::max(u, 0.0f), (float)(mDesc.Width - 1));
+    v = std::min(std::max(v, 0.0f), (float)(mDesc.Height - 1));
+
+    uint32 c0 = std::min((uint32)u, mDesc.Width - 2);
+    uint32 r0 = std::min((uint32)v, mDesc.Height - 2);
+    float fu = u - c0;
+    float fv = v - r0;
+
+    float h00 = Sample(c0, r0, cursor);
+    float h10 = Sample(c0 + 1, r0, cursor);
+    float h01 = Sample(c0, r0 + 1, cursor);
+    float h11 = Sample(c0 + 1, r0 + 1, cursor);
+
+    float h0 = h00 + (h10 - h00)*fu;
+    float h1 = h01 + (h11 - h01)*fu;
+    return h0 + (h1 - h0)*fv;
+}
+
+XMFLOAT3 TiledHeightmap::Normal(float x, float z, TileCursor& cursor)const
+{
+    // As Heightfield::Normal(), with the four heights sharing the cursor.
+    float d = SampleSpacing();
+    float dydx = (Height(x + d, z, cursor) - Height(x - d, z, cursor)) / (2.0f*d);
+    float dydz = (Height(x, z + d, cursor) - Height(x, z - d, cursor)) / (2.0f*d);
+    return NormalFromSlopes(dydx, dydz);
+}
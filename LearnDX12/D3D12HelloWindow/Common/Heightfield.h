@@ -0,0 +1,178 @@
+//***************************************************************************************
+// Heightfield.h
+//
+// Height sources for terrain.  HillsHeightfield is the book's analytic hills function;
+// TiledHeightmap samples a 16-bit raw heightmap through a memory mapping, decoding
+// only the tiles that are touched into a small LRU cache, so even multi-gigabyte maps
+// open instantly and keep a flat memory footprint.
+//
+// Besides the point queries every heightfield answers batches of points, which are
+// split across the thread pool.  HillsHeightfield evaluates its batches four points
+// at a time with polynomial sin/cos instead of calling sinf/cosf per point.
+//
+// Implementations are safe to sample from several threads at once.
+//***************************************************************************************
+
+#pragma once
+
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include <DirectXMath.h>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Heightfield
+{
+public:
+    virtual ~Heightfield() = default;
+
+    virtual float Height(float x, float z)const = 0;
+
+    // Unit surface normal.  The default takes central differences one
+    // SampleSpacing() apart.
+    virtual DirectX::XMFLOAT3 Normal(float x, float z)const;
+
+    // Distance between the samples the heights come from.
+    virtual float SampleSpacing()const = 0;
+
+    // Edge length of the square, origin centered area that has data; 0 if unbounded.
+    virtual float WorldSize()const { return 0.0f; }
+
+    ///<summary>
+    /// y[i] = Height(x[i], z[i]) for count points.  Batches larger than BatchGrain
+    /// are spread over the pool; smaller ones run on the calling thread.
+    ///</summary>
+    void Heights(const float* x, const float* z, float* y, size_t count,
+        ThreadPool& pool = ThreadPool::Default())const;
+
+    ///<summary>
+    /// n[i] = Normal(x[i], z[i]) for count points, split like Heights().
+    ///</summary>
+    void Normals(const float* x, const float* z, DirectX::XMFLOAT3* n, size_t count,
+        ThreadPool& pool = ThreadPool::Default())const;
+
+    static const size_t BatchGrain = 8192;
+
+protected:
+    // One slice of a batch, on the calling thread.  The defaults loop over the point
+    // queries; override them when the heights can be computed several at a time.
+    virtual void HeightsSerial(const float* x, const float* z, float* y, size_t count)const;
+    virtual void NormalsSerial(const float* x, const float* z, DirectX::XMFLOAT3* n, size_t count)const;
+};
+
+// y = 0.3*(z*sin(0.1*x) + x*cos(0.1*z)), with its exact normal.
+//
+// The batch versions agree with the point versions to within 1e-7*(|x| + |z|) in
+// height and 5e-7 per normal component, for |x|, |z| up to 80000 (see SinCosEst).
+// The Heightfield benchmark checks both bounds.
+class HillsHeightfield : public Heightfield
+{
+public:
+    float Height(float x, float z)const override;
+    DirectX::XMFLOAT3 Normal(float x, float z)const override;
+    float SampleSpacing()const override { return 1.0f; }
+
+protected:
+    void HeightsSerial(const float* x, const float* z, float* y, size_t count)const override;
+    void NormalsSerial(const float* x, const float* z, DirectX::XMFLOAT3* n, size_t count)const override;
+};
+
+struct HeightmapDesc
+{
+    std::string Path;
+
+    // Samples per row and rows.  Leaving both zero assumes a square map and derives
+    // the size from the file size.
+    std::uint32_t Width = 0;
+    std::uint32_t Height = 0;
+
+    // File layout: false for plain rows of Width samples (the usual .raw/.r16 export),
+    // true for TileSize x TileSize tiles stored tile row by tile row, with the tiles
+    // on the right and bottom edges padded to full size.
+    bool Tiled = false;
+
+    // Samples per tile edge.  Tiles are also the unit of decoding and caching.
+    std::uint32_t TileSize = 256;
+    std::uint32_t MaxCachedTiles = 64;
+
+    // World units between samples.  The map is centered on the origin.
+    float SampleSpacing = 1.0f;
+
+    // Height = HeightOffset + sample/65535*HeightRange, samples little-endian uint16.
+    float HeightOffset = 0.0f;
+    float HeightRange = 100.0f;
+};
+
+class TiledHeightmap : public Heightfield
+{
+public:
+    using uint32 = std::uint32_t;
+
+    TiledHeightmap() = default;
+    TiledHeightmap(const TiledHeightmap& rhs) = delete;
+    TiledHeightmap& operator=(const TiledHeightmap& rhs) = delete;
+
+    // Maps the file; nothing is decoded yet.  Returns false if the file is missing
+    // or smaller than the described map.
+    bool Open(const HeightmapDesc& desc);
+
+    // Bilinear between the four nearest samples, clamped at the map borders.
+    float Height(float x, float z)const override;
+    DirectX::XMFLOAT3 Normal(float x, float z)const override;
+    float SampleSpacing()const override { return mDesc.SampleSpacing; }
+    float WorldSize()const override;
+
+    uint32 Width()const { return mDesc.Width; }
+    uint32 Rows()const { return mDesc.Height; }
+
+    // Tiles decoded so far, including ones decoded again after eviction.
+    uint32 TileLoads()const { return mTileLoads; }
+    uint32 CachedTileCount()const;
+
+protected:
+    // Keep the tiles between points, so a batch only goes through FetchTile() and
+    // its lock when it moves onto another tile.
+    void HeightsSerial(const float* x, const float* z, float* y, size_t count)const override;
+    void NormalsSerial(const float* x, const float* z, DirectX::XMFLOAT3* n, size_t count)const override;
+
+private:
+    using TilePtr = std::shared_ptr<const std::vector<float>>;
+
+    // The last tiles a run of samples touched; four cover a bilinear footprint on a
+    // tile corner.
+    struct TileCursor
+    {
+        static const uint32 Size = 4;
+
+        TilePtr Tiles[Size];
+        uint32 Ids[Size] = {};
+        uint32 Next = 0;
+    };
+
+    TilePtr FetchTile(uint32 tileX, uint32 tileZ)const;
+    TilePtr DecodeTile(uint32 tileX, uint32 tileZ)const;
+
+    // Height of one sample, from the cursor's tiles when it has the sample's tile.
+    float Sample(uint32 col, uint32 row, TileCursor& cursor)const;
+
+    float Height(float x, float z, TileCursor& cursor)const;
+    DirectX::XMFLOAT3 Normal(float x, float z, TileCursor& cursor)const;
+
+private:
+    HeightmapDesc mDesc;
+    MappedFile mFile;
+    uint32 mTilesX = 0;
+    uint32 mTilesZ = 0;
+
+    mutable std::mutex mMutex;
+    // Most recently used tile first.
+    mutable std::list<uint32> mLru;
+    mutable std::unordered_map<uint32, std::pair<TilePtr, std::list<uint32>::iterator>> mTiles;
+    mutable std::atomic<uint32> mTileLoads{0};
+};
@@ -0,0 +1,554 @@
+//***************************************************************************************
+// LightingModel.cpp
+//***************************************************************************************
+
+#include "LightingModel.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+// MSVC emits AVX code for AVX intrinsics without /arch:AVX, so the AVX path is built
+// there for x86 and x64 and taken when the CPU has AVX.  Other compilers only allow
+// AVX intrinsics when they target AVX, and then the CPU is known to have it.
+#if (defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))) || defined(__AVX__)
+#define LIGHTING_MODEL_AVX 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define LIGHTING_MODEL_AVX 0
+#endif
+
+using namespace DirectX;
+
+const size_t LightingModel::BatchSize;
+const size_t LightingModel::BatchGrain;
+
+namespace
+{
+    //
+    // Scalar helpers for the reference path, named after their HLSL counterparts.
+    //
+
+    XMFLOAT3 Sub(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z); }
+    XMFLOAT3 Add(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.x + b.x, a.y + b.y, a.z + b.z); }
+    XMFLOAT3 Mul(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.x * b.x, a.y * b.y, a.z * b.z); }
+    XMFLOAT3 Scale(const XMFLOAT3& a, float s) { return XMFLOAT3(a.x * s, a.y * s, a.z * s); }
+    float Dot(const XMFLOAT3& a, const XMFLOAT3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    float Length(const XMFLOAT3& a) { return std::sqrt(Dot(a, a)); }
+    XMFLOAT3 Normalize(const XMFLOAT3& a) { return Scale(a, 1.0f / Length(a)); }
+    float Saturate(float x) { return std::min(std::max(x, 0.0f), 1.0f); }
+
+    float CalcAttenuation(float d, float falloffStart, float falloffEnd)
+    {
+        // Linear falloff.
+        return Saturate((falloffEnd - d) / (falloffEnd - falloffStart));
+    }
+
+    XMFLOAT3 SchlickFresnel(const XMFLOAT3& R0, const XMFLOAT3& normal, const XMFLOAT3& lightVec)
+    {
+        float cosIncidentAngle = Saturate(Dot(normal, lightVec));
+        float f0 = 1.0f - cosIncidentAngle;
+        float f4 = f0 * f0 * f0 * f0;
+        return XMFLOAT3(R0.x + (1.0f - R0.x) * f4, R0.y + (1.0f - R0.y) * f4, R0.z + (1.0f - R0.z) * f4);
+    }
+
+    XMFLOAT3 BlinnPhong(const XMFLOAT3& lightStrength, const XMFLOAT3& lightVec, const XMFLOAT3& normal,
+        const XMFLOAT3& toEye, const ShadingMaterial& mat)
+    {
+        const float m = mat.Shininess * 256.0f;
+        XMFLOAT3 halfVec = Normalize(Add(toEye, lightVec));
+
+        float roughnessFactor = (m + 8.0f) * std::pow(std::max(Dot(halfVec, normal), 0.0f), m) / 8.0f;
+        XMFLOAT3 fresnelFactor = SchlickFresnel(mat.FresnelR0, halfVec, lightVec);
+
+        XMFLOAT3 specAlbedo = Scale(fresnelFactor, roughnessFactor);
+
+        // The spec formula goes outside [0,1].
+        specAlbedo = XMFLOAT3(specAlbedo.x / (specAlbedo.x + 1.0f), specAlbedo.y / (specAlbedo.y + 1.0f),
+            specAlbedo.z / (specAlbedo.z + 1.0f));
+
+        XMFLOAT3 diffuse(mat.DiffuseAlbedo.x, mat.DiffuseAlbedo.y, mat.DiffuseAlbedo.z);
+        return Mul(Add(diffuse, specAlbedo), lightStrength);
+    }
+
+    XMFLOAT3 ComputeDirectionalLight(const ShadingLight& L, const ShadingMaterial& mat, const XMFLOAT3& normal,
+        const XMFLOAT3& toEye)
+    {
+        XMFLOAT3 lightVec = Scale(L.Direction, -1.0f);
+        float ndotl = std::max(Dot(lightVec, normal), 0.0f);
+        XMFLOAT3 lightStrength = Scale(L.Strength, ndotl);
+        return BlinnPhong(lightStrength, lightVec, normal, toEye, mat);
+    }
+
+    XMFLOAT3 ComputePointLight(const ShadingLight& L, const ShadingMaterial& mat, const XMFLOAT3& pos,
+        const XMFLOAT3& normal, const XMFLOAT3& toEye)
+    {
+        XMFLOAT3 lightVec = Sub(L.Position, pos);
+        float d = Length(lightVec);
+        if(d > L.FalloffEnd)
+            return XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+        lightVec = Scale(lightVec, 1.0f / d);
+
+        float ndotl = std::max(Dot(normal, lightVec), 0.0f);
+        XMFLOAT3 lightStrength = Scale(L.Strength, ndotl);
+        lightStrength = Scale(lightStrength, CalcAttenuation(d, L.FalloffStart, L.FalloffEnd));
+
+        return BlinnPhong(lightStrength, lightVec, normal, toEye, mat);
+    }
+
+    // Like the shader, spot lights are not attenuated by distance.
+    XMFLOAT3 ComputeSpotLight(const ShadingLight& L, const ShadingMaterial& mat, const XMFLOAT3& pos,
+        const XMFLOAT3& normal, const XMFLOAT3& toEye)
+    {
+        XMFLOAT3 lightVec = Sub(L.Position, pos);
+        float d = Length(lightVec);
+        if(d > L.FalloffEnd)
+            return XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+        lightVec = Scale(lightVec, 1.0f / d);
+
+        float ndotl = std::max(Dot(normal, lightVec), 0.0f);
+        XMFLOAT3 lightStrength = Scale(L.Strength, ndotl);
+
+        float spotFactor = std::pow(std::max(-Dot(lightVec, L.Direction), 0.0f), L.SpotPower);
+        lightStrength = Scale(lightStrength, spotFactor);
+
+        return BlinnPhong(lightStrength, lightVec, normal, toEye, mat);
+    }
+
+    //
+    // log2 and exp2 of four values, for pow().
+    //
+    // Log2Est splits x into exponent and mantissa through the bit pattern, folds the
+    // mantissa into [sqrt(1/2), sqrt(2)) and sums the atanh series of ln to the t^9 term
+    // (truncation below 4e-10).  Exp2Est rounds y to an integer k, evaluates e^(f ln 2)
+    // for the remaining |f| <= 1/2 to degree 7 (below 6e-9) and scales by 2^k built in
+    // the exponent bits.  Both are within a few float ulps; y is clamped to [-126, 127]
+    // so 2^k stays a normal number.
+    //
+    XMVECTOR Log2Est(FXMVECTOR x)
+    {
+        const XMVECTOR exponentMask = XMVectorReplicateInt(0x7F800000);
+        const XMVECTOR mantissaMask = XMVectorReplicateInt(0x007FFFFF);
+        const XMVECTOR one = XMVectorReplicate(1.0f);
+
+        // Exponent field as a float: (bits & mask) / 2^23 converts exactly.
+        XMVECTOR e = XMConvertVectorIntToFloat(XMVectorAndInt(x, exponentMask), 23);
+        XMVECTOR m = XMVectorOrInt(XMVectorAndInt(x, mantissaMask), one);
+
+        XMVECTOR big = XMVectorGreater(m, XMVectorReplicate(1.41421356f));
+        m = XMVectorSelect(m, XMVectorScale(m, 0.5f), big);
+        e = XMVectorSelect(e, XMVectorAdd(e, one), big);
+
+        XMVECTOR t = XMVectorDivide(XMVectorSubtract(m, one), XMVectorAdd(m, one));
+        XMVECTOR t2 = XMVectorMultiply(t, t);
+
+        // ln(m) = 2 (t + t^3/3 + t^5/5 + t^7/7 + t^9/9)
+        XMVECTOR p = XMVectorReplicate(1.0f / 9.0f);
+        p = XMVectorMultiplyAdd(p, t2, XMVectorReplicate(1.0f / 7.0f));
+        p = XMVectorMultiplyAdd(p, t2, XMVectorReplicate(1.0f / 5.0f));
+        p = XMVectorMultiplyAdd(p, t2, XMVectorReplicate(1.0f / 3.0f));
+        p = XMVectorMultiplyAdd(p, t2, one);
+        XMVECTOR lnM = XMVectorScale(XMVectorMultiply(p, t), 2.0f);
+
+        // 2/ln(2) folded into the scale above would lose the exact exponent part.
+        return XMVectorMultiplyAdd(lnM, XMVectorReplicate(1.44269504f), XMVectorSubtract(e, XMVectorReplicate(127.0f)));
+    }
+
+    XMVECTOR Exp2Est(FXMVECTOR y)
+    {
+        XMVECTOR clamped = XMVectorMin(XMVectorMax(y, XMVectorReplicate(-126.0f)), XMVectorReplicate(127.0f));
+        XMVECTOR k = XMVectorRound(clamped);
+        XMVECTOR r = XMVectorScale(XMVectorSubtract(clamped, k), 0.69314718f);
+
+        XMVECTOR p = XMVectorReplicate(1.0f / 5040.0f);
+        p = XMVectorMultiplyAdd(p, r, XMVectorReplicate(1.0f / 720.0f));
+        p = XMVectorMultiplyAdd(p, r, XMVectorReplicate(1.0f / 120.0f));
+        p = XMVectorMultiplyAdd(p, r, XMVectorReplicate(1.0f / 24.0f));
+        p = XMVectorMultiplyAdd(p, r, XMVectorReplicate(1.0f / 6.0f));
+        p = XMVectorMultiplyAdd(p, r, XMVectorReplicate(0.5f));
+        p = XMVectorMultiplyAdd(p, r, XMVectorReplicate(1.0f));
+        p = XMVectorMultiplyAdd(p, r, XMVectorReplicate(1.0f));
+
+        // (k + 127) * 2^23 is the bit pattern of 2^k.
+        XMVECTOR scale = XMConvertVectorFloatToInt(XMVectorAdd(k, XMVectorReplicate(127.0f)), 23);
+        return XMVectorMultiply(p, scale);
+    }
+
+    // pow(max(x, 0), y) for y >= 0, with pow(0, 0) = 1 like std::pow.
+    XMVECTOR PowEst(FXMVECTOR x, FXMVECTOR y)
+    {
+        return Exp2Est(XMVectorMultiply(y, Log2Est(XMVectorMax(x, XMVectorReplicate(FLT_MIN)))));
+    }
+
+    //
+    // Eight float lanes as two DirectXMath vectors, which every x86 and ARM target has.
+    //
+    struct QuadFloat8
+    {
+        XMVECTOR lo;
+        XMVECTOR hi;
+
+        static QuadFloat8 Splat(float s) { XMVECTOR v = XMVectorReplicate(s); return { v, v }; }
+        static QuadFloat8 Load(const float* p) { return { XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p)), XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p + 4)) }; }
+    };
+
+    inline void Store(float* p, QuadFloat8 a) { XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(p), a.lo); XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(p + 4), a.hi); }
+
+    inline QuadFloat8 operator+(QuadFloat8 a, QuadFloat8 b) { return { XMVectorAdd(a.lo, b.lo), XMVectorAdd(a.hi, b.hi) }; }
+    inline QuadFloat8 operator-(QuadFloat8 a, QuadFloat8 b) { return { XMVectorSubtract(a.lo, b.lo), XMVectorSubtract(a.hi, b.hi) }; }
+    inline QuadFloat8 operator*(QuadFloat8 a, QuadFloat8 b) { return { XMVectorMultiply(a.lo, b.lo), XMVectorMultiply(a.hi, b.hi) }; }
+    inline QuadFloat8 operator/(QuadFloat8 a, QuadFloat8 b) { return { XMVectorDivide(a.lo, b.lo), XMVectorDivide(a.hi, b.hi) }; }
+
+    inline QuadFloat8 Min(QuadFloat8 a, QuadFloat8 b) { return { XMVectorMin(a.lo, b.lo), XMVectorMin(a.hi, b.hi) }; }
+    inline QuadFloat8 Max(QuadFloat8 a, QuadFloat8 b) { return { XMVectorMax(a.lo, b.lo), XMVectorMax(a.hi, b.hi) }; }
+    inline QuadFloat8 Sqrt(QuadFloat8 a) { return { XMVectorSqrt(a.lo), XMVectorSqrt(a.hi) }; }
+    inline QuadFloat8 LessOrEqual(QuadFloat8 a, QuadFloat8 b) { return { XMVectorLessOrEqual(a.lo, b.lo), XMVectorLessOrEqual(a.hi, b.hi) }; }
+
+    // Lanes of b where mask is set, of a elsewhere (XMVectorSelect order).
+    inline QuadFloat8 Select(QuadFloat8 a, QuadFloat8 b, QuadFloat8 mask)
+    {
+        return { XMVectorSelect(a.lo, b.lo, mask.lo), XMVectorSelect(a.hi, b.hi, mask.hi) };
+    }
+
+    inline QuadFloat8 Pow(QuadFloat8 x, QuadFloat8 y) { return { PowEst(x.lo, y.lo), PowEst(x.hi, y.hi) }; }
+
+#if LIGHTING_MODEL_AVX
+    //
+    // Eight float lanes in one AVX register.  Everything stays in 256-bit registers,
+    // pow() included, so the batch never mixes in SSE instructions.  Only AVX, not
+    // AVX2 or FMA, so the results match the DirectXMath path to a few ulps.
+    //
+    struct AvxFloat8
+    {
+        __m256 v;
+
+        static AvxFloat8 Splat(float s) { return { _mm256_set1_ps(s) }; }
+        static AvxFloat8 Load(const float* p) { return { _mm256_loadu_ps(p) }; }
+    };
+
+    inline void Store(float* p, AvxFloat8 a) { _mm256_storeu_ps(p, a.v); }
+
+    inline AvxFloat8 operator+(AvxFloat8 a, AvxFloat8 b) { return { _mm256_add_ps(a.v, b.v) }; }
+    inline AvxFloat8 operator-(AvxFloat8 a, AvxFloat8 b) { return { _mm256_sub_ps(a.v, b.v) }; }
+    inline AvxFloat8 operator*(AvxFloat8 a, AvxFloat8 b) { return { _mm256_mul_ps(a.v, b.v) }; }
+    inline AvxFloat8 operator/(AvxFloat8 a, AvxFloat8 b) { return { _mm256_div_ps(a.v, b.v) }; }
+
+    inline AvxFloat8 Min(AvxFloat8 a, AvxFloat8 b) { return { _mm256_min_ps(a.v, b.v) }; }
+    inline AvxFloat8 Max(AvxFloat8 a, AvxFloat8 b) { return { _mm256_max_ps(a.v, b.v) }; }
+    inline AvxFloat8 Sqrt(AvxFloat8 a) { return { _mm256_sqrt_ps(a.v) }; }
+    inline AvxFloat8 LessOrEqual(AvxFloat8 a, AvxFloat8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+    inline AvxFloat8 Select(AvxFloat8 a, AvxFloat8 b, AvxFloat8 mask) { return { _mm256_blendv_ps(a.v, b.v, mask.v) }; }
+
+    // Log2Est() and Exp2Est() on eight lanes, step for step.  The integer conversions
+    // are the AVX float ones; reinterpreting their results as floats needs no AVX2.
+    inline __m256 Log2Est8(__m256 x)
+    {
+        const __m256 exponentMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7F800000));
+        const __m256 mantissaMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x007FFFFF));
+        const __m256 one = _mm256_set1_ps(1.0f);
+
+        __m256 e = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_castps_si256(_mm256_and_ps(x, exponentMask))),
+            _mm256_set1_ps(1.0f / 8388608.0f));
+        __m256 m = _mm256_or_ps(_mm256_and_ps(x, mantissaMask), one);
+
+        __m256 big = _mm256_cmp_ps(m, _mm256_set1_ps(1.41421356f), _CMP_GT_OQ);
+        m = _mm256_blendv_ps(m, _mm256_mul_ps(m, _mm256_set1_ps(0.5f)), big);
+        e = _mm256_blendv_ps(e, _mm256_add_ps(e, one), big);
+
+        __m256 t = _mm256_div_ps(_mm256_sub_ps(m, one), _mm256_add_ps(m, one));
+        __m256 t2 = _mm256_mul_ps(t, t);
+
+        __m256 p = _mm256_set1_ps(1.0f / 9.0f);
+        p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(1.0f / 7.0f));
+        p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(1.0f / 5.0f));
+        p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(1.0f / 3.0f));
+        p = _mm256_add_ps(_mm256_mul_ps(p, t2), one);
+        __m256 lnM = _mm256_mul_ps(_mm256_mul_ps(p, t), _mm256_set1_ps(2.0f));
+
+        return _mm256_add_ps(_mm256_mul_ps(lnM, _mm256_set1_ps(1.44269504f)), _mm256_sub_ps(e, _mm256_set1_ps(127.0f)));
+    }
+
+    inline __m256 Exp2Est8(__m256 y)
+    {
+        __m256 clamped = _mm256_min_ps(_mm256_max_ps(y, _mm256_set1_ps(-126.0f)), _mm256_set1_ps(127.0f));
+        __m256 k = _mm256_round_ps(clamped, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256 r = _mm256_mul_ps(_mm256_sub_ps(clamped, k), _mm256_set1_ps(0.69314718f));
+
+        __m256 p = _mm256_set1_ps(1.0f / 5040.0f);
+        p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(1.0f / 720.0f));
+        p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(1.0f / 120.0f));
+        p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(1.0f / 24.0f));
+        p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(1.0f / 6.0f));
+        p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(0.5f));
+        p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(1.0f));
+        p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(1.0f));
+
+        __m256 scale = _mm256_castsi256_ps(_mm256_cvttps_epi32(
+            _mm256_mul_ps(_mm256_add_ps(k, _mm256_set1_ps(127.0f)), _mm256_set1_ps(8388608.0f))));
+        return _mm256_mul_ps(p, scale);
+    }
+
+    inline AvxFloat8 Pow(AvxFloat8 x, AvxFloat8 y)
+    {
+        return { Exp2Est8(_mm256_mul_ps(y.v, Log2Est8(_mm256_max_ps(x.v, _mm256_set1_ps(FLT_MIN))))) };
+    }
+
+    // CPUID reports AVX, and the OS saves the upper register halves (XCR0 bits 1 and 2).
+    bool CpuHasAvx()
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        return osxsave && avx && (_xgetbv(0) & 6) == 6;
+#else
+        // Only built when the compiler targets AVX anyway.
+        return true;
+#endif
+    }
+
+    const bool UseAvx = CpuHasAvx();
+#endif
+
+    //
+    // The batch, written once for either kind of lanes.
+    //
+    template<typename Float8>
+    inline Float8 Saturate(Float8 a) { return Min(Max(a, Float8::Splat(0.0f)), Float8::Splat(1.0f)); }
+
+    template<typename Float8>
+    struct Vec8
+    {
+        Float8 x, y, z;
+    };
+
+    template<typename Float8>
+    inline Float8 Dot(const Vec8<Float8>& a, const Vec8<Float8>& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+    template<typename Float8>
+    inline Vec8<Float8> SplatVec(const XMFLOAT3& v) { return { Float8::Splat(v.x), Float8::Splat(v.y), Float8::Splat(v.z) }; }
+
+    template<typename Float8>
+    inline Vec8<Float8> Sub(const Vec8<Float8>& a, const Vec8<Float8>& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+
+    template<typename Float8>
+    inline Vec8<Float8> DivideBy(const Vec8<Float8>& a, Float8 s) { return { a.x / s, a.y / s, a.z / s }; }
+
+    // BlinnPhong() times the light's strength, scaled per lane by intensity (n.l times
+    // attenuation, spot and shadow factors), added to color.  Without a material only
+    // the scaled strength is added.
+    template<typename Float8>
+    void AccumulateBlinnPhong(Vec8<Float8>& color, const XMFLOAT3& lightStrength, Float8 intensity, const Vec8<Float8>& lightVec,
+        const Vec8<Float8>& normal, const Vec8<Float8>& toEye, const ShadingMaterial* material, Float8 mask)
+    {
+        const Float8 zero = Float8::Splat(0.0f);
+
+        if(material == nullptr)
+        {
+            color.x = color.x + Select(zero, Float8::Splat(lightStrength.x) * intensity, mask);
+            color.y = color.y + Select(zero, Float8::Splat(lightStrength.y) * intensity, mask);
+            color.z = color.z + Select(zero, Float8::Splat(lightStrength.z) * intensity, mask);
+            return;
+        }
+
+        const ShadingMaterial& mat = *material;
+        const float m = mat.Shininess * 256.0f;
+
+        Vec8<Float8> halfVec = { toEye.x + lightVec.x, toEye.y + lightVec.y, toEye.z + lightVec.z };
+        halfVec = DivideBy(halfVec, Sqrt(Dot(halfVec, halfVec)));
+
+        Float8 roughnessFactor = Float8::Splat((m + 8.0f) / 8.0f) * Pow(Max(Dot(halfVec, normal), zero), Float8::Splat(m));
+
+        Float8 f0 = Float8::Splat(1.0f) - Saturate(Dot(halfVec, lightVec));
+        Float8 f2 = f0 * f0;
+        Float8 f4 = f2 * f2;
+
+        const Float8 one = Float8::Splat(1.0f);
+
+        Float8 specX = (Float8::Splat(mat.FresnelR0.x) + Float8::Splat(1.0f - mat.FresnelR0.x) * f4) * roughnessFactor;
+        Float8 specY = (Float8::Splat(mat.FresnelR0.y) + Float8::Splat(1.0f - mat.FresnelR0.y) * f4) * roughnessFactor;
+        Float8 specZ = (Float8::Splat(mat.FresnelR0.z) + Float8::Splat(1.0f - mat.FresnelR0.z) * f4) * roughnessFactor;
+
+        Float8 litX = (Float8::Splat(mat.DiffuseAlbedo.x) + specX / (specX + one)) * Float8::Splat(lightStrength.x) * intensity;
+        Float8 litY = (Float8::Splat(mat.DiffuseAlbedo.y) + specY / (specY + one)) * Float8::Splat(lightStrength.y) * intensity;
+        Float8 litZ = (Float8::Splat(mat.DiffuseAlbedo.z) + specZ / (specZ + one)) * Float8::Splat(lightStrength.z) * intensity;
+
+        color.x = color.x + Select(zero, litX, mask);
+        color.y = color.y + Select(zero, litY, mask);
+        color.z = color.z + Select(zero, litZ, mask);
+    }
+
+    // The lights of a LightingModel, as ShadeLanes() reads them.
+    struct LightList
+    {
+        const ShadingLight* Lights;
+        std::uint32_t NumDirLights;
+        std::uint32_t NumPointLights;
+        std::uint32_t NumSpotLights;
+        float ShadowFactor[3];
+    };
+
+    // soa holds BatchSize positions and normals, one array per component; out gets the
+    // colors the same way.
+    template<typename Float8>
+    void ShadeLanes(const LightList& lights, const ShadingMaterial* mat, const float (*soa)[LightingModel::BatchSize],
+        const XMFLOAT3& eyePos, float (*out)[LightingModel::BatchSize])
+    {
+        const Vec8<Float8> pos = { Float8::Load(soa[0]), Float8::Load(soa[1]), Float8::Load(soa[2]) };
+        const Vec8<Float8> normal = { Float8::Load(soa[3]), Float8::Load(soa[4]), Float8::Load(soa[5]) };
+
+        Vec8<Float8> toEye = Sub(SplatVec<Float8>(eyePos), pos);
+        toEye = DivideBy(toEye, Sqrt(Dot(toEye, toEye)));
+
+        const Float8 zero = Float8::Splat(0.0f);
+        const Float8 all = LessOrEqual(zero, zero);
+
+        Vec8<Float8> color = { zero, zero, zero };
+        std::uint32_t i = 0;
+
+        for(; i < lights.NumDirLights; ++i)
+        {
+            const ShadingLight& L = lights.Lights[i];
+            const Vec8<Float8> lightVec = { Float8::Splat(-L.Direction.x), Float8::Splat(-L.Direction.y), Float8::Splat(-L.Direction.z) };
+            Float8 ndotl = Max(Dot(lightVec, normal), zero);
+            AccumulateBlinnPhong(color, L.Strength, ndotl * Float8::Splat(lights.ShadowFactor[i]), lightVec, normal, toEye, mat, all);
+        }
+
+        for(; i < lights.NumDirLights + lights.NumPointLights; ++i)
+        {
+            const ShadingLight& L = lights.Lights[i];
+            Vec8<Float8> lightVec = Sub(SplatVec<Float8>(L.Position), pos);
+            Float8 d = Sqrt(Dot(lightVec, lightVec));
+            Float8 inRange = LessOrEqual(d, Float8::Splat(L.FalloffEnd));
+            lightVec = DivideBy(lightVec, d);
+
+            Float8 ndotl = Max(Dot(normal, lightVec), zero);
+            Float8 att = Saturate((Float8::Splat(L.FalloffEnd) - d) / Float8::Splat(L.FalloffEnd - L.FalloffStart));
+            AccumulateBlinnPhong(color, L.Strength, ndotl * att, lightVec, normal, toEye, mat, inRange);
+        }
+
+        for(; i < lights.NumDirLights + lights.NumPointLights + lights.NumSpotLights; ++i)
+        {
+            const ShadingLight& L = lights.Lights[i];
+            Vec8<Float8> lightVec = Sub(SplatVec<Float8>(L.Position), pos);
+            Float8 d = Sqrt(Dot(lightVec, lightVec));
+            Float8 inRange = LessOrEqual(d, Float8::Splat(L.FalloffEnd));
+            lightVec = DivideBy(lightVec, d);
+
+            Float8 ndotl = Max(Dot(normal, lightVec), zero);
+            Float8 spotFactor = Pow(Max(zero - Dot(lightVec, SplatVec<Float8>(L.Direction)), zero), Float8::Splat(L.SpotPower));
+            AccumulateBlinnPhong(color, L.Strength, ndotl * spotFactor, lightVec, normal, toEye, mat, inRange);
+        }
+
+        Store(out[0], color.x);
+        Store(out[1], color.y);
+        Store(out[2], color.z);
+    }
+}
+
+LightingModel::LightingModel(const ShadingLight* lights, uint32 numDirLights, uint32 numPointLights, uint32 numSpotLights) :
+    mLights(lights, lights + numDirLights + numPointLights + numSpotLights),
+    mNumDirLights(numDirLights),
+    mNumPointLights(numPointLights),
+    mNumSpotLights(numSpotLights)
+{
+    assert(numDirLights <= 3);
+}
+
+XMFLOAT3 LightingModel::Shade(const ShadingMaterial& mat, const XMFLOAT3& pos, const XMFLOAT3& normal,
+    const XMFLOAT3& toEye)const
+{
+    const float shadowFactor[3] = { mShadowFactor.x, mShadowFactor.y, mShadowFactor.z };
+
+    XMFLOAT3 result(0.0f, 0.0f, 0.0f);
+    uint32 i = 0;
+
+    for(; i < mNumDirLights; ++i)
+        result = Add(result, Scale(ComputeDirectionalLight(mLights[i], mat, normal, toEye), shadowFactor[i]));
+
+    for(; i < mNumDirLights + mNumPointLights; ++i)
+        result = Add(result, ComputePointLight(mLights[i], mat, pos, normal, toEye));
+
+    for(; i < mNumDirLights + mNumPointLights + mNumSpotLights; ++i)
+        result = Add(result, ComputeSpotLight(mLights[i], mat, pos, normal, toEye));
+
+    return result;
+}
+
+void LightingModel::Shade(const ShadingMaterial& mat, const XMFLOAT3* positions, const XMFLOAT3* normals,
+    const XMFLOAT3& eyePos, XMFLOAT3* colors, size_t count, ThreadPool& pool)const
+{
+    pool.ParallelFor(count, BatchGrain, [=, &mat, &eyePos](size_t begin, size_t end)
+    {
+        ShadeSerial(mat, positions + begin, normals + begin, eyePos, colors + begin, end - begin);
+    });
+}
+
+void LightingModel::ShadeSerial(const ShadingMaterial& mat, const XMFLOAT3* positions, const XMFLOAT3* normals,
+    const XMFLOAT3& eyePos, XMFLOAT3* colors, size_t count)const
+{
+    ShadeRange(&mat, positions, normals, eyePos, colors, count);
+}
+
+void LightingModel::Irradiance(const XMFLOAT3* positions, const XMFLOAT3* normals, XMFLOAT3* irradiance,
+    size_t count, ThreadPool& pool)const
+{
+    const XMFLOAT3 unusedEyePos(0.0f, 0.0f, 0.0f);
+    pool.ParallelFor(count, BatchGrain, [=, &unusedEyePos](size_t begin, size_t end)
+    {
+        ShadeRange(nullptr, positions + begin, normals + begin, unusedEyePos, irradiance + begin, end - begin);
+    });
+}
+
+void LightingModel::ShadeRange(const ShadingMaterial* mat, const XMFLOAT3* positions, const XMFLOAT3* normals,
+    const XMFLOAT3& eyePos, XMFLOAT3* colors, size_t count)const
+{
+    for(size_t i = 0; i < count; i += BatchSize)
+        ShadeBatch(mat, positions + i, normals + i, eyePos, colors + i, std::min(BatchSize, count - i));
+}
+
+void LightingModel::ShadeBatch(const ShadingMaterial* mat, const XMFLOAT3* positions, const XMFLOAT3* normals,
+    const XMFLOAT3& eyePos, XMFLOAT3* colors, size_t lanes)const
+{
+    // Transpose to one array per component; a partial batch repeats its last point.
+    float soa[6][BatchSize];
+    for(size_t i = 0; i < BatchSize; ++i)
+    {
+        const size_t j = std::min(i, lanes - 1);
+        soa[0][i] = positions[j].x;
+        soa[1][i] = positions[j].y;
+        soa[2][i] = positions[j].z;
+        soa[3][i] = normals[j].x;
+        soa[4][i] = normals[j].y;
+        soa[5][i] = normals[j].z;
+    }
+
+    const LightList lights = { mLights.data(), mNumDirLights, mNumPointLights, mNumSpotLights,
+        { mShadowFactor.x, mShadowFactor.y, mShadowFactor.z } };
+
+    float out[3][BatchSize];
+#if LIGHTING_MODEL_AVX
+    if(UseAvx)
+        ShadeLanes<AvxFloat8>(lights, mat, soa, eyePos, out);
+    else
+#endif
+        ShadeLanes<QuadFloat8>(lights, mat, soa, eyePos, out);
+
+    for(size_t j = 0; j < lanes; ++j)
+        colors[j] = XMFLOAT3(out[0][j], out[1][j], out[2][j]);
+}
+
+bool LightingModel::UsesAvx()
+{
+#if LIGHTING_MODEL_AVX
+    return UseAvx;
+#else
+    return false;
+#endif
+}
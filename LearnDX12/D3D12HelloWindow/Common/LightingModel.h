@@ -0,0 +1,106 @@
+//***************************************************************************************
+// LightingModel.h
+//
+// CPU port of the lighting in Shaders/LightingUtil.hlsl (ComputeLighting and the
+// directional, point and spot light functions it calls).  Shade() for a single point is
+// a line-by-line translation and serves as the reference; the array overload evaluates
+// the same model for BatchSize points at a time in SIMD lanes and spreads the batches
+// over a thread pool.  The lanes are one AVX register on CPUs that have AVX, checked at
+// run time, and two DirectXMath vectors otherwise.
+//
+// Uses for it are baking lighting into static vertex colors and checking the shaders
+// against a known answer on machines without a GPU.
+//***************************************************************************************
+
+#pragma once
+
+#include "ThreadPool.h"
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Same layout as Light in LightingUtil.hlsl (and d3dUtil.h).
+struct ShadingLight
+{
+    DirectX::XMFLOAT3 Strength = { 0.5f, 0.5f, 0.5f };
+    float FalloffStart = 1.0f;                          // point/spot light only
+    DirectX::XMFLOAT3 Direction = { 0.0f, -1.0f, 0.0f };// directional/spot light only
+    float FalloffEnd = 10.0f;                           // point/spot light only
+    DirectX::XMFLOAT3 Position = { 0.0f, 0.0f, 0.0f };  // point/spot light only
+    float SpotPower = 64.0f;                            // spot light only
+};
+
+// Material in LightingUtil.hlsl.  Shininess is 1 - roughness, as in Default.hlsl.
+struct ShadingMaterial
+{
+    DirectX::XMFLOAT4 DiffuseAlbedo = { 1.0f, 1.0f, 1.0f, 1.0f };
+    DirectX::XMFLOAT3 FresnelR0 = { 0.01f, 0.01f, 0.01f };
+    float Shininess = 0.75f;
+};
+
+class LightingModel
+{
+public:
+    using uint32 = std::uint32_t;
+
+    // Points shaded per SIMD batch.
+    static const size_t BatchSize = 8;
+
+    // Points per thread pool task; a multiple of BatchSize.
+    static const size_t BatchGrain = 2048;
+
+    ///<summary>
+    /// Lights are ordered as in the pass constants: numDirLights directional lights,
+    /// then the point lights, then the spot lights.  At most three directional lights,
+    /// since the shader's shadow factor is a float3.
+    ///</summary>
+    LightingModel(const ShadingLight* lights, uint32 numDirLights, uint32 numPointLights, uint32 numSpotLights);
+
+    // Per directional light shadow factor (shadowFactor in the shader); 1 by default.
+    void SetShadowFactor(const DirectX::XMFLOAT3& shadowFactor) { mShadowFactor = shadowFactor; }
+
+    ///<summary>
+    /// ComputeLighting().rgb for one surface point.  normal and toEye must be unit length.
+    ///</summary>
+    DirectX::XMFLOAT3 Shade(const ShadingMaterial& mat, const DirectX::XMFLOAT3& pos,
+        const DirectX::XMFLOAT3& normal, const DirectX::XMFLOAT3& toEye)const;
+
+    ///<summary>
+    /// Shades count points seen from eyePos, with toEye = normalize(eyePos - pos) as in
+    /// Default.hlsl.  Normals must be unit length.  Ambient light is not included.
+    ///</summary>
+    void Shade(const ShadingMaterial& mat, const DirectX::XMFLOAT3* positions, const DirectX::XMFLOAT3* normals,
+        const DirectX::XMFLOAT3& eyePos, DirectX::XMFLOAT3* colors, size_t count,
+        ThreadPool& pool = ThreadPool::Default())const;
+
+    // Same as above on the calling thread only.
+    void ShadeSerial(const ShadingMaterial& mat, const DirectX::XMFLOAT3* positions, const DirectX::XMFLOAT3* normals,
+        const DirectX::XMFLOAT3& eyePos, DirectX::XMFLOAT3* colors, size_t count)const;
+
+    ///<summary>
+    /// Light reaching each point: the sum of strength times n.l, attenuation, spot and
+    /// shadow factors.  This is the view independent part of Shade(); multiplied by the
+    /// diffuse albedo it gives the shader's result without the specular term.
+    ///</summary>
+    void Irradiance(const DirectX::XMFLOAT3* positions, const DirectX::XMFLOAT3* normals,
+        DirectX::XMFLOAT3* irradiance, size_t count, ThreadPool& pool = ThreadPool::Default())const;
+
+    // True if the batches run in AVX registers on this machine.
+    static bool UsesAvx();
+
+private:
+    // A null mat computes irradiance instead.
+    void ShadeRange(const ShadingMaterial* mat, const DirectX::XMFLOAT3* positions, const DirectX::XMFLOAT3* normals,
+        const DirectX::XMFLOAT3& eyePos, DirectX::XMFLOAT3* colors, size_t count)const;
+    void ShadeBatch(const ShadingMaterial* mat, const DirectX::XMFLOAT3* positions, const DirectX::XMFLOAT3* normals,
+        const DirectX::XMFLOAT3& eyePos, DirectX::XMFLOAT3* colors, size_t lanes)const;
+
+private:
+    std::vector<ShadingLight> mLights;
+    uint32 mNumDirLights = 0;
+    uint32 mNumPointLights = 0;
+    uint32 mNumSpotLights = 0;
+
+    DirectX::XMFLOAT3 mShadowFactor = { 1.0f, 1.0f, 1.0f };
+};
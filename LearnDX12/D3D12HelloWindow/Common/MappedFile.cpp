@@ -0,0 +1,145 @@
+//***************************************************************************************
+// MappedFile.cpp
+//***************************************************************************************
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& path)
+{
+    int length = MultiByteToWideChar(CP_ACP, 0, path.c_str(), -1, nullptr, 0);
+    if(length <= 0)
+        return false;
+
+    std::wstring widePath(length, L'\0');
+    MultiByteToWideChar(CP_ACP, 0, path.c_str(), -1, &widePath[0], length);
+    widePath.resize(length - 1);
+
+    return Open(widePath);
+}
+
+bool MappedFile::Open(const std::wstring& path)
+{
+    Close();
+
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    mFile = file;
+    mSize = (std::uint64_t)size.QuadPart;
+    mOpen = true;
+
+    // Zero sized files cannot be mapped; they are simply empty.
+    if(mSize == 0)
+        return true;
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(mapping == nullptr)
+    {
+        Close();
+        return false;
+    }
+    mMapping = mapping;
+
+    mData = static_cast<const std::uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if(mData == nullptr)
+    {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if(mData != nullptr)
+        UnmapViewOfFile(mData);
+    if(mMapping != nullptr)
+        CloseHandle(mMapping);
+    if(mFile != nullptr)
+        CloseHandle(mFile);
+
+    mData = nullptr;
+    mMapping = nullptr;
+    mFile = nullptr;
+    mSize = 0;
+    mOpen = false;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    mFd = fd;
+    mSize = (std::uint64_t)st.st_size;
+    mOpen = true;
+
+    if(mSize == 0)
+        return true;
+
+    void* data = mmap(nullptr, (size_t)mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(data == MAP_FAILED)
+    {
+        Close();
+        return false;
+    }
+
+    mData = static_cast<const std::uint8_t*>(data);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if(mData != nullptr)
+        munmap(const_cast<std::uint8_t*>(mData), (size_t)mSize);
+    if(mFd >= 0)
+        close(mFd);
+
+    mData = nullptr;
+    mFd = -1;
+    mSize = 0;
+    mOpen = false;
+}
+
+#endif
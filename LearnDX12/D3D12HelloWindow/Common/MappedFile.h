@@ -0,0 +1,46 @@
+//***************************************************************************************
+// MappedFile.h
+//
+// Read-only memory mapping of a whole file.  Pages are brought in by the OS as they
+// are touched, so mapping a multi-gigabyte file costs address space, not memory.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile& rhs) = delete;
+    MappedFile& operator=(const MappedFile& rhs) = delete;
+    ~MappedFile();
+
+    // Returns false if the file cannot be opened or mapped.  Empty files map to
+    // Data() == nullptr with Size() == 0.
+    bool Open(const std::string& path);
+#ifdef _WIN32
+    bool Open(const std::wstring& path);
+#endif
+
+    void Close();
+
+    bool IsOpen()const { return mOpen; }
+    const std::uint8_t* Data()const { return mData; }
+    std::uint64_t Size()const { return mSize; }
+
+private:
+    const std::uint8_t* mData = nullptr;
+    std::uint64_t mSize = 0;
+    bool mOpen = false;
+
+#ifdef _WIN32
+    // HANDLEs, kept as void* so this header does not pull in windows.h.
+    void* mFile = nullptr;
+    void* mMapping = nullptr;
+#else
+    int mFd = -1;
+#endif
+};
@@ -0,0 +1,103 @@
+//***************************************************************************************
+// MaterialTable.cpp
+//***************************************************************************************
+
+#include "MaterialTable.h"
+#include <algorithm>
+#include <cassert>
+
+const MaterialTable::uint32 MaterialTable::NoIndex;
+const MaterialTable::uint32 MaterialTable::MergeGap;
+
+MaterialTable::MaterialTable(uint32 frameCount, uint32 capacity)
+    : mData(capacity),
+    mDirtyFlags(frameCount, std::vector<bool>(capacity, false)),
+    mDirtyLists(frameCount)
+{
+    assert(frameCount > 0);
+
+    // Hand out the low indices first.
+    mFreeIndices.reserve(capacity);
+    for(uint32 i = capacity; i > 0; --i)
+        mFreeIndices.push_back(i - 1);
+}
+
+MaterialTable::uint32 MaterialTable::Add(const std::string& name, const Entry& data)
+{
+    if(mFreeIndices.empty() || mIndices.count(name) != 0)
+        return NoIndex;
+
+    const uint32 index = mFreeIndices.back();
+    mFreeIndices.pop_back();
+    mIndices[name] = index;
+
+    Set(index, data);
+    return index;
+}
+
+bool MaterialTable::Remove(const std::string& name)
+{
+    auto it = mIndices.find(name);
+    if(it == mIndices.end())
+        return false;
+
+    mFreeIndices.push_back(it->second);
+    mIndices.erase(it);
+    return true;
+}
+
+MaterialTable::uint32 MaterialTable::Find(const std::string& name)const
+{
+    auto it = mIndices.find(name);
+    return it != mIndices.end() ? it->second : NoIndex;
+}
+
+void MaterialTable::Set(uint32 index, const Entry& data)
+{
+    assert(index < mData.size());
+
+    mData[index] = data;
+    MarkDirty(index);
+}
+
+void MaterialTable::MarkDirty(uint32 index)
+{
+    for(size_t frame = 0; frame < mDirtyFlags.size(); ++frame)
+    {
+        if(!mDirtyFlags[frame][index])
+        {
+            mDirtyFlags[frame][index] = true;
+            mDirtyLists[frame].push_back(index);
+        }
+    }
+}
+
+const std::vector<MaterialTable::Range>& MaterialTable::TakeDirtyRanges(uint32 frame)
+{
+    std::vector<uint32>& dirty = mDirtyLists[frame];
+    std::vector<bool>& flags = mDirtyFlags[frame];
+
+    mRanges.clear();
+    std::sort(dirty.begin(), dirty.end());
+    for(uint32 index : dirty)
+    {
+        flags[index] = false;
+
+        if(!mRanges.empty())
+        {
+            Range& last = mRanges.back();
+            if(index - (last.First + last.Count) <= MergeGap)
+            {
+                last.Count = index + 1 - last.First;
+                continue;
+            }
+        }
+        mRanges.push_back({ index, 1 });
+    }
+    dirty.clear();
+
+    for(const Range& range : mRanges)
+        mUploadedEntries += range.Count;
+
+    return mRanges;
+}
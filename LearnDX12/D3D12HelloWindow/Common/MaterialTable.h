@@ -0,0 +1,121 @@
+//***************************************************************************************
+// MaterialTable.h
+//
+// Every material in one tightly packed array, meant to be mirrored into a structured
+// buffer per frame resource and indexed by a per-object material id in the shader.
+// Compared with one constant buffer slot per material this drops the 256-byte
+// alignment (an Entry is 96 bytes) and the per-draw root CBV: the whole buffer is
+// bound once per pass.
+//
+// The table hands out dense indices (freed ones are reused) and tracks, for each frame
+// resource separately, which entries changed since that frame's copy was last
+// written.  TakeDirtyRanges() turns that into a few contiguous ranges to memcpy:
+//
+//   for(const MaterialTable::Range& r : table.TakeDirtyRanges(frameIndex))
+//       frame->MaterialBuffer->CopyRange(r.First, table.Data() + r.First, r.Count);
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class MaterialTable
+{
+public:
+    using uint32 = std::uint32_t;
+
+    static const uint32 NoIndex = 0xffffffff;
+
+    // Clean entries between two dirty ones are copied along when there are at most
+    // this many; one larger memcpy beats several small ones.
+    static const uint32 MergeGap = 4;
+
+    // MaterialData in Default.hlsl; the stride of the structured buffer.
+    struct Entry
+    {
+        DirectX::XMFLOAT4 DiffuseAlbedo = { 1.0f, 1.0f, 1.0f, 1.0f };
+        DirectX::XMFLOAT3 FresnelR0 = { 0.01f, 0.01f, 0.01f };
+        float Roughness = 0.25f;
+
+        // Used in texture mapping; stored transposed, as the shader reads it.
+        DirectX::XMFLOAT4X4 MatTransform = DirectX::XMFLOAT4X4(
+            1.0f, 0.0f, 0.0f, 0.0f,
+            0.0f, 1.0f, 0.0f, 0.0f,
+            0.0f, 0.0f, 1.0f, 0.0f,
+            0.0f, 0.0f, 0.0f, 1.0f);
+    };
+
+    struct Range
+    {
+        uint32 First;
+        uint32 Count;
+    };
+
+    ///<summary>
+    /// frameCount copies are tracked (gNumFrameResources); capacity is the number of
+    /// entries each frame's buffer was created with.
+    ///</summary>
+    MaterialTable(uint32 frameCount, uint32 capacity);
+    MaterialTable(const MaterialTable& rhs) = delete;
+    MaterialTable& operator=(const MaterialTable& rhs) = delete;
+
+    ///<summary>
+    /// Adds a material and returns its index, NoIndex if the name is taken or the
+    /// table is full.  The entry is dirty in every frame.
+    ///</summary>
+    uint32 Add(const std::string& name, const Entry& data);
+
+    ///<summary>
+    /// Frees the material's index for reuse.  Its old data stays in the buffers, so
+    /// nothing may draw with the index anymore.
+    ///</summary>
+    bool Remove(const std::string& name);
+
+    // Index of the named material, NoIndex if there is none.
+    uint32 Find(const std::string& name)const;
+
+    ///<summary>
+    /// Replaces the data of a live index and marks it dirty in every frame.
+    ///</summary>
+    void Set(uint32 index, const Entry& data);
+
+    const Entry& Get(uint32 index)const { return mData[index]; }
+
+    ///<summary>
+    /// Ranges of frame's copy that are out of date, sorted and disjoint, and marks them
+    /// clean for that frame.  Copy Data() over them into the frame's buffer.
+    ///</summary>
+    const std::vector<Range>& TakeDirtyRanges(uint32 frame);
+
+    // All capacity entries; unused ones hold stale or default data.
+    const Entry* Data()const { return mData.data(); }
+
+    uint32 Capacity()const { return (uint32)mData.size(); }
+    uint32 Count()const { return (uint32)mIndices.size(); }
+
+    // Buffer size per frame, and what 256-byte aligned constant buffers would take.
+    size_t ByteSize()const { return mData.size()*sizeof(Entry); }
+    size_t ConstantBufferByteSize()const { return mData.size()*((sizeof(Entry) + 255) & ~size_t(255)); }
+
+    // Entries handed out by TakeDirtyRanges() so far, clean ones in merged gaps included.
+    size_t UploadedEntries()const { return mUploadedEntries; }
+
+private:
+    void MarkDirty(uint32 index);
+
+private:
+    std::vector<Entry> mData;
+    std::unordered_map<std::string, uint32> mIndices;
+    std::vector<uint32> mFreeIndices;
+
+    // Per frame: a flag per entry and the list of set flags, in marking order.
+    std::vector<std::vector<bool>> mDirtyFlags;
+    std::vector<std::vector<uint32>> mDirtyLists;
+    std::vector<Range> mRanges;
+
+    size_t mUploadedEntries = 0;
+};
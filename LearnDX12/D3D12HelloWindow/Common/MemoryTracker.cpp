@@ -0,0 +1,297 @@
+//***************************************************************************************
+// MemoryTracker.cpp
+//***************************************************************************************
+
+#include "MemoryTracker.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <ostream>
+
+const size_t MemoryTracker::DefaultHistoryFrames;
+
+namespace
+{
+    const char* const CategoryNames[MemoryTracker::CategoryCount] =
+    {
+        "Buffers",
+        "Textures",
+        "RenderTargets",
+        "UploadBuffers",
+        "ConstantBuffers",
+        "DescriptorHeaps",
+        "MeshData"
+    };
+
+    template<typename Write>
+    bool SaveText(const std::string& path, Write write)
+    {
+        const std::string temp = path + ".tmp";
+        {
+            std::ofstream fout(temp, std::ios::trunc);
+            if(!fout)
+                return false;
+
+            write(fout);
+
+            if(!fout)
+            {
+                fout.close();
+                std::remove(temp.c_str());
+                return false;
+            }
+        }
+
+        std::remove(path.c_str());
+        if(std::rename(temp.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temp.c_str());
+            return false;
+        }
+        return true;
+    }
+}
+
+const char* MemoryTracker::CategoryName(Category category)
+{
+    assert(category < CategoryCount);
+    return CategoryNames[category];
+}
+
+MemoryTracker::uint64 MemoryTracker::Snapshot::TotalBytes()const
+{
+    uint64 bytes = 0;
+    for(const CategoryStats& stats : Categories)
+        bytes += stats.Bytes;
+    return bytes;
+}
+
+MemoryTracker::Handle::Handle(Category category, uint64 bytes, MemoryTracker& tracker)
+{
+    Reset(category, bytes, tracker);
+}
+
+MemoryTracker::Handle::Handle(Handle&& rhs) noexcept
+    : mTracker(rhs.mTracker),
+    mCategory(rhs.mCategory),
+    mBytes(rhs.mBytes)
+{
+    rhs.mTracker = nullptr;
+    rhs.mBytes = 0;
+}
+
+MemoryTracker::Handle& MemoryTracker::Handle::operator=(Handle&& rhs) noexcept
+{
+    if(this == &rhs)
+        return *this;
+
+    Reset();
+    mTracker = rhs.mTracker;
+    mCategory = rhs.mCategory;
+    mBytes = rhs.mBytes;
+    rhs.mTracker = nullptr;
+    rhs.mBytes = 0;
+    return *this;
+}
+
+MemoryTracker::Handle::~Handle()
+{
+    Reset();
+}
+
+void MemoryTracker::Handle::Reset(Category category, uint64 bytes, MemoryTracker& tracker)
+{
+    // Allocate first, so a Reset() to the same bytes never dips below them.
+    tracker.Allocate(category, bytes);
+    Reset();
+
+    mTracker = &tracker;
+    mCategory = category;
+    mBytes = bytes;
+}
+
+void MemoryTracker::Handle::Reset()
+{
+    if(mTracker != nullptr)
+        mTracker->Release(mCategory, mBytes);
+
+    mTracker = nullptr;
+    mBytes = 0;
+}
+
+MemoryTracker::MemoryTracker()
+    : MemoryTracker(DefaultHistoryFrames)
+{
+}
+
+MemoryTracker::MemoryTracker(size_t historyFrames)
+    : mHistoryFrames(std::max<size_t>(historyFrames, 1))
+{
+    mHistory.reserve(mHistoryFrames);
+}
+
+MemoryTracker& MemoryTracker::Global()
+{
+    static MemoryTracker tracker;
+    return tracker;
+}
+
+void MemoryTracker::Allocate(Category category, uint64 bytes)
+{
+    assert(category < CategoryCount);
+    Counters& counters = mCounters[category];
+
+    const uint64 total = counters.Bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    counters.Count.fetch_add(1, std::memory_order_relaxed);
+    counters.AllocatedBytes.fetch_add(bytes, std::memory_order_relaxed);
+    counters.AllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+    uint64 peak = counters.PeakBytes.load(std::memory_order_relaxed);
+    while(total > peak && !counters.PeakBytes.compare_exchange_weak(peak, total, std::memory_order_relaxed))
+    {
+    }
+}
+
+void MemoryTracker::Release(Category category, uint64 bytes)
+{
+    assert(category < CategoryCount);
+    Counters& counters = mCounters[category];
+
+    counters.Bytes.fetch_sub(bytes, std::memory_order_relaxed);
+    counters.Count.fetch_sub(1, std::memory_order_relaxed);
+    counters.ReleaseCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MemoryTracker::SetBudget(Category category, uint64 bytes)
+{
+    assert(category < CategoryCount);
+    mCounters[category].Budget.store(bytes, std::memory_order_relaxed);
+}
+
+MemoryTracker::CategoryStats MemoryTracker::GetStats(Category category)const
+{
+    assert(category < CategoryCount);
+    const Counters& counters = mCounters[category];
+
+    CategoryStats stats;
+    stats.Bytes = counters.Bytes.load(std::memory_order_relaxed);
+    stats.Count = counters.Count.load(std::memory_order_relaxed);
+    stats.PeakBytes = counters.PeakBytes.load(std::memory_order_relaxed);
+    stats.AllocatedBytes = counters.AllocatedBytes.load(std::memory_order_relaxed);
+    stats.AllocationCount = counters.AllocationCount.load(std::memory_order_relaxed);
+    stats.ReleaseCount = counters.ReleaseCount.load(std::memory_order_relaxed);
+    stats.Budget = counters.Budget.load(std::memory_order_relaxed);
+    return stats;
+}
+
+MemoryTracker::Snapshot MemoryTracker::TakeSnapshot()const
+{
+    Snapshot snapshot;
+    {
+        std::lock_guard<std::mutex> lock(mHistoryMutex);
+        snapshot.Frame = mFrame;
+    }
+
+    for(int c = 0; c < CategoryCount; ++c)
+        snapshot.Categories[c] = GetStats((Category)c);
+    return snapshot;
+}
+
+void MemoryTracker::ResetPeaks()
+{
+    for(Counters& counters : mCounters)
+        counters.PeakBytes.store(counters.Bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void MemoryTracker::EndFrame()
+{
+    Snapshot snapshot = TakeSnapshot();
+
+    std::lock_guard<std::mutex> lock(mHistoryMutex);
+    snapshot.Frame = mFrame++;
+    for(int c = 0; c < CategoryCount; ++c)
+    {
+        snapshot.FrameAllocatedBytes[c] = snapshot.Categories[c].AllocatedBytes - mLastAllocatedBytes[c];
+        mLastAllocatedBytes[c] = snapshot.Categories[c].AllocatedBytes;
+    }
+
+    if(mHistory.size() < mHistoryFrames)
+    {
+        mHistory.push_back(snapshot);
+    }
+    else
+    {
+        mHistory[mHistoryStart] = snapshot;
+        mHistoryStart = (mHistoryStart + 1) % mHistoryFrames;
+    }
+}
+
+std::vector<MemoryTracker::Snapshot> MemoryTracker::History()const
+{
+    std::lock_guard<std::mutex> lock(mHistoryMutex);
+
+    std::vector<Snapshot> history;
+    history.reserve(mHistory.size());
+    history.insert(history.end(), mHistory.begin() + mHistoryStart, mHistory.end());
+    history.insert(history.end(), mHistory.begin(), mHistory.begin() + mHistoryStart);
+    return history;
+}
+
+void MemoryTracker::WriteCsv(std::ostream& out)const
+{
+    out << "frame,category,bytes,count,peakBytes,frameAllocatedBytes\n";
+    for(const Snapshot& snapshot : History())
+    {
+        for(int c = 0; c < CategoryCount; ++c)
+        {
+            const CategoryStats& stats = snapshot.Categories[c];
+            out << snapshot.Frame << ',' << CategoryNames[c] << ','
+                << stats.Bytes << ',' << stats.Count << ',' << stats.PeakBytes << ','
+                << snapshot.FrameAllocatedBytes[c] << '\n';
+        }
+    }
+}
+
+void MemoryTracker::WriteJson(std::ostream& out)const
+{
+    const Snapshot current = TakeSnapshot();
+
+    out << "{\n  \"totalBytes\": " << current.TotalBytes() << ",\n  \"categories\": [\n";
+    for(int c = 0; c < CategoryCount; ++c)
+    {
+        const CategoryStats& stats = current.Categories[c];
+        out << "    { \"name\": \"" << CategoryNames[c] << "\""
+            << ", \"bytes\": " << stats.Bytes
+            << ", \"count\": " << stats.Count
+            << ", \"peakBytes\": " << stats.PeakBytes
+            << ", \"allocatedBytes\": " << stats.AllocatedBytes
+            << ", \"allocations\": " << stats.AllocationCount
+            << ", \"releases\": " << stats.ReleaseCount
+            << ", \"budget\": " << stats.Budget
+            << ", \"overBudget\": " << (stats.OverBudget() ? "true" : "false")
+            << " }" << (c + 1 < CategoryCount ? ",\n" : "\n");
+    }
+
+    // Per frame, bytes in category order.
+    out << "  ],\n  \"frames\": [";
+    const std::vector<Snapshot> history = History();
+    for(size_t i = 0; i < history.size(); ++i)
+    {
+        out << (i > 0 ? ",\n" : "\n") << "    { \"frame\": " << history[i].Frame << ", \"bytes\": [";
+        for(int c = 0; c < CategoryCount; ++c)
+            out << (c > 0 ? ", " : "") << history[i].Categories[c].Bytes;
+        out << "] }";
+    }
+    out << (history.empty() ? "]\n}\n" : "\n  ]\n}\n");
+}
+
+bool MemoryTracker::SaveCsv(const std::string& path)const
+{
+    return SaveText(path, [this](std::ostream& out) { WriteCsv(out); });
+}
+
+bool MemoryTracker::SaveJson(const std::string& path)const
+{
+    return SaveText(path, [this](std::ostream& out) { WriteJson(out); });
+}
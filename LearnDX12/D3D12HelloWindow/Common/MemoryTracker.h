@@ -0,0 +1,171 @@
+//***************************************************************************************
+// MemoryTracker.h
+//
+// Counts the memory held per category: GPU buffers, textures, render targets, upload
+// and constant buffers, descriptor heaps, and CPU side mesh data.  Allocation sites
+// report what they create and what they give back, from any thread; the counters are
+// atomics, so reporting costs a few interlocked adds.
+//
+// Each category keeps its high-water mark and an optional budget.  EndFrame() stores
+// a snapshot of every category in a history of the last frames, which WriteCsv() and
+// WriteJson() export along with the totals.  Something that only ever grows, such as
+// upload buffers kept long after the copies they fed, stands out in the history.
+//***************************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class MemoryTracker
+{
+public:
+    using uint64 = std::uint64_t;
+
+    static const size_t DefaultHistoryFrames = 600;
+
+    enum Category
+    {
+        Buffers,            // default heap buffers: vertices, indices and the like
+        Textures,
+        RenderTargets,      // render target and depth stencil textures
+        UploadBuffers,      // staging memory and the uploaders kept for it
+        ConstantBuffers,    // upload heap buffers written every frame
+        DescriptorHeaps,
+        MeshData,           // CPU copies of vertices and indices
+        CategoryCount
+    };
+
+    static const char* CategoryName(Category category);
+
+    struct CategoryStats
+    {
+        uint64 Bytes = 0;
+        uint64 Count = 0;
+        uint64 PeakBytes = 0;
+
+        // Since the tracker was created.
+        uint64 AllocatedBytes = 0;
+        uint64 AllocationCount = 0;
+        uint64 ReleaseCount = 0;
+
+        // 0 for none.
+        uint64 Budget = 0;
+
+        bool OverBudget()const { return Budget > 0 && Bytes > Budget; }
+    };
+
+    struct Snapshot
+    {
+        uint64 Frame = 0;
+        CategoryStats Categories[CategoryCount];
+
+        // Bytes allocated since the previous EndFrame(); only EndFrame() fills these.
+        uint64 FrameAllocatedBytes[CategoryCount] = {};
+
+        uint64 TotalBytes()const;
+    };
+
+    // Reports bytes for as long as it lives, for memory owned by a C++ object.  Move
+    // only, so the bytes are reported once whatever happens to the owner.
+    class Handle
+    {
+    public:
+        Handle() = default;
+        Handle(Category category, uint64 bytes, MemoryTracker& tracker = MemoryTracker::Global());
+        Handle(const Handle& rhs) = delete;
+        Handle(Handle&& rhs) noexcept;
+        Handle& operator=(const Handle& rhs) = delete;
+        Handle& operator=(Handle&& rhs) noexcept;
+        ~Handle();
+
+        // Reports bytes in place of what was reported so far.
+        void Reset(Category category, uint64 bytes, MemoryTracker& tracker = MemoryTracker::Global());
+        void Reset();
+
+        uint64 Bytes()const { return mBytes; }
+
+    private:
+        MemoryTracker* mTracker = nullptr;
+        Category mCategory = Buffers;
+        uint64 mBytes = 0;
+    };
+
+    MemoryTracker();
+    explicit MemoryTracker(size_t historyFrames);
+    MemoryTracker(const MemoryTracker& rhs) = delete;
+    MemoryTracker& operator=(const MemoryTracker& rhs) = delete;
+
+    // The tracker every allocation site in the framework reports to.
+    static MemoryTracker& Global();
+
+    ///<summary>
+    /// Reports bytes allocated in category.  Thread safe.
+    ///</summary>
+    void Allocate(Category category, uint64 bytes);
+
+    ///<summary>
+    /// Reports bytes given back, the same amount the matching Allocate() reported.
+    ///</summary>
+    void Release(Category category, uint64 bytes);
+
+    void SetBudget(Category category, uint64 bytes);
+
+    CategoryStats GetStats(Category category)const;
+    Snapshot TakeSnapshot()const;
+
+    // Starts the high-water marks over from the current bytes, e.g. after loading.
+    void ResetPeaks();
+
+    ///<summary>
+    /// Stores a snapshot for the frame just finished, dropping the oldest once the
+    /// history is full.
+    ///</summary>
+    void EndFrame();
+
+    // Oldest first.
+    std::vector<Snapshot> History()const;
+
+    ///<summary>
+    /// One row per frame of history and category: bytes, count, high-water mark and the
+    /// bytes allocated during that frame.
+    ///</summary>
+    void WriteCsv(std::ostream& out)const;
+
+    ///<summary>
+    /// The current totals of every category with its budget, and the bytes per category
+    /// of every frame of history.
+    ///</summary>
+    void WriteJson(std::ostream& out)const;
+
+    // Write to a temporary file and rename it; false if either fails.
+    bool SaveCsv(const std::string& path)const;
+    bool SaveJson(const std::string& path)const;
+
+private:
+    struct Counters
+    {
+        std::atomic<uint64> Bytes{ 0 };
+        std::atomic<uint64> Count{ 0 };
+        std::atomic<uint64> PeakBytes{ 0 };
+        std::atomic<uint64> AllocatedBytes{ 0 };
+        std::atomic<uint64> AllocationCount{ 0 };
+        std::atomic<uint64> ReleaseCount{ 0 };
+        std::atomic<uint64> Budget{ 0 };
+    };
+
+private:
+    Counters mCounters[CategoryCount];
+
+    // A ring of snapshots; mHistoryStart is the oldest once it has wrapped.
+    mutable std::mutex mHistoryMutex;
+    std::vector<Snapshot> mHistory;
+    size_t mHistoryFrames = DefaultHistoryFrames;
+    size_t mHistoryStart = 0;
+    uint64 mFrame = 0;
+    uint64 mLastAllocatedBytes[CategoryCount] = {};
+};
@@ -0,0 +1,62 @@
+//***************************************************************************************
+// MeshGeometryBuilder.cpp
+//***************************************************************************************
+
+#include "MeshGeometryBuilder.h"
+#include "UploadArena.h"
+
+namespace
+{
+    // The CPU copies and everything but the GPU buffers.
+    void FillMeshGeometry(const GeometryPacker& packer, MeshGeometry& geo)
+    {
+        const UINT vbByteSize = packer.VertexBufferByteSize();
+        const UINT ibByteSize = packer.IndexBufferByteSize();
+
+        ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo.VertexBufferCPU));
+        ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo.IndexBufferCPU));
+        geo.CpuMemory.Reset(MemoryTracker::MeshData, (UINT64)vbByteSize + ibByteSize);
+
+        packer.Write(geo.VertexBufferCPU->GetBufferPointer(), geo.IndexBufferCPU->GetBufferPointer());
+
+        geo.VertexByteStride = packer.VertexByteStride();
+        geo.VertexBufferByteSize = vbByteSize;
+        geo.IndexFormat = packer.Use16BitIndices() ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+        geo.IndexBufferByteSize = ibByteSize;
+
+        for(const auto& s : packer.Submeshes())
+        {
+            SubmeshGeometry submesh;
+            submesh.IndexCount = s.IndexCount;
+            submesh.StartIndexLocation = s.StartIndexLocation;
+            submesh.BaseVertexLocation = s.BaseVertexLocation;
+
+            geo.DrawArgs[s.Name] = submesh;
+        }
+    }
+}
+
+void BuildMeshGeometry(
+    ID3D12Device* device,
+    ID3D12GraphicsCommandList* cmdList,
+    const GeometryPacker& packer,
+    MeshGeometry& geo)
+{
+    FillMeshGeometry(packer, geo);
+
+    geo.VertexBufferGPU = d3dUtil::CreateDefaultBuffer(device, cmdList,
+        geo.VertexBufferCPU->GetBufferPointer(), geo.VertexBufferByteSize, geo.VertexBufferUploader);
+    geo.IndexBufferGPU = d3dUtil::CreateDefaultBuffer(device, cmdList,
+        geo.IndexBufferCPU->GetBufferPointer(), geo.IndexBufferByteSize, geo.IndexBufferUploader);
+}
+
+void BuildMeshGeometry(
+    UploadArena& arena,
+    const GeometryPacker& packer,
+    MeshGeometry& geo)
+{
+    FillMeshGeometry(packer, geo);
+
+    geo.VertexBufferGPU = arena.CreateBuffer(geo.VertexBufferCPU->GetBufferPointer(), geo.VertexBufferByteSize);
+    geo.IndexBufferGPU = arena.CreateBuffer(geo.IndexBufferCPU->GetBufferPointer(), geo.IndexBufferByteSize);
+}
@@ -0,0 +1,36 @@
+//***************************************************************************************
+// MeshGeometryBuilder.h
+//
+// Turns a filled GeometryPacker into a MeshGeometry: the CPU blobs, the GPU buffers
+// and the DrawArgs of every submesh.  The packer writes straight into the CPU blobs,
+// which then feed the upload, so no intermediate vectors are built.
+//
+//   GeometryPacker packer(layout, sizeof(Vertex));
+//   packer.Add("box", box);
+//   BuildMeshGeometry(*mUploadArena, packer, *geo);
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "GeometryPacker.h"
+
+class UploadArena;
+
+///<summary>
+/// Fills geo from packer, with the GPU buffers created by d3dUtil::CreateDefaultBuffer()
+/// on cmdList.  geo keeps the uploaders until the caller drops them.
+///</summary>
+void BuildMeshGeometry(
+    ID3D12Device* device,
+    ID3D12GraphicsCommandList* cmdList,
+    const GeometryPacker& packer,
+    MeshGeometry& geo);
+
+///<summary>
+/// Same, with the buffers staged in and copied by arena; geo keeps no uploaders.
+///</summary>
+void BuildMeshGeometry(
+    UploadArena& arena,
+    const GeometryPacker& packer,
+    MeshGeometry& geo);
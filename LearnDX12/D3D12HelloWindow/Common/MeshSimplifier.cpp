@@ -0,0 +1,596 @@
+//***************************************************************************************
+// MeshSimplifier.cpp
+//***************************************************************************************
+
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+using namespace DirectX;
+
+namespace
+{
+    // Position (3) + normal (3) + texture coordinate (2).
+    const int QuadricDim = 8;
+    const int QuadricTerms = QuadricDim*(QuadricDim + 1)/2;
+
+    struct Quadric
+    {
+        // Upper triangle of the symmetric matrix, row major.
+        double A[QuadricTerms];
+        double b[QuadricDim];
+        double c;
+        // Accumulated triangle area, used to turn the summed error into an average.
+        double w;
+    };
+
+    double Dot(const double* a, const double* b)
+    {
+        double r = 0.0;
+        for(int i = 0; i < QuadricDim; ++i)
+            r += a[i]*b[i];
+        return r;
+    }
+
+    // Adds the quadric measuring squared distance to the plane spanned by the triangle
+    // in the combined position/attribute space.
+    void QuadricAddTriangle(Quadric& q, const double* p0, const double* p1, const double* p2, double weight)
+    {
+        double e1[QuadricDim];
+        double e2[QuadricDim];
+        for(int i = 0; i < QuadricDim; ++i)
+        {
+            e1[i] = p1[i] - p0[i];
+            e2[i] = p2[i] - p0[i];
+        }
+
+        double len1 = std::sqrt(Dot(e1, e1));
+        if(len1 <= 0.0)
+            return;
+        for(int i = 0; i < QuadricDim; ++i)
+            e1[i] /= len1;
+
+        // Gram-Schmidt the second edge against the first.
+        double d = Dot(e2, e1);
+        for(int i = 0; i < QuadricDim; ++i)
+            e2[i] -= d*e1[i];
+
+        double len2 = std::sqrt(Dot(e2, e2));
+        if(len2 <= 0.0)
+            return;
+        for(int i = 0; i < QuadricDim; ++i)
+            e2[i] /= len2;
+
+        double pe1 = Dot(p0, e1);
+        double pe2 = Dot(p0, e2);
+
+        int k = 0;
+        for(int i = 0; i < QuadricDim; ++i)
+        {
+            for(int j = i; j < QuadricDim; ++j, ++k)
+                q.A[k] += weight*((i == j ? 1.0 : 0.0) - e1[i]*e1[j] - e2[i]*e2[j]);
+
+            q.b[i] += weight*(pe1*e1[i] + pe2*e2[i] - p0[i]);
+        }
+
+        q.c += weight*(Dot(p0, p0) - pe1*pe1 - pe2*pe2);
+        q.w += weight;
+    }
+
+    double QuadricEval(const Quadric& q, const double* v)
+    {
+        double r = q.c;
+        int k = 0;
+        for(int i = 0; i < QuadricDim; ++i)
+        {
+            r += 2.0*q.b[i]*v[i];
+            r += q.A[k++]*v[i]*v[i];
+            for(int j = i + 1; j < QuadricDim; ++j)
+                r += 2.0*q.A[k++]*v[i]*v[j];
+        }
+        return r;
+    }
+
+    void QuadricAdd(Quadric& dst, const Quadric& src)
+    {
+        for(int i = 0; i < QuadricTerms; ++i)
+            dst.A[i] += src.A[i];
+        for(int i = 0; i < QuadricDim; ++i)
+            dst.b[i] += src.b[i];
+        dst.c += src.c;
+        dst.w += src.w;
+    }
+
+    // Plain position quadric: the squared distance to the planes of the triangles it was
+    // built from, with no attribute terms, for the geometric error alone.
+    struct PlaneQuadric
+    {
+        // xx, xy, xz, yy, yz, zz.
+        double A[6];
+        double b[3];
+        double c;
+        double w;
+    };
+
+    void PlaneQuadricAddTriangle(PlaneQuadric& q, const double* p0, const XMFLOAT3& normal, double weight)
+    {
+        double nx = normal.x, ny = normal.y, nz = normal.z;
+        double len = std::sqrt(nx*nx + ny*ny + nz*nz);
+        if(len <= 0.0)
+            return;
+        nx /= len; ny /= len; nz /= len;
+
+        double d = -(nx*p0[0] + ny*p0[1] + nz*p0[2]);
+        q.A[0] += weight*nx*nx; q.A[1] += weight*nx*ny; q.A[2] += weight*nx*nz;
+        q.A[3] += weight*ny*ny; q.A[4] += weight*ny*nz; q.A[5] += weight*nz*nz;
+        q.b[0] += weight*nx*d; q.b[1] += weight*ny*d; q.b[2] += weight*nz*d;
+        q.c += weight*d*d;
+        q.w += weight;
+    }
+
+    double PlaneQuadricEval(const PlaneQuadric& q, const double* v)
+    {
+        const double x = v[0], y = v[1], z = v[2];
+        return q.A[0]*x*x + 2.0*q.A[1]*x*y + 2.0*q.A[2]*x*z + q.A[3]*y*y + 2.0*q.A[4]*y*z + q.A[5]*z*z +
+            2.0*(q.b[0]*x + q.b[1]*y + q.b[2]*z) + q.c;
+    }
+
+    void PlaneQuadricAdd(PlaneQuadric& dst, const PlaneQuadric& src)
+    {
+        for(int i = 0; i < 6; ++i)
+            dst.A[i] += src.A[i];
+        for(int i = 0; i < 3; ++i)
+            dst.b[i] += src.b[i];
+        dst.c += src.c;
+        dst.w += src.w;
+    }
+
+    // Area-averaged squared distance of dst to the planes src and dst stand for.
+    double GeometricError(const std::vector<PlaneQuadric>& planes, const std::vector<double>& attribs,
+        std::uint32_t src, std::uint32_t dst)
+    {
+        const double* v = &attribs[size_t(dst)*QuadricDim];
+        double error = PlaneQuadricEval(planes[src], v) + PlaneQuadricEval(planes[dst], v);
+        double weight = planes[src].w + planes[dst].w;
+
+        error = weight > 0.0 ? error/weight : error;
+        return error > 0.0 ? error : 0.0;
+    }
+
+    // Cost of moving src onto dst, as the area-averaged squared distance.
+    double CollapseCost(const std::vector<Quadric>& quadrics, const std::vector<double>& attribs,
+        std::uint32_t src, std::uint32_t dst)
+    {
+        const double* v = &attribs[size_t(dst)*QuadricDim];
+        double error = QuadricEval(quadrics[src], v) + QuadricEval(quadrics[dst], v);
+        double weight = quadrics[src].w + quadrics[dst].w;
+
+        error = weight > 0.0 ? error/weight : error;
+        return error > 0.0 ? error : 0.0;
+    }
+
+    XMFLOAT3 TriangleNormal(const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2)
+    {
+        float ax = p1.x - p0.x, ay = p1.y - p0.y, az = p1.z - p0.z;
+        float bx = p2.x - p0.x, by = p2.y - p0.y, bz = p2.z - p0.z;
+
+        return XMFLOAT3(ay*bz - az*by, az*bx - ax*bz, ax*by - ay*bx);
+    }
+
+    std::uint64_t EdgeKey(std::uint32_t a, std::uint32_t b)
+    {
+        return a < b ? (std::uint64_t(a) << 32) | b : (std::uint64_t(b) << 32) | a;
+    }
+
+    struct Collapse
+    {
+        std::uint32_t Src;
+        std::uint32_t Dst;
+        double Cost;
+    };
+}
+
+GeometryGenerator::MeshData MeshSimplifier::Simplify(const MeshData& mesh, uint32 targetIndexCount,
+    const SimplifyOptions& options, float* outError)
+{
+    const uint32 vertexCount = (uint32)mesh.Vertices.size();
+    const auto& verts = mesh.Vertices;
+
+    // Drop degenerate triangles up front so the adjacency below stays clean.
+    std::vector<uint32> indices;
+    indices.reserve(mesh.Indices32.size());
+    for(size_t i = 0; i + 2 < mesh.Indices32.size(); i += 3)
+    {
+        uint32 a = mesh.Indices32[i + 0];
+        uint32 b = mesh.Indices32[i + 1];
+        uint32 c = mesh.Indices32[i + 2];
+        if(a != b && b != c && c != a)
+        {
+            indices.push_back(a);
+            indices.push_back(b);
+            indices.push_back(c);
+        }
+    }
+
+    //
+    // Build the attribute vectors.  Positions are normalized to the unit bounding box so
+    // the attribute weights mean the same thing for any model size.
+    //
+
+    XMFLOAT3 vMin(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+    XMFLOAT3 vMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for(const auto& v : verts)
+    {
+        vMin.x = std::min(vMin.x, v.Position.x); vMax.x = std::max(vMax.x, v.Position.x);
+        vMin.y = std::min(vMin.y, v.Position.y); vMax.y = std::max(vMax.y, v.Position.y);
+        vMin.z = std::min(vMin.z, v.Position.z); vMax.z = std::max(vMax.z, v.Position.z);
+    }
+
+    double extent = std::max(std::max(vMax.x - vMin.x, vMax.y - vMin.y), vMax.z - vMin.z);
+    if(!(extent > 0.0))
+        extent = 1.0;
+
+    std::vector<double> attribs(size_t(vertexCount)*QuadricDim);
+    for(uint32 i = 0; i < vertexCount; ++i)
+    {
+        double* a = &attribs[size_t(i)*QuadricDim];
+        a[0] = (verts[i].Position.x - vMin.x)/extent;
+        a[1] = (verts[i].Position.y - vMin.y)/extent;
+        a[2] = (verts[i].Position.z - vMin.z)/extent;
+        a[3] = verts[i].Normal.x*options.NormalWeight;
+        a[4] = verts[i].Normal.y*options.NormalWeight;
+        a[5] = verts[i].Normal.z*options.NormalWeight;
+        a[6] = verts[i].TexC.x*options.TexCWeight;
+        a[7] = verts[i].TexC.y*options.TexCWeight;
+    }
+
+    Quadric zero = {};
+    std::vector<Quadric> quadrics(vertexCount, zero);
+    PlaneQuadric zeroPlane = {};
+    std::vector<PlaneQuadric> planes(vertexCount, zeroPlane);
+    for(size_t i = 0; i < indices.size(); i += 3)
+    {
+        const double* p0 = &attribs[size_t(indices[i + 0])*QuadricDim];
+        const double* p1 = &attribs[size_t(indices[i + 1])*QuadricDim];
+        const double* p2 = &attribs[size_t(indices[i + 2])*QuadricDim];
+
+        XMFLOAT3 n = TriangleNormal(
+            XMFLOAT3((float)p0[0], (float)p0[1], (float)p0[2]),
+            XMFLOAT3((float)p1[0], (float)p1[1], (float)p1[2]),
+            XMFLOAT3((float)p2[0], (float)p2[1], (float)p2[2]));
+        double area = 0.5*std::sqrt(double(n.x)*n.x + double(n.y)*n.y + double(n.z)*n.z);
+
+        for(int k = 0; k < 3; ++k)
+        {
+            QuadricAddTriangle(quadrics[indices[i + k]], p0, p1, p2, area);
+            PlaneQuadricAddTriangle(planes[indices[i + k]], p0, n, area);
+        }
+    }
+
+    //
+    // Lock border vertices: any edge used by a single triangle.
+    //
+
+    std::vector<std::uint8_t> locked(vertexCount, 0);
+    if(options.LockBorders)
+    {
+        std::vector<std::uint64_t> edges;
+        edges.reserve(indices.size());
+        for(size_t i = 0; i < indices.size(); i += 3)
+        {
+            for(int k = 0; k < 3; ++k)
+                edges.push_back(EdgeKey(indices[i + k], indices[i + (k + 1)%3]));
+        }
+        std::sort(edges.begin(), edges.end());
+
+        for(size_t i = 0; i < edges.size(); )
+        {
+            size_t j = i + 1;
+            while(j < edges.size() && edges[j] == edges[i])
+                ++j;
+
+            if(j - i == 1)
+            {
+                locked[uint32(edges[i] >> 32)] = 1;
+                locked[uint32(edges[i] & 0xffffffff)] = 1;
+            }
+            i = j;
+        }
+    }
+
+    const double maxError = options.MaxError < FLT_MAX ?
+        (options.MaxError/extent)*(options.MaxError/extent) : DBL_MAX;
+    const size_t targetTriangles = targetIndexCount/3;
+
+    // Squared, in the normalized positions.
+    double resultError = 0.0;
+
+    std::vector<uint32> remap(vertexCount);
+    std::vector<uint32> triOffsets(vertexCount + 1);
+    std::vector<uint32> triList;
+    std::vector<std::uint64_t> edges;
+    std::vector<Collapse> collapses;
+    std::vector<std::uint8_t> touched(vertexCount);
+    std::vector<uint32> srcNeighbors;
+    std::vector<uint32> dstNeighbors;
+    std::vector<uint32> opposite;
+
+    // The vertices sharing a surviving triangle with v, after this pass's collapses.
+    auto gatherNeighbors = [&](uint32 v, std::vector<uint32>& neighbors)
+    {
+        neighbors.clear();
+        for(uint32 t = triOffsets[v]; t < triOffsets[v + 1]; ++t)
+        {
+            const uint32* tri = &indices[size_t(triList[t])*3];
+            uint32 v0 = remap[tri[0]];
+            uint32 v1 = remap[tri[1]];
+            uint32 v2 = remap[tri[2]];
+            if(v0 == v1 || v1 == v2 || v2 == v0)
+                continue;
+
+            if(v0 != v) neighbors.push_back(v0);
+            if(v1 != v) neighbors.push_back(v1);
+            if(v2 != v) neighbors.push_back(v2);
+        }
+        std::sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+    };
+
+    while(indices.size()/3 > targetTriangles)
+    {
+        const size_t triCount = indices.size()/3;
+
+        // Vertex -> triangle adjacency for this pass.
+        std::fill(triOffsets.begin(), triOffsets.end(), 0);
+        for(uint32 idx : indices)
+            triOffsets[idx + 1]++;
+        for(uint32 i = 0; i < vertexCount; ++i)
+            triOffsets[i + 1] += triOffsets[i];
+
+        triList.resize(indices.size());
+        {
+            std::vector<uint32> fill(triOffsets.begin(), triOffsets.end() - 1);
+            for(size_t i = 0; i < indices.size(); ++i)
+                triList[fill[indices[i]]++] = uint32(i/3);
+        }
+
+        // Unique edges, each considered in its cheaper legal direction.
+        edges.clear();
+        for(size_t i = 0; i < indices.size(); i += 3)
+        {
+            for(int k = 0; k < 3; ++k)
+                edges.push_back(EdgeKey(indices[i + k], indices[i + (k + 1)%3]));
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+        collapses.clear();
+        for(std::uint64_t e : edges)
+        {
+            uint32 a = uint32(e >> 32);
+            uint32 b = uint32(e & 0xffffffff);
+
+            double costAB = locked[a] ? DBL_MAX : CollapseCost(quadrics, attribs, a, b);
+            double costBA = locked[b] ? DBL_MAX : CollapseCost(quadrics, attribs, b, a);
+            if(costAB == DBL_MAX && costBA == DBL_MAX)
+                continue;
+
+            Collapse c;
+            c.Src = costAB <= costBA ? a : b;
+            c.Dst = costAB <= costBA ? b : a;
+            c.Cost = std::min(costAB, costBA);
+            collapses.push_back(c);
+        }
+
+        if(collapses.empty())
+            break;
+
+        std::sort(collapses.begin(), collapses.end(),
+            [](const Collapse& x, const Collapse& y) { return x.Cost < y.Cost; });
+
+        // Each interior collapse removes two triangles.  Only accept collapses up to a
+        // little past the goal's cost so later passes can pick up cheaper ones that
+        // appear once the neighborhood changes.
+        size_t goal = std::max<size_t>((triCount - targetTriangles)/2, 1);
+        double passLimit = collapses[std::min(goal, collapses.size()) - 1].Cost*1.5;
+
+        for(uint32 i = 0; i < vertexCount; ++i)
+            remap[i] = i;
+        std::fill(touched.begin(), touched.end(), 0);
+
+        size_t removed = 0;
+        size_t performed = 0;
+        for(const Collapse& c : collapses)
+        {
+            if(c.Cost > passLimit)
+                break;
+
+            if(touched[c.Src] || touched[c.Dst])
+                continue;
+
+            // MaxError bounds the geometric error; the attribute terms only order the
+            // collapses.
+            const double error = GeometricError(planes, attribs, c.Src, c.Dst);
+            if(error > maxError)
+                continue;
+
+            // Reject collapses that flip or flatten any triangle that survives.
+            bool flips = false;
+            size_t collapsedTris = 0;
+            opposite.clear();
+            for(uint32 t = triOffsets[c.Src]; t < triOffsets[c.Src + 1] && !flips; ++t)
+            {
+                const uint32* tri = &indices[size_t(triList[t])*3];
+                uint32 v0 = remap[tri[0]];
+                uint32 v1 = remap[tri[1]];
+                uint32 v2 = remap[tri[2]];
+
+                if(v0 == c.Dst || v1 == c.Dst || v2 == c.Dst)
+                {
+                    if(v0 != v1 && v1 != v2 && v2 != v0)
+                    {
+                        collapsedTris++;
+                        opposite.push_back(v0 != c.Src && v0 != c.Dst ? v0 : v1 != c.Src && v1 != c.Dst ? v1 : v2);
+                    }
+                    continue;
+                }
+                if(v0 == v1 || v1 == v2 || v2 == v0)
+                    continue;
+
+                XMFLOAT3 p0 = verts[v0].Position;
+                XMFLOAT3 p1 = verts[v1].Position;
+                XMFLOAT3 p2 = verts[v2].Position;
+                XMFLOAT3 before = TriangleNormal(p0, p1, p2);
+
+                const XMFLOAT3& to = verts[c.Dst].Position;
+                if(v0 == c.Src) p0 = to;
+                if(v1 == c.Src) p1 = to;
+                if(v2 == c.Src) p2 = to;
+                XMFLOAT3 after = TriangleNormal(p0, p1, p2);
+
+                float d = before.x*after.x + before.y*after.y + before.z*after.z;
+                float lb = before.x*before.x + before.y*before.y + before.z*before.z;
+                float la = after.x*after.x + after.y*after.y + after.z*after.z;
+
+                // cos(angle) must stay above 0.25.
+                flips = la <= 0.0f || d <= 0.0f || d*d <= 0.0625f*lb*la;
+            }
+
+            if(flips)
+                continue;
+
+            // Link condition: the only vertices next to both ends are the ones across
+            // the triangles on the edge.  Any other would pinch the surface into a
+            // non-manifold edge or fold two sheets together.
+            std::sort(opposite.begin(), opposite.end());
+            opposite.erase(std::unique(opposite.begin(), opposite.end()), opposite.end());
+            gatherNeighbors(c.Src, srcNeighbors);
+            gatherNeighbors(c.Dst, dstNeighbors);
+
+            size_t common = 0;
+            for(size_t i = 0, j = 0; i < srcNeighbors.size() && j < dstNeighbors.size();)
+            {
+                if(srcNeighbors[i] < dstNeighbors[j])
+                    ++i;
+                else if(dstNeighbors[j] < srcNeighbors[i])
+                    ++j;
+                else
+                {
+                    common++;
+                    ++i;
+                    ++j;
+                }
+            }
+            if(common != opposite.size())
+                continue;
+
+            remap[c.Src] = c.Dst;
+            QuadricAdd(quadrics[c.Dst], quadrics[c.Src]);
+            PlaneQuadricAdd(planes[c.Dst], planes[c.Src]);
+            touched[c.Src] = 1;
+            touched[c.Dst] = 1;
+
+            resultError = std::max(resultError, error);
+            removed += collapsedTris;
+            performed++;
+
+            if(triCount - std::min(removed, triCount) <= targetTriangles)
+                break;
+        }
+
+        if(performed == 0)
+            break;
+
+        // Apply the collapses and drop the triangles that became degenerate.
+        size_t write = 0;
+        for(size_t i = 0; i < indices.size(); i += 3)
+        {
+            uint32 a = remap[indices[i + 0]];
+            uint32 b = remap[indices[i + 1]];
+            uint32 c = remap[indices[i + 2]];
+            if(a != b && b != c && c != a)
+            {
+                indices[write++] = a;
+                indices[write++] = b;
+                indices[write++] = c;
+            }
+        }
+        indices.resize(write);
+    }
+
+    //
+    // Compact the vertex buffer in first-use order.
+    //
+
+    MeshData result;
+    const uint32 unused = 0xffffffff;
+    std::fill(remap.begin(), remap.end(), unused);
+
+    result.Indices32.resize(indices.size());
+    for(size_t i = 0; i < indices.size(); ++i)
+    {
+        uint32 v = indices[i];
+        if(remap[v] == unused)
+        {
+            remap[v] = (uint32)result.Vertices.size();
+            result.Vertices.push_back(verts[v]);
+        }
+        result.Indices32[i] = remap[v];
+    }
+
+    if(outError)
+        *outError = float(std::sqrt(resultError)*extent);
+
+    return result;
+}
+
+std::vector<MeshLod> MeshSimplifier::BuildLodChain(const MeshData& mesh, uint32 lodCount,
+    float reduction, const SimplifyOptions& options)
+{
+    std::vector<MeshLod> lods;
+    if(lodCount == 0)
+        return lods;
+
+    lods.reserve(lodCount);
+
+    MeshLod source;
+    source.Mesh.Vertices = mesh.Vertices;
+    source.Mesh.Indices32 = mesh.Indices32;
+    lods.push_back(std::move(source));
+
+    float target = (float)mesh.Indices32.size();
+    for(uint32 i = 1; i < lodCount; ++i)
+    {
+        target *= reduction;
+
+        MeshLod lod;
+        lod.Mesh = Simplify(mesh, (uint32)target/3*3, options, &lod.Error);
+
+        // Nothing left to remove within the error limit.
+        if(lod.Mesh.Indices32.empty() ||
+           lod.Mesh.Indices32.size() >= lods.back().Mesh.Indices32.size())
+            break;
+
+        lod.Error = std::max(lod.Error, lods.back().Error);
+        lods.push_back(std::move(lod));
+    }
+
+    return lods;
+}
+
+MeshSimplifier::uint32 MeshSimplifier::SelectLod(const float* lodErrors, uint32 lodCount, float objectScale,
+    float distance, float projScaleY, float viewportHeight, float pixelThreshold)
+{
+    // World units to pixels at the given view distance.
+    float pixelsPerUnit = projScaleY*0.5f*viewportHeight/std::max(distance, 1e-4f);
+
+    uint32 lod = 0;
+    for(uint32 i = 1; i < lodCount; ++i)
+    {
+        if(lodErrors[i]*objectScale*pixelsPerUnit > pixelThreshold)
+            break;
+        lod = i;
+    }
+    return lod;
+}
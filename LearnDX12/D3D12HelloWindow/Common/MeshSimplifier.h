@@ -0,0 +1,77 @@
+//***************************************************************************************
+// MeshSimplifier.h
+//
+// Edge-collapse mesh simplification driven by quadric error metrics, used to build
+// LOD chains from any GeometryGenerator::MeshData.
+//
+// The quadrics are the generalized (position + attribute) form from Garland & Heckbert
+// "Simplifying Surfaces with Color and Texture using Quadric Error Metrics", so normals
+// and texture coordinates contribute to the collapse cost.  Collapses are half-edge
+// collapses: the surviving vertex keeps its own attributes and no new vertices are made.
+// Collapses that would fold the surface, or break the link condition and leave it
+// non-manifold, are rejected.
+//
+// The reported error is geometric only: a plain position quadric is kept next to the
+// attribute one, so LOD thresholds in world units are not skewed by normal and uv terms.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include <cfloat>
+#include <vector>
+
+struct SimplifyOptions
+{
+    // Weights for the normal and texture coordinate terms of the quadric,
+    // relative to positions normalized to the unit bounding box.
+    float NormalWeight = 0.5f;
+    float TexCWeight = 0.5f;
+
+    // Keep vertices on open borders fixed.  Attribute seams (vertices split by
+    // normal or uv) are borders in the index topology, so this also keeps seams.
+    bool LockBorders = true;
+
+    // Reject collapses whose geometric error would exceed this, in object space.
+    float MaxError = FLT_MAX;
+};
+
+struct MeshLod
+{
+    GeometryGenerator::MeshData Mesh;
+
+    // Object space deviation from the source mesh, the largest area-weighted RMS
+    // distance of a collapsed vertex to the source planes it replaces; 0 for the source.
+    float Error = 0.0f;
+};
+
+class MeshSimplifier
+{
+public:
+    using MeshData = GeometryGenerator::MeshData;
+    using uint32 = GeometryGenerator::uint32;
+
+    ///<summary>
+    /// Collapses edges until the mesh has at most targetIndexCount indices or the
+    /// error limit is hit.  Unreferenced vertices are removed from the result, and
+    /// outError receives the geometric error as MeshLod::Error describes it.
+    ///</summary>
+    static MeshData Simplify(const MeshData& mesh, uint32 targetIndexCount,
+        const SimplifyOptions& options = SimplifyOptions(), float* outError = nullptr);
+
+    ///<summary>
+    /// Builds lodCount levels, finest first.  Level 0 is a copy of the source and each
+    /// following level targets 'reduction' times the index count of the previous one.
+    /// Every level is simplified from the source mesh to avoid compounding error.
+    ///</summary>
+    static std::vector<MeshLod> BuildLodChain(const MeshData& mesh, uint32 lodCount,
+        float reduction = 0.5f, const SimplifyOptions& options = SimplifyOptions());
+
+    ///<summary>
+    /// Picks the coarsest level whose error, projected to the screen, stays below
+    /// pixelThreshold.  lodErrors must be ascending (as returned by BuildLodChain).
+    /// projScaleY is the [1][1] entry of the projection matrix.
+    ///</summary>
+    static uint32 SelectLod(const float* lodErrors, uint32 lodCount, float objectScale,
+        float distance, float projScaleY, float viewportHeight, float pixelThreshold = 1.0f);
+};
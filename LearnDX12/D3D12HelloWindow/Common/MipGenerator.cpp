@@ -0,0 +1,467 @@
+//***************************************************************************************
+// MipGenerator.cpp
+//***************************************************************************************
+
+#include "MipGenerator.h"
+#include <DirectXMath.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+    using uint8 = MipGenerator::uint8;
+    using uint32 = MipGenerator::uint32;
+    using uint16 = std::uint16_t;
+
+    // Weights of the Count source texels from First on that make up one destination
+    // texel; they start at Offset in Kernel::Weights.
+    struct Taps
+    {
+        uint32 First;
+        uint32 Count;
+        uint32 Offset;
+    };
+
+    struct Kernel
+    {
+        std::vector<Taps> Texels;
+        std::vector<float> Weights;
+    };
+
+    // Appends the taps of one destination texel from weights over [first, first + n),
+    // normalized to sum to one.
+    void AddTaps(Kernel& kernel, uint32 first, const std::vector<float>& window)
+    {
+        // Trim zero weights off both ends.
+        size_t begin = 0, end = window.size();
+        while(begin + 1 < end && window[begin] == 0.0f)
+            ++begin;
+        while(end - 1 > begin && window[end - 1] == 0.0f)
+            --end;
+
+        float sum = 0.0f;
+        for(size_t i = begin; i < end; ++i)
+            sum += window[i];
+        const float scale = sum != 0.0f ? 1.0f / sum : 0.0f;
+
+        Taps taps;
+        taps.First = first + (uint32)begin;
+        taps.Count = (uint32)(end - begin);
+        taps.Offset = (uint32)kernel.Weights.size();
+        for(size_t i = begin; i < end; ++i)
+            kernel.Weights.push_back(window[i] * scale);
+        kernel.Texels.push_back(taps);
+    }
+
+    // Each destination texel averages exactly the source span it covers, fractions of
+    // the texels at its ends included.
+    Kernel BoxKernel(uint32 srcSize, uint32 dstSize)
+    {
+        Kernel kernel;
+        const double scale = (double)srcSize / dstSize;
+        std::vector<float> window;
+        for(uint32 x = 0; x < dstSize; ++x)
+        {
+            const double begin = x * scale;
+            const double end = (x + 1) * scale;
+            const uint32 first = (uint32)std::floor(begin);
+            const uint32 last = std::min((uint32)std::ceil(end), srcSize) - 1;
+
+            window.assign(last - first + 1, 0.0f);
+            for(uint32 i = first; i <= last; ++i)
+                window[i - first] = (float)(std::min<double>(i + 1, end) - std::max<double>(i, begin));
+            AddTaps(kernel, first, window);
+        }
+        return kernel;
+    }
+
+    double BesselI0(double x)
+    {
+        // Power series; converges quickly for the alphas a window uses.
+        double sum = 1.0, term = 1.0;
+        const double halfSq = 0.25 * x * x;
+        for(int k = 1; k < 50 && term > 1e-12 * sum; ++k)
+        {
+            term *= halfSq / ((double)k * k);
+            sum += term;
+        }
+        return sum;
+    }
+
+    // Windowed sinc, radius destination texels either side, clamped at the edges.
+    Kernel KaiserKernel(uint32 srcSize, uint32 dstSize, float radius, float alpha)
+    {
+        Kernel kernel;
+        const double scale = (double)srcSize / dstSize;
+        const double support = radius * scale;
+        const double normalizer = 1.0 / BesselI0(alpha);
+
+        std::vector<float> window;
+        for(uint32 x = 0; x < dstSize; ++x)
+        {
+            const double center = (x + 0.5) * scale;
+            const int lo = (int)std::floor(center - support);
+            const int hi = (int)std::ceil(center + support);
+
+            const uint32 first = (uint32)std::max(lo, 0);
+            const uint32 last = (uint32)std::min(hi, (int)srcSize - 1);
+            window.assign(last - first + 1, 0.0f);
+
+            for(int i = lo; i <= hi; ++i)
+            {
+                const double t = (i + 0.5 - center) / scale;
+                const double r = t / radius;
+                if(r <= -1.0 || r >= 1.0)
+                    continue;
+
+                const double sinc = t == 0.0 ? 1.0 : std::sin(XM_PI * t) / (XM_PI * t);
+                const double kaiser = BesselI0(alpha * std::sqrt(1.0 - r * r)) * normalizer;
+
+                // Taps past an edge land on the edge texel.
+                const uint32 clamped = (uint32)std::min(std::max(i, 0), (int)srcSize - 1);
+                window[clamped - first] += (float)(sinc * kaiser);
+            }
+            AddTaps(kernel, first, window);
+        }
+        return kernel;
+    }
+
+    //
+    // Texel conversion.
+    //
+
+    struct SrgbTables
+    {
+        float Decode[256];
+
+        // Midpoints between consecutive decoded values: the byte nearest a linear value
+        // is the number of midpoints below it.
+        float Midpoints[255];
+
+        SrgbTables()
+        {
+            for(int i = 0; i < 256; ++i)
+            {
+                const double c = i / 255.0;
+                Decode[i] = (float)(c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+            }
+            for(int i = 0; i < 255; ++i)
+                Midpoints[i] = 0.5f * (Decode[i] + Decode[i + 1]);
+        }
+
+        uint8 Encode(float linear)const
+        {
+            return (uint8)(std::upper_bound(Midpoints, Midpoints + 255, linear) - Midpoints);
+        }
+    };
+
+    const SrgbTables& Srgb()
+    {
+        static const SrgbTables tables;
+        return tables;
+    }
+
+    float HalfToFloat(uint16 h)
+    {
+        const uint32 sign = (uint32)(h & 0x8000) << 16;
+        const uint32 exponent = (h >> 10) & 0x1f;
+        uint32 mantissa = h & 0x3ff;
+
+        uint32 bits;
+        if(exponent == 0x1f)
+            bits = sign | 0x7f800000 | (mantissa << 13);
+        else if(exponent != 0)
+            bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+        else if(mantissa == 0)
+            bits = sign;
+        else
+        {
+            // Denormal: normalize the mantissa.
+            uint32 e = 113;
+            while(!(mantissa & 0x400))
+            {
+                mantissa <<= 1;
+                --e;
+            }
+            bits = sign | (e << 23) | ((mantissa & 0x3ff) << 13);
+        }
+
+        float f;
+        std::memcpy(&f, &bits, 4);
+        return f;
+    }
+
+    uint16 FloatToHalf(float f)
+    {
+        uint32 bits;
+        std::memcpy(&bits, &f, 4);
+
+        const uint32 sign = (bits >> 16) & 0x8000;
+        const uint32 exponent = (bits >> 23) & 0xff;
+        uint32 mantissa = bits & 0x7fffff;
+
+        if(exponent == 0xff)
+            return (uint16)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+        const int e = (int)exponent - 112;
+        if(e >= 0x1f)
+            return (uint16)(sign | 0x7c00);
+        if(e <= 0)
+        {
+            // Denormal or zero, rounded to nearest even.
+            if(e < -10)
+                return (uint16)sign;
+            mantissa |= 0x800000;
+            const uint32 shift = (uint32)(14 - e);
+            uint32 half = mantissa >> shift;
+            const uint32 rest = mantissa & ((1u << shift) - 1);
+            const uint32 midpoint = 1u << (shift - 1);
+            if(rest > midpoint || (rest == midpoint && (half & 1)))
+                ++half;
+            return (uint16)(sign | half);
+        }
+
+        uint32 half = ((uint32)e << 10) | (mantissa >> 13);
+        const uint32 rest = mantissa & 0x1fff;
+        if(rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+            ++half;     // may carry into the exponent, up to infinity
+        return (uint16)(sign | half);
+    }
+
+    enum class Storage { Unorm8, Half, Float };
+
+    struct FormatDesc
+    {
+        Storage Type;
+        uint32 Channels;
+        bool Srgb;
+    };
+
+    bool Describe(uint32 format, FormatDesc& desc)
+    {
+        switch(format)
+        {
+        case DdsFile::FormatR8G8B8A8Unorm:
+        case DdsFile::FormatB8G8R8A8Unorm:
+            desc = { Storage::Unorm8, 4, false };
+            return true;
+        case DdsFile::FormatR8G8B8A8UnormSrgb:
+        case DdsFile::FormatB8G8R8A8UnormSrgb:
+            desc = { Storage::Unorm8, 4, true };
+            return true;
+        case DdsFile::FormatR16G16B16A16Float:
+            desc = { Storage::Half, 4, false };
+            return true;
+        case DdsFile::FormatR32G32B32A32Float:
+            desc = { Storage::Float, 4, false };
+            return true;
+        case DdsFile::FormatR32Float:
+            desc = { Storage::Float, 1, false };
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // count texels, to floats in linear light.  Byte order is kept: BGRA stays BGRA,
+    // and in both the fourth channel is alpha.
+    void ToFloat(const FormatDesc& desc, bool srgb, const void* src, float* dst, size_t count)
+    {
+        const size_t values = count * desc.Channels;
+        if(desc.Type == Storage::Float)
+        {
+            std::memcpy(dst, src, values * sizeof(float));
+        }
+        else if(desc.Type == Storage::Half)
+        {
+            const uint16* h = static_cast<const uint16*>(src);
+            for(size_t i = 0; i < values; ++i)
+                dst[i] = HalfToFloat(h[i]);
+        }
+        else
+        {
+            const uint8* b = static_cast<const uint8*>(src);
+            const float* decode = Srgb().Decode;
+            for(size_t i = 0; i < values; i += 4)
+            {
+                for(size_t c = 0; c < 3; ++c)
+                    dst[i + c] = srgb ? decode[b[i + c]] : b[i + c] * (1.0f / 255.0f);
+                dst[i + 3] = b[i + 3] * (1.0f / 255.0f);
+            }
+        }
+    }
+
+    void FromFloat(const FormatDesc& desc, bool srgb, const float* src, void* dst, size_t count)
+    {
+        const size_t values = count * desc.Channels;
+        if(desc.Type == Storage::Float)
+        {
+            std::memcpy(dst, src, values * sizeof(float));
+        }
+        else if(desc.Type == Storage::Half)
+        {
+            uint16* h = static_cast<uint16*>(dst);
+            for(size_t i = 0; i < values; ++i)
+                h[i] = FloatToHalf(src[i]);
+        }
+        else
+        {
+            uint8* b = static_cast<uint8*>(dst);
+            const SrgbTables& tables = Srgb();
+            auto unorm = [](float v) { return (uint8)(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f); };
+            for(size_t i = 0; i < values; i += 4)
+            {
+                for(size_t c = 0; c < 3; ++c)
+                    b[i + c] = srgb ? tables.Encode(src[i + c]) : unorm(src[i + c]);
+                b[i + 3] = unorm(src[i + 3]);
+            }
+        }
+    }
+
+    inline XMVECTOR LoadQuad(const float* v)
+    {
+        return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(v));
+    }
+
+    inline void StoreQuad(float* v, FXMVECTOR value)
+    {
+        XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(v), value);
+    }
+
+    // One destination row: the source rows under it blended into row, then filtered
+    // across into dst.
+    void FilterRow(const float* src, uint32 srcWidth, uint32 channels, const Taps& rowTaps,
+        const float* rowWeights, const Kernel& columns, float* row, float* dst)
+    {
+        const size_t stride = (size_t)srcWidth * channels;
+        const float* first = src + rowTaps.First * stride;
+
+        // Vertical, four floats at a time whatever the texel layout.
+        size_t i = 0;
+        for(; i + 4 <= stride; i += 4)
+        {
+            XMVECTOR sum = XMVectorZero();
+            for(uint32 k = 0; k < rowTaps.Count; ++k)
+                sum = XMVectorMultiplyAdd(LoadQuad(first + k * stride + i), XMVectorReplicate(rowWeights[k]), sum);
+            StoreQuad(row + i, sum);
+        }
+        for(; i < stride; ++i)
+        {
+            float sum = 0.0f;
+            for(uint32 k = 0; k < rowTaps.Count; ++k)
+                sum += first[k * stride + i] * rowWeights[k];
+            row[i] = sum;
+        }
+
+        // Horizontal, a texel at a time for four channels.
+        const uint32 dstWidth = (uint32)columns.Texels.size();
+        for(uint32 x = 0; x < dstWidth; ++x)
+        {
+            const Taps& taps = columns.Texels[x];
+            const float* weights = &columns.Weights[taps.Offset];
+            if(channels == 4)
+            {
+                XMVECTOR sum = XMVectorZero();
+                for(uint32 k = 0; k < taps.Count; ++k)
+                    sum = XMVectorMultiplyAdd(LoadQuad(row + (taps.First + k) * 4), XMVectorReplicate(weights[k]), sum);
+                StoreQuad(dst + x * 4, sum);
+            }
+            else
+            {
+                float sum = 0.0f;
+                for(uint32 k = 0; k < taps.Count; ++k)
+                    sum += row[taps.First + k] * weights[k];
+                dst[x] = sum;
+            }
+        }
+    }
+
+    // About this many floats per ParallelFor chunk.
+    size_t RowGrain(uint32 width, uint32 channels)
+    {
+        return std::max<size_t>(1, 16384 / ((size_t)width * channels));
+    }
+}
+
+bool MipGenerator::CanGenerate(uint32 format)
+{
+    FormatDesc desc;
+    return Describe(format, desc);
+}
+
+bool MipGenerator::Generate(uint32 format, uint32 width, uint32 height, const void* level0,
+    const Options& options, DdsFile::Info& info, std::vector<uint8>& surfaces, ThreadPool& pool)
+{
+    FormatDesc desc;
+    if(!Describe(format, desc) || width == 0 || height == 0 || level0 == nullptr)
+        return false;
+
+    const bool srgb = desc.Type == Storage::Unorm8 && (desc.Srgb || options.SrgbColor);
+    const uint32 channels = desc.Channels;
+
+    uint32 mipCount = 1;
+    while((width >> mipCount) > 0 || (height >> mipCount) > 0)
+        ++mipCount;
+    mipCount = std::min(mipCount, 15u);
+    if(options.MaxMipCount > 0)
+        mipCount = std::min(mipCount, options.MaxMipCount);
+
+    info = DdsFile::Info();
+    info.Width = width;
+    info.Height = height;
+    info.MipCount = mipCount;
+    info.Format = format;
+    surfaces.resize((size_t)DdsFile::DataSize(info));
+
+    // Mip 0 is copied as is; the others come from floats.
+    const size_t level0Size = (size_t)DdsFile::MipSize(info, 0);
+    std::memcpy(surfaces.data(), level0, level0Size);
+    if(mipCount == 1)
+        return true;
+
+    const size_t texelBytes = DdsFile::BitsPerPixel(format) / 8;
+    std::vector<float> src((size_t)width * height * channels);
+    pool.ParallelFor(height, RowGrain(width, channels), [&](size_t begin, size_t end)
+    {
+        const uint8* bytes = static_cast<const uint8*>(level0);
+        for(size_t y = begin; y < end; ++y)
+            ToFloat(desc, srgb, bytes + y * width * texelBytes, &src[y * width * channels], width);
+    });
+
+    std::vector<float> dst;
+    uint8* out = surfaces.data() + level0Size;
+    uint32 srcWidth = width, srcHeight = height;
+    for(uint32 mip = 1; mip < mipCount; ++mip)
+    {
+        const uint32 dstWidth = DdsFile::MipDimension(width, mip);
+        const uint32 dstHeight = DdsFile::MipDimension(height, mip);
+
+        const Kernel columns = options.Filter == Kaiser ?
+            KaiserKernel(srcWidth, dstWidth, options.KaiserRadius, options.KaiserAlpha) : BoxKernel(srcWidth, dstWidth);
+        const Kernel rows = options.Filter == Kaiser ?
+            KaiserKernel(srcHeight, dstHeight, options.KaiserRadius, options.KaiserAlpha) : BoxKernel(srcHeight, dstHeight);
+
+        dst.resize((size_t)dstWidth * dstHeight * channels);
+        pool.ParallelFor(dstHeight, RowGrain(dstWidth, channels), [&](size_t begin, size_t end)
+        {
+            std::vector<float> row((size_t)srcWidth * channels);
+            for(size_t y = begin; y < end; ++y)
+            {
+                const Taps& taps = rows.Texels[y];
+                float* dstRow = &dst[y * dstWidth * channels];
+                FilterRow(src.data(), srcWidth, channels, taps, &rows.Weights[taps.Offset], columns, row.data(), dstRow);
+                FromFloat(desc, srgb, dstRow, out + y * dstWidth * texelBytes, dstWidth);
+            }
+        });
+
+        // The next mip filters this one, unrounded.
+        out += (size_t)DdsFile::MipSize(info, mip);
+        std::swap(src, dst);
+        srcWidth = dstWidth;
+        srcHeight = dstHeight;
+    }
+    return true;
+}
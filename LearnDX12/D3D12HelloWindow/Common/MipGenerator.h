@@ -0,0 +1,63 @@
+//***************************************************************************************
+// MipGenerator.h
+//
+// Builds the mip chain of an uncompressed 2D texture on the CPU, for textures that
+// arrive with a single level.  Each mip is filtered from the one above it, with a box
+// or a Kaiser windowed sinc, separably: the rows a destination row needs are first
+// blended into one row, four floats at a time, and that row is then filtered across.
+// Destination rows are spread over a ThreadPool.
+//
+// Sizes need not be powers of two.  Each mip is half the one above, rounded down as
+// Direct3D does, and every destination texel filters exactly the source area it
+// covers, so odd sizes neither shift nor drop texels.
+//
+// Filtering is done in linear light: 8 bit colour channels are decoded from sRGB
+// first and encoded again after, while alpha and float formats are taken as linear.
+// The result is laid out as DdsFile describes, ready for DdsFile::Save().
+//***************************************************************************************
+
+#pragma once
+
+#include "DdsFile.h"
+#include "ThreadPool.h"
+#include <cstdint>
+#include <vector>
+
+class MipGenerator
+{
+public:
+    using uint8 = std::uint8_t;
+    using uint32 = std::uint32_t;
+
+    enum FilterType { Box, Kaiser };
+
+    struct Options
+    {
+        FilterType Filter = Box;
+
+        // Treat the colour of the UNORM 8 bit formats as sRGB encoded, as most colour
+        // textures are whatever their format says; the _SRGB formats always are.  Turn
+        // off for data such as normal maps.
+        bool SrgbColor = true;
+
+        // Kaiser filter reach either side of a destination texel, in destination
+        // texels, and window shape.
+        float KaiserRadius = 3.0f;
+        float KaiserAlpha = 4.0f;
+
+        // 0 for the full chain down to 1x1.
+        uint32 MaxMipCount = 0;
+    };
+
+    // RGBA8 and BGRA8 (UNORM and sRGB), RGBA16F, RGBA32F and R32F.
+    static bool CanGenerate(uint32 format);
+
+    ///<summary>
+    /// Fills info and surfaces with the mip chain of the width x height image of format
+    /// whose tightly packed rows start at level0; mip 0 is a copy of it.  Returns false
+    /// for formats not handled here.
+    ///</summary>
+    static bool Generate(uint32 format, uint32 width, uint32 height, const void* level0,
+        const Options& options, DdsFile::Info& info, std::vector<uint8>& surfaces,
+        ThreadPool& pool = ThreadPool::Default());
+};
@@ -0,0 +1,215 @@
+//***************************************************************************************
+// PipelineCache.cpp
+//***************************************************************************************
+
+#include "PipelineCache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // Bump whenever the file layout changes.
+    const std::uint32_t BlobVersion = 1;
+    const char BlobMagic[4] = { 'P', 'S', 'O', 'B' };
+
+    void MakeDirectory(const std::string& path)
+    {
+#ifdef _WIN32
+        _mkdir(path.c_str());
+#else
+        mkdir(path.c_str(), 0755);
+#endif
+    }
+
+    // A temporary next to path that no other writer uses, in this process or in
+    // another launch sharing the directory.
+    std::string TempPath(const std::string& path)
+    {
+        static std::atomic<std::uint32_t> counter{0};
+#ifdef _WIN32
+        const int pid = _getpid();
+#else
+        const int pid = (int)getpid();
+#endif
+        return path + "." + std::to_string(pid) + "-" + std::to_string(counter++) + ".tmp";
+    }
+}
+
+PipelineCache::PipelineCache(ThreadPool& pool) :
+    mPool(pool)
+{
+}
+
+PipelineCache::~PipelineCache()
+{
+    // Workers write into mEntries; let them finish first.
+    WaitAll();
+}
+
+void PipelineCache::SetDirectory(const std::string& directory)
+{
+    if(!directory.empty())
+        MakeDirectory(directory);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mDirectory = directory;
+}
+
+PipelineCache::Handle PipelineCache::Request(const std::string& key, Builder builder)
+{
+    ++mRequests;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto it = mHandles.find(key);
+    if(it != mHandles.end())
+    {
+        ++mDeduplicated;
+        return it->second;
+    }
+
+    const Handle handle = (Handle)mEntries.size();
+    mEntries.emplace_back();
+    mHandles[key] = handle;
+
+    const std::string path = mDirectory.empty() ? std::string() : mDirectory + "/" + key + ".pso";
+    mEntries[handle].Done = mPool.Submit([this, handle, path, builder]()
+    {
+        Build(handle, path, builder);
+    }).share();
+
+    return handle;
+}
+
+void PipelineCache::Build(Handle handle, const std::string& path, const Builder& builder)
+{
+    Blob cachedBlob;
+    if(!path.empty() && LoadBlob(path, cachedBlob))
+        ++mBlobsLoaded;
+
+    std::shared_ptr<void> object;
+    Blob blob;
+    try
+    {
+        object = builder(cachedBlob, blob);
+    }
+    catch(...)
+    {
+        object = nullptr;
+    }
+    ++mBuilt;
+
+    if(object != nullptr && !path.empty() && !blob.empty() && blob != cachedBlob)
+        SaveBlob(path, blob);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    Entry& entry = mEntries[handle];
+    entry.Object = object;
+    entry.Status = object != nullptr ? State::Ready : State::Failed;
+}
+
+PipelineCache::State PipelineCache::GetState(Handle handle)const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mEntries[handle].Status;
+}
+
+std::shared_ptr<void> PipelineCache::Get(Handle handle)const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mEntries[handle].Object;
+}
+
+void PipelineCache::Wait(Handle handle)
+{
+    std::shared_future<void> done;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        done = mEntries[handle].Done;
+    }
+    done.wait();
+}
+
+void PipelineCache::WaitAll()
+{
+    std::vector<std::shared_future<void>> pending;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for(const Entry& entry : mEntries)
+            pending.push_back(entry.Done);
+    }
+
+    for(auto& done : pending)
+        done.wait();
+}
+
+bool PipelineCache::LoadBlob(const std::string& path, Blob& blob)
+{
+    std::ifstream fin(path, std::ios::binary);
+    if(!fin)
+        return false;
+
+    char magic[4];
+    std::uint32_t version = 0;
+    std::uint64_t size = 0;
+    if(!fin.read(magic, 4) || std::memcmp(magic, BlobMagic, 4) != 0 ||
+       !fin.read(reinterpret_cast<char*>(&version), sizeof(version)) || version != BlobVersion ||
+       !fin.read(reinterpret_cast<char*>(&size), sizeof(size)))
+        return false;
+
+    // A damaged or truncated file is a miss, not a huge allocation.
+    const std::streampos start = fin.tellg();
+    fin.seekg(0, std::ios::end);
+    const std::streamoff remaining = fin.tellg() - start;
+    fin.seekg(start);
+    if(remaining < 0 || size != (std::uint64_t)remaining)
+        return false;
+
+    blob.resize((size_t)size);
+    if(!fin.read(reinterpret_cast<char*>(blob.data()), (std::streamsize)size))
+    {
+        blob.clear();
+        return false;
+    }
+
+    return true;
+}
+
+void PipelineCache::SaveBlob(const std::string& path, const Blob& blob)
+{
+    // Write to a temporary and rename so a concurrent launch never reads half a file.
+    // Each writer has its own temporary, so two launches saving the same key cannot
+    // interleave their writes.
+    const std::string temp = TempPath(path);
+    {
+        std::ofstream fout(temp, std::ios::binary | std::ios::trunc);
+        if(!fout)
+            return;
+
+        const std::uint64_t size = blob.size();
+        fout.write(BlobMagic, 4);
+        fout.write(reinterpret_cast<const char*>(&BlobVersion), sizeof(BlobVersion));
+        fout.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        fout.write(reinterpret_cast<const char*>(blob.data()), (std::streamsize)size);
+
+        if(!fout)
+        {
+            fout.close();
+            std::remove(temp.c_str());
+            return;
+        }
+    }
+
+    std::remove(path.c_str());
+    if(std::rename(temp.c_str(), path.c_str()) != 0)
+        std::remove(temp.c_str());
+}
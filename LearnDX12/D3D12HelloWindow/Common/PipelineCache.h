@@ -0,0 +1,107 @@
+//***************************************************************************************
+// PipelineCache.h
+//
+// Deduplicating, asynchronous cache of expensive-to-create objects such as pipeline
+// states.  Request() returns a handle immediately; the object is built on the thread
+// pool and Get() returns nullptr until it is ready, so the caller keeps drawing with a
+// placeholder meanwhile.  Requests with the same key share one handle and one build.
+//
+// Builders may produce a blob (e.g. ID3D12PipelineState::GetCachedBlob) that is saved
+// under the key and handed back to the builder on the next launch.
+//
+// PipelineStateManager is the D3D12 front end.
+//***************************************************************************************
+
+#pragma once
+
+#include "ThreadPool.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class PipelineCache
+{
+public:
+    using uint32 = std::uint32_t;
+    using Handle = uint32;
+    using Blob = std::vector<std::uint8_t>;
+
+    enum class State
+    {
+        Pending,
+        Ready,
+        Failed
+    };
+
+    // Builds the object.  cachedBlob is what an earlier build saved for the same key
+    // (empty if none; possibly stale, e.g. after a driver update).  Fill blobOut to
+    // have it saved.  Returning nullptr marks the entry failed.  Runs on a worker.
+    using Builder = std::function<std::shared_ptr<void>(const Blob& cachedBlob, Blob& blobOut)>;
+
+    explicit PipelineCache(ThreadPool& pool = ThreadPool::Default());
+    PipelineCache(const PipelineCache& rhs) = delete;
+    PipelineCache& operator=(const PipelineCache& rhs) = delete;
+    ~PipelineCache();
+
+    // Directory for the saved blobs, created if missing.  Empty keeps nothing on disk
+    // (the default).
+    void SetDirectory(const std::string& directory);
+
+    ///<summary>
+    /// Returns the handle for key, queuing builder on the pool if the key is new.  key
+    /// is a content hash of everything the object is built from and also names the
+    /// blob file, so it must be a valid file name.  Handles stay valid for the
+    /// lifetime of the cache.
+    ///</summary>
+    Handle Request(const std::string& key, Builder builder);
+
+    State GetState(Handle handle)const;
+
+    // The built object, or nullptr while pending or after a failure.
+    std::shared_ptr<void> Get(Handle handle)const;
+
+    // Blocks until the build of handle, or of everything requested so far, is done.
+    void Wait(Handle handle);
+    void WaitAll();
+
+    uint32 Requests()const { return mRequests; }
+    uint32 Deduplicated()const { return mDeduplicated; }
+    uint32 Built()const { return mBuilt; }
+    uint32 BlobsLoaded()const { return mBlobsLoaded; }
+
+private:
+    struct Entry
+    {
+        State Status = State::Pending;
+        std::shared_ptr<void> Object;
+        std::shared_future<void> Done;
+    };
+
+    void Build(Handle handle, const std::string& path, const Builder& builder);
+
+    static bool LoadBlob(const std::string& path, Blob& blob);
+    static void SaveBlob(const std::string& path, const Blob& blob);
+
+private:
+    ThreadPool& mPool;
+
+    mutable std::mutex mMutex;
+
+    // A deque so entries never move while workers fill them in.
+    std::deque<Entry> mEntries;
+    std::unordered_map<std::string, Handle> mHandles;
+
+    std::string mDirectory;
+
+    std::atomic<uint32> mRequests{0};
+    std::atomic<uint32> mDeduplicated{0};
+    std::atomic<uint32> mBuilt{0};
+    std::atomic<uint32> mBlobsLoaded{0};
+};
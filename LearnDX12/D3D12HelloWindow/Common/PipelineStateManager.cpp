@@ -0,0 +1,234 @@
+//***************************************************************************************
+// PipelineStateManager.cpp
+//***************************************************************************************
+
+#include "PipelineStateManager.h"
+#include "ContentHash.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    // A D3D12_GRAPHICS_PIPELINE_STATE_DESC with copies of everything it points to,
+    // so a worker can create the PSO after the caller's data is gone.
+    struct OwnedGraphicsDesc
+    {
+        explicit OwnedGraphicsDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& src) :
+            Desc(src),
+            RootSignature(src.pRootSignature)
+        {
+            Desc.VS = Copy(src.VS, VS);
+            Desc.PS = Copy(src.PS, PS);
+            Desc.DS = Copy(src.DS, DS);
+            Desc.HS = Copy(src.HS, HS);
+            Desc.GS = Copy(src.GS, GS);
+
+            assert(src.StreamOutput.NumEntries == 0);
+            Desc.StreamOutput = {};
+            Desc.CachedPSO = {};
+
+            // Names first; the elements point into them.
+            const UINT count = src.InputLayout.NumElements;
+            SemanticNames.reserve(count);
+            InputElements.assign(src.InputLayout.pInputElementDescs, src.InputLayout.pInputElementDescs + count);
+            for(UINT i = 0; i < count; ++i)
+                SemanticNames.push_back(InputElements[i].SemanticName);
+            for(UINT i = 0; i < count; ++i)
+                InputElements[i].SemanticName = SemanticNames[i].c_str();
+            Desc.InputLayout = { InputElements.data(), count };
+        }
+
+        static D3D12_SHADER_BYTECODE Copy(const D3D12_SHADER_BYTECODE& src, std::vector<std::uint8_t>& storage)
+        {
+            const std::uint8_t* bytes = static_cast<const std::uint8_t*>(src.pShaderBytecode);
+            storage.assign(bytes, bytes + src.BytecodeLength);
+            return { storage.data(), storage.size() };
+        }
+
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC Desc;
+        std::vector<std::uint8_t> VS, PS, DS, HS, GS;
+        std::vector<D3D12_INPUT_ELEMENT_DESC> InputElements;
+        std::vector<std::string> SemanticNames;
+        ComPtr<ID3D12RootSignature> RootSignature;
+    };
+
+    // {3C1F8E2A-5B7D-4E91-A0C6-8D2B4F6E1A73}
+    const GUID RootSignatureHashGuid = { 0x3c1f8e2a, 0x5b7d, 0x4e91, { 0xa0, 0xc6, 0x8d, 0x2b, 0x4f, 0x6e, 0x1a, 0x73 } };
+
+    void AddShader(ContentHasher& hasher, const D3D12_SHADER_BYTECODE& shader)
+    {
+        hasher.AddPod((std::uint64_t)shader.BytecodeLength);
+        hasher.AddBytes(shader.pShaderBytecode, shader.BytecodeLength);
+    }
+
+    void AddRootSignature(ContentHasher& hasher, ID3D12RootSignature* rootSignature)
+    {
+        // None: the shaders carry it, and they are hashed already.
+        if(rootSignature == nullptr)
+        {
+            hasher.Add(std::string());
+            return;
+        }
+
+        char digest[32];
+        UINT size = sizeof(digest);
+        ThrowIfFailed(rootSignature->GetPrivateData(RootSignatureHashGuid, &size, digest));
+        hasher.Add(std::string(digest, size));
+    }
+
+    // Field by field: the blend and depth stencil descs have UINT8 masks, and the
+    // padding after them is not guaranteed to be zero.
+    void AddBlendState(ContentHasher& hasher, const D3D12_BLEND_DESC& blend)
+    {
+        hasher.AddPod(blend.AlphaToCoverageEnable);
+        hasher.AddPod(blend.IndependentBlendEnable);
+        for(const D3D12_RENDER_TARGET_BLEND_DESC& rt : blend.RenderTarget)
+        {
+            hasher.AddPod(rt.BlendEnable);
+            hasher.AddPod(rt.LogicOpEnable);
+            hasher.AddPod(rt.SrcBlend);
+            hasher.AddPod(rt.DestBlend);
+            hasher.AddPod(rt.BlendOp);
+            hasher.AddPod(rt.SrcBlendAlpha);
+            hasher.AddPod(rt.DestBlendAlpha);
+            hasher.AddPod(rt.BlendOpAlpha);
+            hasher.AddPod(rt.LogicOp);
+            hasher.AddPod(rt.RenderTargetWriteMask);
+        }
+    }
+
+    void AddRasterizerState(ContentHasher& hasher, const D3D12_RASTERIZER_DESC& rasterizer)
+    {
+        hasher.AddPod(rasterizer.FillMode);
+        hasher.AddPod(rasterizer.CullMode);
+        hasher.AddPod(rasterizer.FrontCounterClockwise);
+        hasher.AddPod(rasterizer.DepthBias);
+        hasher.AddPod(rasterizer.DepthBiasClamp);
+        hasher.AddPod(rasterizer.SlopeScaledDepthBias);
+        hasher.AddPod(rasterizer.DepthClipEnable);
+        hasher.AddPod(rasterizer.MultisampleEnable);
+        hasher.AddPod(rasterizer.AntialiasedLineEnable);
+        hasher.AddPod(rasterizer.ForcedSampleCount);
+        hasher.AddPod(rasterizer.ConservativeRaster);
+    }
+
+    void AddStencilOp(ContentHasher& hasher, const D3D12_DEPTH_STENCILOP_DESC& op)
+    {
+        hasher.AddPod(op.StencilFailOp);
+        hasher.AddPod(op.StencilDepthFailOp);
+        hasher.AddPod(op.StencilPassOp);
+        hasher.AddPod(op.StencilFunc);
+    }
+
+    void AddDepthStencilState(ContentHasher& hasher, const D3D12_DEPTH_STENCIL_DESC& depthStencil)
+    {
+        hasher.AddPod(depthStencil.DepthEnable);
+        hasher.AddPod(depthStencil.DepthWriteMask);
+        hasher.AddPod(depthStencil.DepthFunc);
+        hasher.AddPod(depthStencil.StencilEnable);
+        hasher.AddPod(depthStencil.StencilReadMask);
+        hasher.AddPod(depthStencil.StencilWriteMask);
+        AddStencilOp(hasher, depthStencil.FrontFace);
+        AddStencilOp(hasher, depthStencil.BackFace);
+    }
+}
+
+PipelineStateManager::PipelineStateManager(ID3D12Device* device, ThreadPool& pool) :
+    mDevice(device),
+    mCache(pool)
+{
+}
+
+void PipelineStateManager::SetRootSignatureBlob(ID3D12RootSignature* rootSignature, ID3DBlob* serialized)
+{
+    const std::string digest = ContentHasher::Hash(serialized->GetBufferPointer(), serialized->GetBufferSize());
+
+    ThrowIfFailed(rootSignature->SetPrivateData(RootSignatureHashGuid, (UINT)digest.size(), digest.data()));
+}
+
+std::string PipelineStateManager::HashDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+{
+    ContentHasher hasher;
+    hasher.AddBytes("GraphicsPSO", 11);
+
+    AddShader(hasher, desc.VS);
+    AddShader(hasher, desc.PS);
+    AddShader(hasher, desc.DS);
+    AddShader(hasher, desc.HS);
+    AddShader(hasher, desc.GS);
+    AddRootSignature(hasher, desc.pRootSignature);
+
+    hasher.AddPod(desc.InputLayout.NumElements);
+    for(UINT i = 0; i < desc.InputLayout.NumElements; ++i)
+    {
+        const D3D12_INPUT_ELEMENT_DESC& e = desc.InputLayout.pInputElementDescs[i];
+        hasher.Add(e.SemanticName);
+        hasher.AddPod(e.SemanticIndex);
+        hasher.AddPod(e.Format);
+        hasher.AddPod(e.InputSlot);
+        hasher.AddPod(e.AlignedByteOffset);
+        hasher.AddPod(e.InputSlotClass);
+        hasher.AddPod(e.InstanceDataStepRate);
+    }
+
+    AddBlendState(hasher, desc.BlendState);
+    hasher.AddPod(desc.SampleMask);
+    AddRasterizerState(hasher, desc.RasterizerState);
+    AddDepthStencilState(hasher, desc.DepthStencilState);
+    hasher.AddPod(desc.IBStripCutValue);
+    hasher.AddPod(desc.PrimitiveTopologyType);
+    hasher.AddPod(desc.NumRenderTargets);
+    hasher.AddPod(desc.RTVFormats);
+    hasher.AddPod(desc.DSVFormat);
+    hasher.AddPod(desc.SampleDesc);
+    hasher.AddPod(desc.NodeMask);
+    hasher.AddPod(desc.Flags);
+
+    return hasher.Digest();
+}
+
+PipelineStateManager::Handle PipelineStateManager::Request(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+{
+    const std::string key = HashDesc(desc);
+
+    auto owned = std::make_shared<OwnedGraphicsDesc>(desc);
+    ComPtr<ID3D12Device> device = mDevice;
+
+    return mCache.Request(key, [owned, device](const PipelineCache::Blob& cachedBlob, PipelineCache::Blob& blobOut)
+        -> std::shared_ptr<void>
+    {
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = owned->Desc;
+
+        ComPtr<ID3D12PipelineState> pso;
+        HRESULT hr = E_FAIL;
+        if(!cachedBlob.empty())
+        {
+            psoDesc.CachedPSO = { cachedBlob.data(), cachedBlob.size() };
+            hr = device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&pso));
+        }
+
+        // No blob, or one the driver no longer accepts (new driver or adapter).
+        if(FAILED(hr))
+        {
+            psoDesc.CachedPSO = {};
+            hr = device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&pso));
+        }
+
+        if(FAILED(hr))
+            return nullptr;
+
+        ComPtr<ID3DBlob> blob;
+        if(SUCCEEDED(pso->GetCachedBlob(&blob)))
+        {
+            const std::uint8_t* bytes = static_cast<const std::uint8_t*>(blob->GetBufferPointer());
+            blobOut.assign(bytes, bytes + blob->GetBufferSize());
+        }
+
+        return std::shared_ptr<ID3D12PipelineState>(pso.Detach(), [](ID3D12PipelineState* p) { p->Release(); });
+    });
+}
+
+ID3D12PipelineState* PipelineStateManager::Get(Handle handle)const
+{
+    return static_cast<ID3D12PipelineState*>(mCache.Get(handle).get());
+}
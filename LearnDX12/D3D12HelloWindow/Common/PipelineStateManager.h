@@ -0,0 +1,63 @@
+//***************************************************************************************
+// PipelineStateManager.h
+//
+// Graphics pipeline states created on worker threads.  Descriptions are hashed by
+// content (shader bytecode, root signature, input layout and fixed-function state), so
+// requesting the same state twice yields the same handle and one
+// CreateGraphicsPipelineState call.  Root signatures are hashed by their serialized
+// form, which SetRootSignatureBlob() attaches to them.
+// The driver's cached blob of every PSO is saved and passed back as CachedPSO on the
+// next launch, which skips most of the driver compile.
+//
+// Get() returns nullptr until a PSO is ready; callers draw with a placeholder (e.g. the
+// previously used PSO) or Wait() for it.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "PipelineCache.h"
+
+class PipelineStateManager
+{
+public:
+    using Handle = PipelineCache::Handle;
+
+    explicit PipelineStateManager(ID3D12Device* device, ThreadPool& pool = ThreadPool::Default());
+    PipelineStateManager(const PipelineStateManager& rhs) = delete;
+    PipelineStateManager& operator=(const PipelineStateManager& rhs) = delete;
+
+    // Directory for the driver blobs; empty (the default) keeps nothing on disk.
+    void SetDirectory(const std::string& directory) { mCache.SetDirectory(directory); }
+
+    ///<summary>
+    /// Records the serialized form rootSignature was created from, which requests
+    /// using it are keyed by.  Call it once for every root signature given to
+    /// Request(); the root signature keeps a hash of the blob, not the blob.
+    ///</summary>
+    static void SetRootSignatureBlob(ID3D12RootSignature* rootSignature, ID3DBlob* serialized);
+
+    ///<summary>
+    /// Queues creation of desc and returns its handle.  Everything desc points to is
+    /// copied, so it may be freed on return.  desc.CachedPSO is ignored and stream
+    /// output is not supported.
+    ///</summary>
+    Handle Request(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc);
+
+    // The PSO, or nullptr while it is being created or if creation failed.
+    ID3D12PipelineState* Get(Handle handle)const;
+    PipelineCache::State GetState(Handle handle)const { return mCache.GetState(handle); }
+
+    void Wait(Handle handle) { mCache.Wait(handle); }
+    void WaitAll() { mCache.WaitAll(); }
+
+    const PipelineCache& Cache()const { return mCache; }
+
+    // Content hash of desc, excluding CachedPSO.  Throws if desc.pRootSignature has
+    // no SetRootSignatureBlob().
+    static std::string HashDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc);
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12Device> mDevice;
+    PipelineCache mCache;
+};
@@ -0,0 +1,108 @@
+//***************************************************************************************
+// ResourceHeapAllocator.cpp
+//***************************************************************************************
+
+#include "ResourceHeapAllocator.h"
+
+using Microsoft::WRL::ComPtr;
+
+ResourceHeapAllocator::ResourceHeapAllocator(ID3D12Device* device)
+    : ResourceHeapAllocator(device, ResourceHeapPolicy::Config())
+{
+}
+
+ResourceHeapAllocator::ResourceHeapAllocator(ID3D12Device* device, const ResourceHeapPolicy::Config& config)
+    : mDevice(device),
+    mPolicy(config)
+{
+}
+
+ResourceHeapPolicy::Type ResourceHeapAllocator::TypeOf(const D3D12_RESOURCE_DESC& desc)
+{
+    if(desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+        return ResourceHeapPolicy::Buffers;
+
+    if(desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+        return ResourceHeapPolicy::RenderTargets;
+
+    return ResourceHeapPolicy::Textures;
+}
+
+ComPtr<ID3D12Resource> ResourceHeapAllocator::CreateResource(
+    const D3D12_RESOURCE_DESC& desc,
+    D3D12_RESOURCE_STATES initialState,
+    const D3D12_CLEAR_VALUE* clearValue,
+    ResourceHeapPolicy::Allocation& allocation)
+{
+    // Multisampled textures come back asking for 4MB, everything else for 64KB or less.
+    const D3D12_RESOURCE_ALLOCATION_INFO info = mDevice->GetResourceAllocationInfo(0, 1, &desc);
+    if(info.SizeInBytes == UINT64_MAX)
+        ThrowIfFailed(E_INVALIDARG);
+
+    allocation = mPolicy.Allocate(TypeOf(desc), info.SizeInBytes, info.Alignment);
+    return CreatePlacedResource(allocation, desc, initialState, clearValue);
+}
+
+ComPtr<ID3D12Resource> ResourceHeapAllocator::CreatePlacedResource(
+    const ResourceHeapPolicy::Allocation& allocation,
+    const D3D12_RESOURCE_DESC& desc,
+    D3D12_RESOURCE_STATES initialState,
+    const D3D12_CLEAR_VALUE* clearValue)
+{
+    CreateHeap(allocation.Heap);
+
+    ComPtr<ID3D12Resource> resource;
+    ThrowIfFailed(mDevice->CreatePlacedResource(
+        mHeaps[allocation.Heap].Get(),
+        allocation.Offset,
+        &desc,
+        initialState,
+        clearValue,
+        IID_PPV_ARGS(resource.GetAddressOf())));
+    return resource;
+}
+
+void ResourceHeapAllocator::Free(const ResourceHeapPolicy::Allocation& allocation)
+{
+    // The resources placed in a released heap keep it alive until they go.
+    if(mPolicy.Free(allocation))
+        mHeaps[allocation.Heap].Reset();
+}
+
+std::vector<ResourceHeapPolicy::Move> ResourceHeapAllocator::Defragment(ResourceHeapPolicy::Type type, UINT64 maxBytes)
+{
+    return mPolicy.Defragment(type, maxBytes);
+}
+
+void ResourceHeapAllocator::CreateHeap(UINT heap)
+{
+    if(heap >= mHeaps.size())
+        mHeaps.resize(mPolicy.HeapSlotCount());
+    if(mHeaps[heap] != nullptr)
+        return;
+
+    static const D3D12_HEAP_FLAGS flags[ResourceHeapPolicy::TypeCount] =
+    {
+        D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS,
+        D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES,
+        D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES
+    };
+
+    // 4MB aligned, so that the policy's 4MB offsets are too.
+    D3D12_HEAP_DESC heapDesc = {};
+    heapDesc.SizeInBytes = mPolicy.HeapSize(heap);
+    heapDesc.Properties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+    heapDesc.Alignment = D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT;
+    heapDesc.Flags = flags[mPolicy.HeapType(heap)];
+
+    ThrowIfFailed(mDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(mHeaps[heap].GetAddressOf())));
+
+    // The heaps are what take the memory; resources placed in them add nothing.
+    static const MemoryTracker::Category categories[ResourceHeapPolicy::TypeCount] =
+    {
+        MemoryTracker::Buffers,
+        MemoryTracker::Textures,
+        MemoryTracker::RenderTargets
+    };
+    d3dUtil::TrackMemory(mHeaps[heap].Get(), categories[mPolicy.HeapType(heap)], heapDesc.SizeInBytes);
+}
@@ -0,0 +1,75 @@
+//***************************************************************************************
+// ResourceHeapAllocator.h
+//
+// Places resources in a few large ID3D12Heaps instead of giving every one a committed
+// resource and an implicit heap of its own.  Where they go is up to a
+// ResourceHeapPolicy; this creates and releases the heaps behind its slots.
+//
+// Placed resources hold a reference on their heap, so a heap the policy releases lives
+// on until the last resource in it is released too.  Free() an allocation only once
+// the GPU is done with its resource, as with any resource release.
+//
+// Defragmenting is up to the caller:
+//
+//     for(const ResourceHeapPolicy::Move& move : heaps.Defragment(type, maxBytes))
+//     {
+//         // CreatePlacedResource(move.To, desc, ...), record the copy from the old
+//         // resource, and once it has executed release the old one and Free(move.From).
+//     }
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "ResourceHeapPolicy.h"
+
+class ResourceHeapAllocator
+{
+public:
+    explicit ResourceHeapAllocator(ID3D12Device* device);
+    ResourceHeapAllocator(ID3D12Device* device, const ResourceHeapPolicy::Config& config);
+    ResourceHeapAllocator(const ResourceHeapAllocator& rhs) = delete;
+    ResourceHeapAllocator& operator=(const ResourceHeapAllocator& rhs) = delete;
+
+    // The heap type a resource must be placed in under resource heap tier 1.
+    static ResourceHeapPolicy::Type TypeOf(const D3D12_RESOURCE_DESC& desc);
+
+    ///<summary>
+    /// A placed resource for desc, with the allocation to Free() after it is released.
+    /// clearValue is for render targets and depth buffers, as with committed resources.
+    ///</summary>
+    Microsoft::WRL::ComPtr<ID3D12Resource> CreateResource(
+        const D3D12_RESOURCE_DESC& desc,
+        D3D12_RESOURCE_STATES initialState,
+        const D3D12_CLEAR_VALUE* clearValue,
+        ResourceHeapPolicy::Allocation& allocation);
+
+    ///<summary>
+    /// A resource for desc at an allocation made already, such as the destination of a
+    /// Defragment() move.
+    ///</summary>
+    Microsoft::WRL::ComPtr<ID3D12Resource> CreatePlacedResource(
+        const ResourceHeapPolicy::Allocation& allocation,
+        const D3D12_RESOURCE_DESC& desc,
+        D3D12_RESOURCE_STATES initialState,
+        const D3D12_CLEAR_VALUE* clearValue);
+
+    // Gives back the space of a resource the GPU no longer uses.
+    void Free(const ResourceHeapPolicy::Allocation& allocation);
+
+    // See ResourceHeapPolicy::Defragment().
+    std::vector<ResourceHeapPolicy::Move> Defragment(ResourceHeapPolicy::Type type, UINT64 maxBytes);
+
+    ID3D12Heap* Heap(UINT heap)const { return mHeaps[heap].Get(); }
+    const ResourceHeapPolicy& Policy()const { return mPolicy; }
+
+private:
+    // Creates the heap behind a slot the first time an allocation names it.
+    void CreateHeap(UINT heap);
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12Device> mDevice;
+
+    ResourceHeapPolicy mPolicy;
+    std::vector<Microsoft::WRL::ComPtr<ID3D12Heap>> mHeaps;
+};
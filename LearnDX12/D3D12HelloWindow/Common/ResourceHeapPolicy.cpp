@@ -0,0 +1,312 @@
+//***************************************************************************************
+// ResourceHeapPolicy.cpp
+//***************************************************************************************
+
+#include "ResourceHeapPolicy.h"
+#include <algorithm>
+#include <cassert>
+
+const ResourceHeapPolicy::uint64 ResourceHeapPolicy::SmallAlignment;
+const ResourceHeapPolicy::uint64 ResourceHeapPolicy::LargeAlignment;
+const ResourceHeapPolicy::uint32 ResourceHeapPolicy::NoHeap;
+
+namespace
+{
+    using uint32 = ResourceHeapPolicy::uint32;
+    using uint64 = ResourceHeapPolicy::uint64;
+
+    const uint32 LargeAlignmentPages = (uint32)(ResourceHeapPolicy::LargeAlignment / ResourceHeapPolicy::SmallAlignment);
+
+    uint64 RoundUp(uint64 value, uint64 multiple)
+    {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+}
+
+ResourceHeapPolicy::ResourceHeapPolicy()
+    : ResourceHeapPolicy(Config())
+{
+}
+
+ResourceHeapPolicy::ResourceHeapPolicy(const Config& config)
+    : mConfig(config)
+{
+    mConfig.HeapSize = std::max(RoundUp(mConfig.HeapSize, LargeAlignment), LargeAlignment);
+}
+
+ResourceHeapPolicy::uint32 ResourceHeapPolicy::NewHeap(Type type, uint64 size, bool dedicated)
+{
+    uint32 heap;
+    if(!mFreeSlots.empty())
+    {
+        heap = mFreeSlots.back();
+        mFreeSlots.pop_back();
+    }
+    else
+    {
+        heap = (uint32)mHeaps.size();
+        mHeaps.emplace_back();
+    }
+
+    Heap& h = mHeaps[heap];
+    h.Kind = type;
+    h.Size = size;
+    h.Live = true;
+    h.Dedicated = dedicated;
+    h.Draining = false;
+
+    const uint32 pages = dedicated ? 0 : (uint32)(size / SmallAlignment);
+    h.Pages.Reset(pages);
+    h.LargeAligned.assign(pages, false);
+
+    if(!dedicated)
+    {
+        mSharedHeaps[type].push_back(heap);
+        mEmptyHeaps[type]++;
+    }
+
+    mReservedBytes[type] += size;
+    mPeakReservedBytes[type] = std::max(mPeakReservedBytes[type], mReservedBytes[type]);
+    return heap;
+}
+
+void ResourceHeapPolicy::ReleaseHeap(uint32 heap)
+{
+    Heap& h = mHeaps[heap];
+    mReservedBytes[h.Kind] -= h.Size;
+
+    if(!h.Dedicated)
+    {
+        std::vector<uint32>& shared = mSharedHeaps[h.Kind];
+        shared.erase(std::find(shared.begin(), shared.end(), heap));
+    }
+
+    h.Live = false;
+    h.Pages.Reset(0);
+    h.LargeAligned.clear();
+    mFreeSlots.push_back(heap);
+}
+
+void ResourceHeapPolicy::SortStep(Type type)
+{
+    std::vector<uint32>& shared = mSharedHeaps[type];
+    for(size_t i = 1; i < shared.size(); ++i)
+    {
+        if(mHeaps[shared[i - 1]].Pages.UsedSize() < mHeaps[shared[i]].Pages.UsedSize())
+        {
+            std::swap(shared[i - 1], shared[i]);
+            return;
+        }
+    }
+}
+
+ResourceHeapPolicy::Allocation ResourceHeapPolicy::Allocate(Type type, uint64 size, uint64 alignment)
+{
+    assert(type < TypeCount && (alignment & (alignment - 1)) == 0);
+
+    Allocation allocation;
+    allocation.Kind = type;
+    if(size == 0)
+        return allocation;
+
+    alignment = std::max(alignment, SmallAlignment);
+    size = RoundUp(size, SmallAlignment);
+
+    // Too big to share: a heap of its own, released with it.
+    if(size + (alignment - SmallAlignment) > mConfig.HeapSize)
+    {
+        allocation.Heap = NewHeap(type, RoundUp(size, alignment), true);
+        allocation.Size = mHeaps[allocation.Heap].Size;
+        return allocation;
+    }
+
+    const uint32 pages = (uint32)(size / SmallAlignment);
+    const uint32 alignmentPages = (uint32)(alignment / SmallAlignment);
+
+    // The fullest heap with room, so the emptier ones drain.
+    SortStep(type);
+    for(uint32 heap : mSharedHeaps[type])
+    {
+        Heap& h = mHeaps[heap];
+        if(h.Draining || h.Pages.Capacity() - h.Pages.UsedSize() < pages)
+            continue;
+
+        allocation.Pages = h.Pages.Allocate(pages, alignmentPages);
+        if(allocation.Pages.Valid())
+        {
+            allocation.Heap = heap;
+            break;
+        }
+    }
+
+    if(!allocation.Valid())
+    {
+        allocation.Heap = NewHeap(type, mConfig.HeapSize, false);
+        allocation.Pages = mHeaps[allocation.Heap].Pages.Allocate(pages, alignmentPages);
+        assert(allocation.Pages.Valid());
+    }
+
+    Heap& h = mHeaps[allocation.Heap];
+    if(h.Pages.UsedSize() == pages)
+        mEmptyHeaps[type]--;
+
+    h.LargeAligned[allocation.Pages.Offset] = alignmentPages >= LargeAlignmentPages;
+    allocation.Offset = (uint64)allocation.Pages.Offset * SmallAlignment;
+    allocation.Size = size;
+    return allocation;
+}
+
+bool ResourceHeapPolicy::Free(const Allocation& allocation)
+{
+    if(!allocation.Valid())
+        return false;
+
+    Heap& h = mHeaps[allocation.Heap];
+    assert(h.Live && h.Kind == allocation.Kind);
+
+    if(h.Dedicated)
+    {
+        ReleaseHeap(allocation.Heap);
+        return true;
+    }
+
+    h.Pages.Free(allocation.Pages);
+    h.LargeAligned[allocation.Pages.Offset] = false;
+    SortStep(h.Kind);
+    if(h.Pages.UsedSize() > 0)
+        return false;
+
+    // Keep a few empty heaps around unless Defragment() asked for this one.
+    if(!h.Draining && mEmptyHeaps[h.Kind] < mConfig.MaxEmptyHeaps)
+    {
+        mEmptyHeaps[h.Kind]++;
+        return false;
+    }
+
+    ReleaseHeap(allocation.Heap);
+    return true;
+}
+
+std::vector<ResourceHeapPolicy::Move> ResourceHeapPolicy::Defragment(Type type, uint64 maxBytes)
+{
+    std::vector<Move> moves;
+
+    // Fully sorted this time, draining heaps left out.
+    mOrder.clear();
+    for(uint32 heap : mSharedHeaps[type])
+    {
+        if(!mHeaps[heap].Draining)
+            mOrder.push_back(heap);
+    }
+    std::stable_sort(mOrder.begin(), mOrder.end(), [this](uint32 a, uint32 b)
+    {
+        return mHeaps[a].Pages.UsedSize() > mHeaps[b].Pages.UsedSize();
+    });
+
+    uint64 planned = 0;
+    std::vector<TlsfAllocator::Allocation> sources;
+
+    // Whole heaps, emptiest first, into the heaps fuller than them.  A heap that
+    // cannot be emptied entirely keeps everything.
+    for(size_t s = mOrder.size(); s-- > 1;)
+    {
+        const uint32 source = mOrder[s];
+        Heap& src = mHeaps[source];
+        const uint64 used = (uint64)src.Pages.UsedSize() * SmallAlignment;
+        if(used == 0)
+            continue;
+        if(planned + used > maxBytes)
+            break;
+
+        sources.clear();
+        src.Pages.ForEachAllocation([&sources](const TlsfAllocator::Allocation& a) { sources.push_back(a); });
+        std::sort(sources.begin(), sources.end(),
+            [](const TlsfAllocator::Allocation& a, const TlsfAllocator::Allocation& b) { return a.Size > b.Size; });
+
+        const size_t firstMove = moves.size();
+        bool emptied = true;
+        for(const TlsfAllocator::Allocation& pages : sources)
+        {
+            const uint32 alignmentPages = src.LargeAligned[pages.Offset] ? LargeAlignmentPages : 1;
+
+            Move move;
+            for(size_t d = 0; d < s && !move.To.Valid(); ++d)
+            {
+                const uint32 target = mOrder[d];
+                move.To.Pages = mHeaps[target].Pages.Allocate(pages.Size, alignmentPages);
+                if(move.To.Pages.Valid())
+                    move.To.Heap = target;
+            }
+            if(!move.To.Valid())
+            {
+                emptied = false;
+                break;
+            }
+
+            mHeaps[move.To.Heap].LargeAligned[move.To.Pages.Offset] = alignmentPages >= LargeAlignmentPages;
+            move.To.Kind = type;
+            move.To.Offset = (uint64)move.To.Pages.Offset * SmallAlignment;
+            move.To.Size = (uint64)pages.Size * SmallAlignment;
+
+            move.From.Heap = source;
+            move.From.Kind = type;
+            move.From.Pages = pages;
+            move.From.Offset = (uint64)pages.Offset * SmallAlignment;
+            move.From.Size = move.To.Size;
+            moves.push_back(move);
+        }
+
+        if(!emptied)
+        {
+            // Give the destinations back; heaps that only took these moves cannot
+            // have been empty, so none is released.
+            while(moves.size() > firstMove)
+            {
+                const Allocation& to = moves.back().To;
+                mHeaps[to.Heap].Pages.Free(to.Pages);
+                mHeaps[to.Heap].LargeAligned[to.Pages.Offset] = false;
+                moves.pop_back();
+            }
+            continue;
+        }
+
+        src.Draining = true;
+        planned += used;
+    }
+    return moves;
+}
+
+ResourceHeapPolicy::Stats ResourceHeapPolicy::GetStats(Type type)const
+{
+    Stats stats;
+    for(const Heap& h : mHeaps)
+    {
+        if(!h.Live || (type != TypeCount && h.Kind != type))
+            continue;
+
+        stats.HeapCount++;
+        stats.ReservedBytes += h.Size;
+        if(h.Dedicated)
+        {
+            stats.DedicatedHeapCount++;
+            stats.AllocationCount++;
+            stats.UsedBytes += h.Size;
+            continue;
+        }
+
+        const TlsfAllocator::Stats pages = h.Pages.GetStats();
+        stats.AllocationCount += pages.AllocationCount;
+        stats.UsedBytes += (uint64)pages.UsedSize * SmallAlignment;
+        stats.FreeBytes += (uint64)(pages.Capacity - pages.UsedSize) * SmallAlignment;
+        stats.FreeBlockCount += pages.FreeBlockCount;
+        stats.LargestFreeBlock = std::max(stats.LargestFreeBlock, (uint64)pages.LargestFreeBlock * SmallAlignment);
+        stats.LargestFreeBlockSum += (uint64)pages.LargestFreeBlock * SmallAlignment;
+    }
+
+    for(uint32 t = 0; t < TypeCount; ++t)
+    {
+        if(type == TypeCount || type == (Type)t)
+            stats.PeakReservedBytes += mPeakReservedBytes[t];
+    }
+    return stats;
+}
@@ -0,0 +1,167 @@
+//***************************************************************************************
+// ResourceHeapPolicy.h
+//
+// Decides where placed resources go: a few large heaps per resource type, each
+// suballocated by a TlsfAllocator in 64KB pages, the placement alignment of buffers
+// and ordinary textures.  Multisampled textures ask for 4MB and get it in the same
+// heaps.  Anything larger than a heap gets a dedicated heap of its own.
+//
+// Buffers, textures and render targets never share a heap, as resource heap tier 1
+// hardware requires.  New allocations go to the fullest heap that has room, so the
+// emptier heaps drain and can be released; Defragment() plans moves out of the
+// emptiest heaps into the others for what is left in them.
+//
+// Heaps are numbered slots; the caller creates the heap behind a slot the first time
+// an allocation names it and releases it when Free() says so.
+//
+// ResourceHeapAllocator is the D3D12 front end.
+//***************************************************************************************
+
+#pragma once
+
+#include "TlsfAllocator.h"
+#include <cstdint>
+#include <vector>
+
+class ResourceHeapPolicy
+{
+public:
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+    // D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT and its MSAA counterpart.
+    static const uint64 SmallAlignment = 64 * 1024;
+    static const uint64 LargeAlignment = 4 * 1024 * 1024;
+
+    static const uint32 NoHeap = 0xffffffff;
+
+    enum Type { Buffers, Textures, RenderTargets, TypeCount };
+
+    struct Config
+    {
+        // Bytes per shared heap; a multiple of LargeAlignment.
+        uint64 HeapSize = 64 * 1024 * 1024;
+
+        // Empty shared heaps kept per type for the next allocations.
+        uint32 MaxEmptyHeaps = 1;
+    };
+
+    struct Allocation
+    {
+        uint32 Heap = NoHeap;
+        uint64 Offset = 0;  // bytes into the heap
+        uint64 Size = 0;    // bytes, a multiple of SmallAlignment
+        Type Kind = Buffers;
+
+        // Pages in the heap's allocator, for Free(); unused for dedicated heaps.
+        TlsfAllocator::Allocation Pages;
+
+        bool Valid()const { return Heap != NoHeap; }
+    };
+
+    struct Stats
+    {
+        uint32 HeapCount = 0;
+        uint32 DedicatedHeapCount = 0;
+        uint32 AllocationCount = 0;
+        uint64 ReservedBytes = 0;
+        uint64 UsedBytes = 0;
+        uint64 PeakReservedBytes = 0;
+
+        // Over the shared heaps; LargestFreeBlockSum adds up the largest free block of
+        // each heap.
+        uint64 FreeBytes = 0;
+        uint32 FreeBlockCount = 0;
+        uint64 LargestFreeBlock = 0;
+        uint64 LargestFreeBlockSum = 0;
+
+        double Utilization()const { return ReservedBytes > 0 ? (double)UsedBytes / ReservedBytes : 0.0; }
+
+        // 0 with the free space of every shared heap in one block, towards 1 as it
+        // splinters into pieces within the heaps; the mean over the heaps, weighted by
+        // their free bytes.  Free space spread over many heaps does not count, so the
+        // number stays meaningful however many heaps there are.
+        double Fragmentation()const { return FreeBytes > 0 ? 1.0 - (double)LargestFreeBlockSum / FreeBytes : 0.0; }
+    };
+
+    // A resource to move: create it at To, copy, and Free(From) once the copy has
+    // executed.
+    struct Move
+    {
+        Allocation From;
+        Allocation To;
+    };
+
+    ResourceHeapPolicy();
+    explicit ResourceHeapPolicy(const Config& config);
+
+    ///<summary>
+    /// Places size bytes of a resource of type.  alignment is what the resource's
+    /// D3D12_RESOURCE_ALLOCATION_INFO asks for; anything under 64KB gets 64KB.
+    ///</summary>
+    Allocation Allocate(Type type, uint64 size, uint64 alignment = SmallAlignment);
+
+    ///<summary>
+    /// Gives back an allocation.  Returns true if its heap is released with it: the
+    /// caller drops the heap once the resources in it are gone.
+    ///</summary>
+    bool Free(const Allocation& allocation);
+
+    ///<summary>
+    /// Plans moves of up to maxBytes out of the emptiest shared heaps of type into
+    /// the fuller ones.  The destinations are allocated already; every source heap
+    /// emptied by the moves is released by the Free() of its last source.
+    ///</summary>
+    std::vector<Move> Defragment(Type type, uint64 maxBytes);
+
+    // Slots handed out so far, released ones included.
+    uint32 HeapSlotCount()const { return (uint32)mHeaps.size(); }
+    bool HeapLive(uint32 heap)const { return mHeaps[heap].Live; }
+    uint64 HeapSize(uint32 heap)const { return mHeaps[heap].Size; }
+    Type HeapType(uint32 heap)const { return mHeaps[heap].Kind; }
+
+    // TypeCount for every type together.
+    Stats GetStats(Type type)const;
+    const Config& GetConfig()const { return mConfig; }
+
+private:
+    struct Heap
+    {
+        Type Kind = Buffers;
+        uint64 Size = 0;
+        bool Live = false;
+        bool Dedicated = false;
+
+        // Being emptied by Defragment(): takes no new allocations and is released
+        // when its last one is freed.
+        bool Draining = false;
+
+        TlsfAllocator Pages;
+
+        // Per page, whether an allocation starting there needs LargeAlignment, so
+        // that Defragment() keeps it.
+        std::vector<bool> LargeAligned;
+    };
+
+    uint32 NewHeap(Type type, uint64 size, bool dedicated);
+    void ReleaseHeap(uint32 heap);
+
+    // One bubble sort step towards fullest first over the shared heaps of type; a
+    // step per call keeps them close to sorted for next to nothing.
+    void SortStep(Type type);
+
+private:
+    Config mConfig;
+    std::vector<Heap> mHeaps;
+    std::vector<uint32> mFreeSlots;
+
+    // Live shared heaps per type, roughly fullest first, and how many are empty.
+    std::vector<uint32> mSharedHeaps[TypeCount];
+    uint32 mEmptyHeaps[TypeCount] = {};
+
+    uint64 mReservedBytes[TypeCount] = {};
+    uint64 mPeakReservedBytes[TypeCount] = {};
+
+    // Scratch for Defragment().
+    std::vector<uint32> mOrder;
+};
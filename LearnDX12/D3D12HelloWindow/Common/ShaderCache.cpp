@@ -0,0 +1,333 @@
+//***************************************************************************************
+// ShaderCache.cpp
+//***************************************************************************************
+
+#include "ShaderCache.h"
+#include "ContentHash.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+    // Bump whenever the key layout or the file layout changes.
+    const std::uint32_t CacheVersion = 1;
+    const char CacheMagic[4] = { 'S', 'H', 'D', 'C' };
+
+    // Following #include chains deeper than this is treated as a cycle.
+    const int MaxIncludeDepth = 32;
+
+    bool ReadFile(const std::string& path, std::string& contents)
+    {
+        std::ifstream fin(path, std::ios::binary);
+        if(!fin)
+            return false;
+
+        std::ostringstream ss;
+        ss << fin.rdbuf();
+        contents = ss.str();
+        return true;
+    }
+
+    std::string DirectoryOf(const std::string& path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    }
+
+    // Names from the #include lines of source, in order.  Lines in disabled #if
+    // branches are picked up too; that only costs a few extra files to hash.
+    std::vector<std::string> FindIncludes(const std::string& source)
+    {
+        std::vector<std::string> includes;
+
+        size_t pos = 0;
+        while(pos < source.size())
+        {
+            size_t end = source.find('\n', pos);
+            if(end == std::string::npos)
+                end = source.size();
+
+            size_t i = source.find_first_not_of(" \t", pos);
+            if(i < end && source[i] == '#')
+            {
+                i = source.find_first_not_of(" \t", i + 1);
+                if(i < end && source.compare(i, 7, "include") == 0)
+                {
+                    i = source.find_first_not_of(" \t", i + 7);
+                    if(i < end && (source[i] == '"' || source[i] == '<'))
+                    {
+                        char close = source[i] == '"' ? '"' : '>';
+                        size_t last = source.find(close, i + 1);
+                        if(last < end)
+                            includes.push_back(source.substr(i + 1, last - i - 1));
+                    }
+                }
+            }
+
+            pos = end + 1;
+        }
+
+        return includes;
+    }
+
+    // Appends every file reachable from path, each once.  Includes are looked up
+    // next to the including file first and then next to the root source, like
+    // D3D_COMPILE_STANDARD_FILE_INCLUDE.
+    void AppendIncludes(ContentHasher& key, const std::string& source, const std::string& path,
+        const std::string& rootDirectory, std::set<std::string>& visited, int depth)
+    {
+        if(depth > MaxIncludeDepth)
+            return;
+
+        for(const std::string& name : FindIncludes(source))
+        {
+            std::string candidates[2] = { DirectoryOf(path) + name, rootDirectory + name };
+
+            std::string contents;
+            std::string found;
+            for(const std::string& candidate : candidates)
+            {
+                if(ReadFile(candidate, contents))
+                {
+                    found = candidate;
+                    break;
+                }
+            }
+
+            key.Add(name);
+            if(found.empty())
+            {
+                key.AddBytes("-", 1);
+                continue;
+            }
+            key.AddBytes("+", 1);
+
+            if(!visited.insert(found).second)
+                continue;
+
+            key.Add(contents);
+            AppendIncludes(key, contents, found, rootDirectory, visited, depth + 1);
+        }
+    }
+
+    void MakeDirectory(const std::string& path)
+    {
+#ifdef _WIN32
+        _mkdir(path.c_str());
+#else
+        mkdir(path.c_str(), 0755);
+#endif
+    }
+}
+
+ShaderCache::ShaderCache(Compiler compiler, const std::string& compilerId) :
+    mCompiler(std::move(compiler)),
+    mCompilerId(compilerId)
+{
+}
+
+void ShaderCache::SetDirectory(const std::string& directory)
+{
+    if(!directory.empty())
+        MakeDirectory(directory);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mDirectory = directory;
+}
+
+void ShaderCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mEntries.clear();
+}
+
+std::string ShaderCache::ComputeKey(const ShaderCompileDesc& desc)const
+{
+    std::string source;
+    if(!ReadFile(desc.Path, source))
+        return std::string();
+
+    ContentHasher key;
+    key.AddBytes("ShaderCache", 11);
+    key.Add(std::to_string(CacheVersion));
+    key.Add(mCompilerId);
+    key.Add(desc.EntryPoint);
+    key.Add(desc.Target);
+    key.Add(std::to_string(desc.Flags));
+
+    key.Add(std::to_string(desc.Defines.size()));
+    for(const ShaderDefine& define : desc.Defines)
+    {
+        key.Add(define.Name);
+        key.Add(define.Definition);
+    }
+
+    // The root file is keyed by contents only, so moving a shader keeps its entry.
+    key.Add(source);
+
+    std::set<std::string> visited;
+    visited.insert(desc.Path);
+    AppendIncludes(key, source, desc.Path, DirectoryOf(desc.Path), visited, 0);
+
+    return key.Digest();
+}
+
+ShaderCache::ByteCodePtr ShaderCache::Compile(const ShaderCompileDesc& desc, std::string* messages, std::int32_t* error)
+{
+    const std::string key = ComputeKey(desc);
+    if(error != nullptr)
+        *error = 0;
+
+    std::promise<Entry> promise;
+    std::string directory;
+    if(!key.empty())
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        auto it = mEntries.find(key);
+        if(it != mEntries.end())
+        {
+            std::shared_future<Entry> entry = it->second;
+            lock.unlock();
+
+            const Entry& found = entry.get();
+            if(found.ByteCode != nullptr)
+                ++mMemoryHits;
+            else if(error != nullptr)
+                *error = found.Error;
+            return found.ByteCode;
+        }
+
+        mEntries[key] = promise.get_future().share();
+        directory = mDirectory;
+    }
+
+    try
+    {
+        const std::string path = (key.empty() || directory.empty()) ? std::string() : PathForKey(directory, key);
+
+        auto byteCode = std::make_shared<ShaderByteCode>();
+        if(!path.empty() && LoadFromDisk(path, *byteCode))
+        {
+            ++mDiskHits;
+        }
+        else
+        {
+            // A missing source still goes to the compiler, which reports the error.
+            std::string output;
+            Entry failed;
+            failed.Error = mCompiler(desc, *byteCode, output);
+            ++mCompiled;
+
+            if(messages != nullptr)
+                *messages = output;
+
+            if(failed.Error != 0)
+            {
+                // Failures are not remembered; fixing the source changes the key anyway.
+                Forget(key);
+                if(error != nullptr)
+                    *error = failed.Error;
+                promise.set_value(failed);
+                return nullptr;
+            }
+
+            if(!path.empty())
+                SaveToDisk(path, *byteCode);
+        }
+
+        Entry result;
+        result.ByteCode = byteCode;
+        promise.set_value(result);
+        return result.ByteCode;
+    }
+    catch(...)
+    {
+        Forget(key);
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+}
+
+void ShaderCache::Forget(const std::string& key)
+{
+    if(key.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mEntries.erase(key);
+}
+
+std::string ShaderCache::PathForKey(const std::string& directory, const std::string& key)
+{
+    return directory + "/" + key + ".cso";
+}
+
+bool ShaderCache::LoadFromDisk(const std::string& path, ShaderByteCode& byteCode)
+{
+    std::ifstream fin(path, std::ios::binary);
+    if(!fin)
+        return false;
+
+    char magic[4];
+    std::uint32_t version = 0;
+    std::uint64_t size = 0;
+    if(!fin.read(magic, 4) || std::memcmp(magic, CacheMagic, 4) != 0 ||
+       !fin.read(reinterpret_cast<char*>(&version), sizeof(version)) || version != CacheVersion ||
+       !fin.read(reinterpret_cast<char*>(&size), sizeof(size)))
+        return false;
+
+    // A damaged or truncated file is a miss, not a huge allocation.
+    const std::streampos start = fin.tellg();
+    fin.seekg(0, std::ios::end);
+    const std::streamoff remaining = fin.tellg() - start;
+    fin.seekg(start);
+    if(remaining < 0 || size != (std::uint64_t)remaining)
+        return false;
+
+    byteCode.resize((size_t)size);
+    if(!fin.read(reinterpret_cast<char*>(byteCode.data()), (std::streamsize)size))
+    {
+        byteCode.clear();
+        return false;
+    }
+
+    return true;
+}
+
+void ShaderCache::SaveToDisk(const std::string& path, const ShaderByteCode& byteCode)
+{
+    // Write to a temporary and rename so a concurrent launch never reads half a file.
+    const std::string temp = path + ".tmp";
+    {
+        std::ofstream fout(temp, std::ios::binary | std::ios::trunc);
+        if(!fout)
+            return;
+
+        const std::uint64_t size = byteCode.size();
+        fout.write(CacheMagic, 4);
+        fout.write(reinterpret_cast<const char*>(&CacheVersion), sizeof(CacheVersion));
+        fout.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        fout.write(reinterpret_cast<const char*>(byteCode.data()), (std::streamsize)size);
+
+        if(!fout)
+        {
+            fout.close();
+            std::remove(temp.c_str());
+            return;
+        }
+    }
+
+    std::remove(path.c_str());
+    if(std::rename(temp.c_str(), path.c_str()) != 0)
+        std::remove(temp.c_str());
+}
@@ -0,0 +1,114 @@
+//***************************************************************************************
+// ShaderCache.h
+//
+// Content-addressed cache of compiled shader bytecode.  A compilation is identified by
+// a 128-bit hash of everything that can change its output: the source file, every file
+// it includes (found by following #include lines), the defines, entry point, target,
+// flags and the compiler itself.  Hits return the stored bytecode without invoking
+// the compiler; with a cache directory set the bytecode also persists across launches.
+//
+// The compiler is passed in as a function, so the cache itself has no Direct3D
+// dependency and runs with any stand-in compiler.
+//***************************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct ShaderDefine
+{
+    std::string Name;
+    std::string Definition;
+};
+
+struct ShaderCompileDesc
+{
+    std::string Path;
+    std::vector<ShaderDefine> Defines;
+    std::string EntryPoint;
+    std::string Target;
+    std::uint32_t Flags = 0;
+};
+
+using ShaderByteCode = std::vector<std::uint8_t>;
+
+class ShaderCache
+{
+public:
+    using uint32 = std::uint32_t;
+    using ByteCodePtr = std::shared_ptr<const ShaderByteCode>;
+
+    // Compiles desc into byteCode.  Returns 0 on success and the compiler's error code
+    // (an HRESULT for the D3D compilers) on failure; messages receives the compiler
+    // output (errors, or warnings on success).
+    using Compiler = std::function<std::int32_t(const ShaderCompileDesc& desc, ShaderByteCode& byteCode, std::string& messages)>;
+
+    // compilerId names the compiler and its version; it is part of every key, so
+    // changing it invalidates what was cached by another compiler.
+    ShaderCache(Compiler compiler, const std::string& compilerId);
+    ShaderCache(const ShaderCache& rhs) = delete;
+    ShaderCache& operator=(const ShaderCache& rhs) = delete;
+
+    // Directory for the persistent copies, created if missing.  Empty keeps the
+    // cache in memory only (the default).
+    void SetDirectory(const std::string& directory);
+
+    ///<summary>
+    /// Returns the bytecode for desc, compiling only if no copy with the same key is
+    /// in memory or on disk.  Returns nullptr if compilation fails, with the
+    /// compiler's code in error; messages gets the compiler output of a compilation
+    /// done by this call.
+    ///</summary>
+    ByteCodePtr Compile(const ShaderCompileDesc& desc, std::string* messages = nullptr, std::int32_t* error = nullptr);
+
+    ///<summary>
+    /// 32 hex digit key of desc, or an empty string if the source file cannot be read.
+    /// Includes that cannot be opened are hashed by name only, since they may sit in
+    /// a disabled #if branch.
+    ///</summary>
+    std::string ComputeKey(const ShaderCompileDesc& desc)const;
+
+    // Drops the in-memory entries.  Bytecode already handed out stays valid.
+    void Clear();
+
+    // Lookups served from memory, from disk, and by running the compiler.
+    uint32 MemoryHits()const { return mMemoryHits; }
+    uint32 DiskHits()const { return mDiskHits; }
+    uint32 Compiled()const { return mCompiled; }
+
+private:
+    struct Entry
+    {
+        ByteCodePtr ByteCode;
+        std::int32_t Error = 0;
+    };
+
+    void Forget(const std::string& key);
+
+    static std::string PathForKey(const std::string& directory, const std::string& key);
+    static bool LoadFromDisk(const std::string& path, ShaderByteCode& byteCode);
+    static void SaveToDisk(const std::string& path, const ShaderByteCode& byteCode);
+
+private:
+    Compiler mCompiler;
+    std::string mCompilerId;
+
+    std::mutex mMutex;
+
+    // Futures let concurrent requests for the same shader wait on one compilation.
+    std::unordered_map<std::string, std::shared_future<Entry>> mEntries;
+
+    std::string mDirectory;
+
+    std::atomic<uint32> mMemoryHits{0};
+    std::atomic<uint32> mDiskHits{0};
+    std::atomic<uint32> mCompiled{0};
+};
@@ -0,0 +1,87 @@
+//***************************************************************************************
+// ShaderCompiler.cpp
+//***************************************************************************************
+
+#include "ShaderCompiler.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    std::string WStringToAnsi(const std::wstring& str)
+    {
+        int length = WideCharToMultiByte(CP_ACP, 0, str.c_str(), -1, nullptr, 0, nullptr, nullptr);
+        if(length <= 0)
+            return std::string();
+
+        std::string result(length, '\0');
+        WideCharToMultiByte(CP_ACP, 0, str.c_str(), -1, &result[0], length, nullptr, nullptr);
+        result.resize(length - 1);
+        return result;
+    }
+}
+
+ShaderCache& ShaderCompiler::Cache()
+{
+    static ShaderCache cache(CompileWithD3DCompiler, "d3dcompiler_" + std::to_string(D3D_COMPILER_VERSION));
+
+    // Function statics are initialized once, even with several threads compiling.
+    static const bool directorySet = (cache.SetDirectory("ShaderCache"), true);
+    (void)directorySet;
+
+    return cache;
+}
+
+std::int32_t ShaderCompiler::CompileWithD3DCompiler(const ShaderCompileDesc& desc, ShaderByteCode& byteCode, std::string& messages)
+{
+    std::vector<D3D_SHADER_MACRO> defines;
+    for(const ShaderDefine& define : desc.Defines)
+        defines.push_back({ define.Name.c_str(), define.Definition.c_str() });
+    defines.push_back({ nullptr, nullptr });
+
+    ComPtr<ID3DBlob> blob;
+    ComPtr<ID3DBlob> errors;
+    HRESULT hr = D3DCompileFromFile(AnsiToWString(desc.Path).c_str(), defines.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE,
+        desc.EntryPoint.c_str(), desc.Target.c_str(), desc.Flags, 0, &blob, &errors);
+
+    if(errors != nullptr)
+        messages.assign((const char*)errors->GetBufferPointer(), errors->GetBufferSize());
+
+    if(FAILED(hr))
+        return hr;
+
+    const std::uint8_t* data = (const std::uint8_t*)blob->GetBufferPointer();
+    byteCode.assign(data, data + blob->GetBufferSize());
+    return S_OK;
+}
+
+ComPtr<ID3DBlob> ShaderCompiler::Compile(
+    const std::wstring& filename,
+    const D3D_SHADER_MACRO* defines,
+    const std::string& entrypoint,
+    const std::string& target)
+{
+    ShaderCompileDesc desc;
+    desc.Path = WStringToAnsi(filename);
+    for(const D3D_SHADER_MACRO* define = defines; define != nullptr && define->Name != nullptr; ++define)
+        desc.Defines.push_back({ define->Name, define->Definition != nullptr ? define->Definition : "" });
+    desc.EntryPoint = entrypoint;
+    desc.Target = target;
+    desc.Flags = d3dUtil::ShaderCompileFlags();
+
+    std::string messages;
+    std::int32_t error = S_OK;
+    ShaderCache::ByteCodePtr byteCode = Cache().Compile(desc, &messages, &error);
+
+    if(!messages.empty())
+        OutputDebugStringA(messages.c_str());
+
+    if(byteCode == nullptr)
+        throw DxException(FAILED(error) ? error : E_FAIL, L"D3DCompileFromFile(" + filename + L")", AnsiToWString(__FILE__), __LINE__);
+
+    ComPtr<ID3DBlob> blob;
+    ThrowIfFailed(D3DCreateBlob(byteCode->size(), &blob));
+    memcpy(blob->GetBufferPointer(), byteCode->data(), byteCode->size());
+
+    return blob;
+}
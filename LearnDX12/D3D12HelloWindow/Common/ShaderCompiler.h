@@ -0,0 +1,33 @@
+//***************************************************************************************
+// ShaderCompiler.h
+//
+// d3dUtil::CompileShader() through a ShaderCache, so unchanged shaders are compiled
+// once and later launches read the bytecode back from the "ShaderCache" directory.
+// Kept apart from d3dUtil so only the samples that cache their shaders build the
+// cache and its hashing.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "ShaderCache.h"
+
+class ShaderCompiler
+{
+public:
+    // The cache behind Compile(), keyed with the D3DCompiler version.
+    static ShaderCache& Cache();
+
+    // ShaderCache::Compiler that runs D3DCompileFromFile and returns its HRESULT.
+    static std::int32_t CompileWithD3DCompiler(const ShaderCompileDesc& desc, ShaderByteCode& byteCode, std::string& messages);
+
+    ///<summary>
+    /// Same as d3dUtil::CompileShader(), compiled with d3dUtil::ShaderCompileFlags().
+    /// Throws a DxException with the compiler's HRESULT if compilation fails.
+    ///</summary>
+    static Microsoft::WRL::ComPtr<ID3DBlob> Compile(
+        const std::wstring& filename,
+        const D3D_SHADER_MACRO* defines,
+        const std::string& entrypoint,
+        const std::string& target);
+};
@@ -0,0 +1,111 @@
+//***************************************************************************************
+// ShaderPermutations.cpp
+//***************************************************************************************
+
+#include "ShaderPermutations.h"
+#include <cassert>
+
+const ShaderPermutations::uint32 ShaderPermutations::NoVariant;
+
+ShaderPermutations::ShaderPermutations(const ShaderCompileDesc& base, const std::vector<PermutationAxis>& axes) :
+    mBase(base),
+    mAxes(axes)
+{
+    for(const PermutationAxis& axis : mAxes)
+    {
+        assert(!axis.Values.empty());
+        mVariantCount *= (uint32)axis.Values.size();
+    }
+
+    mByteCode.resize(mVariantCount);
+}
+
+std::vector<ShaderPermutations::uint32> ShaderPermutations::Values(uint32 variant)const
+{
+    std::vector<uint32> values(mAxes.size());
+    for(size_t a = 0; a < mAxes.size(); ++a)
+    {
+        const uint32 size = (uint32)mAxes[a].Values.size();
+        values[a] = mAxes[a].Values[variant % size];
+        variant /= size;
+    }
+    return values;
+}
+
+ShaderCompileDesc ShaderPermutations::Desc(uint32 variant)const
+{
+    ShaderCompileDesc desc = mBase;
+
+    std::vector<uint32> values = Values(variant);
+    for(size_t a = 0; a < mAxes.size(); ++a)
+        desc.Defines.push_back({ mAxes[a].Define, std::to_string(values[a]) });
+
+    return desc;
+}
+
+bool ShaderPermutations::CompileAll(ShaderCache& cache, ThreadPool& pool, std::string* messages)
+{
+    std::vector<std::string> output(mVariantCount);
+
+    // One variant per chunk: compile times are long and uneven.
+    pool.ParallelFor(mVariantCount, 1, [&](size_t begin, size_t end)
+    {
+        for(size_t v = begin; v < end; ++v)
+            mByteCode[v] = cache.Compile(Desc((uint32)v), &output[v]);
+    });
+
+    bool succeeded = true;
+    for(uint32 v = 0; v < mVariantCount; ++v)
+    {
+        if(mByteCode[v] == nullptr)
+            succeeded = false;
+
+        if(messages != nullptr && !output[v].empty())
+        {
+            *messages += mBase.Path + " " + mBase.EntryPoint;
+            for(const ShaderDefine& define : Desc(v).Defines)
+                *messages += " " + define.Name + "=" + define.Definition;
+            *messages += ":\n" + output[v];
+            if(output[v].back() != '\n')
+                *messages += '\n';
+        }
+    }
+
+    return succeeded;
+}
+
+const ShaderCache::ByteCodePtr& ShaderPermutations::Compile(uint32 variant, ShaderCache& cache, std::string* messages, std::int32_t* error)
+{
+    assert(variant < mVariantCount);
+
+    if(error != nullptr)
+        *error = 0;
+    if(mByteCode[variant] == nullptr)
+        mByteCode[variant] = cache.Compile(Desc(variant), messages, error);
+
+    return mByteCode[variant];
+}
+
+ShaderPermutations::uint32 ShaderPermutations::Select(const std::vector<uint32>& counts)const
+{
+    assert(counts.size() == mAxes.size());
+
+    uint32 variant = 0;
+    uint32 stride = 1;
+    for(size_t a = 0; a < mAxes.size(); ++a)
+    {
+        const std::vector<uint32>& values = mAxes[a].Values;
+
+        size_t index = 0;
+        while(index < values.size() && values[index] != counts[a])
+            ++index;
+
+        if(index == values.size())
+            return NoVariant;
+
+        variant += (uint32)index*stride;
+        stride *= (uint32)values.size();
+    }
+
+    return variant;
+}
@@ -0,0 +1,83 @@
+//***************************************************************************************
+// ShaderPermutations.h
+//
+// Every combination of a few integer defines of one shader entry point, e.g. the
+// light counts of LightingUtil.hlsl.  Each variant is compiled with its exact counts
+// so loops unroll and absent light types cost nothing.  Variants are compiled through
+// a ShaderCache, one at a time as passes need them or all at once in parallel, and
+// Select() finds the one matching a pass.
+//
+// Select() only returns exact matches.  LightingUtil.hlsl finds each light type at an
+// offset given by the counts before it (point lights start at NUM_DIR_LIGHTS), so a
+// variant with more lights of one type than the pass has would read the others from
+// the wrong slots.
+//***************************************************************************************
+
+#pragma once
+
+#include "ShaderCache.h"
+#include "ThreadPool.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct PermutationAxis
+{
+    std::string Define;
+
+    // Values the define takes, ascending.
+    std::vector<std::uint32_t> Values;
+};
+
+class ShaderPermutations
+{
+public:
+    using uint32 = std::uint32_t;
+
+    static const uint32 NoVariant = 0xffffffff;
+
+    // base names the source, entry point, target and flags, plus defines shared by
+    // every variant.
+    ShaderPermutations(const ShaderCompileDesc& base, const std::vector<PermutationAxis>& axes);
+    ShaderPermutations(const ShaderPermutations& rhs) = delete;
+    ShaderPermutations& operator=(const ShaderPermutations& rhs) = delete;
+
+    uint32 VariantCount()const { return mVariantCount; }
+    const std::vector<PermutationAxis>& Axes()const { return mAxes; }
+
+    // Define values of a variant, one per axis.  The first axis varies fastest.
+    std::vector<uint32> Values(uint32 variant)const;
+
+    // base plus the axis defines of a variant.
+    ShaderCompileDesc Desc(uint32 variant)const;
+
+    ///<summary>
+    /// Compiles every variant through cache, spread over the pool, and waits for all
+    /// of them.  Returns false if any variant failed; messages collects the compiler
+    /// output labelled by variant.
+    ///</summary>
+    bool CompileAll(ShaderCache& cache, ThreadPool& pool = ThreadPool::Default(), std::string* messages = nullptr);
+
+    ///<summary>
+    /// Compiles one variant through cache unless it was compiled already, and returns
+    /// its bytecode; nullptr if it fails to compile, with the output in messages and
+    /// the compiler's code in error.
+    ///</summary>
+    const ShaderCache::ByteCodePtr& Compile(uint32 variant, ShaderCache& cache, std::string* messages = nullptr, std::int32_t* error = nullptr);
+
+    ///<summary>
+    /// The variant whose values are exactly the given per-axis counts, or NoVariant if
+    /// the axes do not have that combination.
+    ///</summary>
+    uint32 Select(const std::vector<uint32>& counts)const;
+
+    // Bytecode of a compiled variant, or nullptr.
+    const ShaderCache::ByteCodePtr& ByteCode(uint32 variant)const { return mByteCode[variant]; }
+
+private:
+    ShaderCompileDesc mBase;
+    std::vector<PermutationAxis> mAxes;
+    uint32 mVariantCount = 1;
+
+    std::vector<ShaderCache::ByteCodePtr> mByteCode;
+};
@@ -0,0 +1,227 @@
+//***************************************************************************************
+// TangentSpace.cpp
+//***************************************************************************************
+
+#include "TangentSpace.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+    using uint32 = GeometryGenerator::uint32;
+
+    // Smaller meshes are not worth a private buffer per thread.
+    const uint32 MinTrianglesPerChunk = 4096;
+
+    // Vertices per job of the reduce pass.
+    const size_t ReduceGrainSize = 4096;
+
+    struct NormalSum
+    {
+        XMFLOAT3 N = XMFLOAT3(0.0f, 0.0f, 0.0f);
+    };
+
+    struct TangentSum
+    {
+        XMFLOAT3 T = XMFLOAT3(0.0f, 0.0f, 0.0f);
+        XMFLOAT3 B = XMFLOAT3(0.0f, 0.0f, 0.0f);
+    };
+
+    void Accumulate(XMFLOAT3& sum, FXMVECTOR v)
+    {
+        XMStoreFloat3(&sum, XMVectorAdd(XMLoadFloat3(&sum), v));
+    }
+
+    //
+    // Runs scatter(buffer, firstTriangle, lastTriangle) over one triangle range per
+    // chunk, each with its own zeroed per-vertex buffer, then calls
+    // resolve(vertex, buffers, chunkCount) for every vertex in parallel.
+    //
+    template<typename Sum, typename Scatter, typename Resolve>
+    void ScatterReduce(uint32 vertexCount, uint32 triangleCount, ThreadPool& pool, Scatter scatter, Resolve resolve)
+    {
+        const uint32 chunkCount = std::max(1u,
+            std::min(pool.ThreadCount() + 1, triangleCount/MinTrianglesPerChunk));
+
+        std::vector<std::vector<Sum>> buffers(chunkCount);
+
+        pool.ParallelFor(chunkCount, 1, [&](size_t begin, size_t end)
+        {
+            for(size_t c = begin; c < end; ++c)
+            {
+                buffers[c].assign(vertexCount, Sum());
+
+                uint32 first = (uint32)((std::uint64_t)triangleCount*c/chunkCount);
+                uint32 last = (uint32)((std::uint64_t)triangleCount*(c + 1)/chunkCount);
+                scatter(buffers[c].data(), first, last);
+            }
+        });
+
+        pool.ParallelFor(vertexCount, ReduceGrainSize, [&](size_t begin, size_t end)
+        {
+            for(size_t v = begin; v < end; ++v)
+                resolve((uint32)v, buffers, chunkCount);
+        });
+    }
+
+    // Interior angles at p0, p1 and p2; the triangle must not be degenerate.
+    XMVECTOR CornerAngles(FXMVECTOR p0, FXMVECTOR p1, FXMVECTOR p2)
+    {
+        float a0 = XMVectorGetX(XMVector3AngleBetweenVectors(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0)));
+        float a1 = XMVectorGetX(XMVector3AngleBetweenVectors(XMVectorSubtract(p0, p1), XMVectorSubtract(p2, p1)));
+        return XMVectorSet(a0, a1, XM_PI - a0 - a1, 0.0f);
+    }
+
+    // Projects v into the plane with unit normal n and normalizes it.
+    XMVECTOR Orthogonalize(FXMVECTOR v, FXMVECTOR n)
+    {
+        return XMVector3Normalize(XMVectorSubtract(v, XMVectorMultiply(n, XMVector3Dot(n, v))));
+    }
+}
+
+void TangentSpace::ComputeNormals(MeshData& mesh, NormalWeighting weighting, ThreadPool& pool)
+{
+    const uint32 vertexCount = (uint32)mesh.Vertices.size();
+    const uint32 triangleCount = (uint32)(mesh.Indices32.size()/3);
+    const GeometryGenerator::Vertex* vertices = mesh.Vertices.data();
+    const uint32* indices = mesh.Indices32.data();
+
+    auto scatter = [&](NormalSum* sums, uint32 first, uint32 last)
+    {
+        for(uint32 t = first; t < last; ++t)
+        {
+            const uint32 i0 = indices[3*t + 0];
+            const uint32 i1 = indices[3*t + 1];
+            const uint32 i2 = indices[3*t + 2];
+
+            XMVECTOR p0 = XMLoadFloat3(&vertices[i0].Position);
+            XMVECTOR p1 = XMLoadFloat3(&vertices[i1].Position);
+            XMVECTOR p2 = XMLoadFloat3(&vertices[i2].Position);
+
+            // |cross| is twice the triangle area.
+            XMVECTOR n = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+            if(XMVectorGetX(XMVector3LengthSq(n)) <= 0.0f)
+                continue;
+
+            if(weighting == NormalWeighting::Area)
+            {
+                Accumulate(sums[i0].N, n);
+                Accumulate(sums[i1].N, n);
+                Accumulate(sums[i2].N, n);
+                continue;
+            }
+
+            if(weighting == NormalWeighting::Angle)
+                n = XMVector3Normalize(n);
+
+            XMVECTOR angles = CornerAngles(p0, p1, p2);
+            Accumulate(sums[i0].N, XMVectorMultiply(n, XMVectorSplatX(angles)));
+            Accumulate(sums[i1].N, XMVectorMultiply(n, XMVectorSplatY(angles)));
+            Accumulate(sums[i2].N, XMVectorMultiply(n, XMVectorSplatZ(angles)));
+        }
+    };
+
+    auto resolve = [&](uint32 v, const std::vector<std::vector<NormalSum>>& sums, uint32 chunkCount)
+    {
+        XMVECTOR n = XMLoadFloat3(&sums[0][v].N);
+        for(uint32 c = 1; c < chunkCount; ++c)
+            n = XMVectorAdd(n, XMLoadFloat3(&sums[c][v].N));
+
+        if(XMVectorGetX(XMVector3LengthSq(n)) > 0.0f)
+            XMStoreFloat3(&mesh.Vertices[v].Normal, XMVector3Normalize(n));
+    };
+
+    ScatterReduce<NormalSum>(vertexCount, triangleCount, pool, scatter, resolve);
+}
+
+void TangentSpace::ComputeTangents(MeshData& mesh, std::vector<float>* handedness, ThreadPool& pool)
+{
+    const uint32 vertexCount = (uint32)mesh.Vertices.size();
+    const uint32 triangleCount = (uint32)(mesh.Indices32.size()/3);
+    const GeometryGenerator::Vertex* vertices = mesh.Vertices.data();
+    const uint32* indices = mesh.Indices32.data();
+
+    if(handedness != nullptr)
+        handedness->assign(vertexCount, 1.0f);
+
+    auto scatter = [&](TangentSum* sums, uint32 first, uint32 last)
+    {
+        for(uint32 t = first; t < last; ++t)
+        {
+            const uint32 i[3] = { indices[3*t + 0], indices[3*t + 1], indices[3*t + 2] };
+
+            XMVECTOR p0 = XMLoadFloat3(&vertices[i[0]].Position);
+            XMVECTOR p1 = XMLoadFloat3(&vertices[i[1]].Position);
+            XMVECTOR p2 = XMLoadFloat3(&vertices[i[2]].Position);
+
+            XMVECTOR e1 = XMVectorSubtract(p1, p0);
+            XMVECTOR e2 = XMVectorSubtract(p2, p0);
+            if(XMVectorGetX(XMVector3LengthSq(XMVector3Cross(e1, e2))) <= 0.0f)
+                continue;
+
+            const XMFLOAT2& uv0 = vertices[i[0]].TexC;
+            const XMFLOAT2& uv1 = vertices[i[1]].TexC;
+            const XMFLOAT2& uv2 = vertices[i[2]].TexC;
+
+            float du1 = uv1.x - uv0.x, dv1 = uv1.y - uv0.y;
+            float du2 = uv2.x - uv0.x, dv2 = uv2.y - uv0.y;
+
+            // Triangles without a uv mapping say nothing about the tangent.
+            float det = du1*dv2 - du2*dv1;
+            if(std::fabs(det) <= 1e-12f)
+                continue;
+
+            // Solve e1 = du1*T + dv1*B, e2 = du2*T + dv2*B.
+            float r = 1.0f/det;
+            XMVECTOR T = XMVectorScale(XMVectorSubtract(XMVectorScale(e1, dv2), XMVectorScale(e2, dv1)), r);
+            XMVECTOR B = XMVectorScale(XMVectorSubtract(XMVectorScale(e2, du1), XMVectorScale(e1, du2)), r);
+
+            XMFLOAT3 angles;
+            XMStoreFloat3(&angles, CornerAngles(p0, p1, p2));
+            const float weights[3] = { angles.x, angles.y, angles.z };
+
+            for(int k = 0; k < 3; ++k)
+            {
+                XMVECTOR n = XMLoadFloat3(&vertices[i[k]].Normal);
+                Accumulate(sums[i[k]].T, XMVectorScale(Orthogonalize(T, n), weights[k]));
+                Accumulate(sums[i[k]].B, XMVectorScale(Orthogonalize(B, n), weights[k]));
+            }
+        }
+    };
+
+    auto resolve = [&](uint32 v, const std::vector<std::vector<TangentSum>>& sums, uint32 chunkCount)
+    {
+        XMVECTOR t = XMLoadFloat3(&sums[0][v].T);
+        XMVECTOR b = XMLoadFloat3(&sums[0][v].B);
+        for(uint32 c = 1; c < chunkCount; ++c)
+        {
+            t = XMVectorAdd(t, XMLoadFloat3(&sums[c][v].T));
+            b = XMVectorAdd(b, XMLoadFloat3(&sums[c][v].B));
+        }
+
+        GeometryGenerator::Vertex& vertex = mesh.Vertices[v];
+        XMVECTOR n = XMLoadFloat3(&vertex.Normal);
+
+        t = Orthogonalize(t, n);
+        if(XMVectorGetX(XMVector3LengthSq(t)) <= 0.0f)
+        {
+            // No uv information: any direction in the normal plane will do, as long
+            // as it is stable for equal normals.
+            XMVECTOR axis = std::fabs(vertex.Normal.x) < 0.9f ?
+                XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f) : XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+            t = Orthogonalize(axis, n);
+        }
+
+        XMStoreFloat3(&vertex.TangentU, t);
+
+        if(handedness != nullptr)
+        {
+            float sign = XMVectorGetX(XMVector3Dot(XMVector3Cross(n, t), b));
+            (*handedness)[v] = sign < 0.0f ? -1.0f : 1.0f;
+        }
+    };
+
+    ScatterReduce<TangentSum>(vertexCount, triangleCount, pool, scatter, resolve);
+}
@@ -0,0 +1,49 @@
+//***************************************************************************************
+// TangentSpace.h
+//
+// Rebuilds vertex normals and tangents of a GeometryGenerator::MeshData, for meshes that
+// do not come out of GeometryGenerator with them (loaded models have normals only).
+//
+// Triangles are split into one range per thread.  Each range scatters its weighted
+// contributions into a private per-vertex buffer and a second pass sums the buffers
+// per vertex, so no atomics or locks are involved.  The vector math uses DirectXMath.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include "ThreadPool.h"
+#include <vector>
+
+enum class NormalWeighting
+{
+    Area,       // Face normal scaled by triangle area.
+    Angle,      // Unit face normal scaled by the corner angle.
+    AreaAngle   // Both; the usual choice for irregular tessellations.
+};
+
+class TangentSpace
+{
+public:
+    using MeshData = GeometryGenerator::MeshData;
+
+    ///<summary>
+    /// Recomputes every vertex normal from the triangles that reference it.  Vertices
+    /// with no non-degenerate triangle keep their current normal.
+    ///</summary>
+    static void ComputeNormals(MeshData& mesh, NormalWeighting weighting = NormalWeighting::AreaAngle,
+        ThreadPool& pool = ThreadPool::Default());
+
+    ///<summary>
+    /// Computes TangentU from positions, texture coordinates and the existing normals,
+    /// following the MikkTSpace per-corner rules: the triangle tangent is projected
+    /// into each corner's normal plane, weighted by the corner angle, then summed and
+    /// orthonormalized per vertex.  Vertices without usable uvs get an arbitrary
+    /// tangent perpendicular to the normal.
+    ///
+    /// If handedness is given it receives one +1/-1 per vertex, the sign such that
+    /// bitangent = sign * cross(normal, tangent).
+    ///</summary>
+    static void ComputeTangents(MeshData& mesh, std::vector<float>* handedness = nullptr,
+        ThreadPool& pool = ThreadPool::Default());
+};
@@ -0,0 +1,226 @@
+//***************************************************************************************
+// TextureLoadQueue.cpp
+//***************************************************************************************
+
+#include "TextureLoadQueue.h"
+#include <algorithm>
+#include <cmath>
+
+const TextureLoadQueue::uint32 TextureLoadQueue::NoTicket;
+
+namespace
+{
+    // Stride for faulting a mapping in, no larger than any page size in use.
+    const std::uint64_t PageSize = 4096;
+
+    double Seconds(TextureLoadQueue::Clock::duration duration)
+    {
+        return std::chrono::duration<double>(duration).count();
+    }
+}
+
+TextureLoadQueue::TextureLoadQueue(unsigned threadCount)
+{
+    if(threadCount == 0)
+        threadCount = 2;
+
+    for(unsigned i = 0; i < threadCount; ++i)
+        mWorkers.emplace_back(&TextureLoadQueue::WorkerLoop, this);
+}
+
+TextureLoadQueue::~TextureLoadQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+        mStats.Cancelled += mWaiting.size();
+        mWaiting.clear();
+        mQueue.clear();
+    }
+    mWorkAvailable.notify_all();
+
+    for(std::thread& worker : mWorkers)
+        worker.join();
+}
+
+void TextureLoadQueue::PushEntry(uint32 ticket, float priority)
+{
+    mQueue.push_back({ priority, ticket });
+    std::push_heap(mQueue.begin(), mQueue.end());
+}
+
+TextureLoadQueue::uint32 TextureLoadQueue::Submit(const std::string& path, float priority)
+{
+    uint32 ticket;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        ticket = mNextTicket++;
+        mWaiting[ticket] = { path, priority, Clock::now() };
+        PushEntry(ticket, priority);
+        mStats.Submitted++;
+    }
+    mWorkAvailable.notify_one();
+    return ticket;
+}
+
+bool TextureLoadQueue::SetPriority(uint32 ticket, float priority)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto it = mWaiting.find(ticket);
+    if(it == mWaiting.end())
+        return false;
+    if(it->second.Priority == priority)
+        return true;
+
+    // The old entry goes stale and is skipped when it surfaces.  Rebuild the heap
+    // if stale entries start to outnumber live ones.
+    it->second.Priority = priority;
+    PushEntry(ticket, priority);
+    if(mQueue.size() > 2 * mWaiting.size() + 64)
+    {
+        mQueue.clear();
+        for(const auto& waiting : mWaiting)
+            mQueue.push_back({ waiting.second.Priority, waiting.first });
+        std::make_heap(mQueue.begin(), mQueue.end());
+    }
+    return true;
+}
+
+bool TextureLoadQueue::Cancel(uint32 ticket)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if(mWaiting.erase(ticket) == 0)
+        return false;
+
+    mStats.Cancelled++;
+    if(mWaiting.empty() && mLoading == 0)
+        mIdle.notify_all();
+    return true;
+}
+
+size_t TextureLoadQueue::Poll(std::vector<LoadedFile>& completed, size_t maxCount)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    const Clock::time_point now = Clock::now();
+    size_t count = 0;
+    while(count < maxCount && !mCompleted.empty())
+    {
+        mStats.TotalCompletionSeconds += Seconds(now - mCompleted.front().FinishTime);
+        completed.push_back(std::move(mCompleted.front()));
+        mCompleted.pop_front();
+        count++;
+    }
+    return count;
+}
+
+void TextureLoadQueue::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mIdle.wait(lock, [this]() { return mWaiting.empty() && mLoading == 0; });
+}
+
+TextureLoadQueue::uint32 TextureLoadQueue::OutstandingCount()const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return (uint32)(mWaiting.size() + mLoading + mCompleted.size());
+}
+
+TextureLoadQueue::Stats TextureLoadQueue::GetStats()const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats;
+}
+
+float TextureLoadQueue::ScreenSpacePriority(float radius, float distance, float fovY, float viewportHeight)
+{
+    if(distance <= radius)
+        return viewportHeight;
+
+    // Projected diameter over the height of the view frustum at that distance.
+    return std::min(radius / (distance * std::tan(0.5f * fovY)), 1.0f) * viewportHeight;
+}
+
+void TextureLoadQueue::WorkerLoop()
+{
+    for(;;)
+    {
+        LoadedFile file;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            for(;;)
+            {
+                mWorkAvailable.wait(lock, [this]() { return mStopping || !mQueue.empty(); });
+                if(mStopping)
+                    return;
+
+                std::pop_heap(mQueue.begin(), mQueue.end());
+                const QueueEntry entry = mQueue.back();
+                mQueue.pop_back();
+
+                auto it = mWaiting.find(entry.Ticket);
+                if(it == mWaiting.end() || it->second.Priority != entry.Priority)
+                    continue;
+
+                file.Ticket = entry.Ticket;
+                file.Path = std::move(it->second.Path);
+                file.Priority = it->second.Priority;
+                file.SubmitTime = it->second.SubmitTime;
+                mWaiting.erase(it);
+                mLoading++;
+                break;
+            }
+        }
+
+        file.StartTime = Clock::now();
+        Load(file);
+        file.FinishTime = Clock::now();
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            const double queueSeconds = Seconds(file.StartTime - file.SubmitTime);
+            mStats.TotalQueueSeconds += queueSeconds;
+            mStats.MaxQueueSeconds = std::max(mStats.MaxQueueSeconds, queueSeconds);
+            mStats.TotalLoadSeconds += Seconds(file.FinishTime - file.StartTime);
+            if(file.Succeeded)
+            {
+                mStats.Completed++;
+                mStats.BytesRead += file.File->Size();
+            }
+            else
+            {
+                mStats.Failed++;
+            }
+
+            mCompleted.push_back(std::move(file));
+            mLoading--;
+            if(mWaiting.empty() && mLoading == 0)
+                mIdle.notify_all();
+        }
+    }
+}
+
+void TextureLoadQueue::Load(LoadedFile& file)
+{
+    std::unique_ptr<MappedFile> mapped(new MappedFile());
+    if(!mapped->Open(file.Path))
+        return;
+    if(!DdsFile::ParseHeader(mapped->Data(), mapped->Size(), file.Info))
+        return;
+
+    // Touch every page so the disk reads happen here rather than in the copies the
+    // frame loop makes from the mapping.
+    const std::uint8_t* data = mapped->Data();
+    const std::uint64_t size = mapped->Size();
+    std::uint32_t sum = 0;
+    for(std::uint64_t offset = 0; offset < size; offset += PageSize)
+        sum += data[offset];
+    volatile std::uint32_t sink = sum;
+    (void)sink;
+
+    file.File = std::move(mapped);
+    file.Succeeded = true;
+}
@@ -0,0 +1,156 @@
+//***************************************************************************************
+// TextureLoadQueue.h
+//
+// Background loading of DDS files.  Requests wait in a priority queue served by a few
+// I/O threads, which map the file, parse its header and fault its pages in, then post
+// the result to a completion queue that the frame loop drains once per frame with
+// Poll().  Priorities may change while requests wait, e.g. as the camera moves, and
+// the highest waiting request is always served next.
+//
+// The I/O threads are kept apart from ThreadPool: they spend their time blocked on
+// the disk, which would starve the CPU work sharing the pool.
+//
+// GetStats() reports throughput and queue latency; AsyncTextureLoader is the D3D12
+// front end.
+//***************************************************************************************
+
+#pragma once
+
+#include "DdsFile.h"
+#include "MappedFile.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class TextureLoadQueue
+{
+public:
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+    using Clock = std::chrono::steady_clock;
+
+    // Tickets start at 1.
+    static const uint32 NoTicket = 0;
+
+    struct LoadedFile
+    {
+        uint32 Ticket = NoTicket;
+        std::string Path;
+        float Priority = 0.0f;
+
+        // On success the file is open, mapped and resident, and Info describes it.
+        bool Succeeded = false;
+        std::unique_ptr<MappedFile> File;
+        DdsFile::Info Info;
+
+        Clock::time_point SubmitTime;
+        Clock::time_point StartTime;
+        Clock::time_point FinishTime;
+    };
+
+    struct Stats
+    {
+        uint64 Submitted = 0;
+        uint64 Completed = 0;
+        uint64 Failed = 0;
+        uint64 Cancelled = 0;
+        uint64 BytesRead = 0;
+
+        // Submit to an I/O thread picking the request up, and from there to the file
+        // being ready; sums over Completed + Failed requests.
+        double TotalQueueSeconds = 0.0;
+        double MaxQueueSeconds = 0.0;
+        double TotalLoadSeconds = 0.0;
+
+        // From ready to drained by Poll().
+        double TotalCompletionSeconds = 0.0;
+    };
+
+    // threadCount == 0 uses two I/O threads.
+    explicit TextureLoadQueue(unsigned threadCount = 0);
+    TextureLoadQueue(const TextureLoadQueue& rhs) = delete;
+    TextureLoadQueue& operator=(const TextureLoadQueue& rhs) = delete;
+
+    // Drops the requests still waiting and joins the I/O threads.
+    ~TextureLoadQueue();
+
+    ///<summary>
+    /// Queues the DDS file at path; higher priorities load first.  Returns the ticket
+    /// the finished load is reported under.
+    ///</summary>
+    uint32 Submit(const std::string& path, float priority);
+
+    // Both return false once an I/O thread has picked the request up.
+    bool SetPriority(uint32 ticket, float priority);
+    bool Cancel(uint32 ticket);
+
+    ///<summary>
+    /// Appends up to maxCount finished loads, in the order they finished, to completed
+    /// and returns how many were appended.  Failed loads are reported too.
+    ///</summary>
+    size_t Poll(std::vector<LoadedFile>& completed, size_t maxCount = SIZE_MAX);
+
+    // Blocks until no request is waiting or loading; finished ones may remain to Poll().
+    void WaitIdle();
+
+    // Requests submitted and not yet polled or cancelled.
+    uint32 OutstandingCount()const;
+
+    Stats GetStats()const;
+
+    ///<summary>
+    /// Height in pixels of a sphere of radius at distance from the eye, the priority
+    /// to load its textures with.  An eye inside the sphere gets the viewport height.
+    ///</summary>
+    static float ScreenSpacePriority(float radius, float distance, float fovY, float viewportHeight);
+
+private:
+    struct Waiting
+    {
+        std::string Path;
+        float Priority;
+        Clock::time_point SubmitTime;
+    };
+
+    // Heap entry; stale once its ticket is gone from mWaiting or has a new priority.
+    struct QueueEntry
+    {
+        float Priority;
+        uint32 Ticket;
+
+        bool operator<(const QueueEntry& rhs)const
+        {
+            // Equal priorities are served in submission order.
+            return Priority != rhs.Priority ? Priority < rhs.Priority : Ticket > rhs.Ticket;
+        }
+    };
+
+    void WorkerLoop();
+    static void Load(LoadedFile& file);
+
+    void PushEntry(uint32 ticket, float priority);
+
+private:
+    std::vector<std::thread> mWorkers;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mWorkAvailable;
+    std::condition_variable mIdle;
+
+    std::unordered_map<uint32, Waiting> mWaiting;
+    std::vector<QueueEntry> mQueue;
+    std::deque<LoadedFile> mCompleted;
+
+    uint32 mNextTicket = 1;
+    uint32 mLoading = 0;
+    bool mStopping = false;
+
+    Stats mStats;
+};
@@ -0,0 +1,517 @@
+//***************************************************************************************
+// TexturePacker.cpp
+//***************************************************************************************
+
+#include "TexturePacker.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <tuple>
+
+using namespace DirectX;
+
+const TexturePacker::uint32 TexturePacker::NoPage;
+
+namespace
+{
+    using uint8 = TexturePacker::uint8;
+    using uint32 = TexturePacker::uint32;
+    using uint64 = TexturePacker::uint64;
+
+    struct Rect
+    {
+        uint32 X;
+        uint32 Y;
+        uint32 Width;
+        uint32 Height;
+    };
+
+    // Bottom left skyline: the top edge of what has been placed, as segments from left
+    // to right.  A rectangle goes where its top ends up lowest.
+    class SkylineBin
+    {
+    public:
+        SkylineBin(uint32 width, uint32 height)
+            : mWidth(width), mHeight(height)
+        {
+            mSkyline.push_back({ 0, 0, width });
+        }
+
+        bool Insert(uint32 width, uint32 height, Rect& rect)
+        {
+            size_t best = mSkyline.size();
+            uint32 bestTop = 0, bestWidth = 0, bestY = 0;
+            for(size_t i = 0; i < mSkyline.size(); ++i)
+            {
+                uint32 y;
+                if(!Fits(i, width, height, y))
+                    continue;
+
+                const uint32 top = y + height;
+                if(best == mSkyline.size() || top < bestTop || (top == bestTop && mSkyline[i].Width < bestWidth))
+                {
+                    best = i;
+                    bestTop = top;
+                    bestWidth = mSkyline[i].Width;
+                    bestY = y;
+                }
+            }
+            if(best == mSkyline.size())
+                return false;
+
+            rect = { mSkyline[best].X, bestY, width, height };
+            AddLevel(best, rect);
+            return true;
+        }
+
+    private:
+        struct Segment
+        {
+            uint32 X;
+            uint32 Y;
+            uint32 Width;
+        };
+
+        // Whether a rectangle fits with its left edge on segment index, resting on the
+        // highest segment under it at y.
+        bool Fits(size_t index, uint32 width, uint32 height, uint32& y)const
+        {
+            if(mSkyline[index].X + width > mWidth)
+                return false;
+
+            y = 0;
+            uint32 remaining = width;
+            for(size_t i = index; remaining > 0; ++i)
+            {
+                y = std::max(y, mSkyline[i].Y);
+                if(y + height > mHeight)
+                    return false;
+                remaining -= std::min(remaining, mSkyline[i].Width);
+            }
+            return true;
+        }
+
+        void AddLevel(size_t index, const Rect& rect)
+        {
+            mSkyline.insert(mSkyline.begin() + index, { rect.X, rect.Y + rect.Height, rect.Width });
+
+            // Cut the segments the new one covers.
+            for(size_t i = index + 1; i < mSkyline.size();)
+            {
+                const uint32 end = mSkyline[i - 1].X + mSkyline[i - 1].Width;
+                if(mSkyline[i].X >= end)
+                    break;
+
+                const uint32 overlap = end - mSkyline[i].X;
+                if(mSkyline[i].Width <= overlap)
+                {
+                    mSkyline.erase(mSkyline.begin() + i);
+                    continue;
+                }
+                mSkyline[i].X += overlap;
+                mSkyline[i].Width -= overlap;
+                break;
+            }
+
+            for(size_t i = 1; i < mSkyline.size();)
+            {
+                if(mSkyline[i - 1].Y == mSkyline[i].Y)
+                {
+                    mSkyline[i - 1].Width += mSkyline[i].Width;
+                    mSkyline.erase(mSkyline.begin() + i);
+                }
+                else
+                    ++i;
+            }
+        }
+
+    private:
+        uint32 mWidth;
+        uint32 mHeight;
+        std::vector<Segment> mSkyline;
+    };
+
+    // Maximal free rectangles, best short side fit: slower than the skyline but it
+    // fills the holes the skyline leaves under tall neighbours.
+    class MaxRectsBin
+    {
+    public:
+        MaxRectsBin(uint32 width, uint32 height)
+        {
+            mFree.push_back({ 0, 0, width, height });
+        }
+
+        bool Insert(uint32 width, uint32 height, Rect& rect)
+        {
+            size_t best = mFree.size();
+            uint32 bestShort = 0, bestLong = 0;
+            for(size_t i = 0; i < mFree.size(); ++i)
+            {
+                const Rect& f = mFree[i];
+                if(f.Width < width || f.Height < height)
+                    continue;
+
+                const uint32 dx = f.Width - width;
+                const uint32 dy = f.Height - height;
+                const uint32 shortSide = std::min(dx, dy);
+                const uint32 longSide = std::max(dx, dy);
+                if(best == mFree.size() || shortSide < bestShort || (shortSide == bestShort && longSide < bestLong))
+                {
+                    best = i;
+                    bestShort = shortSide;
+                    bestLong = longSide;
+                }
+            }
+            if(best == mFree.size())
+                return false;
+
+            rect = { mFree[best].X, mFree[best].Y, width, height };
+            Split(rect);
+            return true;
+        }
+
+    private:
+        static bool Intersects(const Rect& a, const Rect& b)
+        {
+            return a.X < b.X + b.Width && b.X < a.X + a.Width && a.Y < b.Y + b.Height && b.Y < a.Y + a.Height;
+        }
+
+        static bool Contains(const Rect& outer, const Rect& inner)
+        {
+            return inner.X >= outer.X && inner.Y >= outer.Y &&
+                inner.X + inner.Width <= outer.X + outer.Width && inner.Y + inner.Height <= outer.Y + outer.Height;
+        }
+
+        // Replaces every free rectangle the placed one overlaps by the up to four
+        // maximal ones around it, then drops those inside others.
+        void Split(const Rect& placed)
+        {
+            mNext.clear();
+            for(const Rect& f : mFree)
+            {
+                if(!Intersects(f, placed))
+                {
+                    mNext.push_back(f);
+                    continue;
+                }
+
+                const uint32 fRight = f.X + f.Width, fBottom = f.Y + f.Height;
+                const uint32 pRight = placed.X + placed.Width, pBottom = placed.Y + placed.Height;
+                if(placed.X > f.X)
+                    mNext.push_back({ f.X, f.Y, placed.X - f.X, f.Height });
+                if(pRight < fRight)
+                    mNext.push_back({ pRight, f.Y, fRight - pRight, f.Height });
+                if(placed.Y > f.Y)
+                    mNext.push_back({ f.X, f.Y, f.Width, placed.Y - f.Y });
+                if(pBottom < fBottom)
+                    mNext.push_back({ f.X, pBottom, f.Width, fBottom - pBottom });
+            }
+
+            mFree.clear();
+            for(size_t i = 0; i < mNext.size(); ++i)
+            {
+                bool redundant = false;
+                for(size_t j = 0; j < mNext.size() && !redundant; ++j)
+                {
+                    // Of two equal rectangles the first is kept.
+                    redundant = i != j && Contains(mNext[j], mNext[i]) &&
+                        (j < i || !Contains(mNext[i], mNext[j]));
+                }
+                if(!redundant)
+                    mFree.push_back(mNext[i]);
+            }
+        }
+
+    private:
+        std::vector<Rect> mFree;
+        std::vector<Rect> mNext;
+    };
+
+    class Bin
+    {
+    public:
+        Bin(TexturePacker::Algorithm method, uint32 width, uint32 height)
+            : mMethod(method), mSkyline(width, height), mMaxRects(width, height)
+        {
+        }
+
+        bool Insert(uint32 width, uint32 height, Rect& rect)
+        {
+            const bool placed = mMethod == TexturePacker::Skyline ?
+                mSkyline.Insert(width, height, rect) : mMaxRects.Insert(width, height, rect);
+            if(placed)
+            {
+                mRight = std::max(mRight, rect.X + rect.Width);
+                mBottom = std::max(mBottom, rect.Y + rect.Height);
+            }
+            return placed;
+        }
+
+        uint32 Right()const { return mRight; }
+        uint32 Bottom()const { return mBottom; }
+
+    private:
+        TexturePacker::Algorithm mMethod;
+        SkylineBin mSkyline;
+        MaxRectsBin mMaxRects;
+        uint32 mRight = 0;
+        uint32 mBottom = 0;
+    };
+
+    bool IsPlain2D(const DdsFile::Info& info)
+    {
+        return info.ArraySize == 1 && info.Depth == 1 && !info.IsCubeMap && !info.IsVolume &&
+            DdsFile::BitsPerPixel(info.Format) != 0;
+    }
+
+    uint32 RoundUp(uint32 value, uint32 multiple)
+    {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+
+    uint64 MipOffset(const DdsFile::Info& info, uint32 mip)
+    {
+        uint64 offset = 0;
+        for(uint32 m = 0; m < mip; ++m)
+            offset += DdsFile::MipSize(info, m);
+        return offset;
+    }
+}
+
+XMFLOAT4X4 TexturePacker::Placement::Transform(const XMFLOAT4X4& matTransform)const
+{
+    XMMATRIX toPage = XMMatrixScaling(Scale.x, Scale.y, 1.0f) * XMMatrixTranslation(Offset.x, Offset.y, (float)Slice);
+
+    XMFLOAT4X4 result;
+    XMStoreFloat4x4(&result, XMLoadFloat4x4(&matTransform) * toPage);
+    return result;
+}
+
+TexturePacker::Result TexturePacker::Pack(const std::vector<Texture>& textures, const Options& options)
+{
+    Result result;
+    result.Placements.resize(textures.size());
+
+    const uint32 count = (uint32)textures.size();
+    std::vector<bool> packed(count, false);
+
+    // Arrays first: same format, size and mips.  Groups keep the order of their first
+    // texture, so the result does not depend on map ordering.
+    if(options.UseArrays)
+    {
+        using Key = std::tuple<uint32, uint32, uint32, uint32>;
+        std::map<Key, uint32> groupOf;
+        std::vector<std::vector<uint32>> groups;
+        for(uint32 i = 0; i < count; ++i)
+        {
+            const DdsFile::Info& info = textures[i].Info;
+            if(!IsPlain2D(info))
+                continue;
+
+            const Key key(info.Format, info.Width, info.Height, info.MipCount);
+            auto it = groupOf.find(key);
+            if(it == groupOf.end())
+            {
+                it = groupOf.emplace(key, (uint32)groups.size()).first;
+                groups.emplace_back();
+            }
+            groups[it->second].push_back(i);
+        }
+
+        const uint32 maxSlices = std::max(options.MaxArraySize, 1u);
+        for(const std::vector<uint32>& group : groups)
+        {
+            for(size_t first = 0; first < group.size(); first += maxSlices)
+            {
+                const uint32 slices = (uint32)std::min<size_t>(maxSlices, group.size() - first);
+                if(slices < std::max(options.MinArraySize, 1u))
+                    break;
+
+                const uint32 pageIndex = (uint32)result.Pages.size();
+                result.Pages.emplace_back();
+                Page& page = result.Pages.back();
+                page.Info = textures[group[first]].Info;
+                page.Info.ArraySize = slices;
+                page.Info.DataOffset = 0;
+                page.IsArray = true;
+
+                for(uint32 slice = 0; slice < slices; ++slice)
+                {
+                    const uint32 texture = group[first + slice];
+                    page.Textures.push_back(texture);
+                    packed[texture] = true;
+
+                    Placement& placement = result.Placements[texture];
+                    placement.Page = pageIndex;
+                    placement.Slice = slice;
+                }
+            }
+        }
+    }
+
+    // Atlases, per format.  Everything is placed in units of the alignment, so every
+    // rectangle and gutter stays whole down to the last mip.
+    const uint32 mipCount = std::min(std::max(options.MipCount, 1u), 12u);
+    std::vector<uint32> formats;
+    for(uint32 i = 0; i < count; ++i)
+    {
+        if(!packed[i] && IsPlain2D(textures[i].Info) &&
+            std::find(formats.begin(), formats.end(), textures[i].Info.Format) == formats.end())
+            formats.push_back(textures[i].Info.Format);
+    }
+
+    for(uint32 format : formats)
+    {
+        const uint32 block = DdsFile::IsBlockCompressed(format) ? 4 : 1;
+        const uint32 align = block << (mipCount - 1);
+        const uint32 gutter = align + RoundUp(options.Padding, align);
+        const uint32 binSize = options.MaxSize / align;
+
+        std::vector<uint32> items;
+        for(uint32 i = 0; i < count; ++i)
+        {
+            const Texture& t = textures[i];
+            if(packed[i] || t.Repeats || !IsPlain2D(t.Info) || t.Info.Format != format || t.Info.MipCount < mipCount)
+                continue;
+            if(t.Info.Width % align != 0 || t.Info.Height % align != 0)
+                continue;
+            if((t.Info.Width + 2 * gutter) / align > binSize || (t.Info.Height + 2 * gutter) / align > binSize)
+                continue;
+            items.push_back(i);
+        }
+
+        // Largest side first, then largest area.
+        std::sort(items.begin(), items.end(), [&textures](uint32 a, uint32 b)
+        {
+            const DdsFile::Info& ia = textures[a].Info;
+            const DdsFile::Info& ib = textures[b].Info;
+            const uint32 sa = std::max(ia.Width, ia.Height), sb = std::max(ib.Width, ib.Height);
+            if(sa != sb)
+                return sa > sb;
+            const uint64 aa = (uint64)ia.Width * ia.Height, ab = (uint64)ib.Width * ib.Height;
+            if(aa != ab)
+                return aa > ab;
+            return a < b;
+        });
+
+        std::vector<Bin> bins;
+        std::vector<std::vector<std::pair<uint32, Rect>>> contents;
+        for(uint32 i : items)
+        {
+            const uint32 w = (textures[i].Info.Width + 2 * gutter) / align;
+            const uint32 h = (textures[i].Info.Height + 2 * gutter) / align;
+
+            Rect rect;
+            size_t b = 0;
+            while(b < bins.size() && !bins[b].Insert(w, h, rect))
+                ++b;
+            if(b == bins.size())
+            {
+                bins.emplace_back(options.Method, binSize, binSize);
+                contents.emplace_back();
+                bins.back().Insert(w, h, rect);
+            }
+            contents[b].emplace_back(i, rect);
+        }
+
+        for(size_t b = 0; b < bins.size(); ++b)
+        {
+            const uint32 pageIndex = (uint32)result.Pages.size();
+            result.Pages.emplace_back();
+            Page& page = result.Pages.back();
+            page.Info.Width = bins[b].Right() * align;
+            page.Info.Height = bins[b].Bottom() * align;
+            page.Info.MipCount = mipCount;
+            page.Info.Format = format;
+            page.Gutter = gutter;
+            result.AtlasTexels += (uint64)page.Info.Width * page.Info.Height;
+
+            for(const std::pair<uint32, Rect>& item : contents[b])
+            {
+                const DdsFile::Info& info = textures[item.first].Info;
+                page.Textures.push_back(item.first);
+                packed[item.first] = true;
+                result.PackedTexels += (uint64)info.Width * info.Height;
+
+                Placement& placement = result.Placements[item.first];
+                placement.Page = pageIndex;
+                placement.X = item.second.X * align + gutter;
+                placement.Y = item.second.Y * align + gutter;
+                placement.Scale = XMFLOAT2((float)info.Width / page.Info.Width, (float)info.Height / page.Info.Height);
+                placement.Offset = XMFLOAT2((float)placement.X / page.Info.Width, (float)placement.Y / page.Info.Height);
+            }
+        }
+    }
+
+    for(bool p : packed)
+        result.Unpacked += p ? 0 : 1;
+    return result;
+}
+
+void TexturePacker::Compose(const Result& result, uint32 pageIndex, const std::vector<Texture>& textures,
+    const std::vector<const uint8*>& sources, std::vector<uint8>& surfaces, ThreadPool& pool)
+{
+    const Page& page = result.Pages[pageIndex];
+    surfaces.assign((size_t)DdsFile::DataSize(page.Info), 0);
+
+    if(page.IsArray)
+    {
+        // Same layout as every slice; copy the mips the array keeps.
+        DdsFile::Info slice = page.Info;
+        slice.ArraySize = 1;
+        const size_t sliceBytes = (size_t)DdsFile::DataSize(slice);
+        pool.ParallelFor(page.Textures.size(), 1, [&](size_t begin, size_t end)
+        {
+            for(size_t s = begin; s < end; ++s)
+                std::memcpy(&surfaces[s * sliceBytes], sources[page.Textures[s]], sliceBytes);
+        });
+        return;
+    }
+
+    // Atlases are copied in elements: texels, or 4x4 blocks for the BC formats.
+    const uint32 format = page.Info.Format;
+    const uint32 block = DdsFile::IsBlockCompressed(format) ? 4 : 1;
+    const size_t elementBytes = block == 4 ? DdsFile::BitsPerPixel(format) * 2 : DdsFile::BitsPerPixel(format) / 8;
+
+    for(uint32 mip = 0; mip < page.Info.MipCount; ++mip)
+    {
+        uint64 pagePitch;
+        DdsFile::SurfaceSize(format, DdsFile::MipDimension(page.Info.Width, mip),
+            DdsFile::MipDimension(page.Info.Height, mip), &pagePitch);
+        uint8* dstMip = &surfaces[(size_t)MipOffset(page.Info, mip)];
+
+        pool.ParallelFor(page.Textures.size(), 1, [&](size_t begin, size_t end)
+        {
+            for(size_t t = begin; t < end; ++t)
+            {
+                const uint32 texture = page.Textures[t];
+                const DdsFile::Info& info = textures[texture].Info;
+                const Placement& placement = result.Placements[texture];
+
+                uint64 srcPitch;
+                DdsFile::SurfaceSize(format, DdsFile::MipDimension(info.Width, mip),
+                    DdsFile::MipDimension(info.Height, mip), &srcPitch);
+                const uint8* srcMip = sources[texture] + MipOffset(info, mip);
+
+                const uint32 x = (placement.X >> mip) / block;
+                const uint32 y = (placement.Y >> mip) / block;
+                const uint32 width = (info.Width >> mip) / block;
+                const uint32 height = (info.Height >> mip) / block;
+                const uint32 gutter = (page.Gutter >> mip) / block;
+
+                for(int row = -(int)gutter; row < (int)(height + gutter); ++row)
+                {
+                    const uint32 srcRow = (uint32)std::min(std::max(row, 0), (int)height - 1);
+                    const uint8* src = srcMip + srcRow * srcPitch;
+                    uint8* dst = dstMip + (y + row) * pagePitch + (x - gutter) * elementBytes;
+
+                    for(uint32 i = 0; i < gutter; ++i)
+                        std::memcpy(dst + i * elementBytes, src, elementBytes);
+                    std::memcpy(dst + gutter * elementBytes, src, width * elementBytes);
+                    for(uint32 i = 0; i < gutter; ++i)
+                        std::memcpy(dst + (gutter + width + i) * elementBytes, src + (width - 1) * elementBytes, elementBytes);
+                }
+            }
+        });
+    }
+}
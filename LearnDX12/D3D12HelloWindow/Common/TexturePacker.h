@@ -0,0 +1,132 @@
+//***************************************************************************************
+// TexturePacker.h
+//
+// Groups textures of the same format so that many materials share one descriptor:
+// textures of the same size and mip count become texture arrays, and the rest are
+// packed into atlas pages with a skyline or a maximal rectangles packer.  Every
+// texture gets a Placement whose Transform() folds the move into its material's
+// MatTransform, so the shader's mul(float4(uv, 0, 1), MatTransform) lands in the
+// texture's rectangle, with the array slice in z.
+//
+// Atlases are mip safe: they keep Options::MipCount mips, every rectangle and gutter
+// is aligned so that it still starts on a whole texel (block, for the BC formats) in
+// the smallest of them, and gutters are at least one texel wide there.  Gutters
+// repeat the edge texels; the BC formats repeat whole edge blocks.  Textures that
+// repeat across their UVs cannot live in an atlas and only go into arrays.
+//
+// Pack() only decides placement; Compose() builds a page's surfaces from the source
+// surfaces, in DdsFile layout, ready for DdsFile::Save() at build time or for an
+// upload at load time.
+//***************************************************************************************
+
+#pragma once
+
+#include "DdsFile.h"
+#include "ThreadPool.h"
+#include <DirectXMath.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class TexturePacker
+{
+public:
+    using uint8 = std::uint8_t;
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+    static const uint32 NoPage = 0xffffffff;
+
+    enum Algorithm { Skyline, MaxRects };
+
+    struct Options
+    {
+        Algorithm Method = MaxRects;
+
+        // Largest atlas width and height.
+        uint32 MaxSize = 4096;
+
+        // Mips atlases keep.  Textures with fewer mips, or sizes that do not halve
+        // evenly that often, are left out.
+        uint32 MipCount = 4;
+
+        // Mip 0 texels of gutter wanted on each side beyond the mip safe minimum,
+        // for anisotropic filtering.
+        uint32 Padding = 0;
+
+        // Same size textures go into arrays of at least MinArraySize slices before
+        // anything is atlased.
+        bool UseArrays = true;
+        uint32 MinArraySize = 2;
+        uint32 MaxArraySize = 256;
+    };
+
+    struct Texture
+    {
+        std::string Name;
+        DdsFile::Info Info;
+
+        // Sampled outside [0, 1] with wrapping or mirroring.
+        bool Repeats = false;
+    };
+
+    struct Placement
+    {
+        // NoPage if the texture stays on its own.
+        uint32 Page = NoPage;
+        uint32 Slice = 0;
+
+        // Mip 0 texels of the page where the texture starts.
+        uint32 X = 0;
+        uint32 Y = 0;
+
+        // uv * scale + offset in page UVs.
+        DirectX::XMFLOAT2 Scale = { 1.0f, 1.0f };
+        DirectX::XMFLOAT2 Offset = { 0.0f, 0.0f };
+
+        ///<summary>
+        /// matTransform, as a Material keeps it (not transposed), followed by the move
+        /// to the page.  The slice is added to z, for sampling a Texture2DArray.
+        ///</summary>
+        DirectX::XMFLOAT4X4 Transform(const DirectX::XMFLOAT4X4& matTransform)const;
+    };
+
+    struct Page
+    {
+        // ArraySize is the slice count of arrays and 1 for atlases.
+        DdsFile::Info Info;
+        bool IsArray = false;
+
+        // Indices of the textures on the page; for arrays in slice order.
+        std::vector<uint32> Textures;
+
+        // Mip 0 texels of gutter around each texture of an atlas.
+        uint32 Gutter = 0;
+    };
+
+    struct Result
+    {
+        std::vector<Page> Pages;
+        std::vector<Placement> Placements;  // one per texture
+
+        // Mip 0 texels of the atlas pages, and of the textures on them.
+        uint64 AtlasTexels = 0;
+        uint64 PackedTexels = 0;
+
+        uint32 Unpacked = 0;
+
+        // How much of the atlases the textures cover, gutters not counted.
+        double Occupancy()const { return AtlasTexels > 0 ? (double)PackedTexels / AtlasTexels : 0.0; }
+    };
+
+    static Result Pack(const std::vector<Texture>& textures, const Options& options);
+
+    ///<summary>
+    /// Fills surfaces with page of result, in DdsFile layout for the page's Info.
+    /// sources[i] holds the surfaces of textures[i] in DdsFile layout; only those of
+    /// the textures on the page are read.  Texels no texture covers are zero.
+    ///</summary>
+    static void Compose(const Result& result, uint32 page, const std::vector<Texture>& textures,
+        const std::vector<const uint8*>& sources, std::vector<uint8>& surfaces,
+        ThreadPool& pool = ThreadPool::Default());
+};
@@ -0,0 +1,309 @@
+//***************************************************************************************
+// TextureResidency.cpp
+//***************************************************************************************
+
+#include "TextureResidency.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+const TextureResidency::uint32 TextureResidency::NoTexture;
+
+TextureResidency::TextureResidency()
+    : TextureResidency(Config())
+{
+}
+
+TextureResidency::TextureResidency(const Config& config)
+    : mConfig(config)
+{
+}
+
+TextureResidency::uint32 TextureResidency::AddTexture(const std::vector<uint64>& mipBytes, uint32 tailMip)
+{
+    assert(!mipBytes.empty());
+
+    uint32 id;
+    if(!mFreeIds.empty())
+    {
+        id = mFreeIds.back();
+        mFreeIds.pop_back();
+    }
+    else
+    {
+        id = (uint32)mTextures.size();
+        mTextures.emplace_back();
+    }
+
+    Texture& texture = mTextures[id];
+    texture = Texture();
+    texture.MipBytes = mipBytes;
+    texture.TailMip = std::min(tailMip, (uint32)mipBytes.size() - 1);
+    texture.ResidentMip = texture.TailMip;
+    texture.RequestedMip = texture.TailMip;
+    texture.DesiredMip = texture.TailMip;
+    texture.LastUsedFrame = mFrame;
+    texture.Live = true;
+
+    for(uint32 mip = texture.TailMip; mip < mipBytes.size(); ++mip)
+        mStats.ResidentBytes += mipBytes[mip];
+    mStats.PeakResidentBytes = std::max(mStats.PeakResidentBytes, mStats.ResidentBytes);
+    return id;
+}
+
+TextureResidency::uint32 TextureResidency::AddTexture(const DdsFile::Info& info, uint64 tailBytes)
+{
+    std::vector<uint64> mipBytes(info.MipCount);
+    uint32 tailMip = info.MipCount - 1;
+    for(uint32 mip = 0; mip < info.MipCount; ++mip)
+    {
+        mipBytes[mip] = DdsFile::MipSize(info, mip) * info.ArraySize;
+        if(mipBytes[mip] < tailBytes)
+            tailMip = std::min(tailMip, mip);
+    }
+    return AddTexture(mipBytes, tailMip);
+}
+
+void TextureResidency::RemoveTexture(uint32 texture)
+{
+    Texture& t = mTextures[texture];
+    assert(t.Live);
+
+    for(uint32 mip = t.RequestedMip; mip < t.MipBytes.size(); ++mip)
+        mStats.ResidentBytes -= t.MipBytes[mip];
+
+    t = Texture();
+    mFreeIds.push_back(texture);
+}
+
+void TextureResidency::Request(uint32 texture, float desiredMip, float priority)
+{
+    Texture& t = mTextures[texture];
+    assert(t.Live);
+
+    // The tail is always there, so asking for anything coarser asks for the tail.
+    const float clamped = std::min(std::max(desiredMip, 0.0f), (float)t.TailMip);
+    const uint32 mip = (uint32)clamped;
+
+    if(!t.Requested)
+    {
+        t.Requested = true;
+        t.DesiredMip = mip;
+        t.Priority = priority;
+    }
+    else
+    {
+        t.DesiredMip = std::min(t.DesiredMip, mip);
+        t.Priority = std::max(t.Priority, priority);
+    }
+    t.LastUsedFrame = mFrame;
+}
+
+TextureResidency::uint32 TextureResidency::FindVictim(uint32 loading, float priority)const
+{
+    // Ranked by what eviction costs: mips finer than their texture wants cost nothing
+    // on screen, then textures not seen this frame, oldest first, then visible ones of
+    // lower priority than the load.  Lower priority breaks ties.
+    uint32 best = NoTexture;
+    int bestRank = 0;
+    uint64 bestFrame = 0;
+    float bestPriority = 0.0f;
+
+    for(uint32 id = 0; id < mTextures.size(); ++id)
+    {
+        const Texture& t = mTextures[id];
+        if(!t.Live || id == loading || Loading(t) || t.ResidentMip >= t.TailMip)
+            continue;
+
+        int rank;
+        if(t.Requested && t.ResidentMip < t.DesiredMip)
+            rank = 0;
+        else if(!t.Requested)
+            rank = 1;
+        else if(t.Priority < priority)
+            rank = 2;
+        else
+            continue;
+
+        const bool better = best == NoTexture || rank < bestRank ||
+            (rank == bestRank && (t.LastUsedFrame < bestFrame ||
+            (t.LastUsedFrame == bestFrame && t.Priority < bestPriority)));
+        if(better)
+        {
+            best = id;
+            bestRank = rank;
+            bestFrame = t.LastUsedFrame;
+            bestPriority = t.Priority;
+        }
+    }
+    return best;
+}
+
+void TextureResidency::Evict(uint32 texture)
+{
+    Texture& t = mTextures[texture];
+    const uint32 mip = t.ResidentMip;
+    const uint64 bytes = t.MipBytes[mip];
+
+    t.ResidentMip++;
+    t.RequestedMip++;
+    mStats.ResidentBytes -= bytes;
+    mStats.EvictedBytes += bytes;
+    mStats.Evictions++;
+
+    mActions.push_back({ Action::Evict, texture, mip });
+}
+
+void TextureResidency::Unevict(uint32 texture)
+{
+    Texture& t = mTextures[texture];
+    t.ResidentMip--;
+    t.RequestedMip--;
+
+    const uint64 bytes = t.MipBytes[t.ResidentMip];
+    mStats.ResidentBytes += bytes;
+    mStats.EvictedBytes -= bytes;
+    mStats.Evictions--;
+}
+
+const std::vector<TextureResidency::Action>& TextureResidency::Update()
+{
+    mActions.clear();
+    mCandidates.clear();
+
+    mStats.RequestedTextures = 0;
+    mStats.SatisfiedTextures = 0;
+    for(uint32 id = 0; id < mTextures.size(); ++id)
+    {
+        const Texture& t = mTextures[id];
+        if(!t.Live || !t.Requested)
+            continue;
+
+        mStats.RequestedTextures++;
+        if(t.ResidentMip <= t.DesiredMip)
+            mStats.SatisfiedTextures++;
+        else if(!Loading(t))
+            mCandidates.push_back(id);
+    }
+
+    std::sort(mCandidates.begin(), mCandidates.end(), [this](uint32 a, uint32 b)
+    {
+        const Texture& ta = mTextures[a];
+        const Texture& tb = mTextures[b];
+        if(ta.Priority != tb.Priority)
+            return ta.Priority > tb.Priority;
+        return ta.RequestedMip - ta.DesiredMip > tb.RequestedMip - tb.DesiredMip;
+    });
+
+    uint32 loads = 0;
+    uint64 loadBytes = 0;
+    for(uint32 id : mCandidates)
+    {
+        Texture& t = mTextures[id];
+        const uint32 mip = t.RequestedMip - 1;
+        const uint64 bytes = t.MipBytes[mip];
+
+        if(loads >= mConfig.MaxLoadsPerUpdate ||
+            (loads > 0 && loadBytes + bytes > mConfig.MaxLoadBytesPerUpdate))
+            break;
+
+        // Make room first; if not enough can be freed, put the victims back.
+        const size_t firstEviction = mActions.size();
+        while(mStats.ResidentBytes + bytes > mConfig.Budget)
+        {
+            const uint32 victim = FindVictim(id, t.Priority);
+            if(victim == NoTexture)
+                break;
+            Evict(victim);
+        }
+
+        if(mStats.ResidentBytes + bytes > mConfig.Budget)
+        {
+            while(mActions.size() > firstEviction)
+            {
+                Unevict(mActions.back().Texture);
+                mActions.pop_back();
+            }
+
+            mStats.DeniedLoads++;
+            continue;
+        }
+
+        t.RequestedMip = mip;
+        mStats.ResidentBytes += bytes;
+        mStats.PeakResidentBytes = std::max(mStats.PeakResidentBytes, mStats.ResidentBytes);
+        mActions.push_back({ Action::Load, id, mip });
+
+        loads++;
+        loadBytes += bytes;
+    }
+
+    // Requests are per frame.
+    for(Texture& t : mTextures)
+        t.Requested = false;
+    mFrame++;
+
+    return mActions;
+}
+
+void TextureResidency::Loaded(uint32 texture, uint32 mip)
+{
+    Texture& t = mTextures[texture];
+    if(!t.Live || mip != t.ResidentMip - 1 || mip < t.RequestedMip)
+        return;
+
+    t.ResidentMip = mip;
+    mStats.LoadedBytes += t.MipBytes[mip];
+    mStats.Loads++;
+}
+
+void TextureResidency::LoadFailed(uint32 texture, uint32 mip)
+{
+    Texture& t = mTextures[texture];
+    if(!t.Live || mip != t.RequestedMip || !Loading(t))
+        return;
+
+    t.RequestedMip = t.ResidentMip;
+    mStats.ResidentBytes -= t.MipBytes[mip];
+}
+
+TextureResidency::Stats TextureResidency::GetStats()const
+{
+    Stats stats = mStats;
+    stats.Budget = mConfig.Budget;
+    return stats;
+}
+
+float TextureResidency::DesiredMip(float uvPerUnit, uint32 size, float distance, float fovY, float viewportHeight)
+{
+    if(distance <= 0.0f || uvPerUnit <= 0.0f)
+        return 0.0f;
+
+    const float texelsPerUnit = uvPerUnit * size;
+    const float pixelsPerUnit = viewportHeight / (2.0f * distance * std::tan(0.5f * fovY));
+    return std::max(std::log2(texelsPerUnit / pixelsPerUnit), 0.0f);
+}
+
+float TextureResidency::UvDensity(const GeometryGenerator::MeshData& mesh)
+{
+    double worldArea = 0.0;
+    double uvArea = 0.0;
+    for(size_t i = 0; i + 2 < mesh.Indices32.size(); i += 3)
+    {
+        const GeometryGenerator::Vertex& v0 = mesh.Vertices[mesh.Indices32[i + 0]];
+        const GeometryGenerator::Vertex& v1 = mesh.Vertices[mesh.Indices32[i + 1]];
+        const GeometryGenerator::Vertex& v2 = mesh.Vertices[mesh.Indices32[i + 2]];
+
+        const double e1[3] = { v1.Position.x - v0.Position.x, v1.Position.y - v0.Position.y, v1.Position.z - v0.Position.z };
+        const double e2[3] = { v2.Position.x - v0.Position.x, v2.Position.y - v0.Position.y, v2.Position.z - v0.Position.z };
+        const double cx = e1[1] * e2[2] - e1[2] * e2[1];
+        const double cy = e1[2] * e2[0] - e1[0] * e2[2];
+        const double cz = e1[0] * e2[1] - e1[1] * e2[0];
+        worldArea += 0.5 * std::sqrt(cx * cx + cy * cy + cz * cz);
+
+        const double du1 = v1.TexC.x - v0.TexC.x, dv1 = v1.TexC.y - v0.TexC.y;
+        const double du2 = v2.TexC.x - v0.TexC.x, dv2 = v2.TexC.y - v0.TexC.y;
+        uvArea += 0.5 * std::abs(du1 * dv2 - dv1 * du2);
+    }
+    return worldArea > 0.0 ? (float)std::sqrt(uvArea / worldArea) : 0.0f;
+}
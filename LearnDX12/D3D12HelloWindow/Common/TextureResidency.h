@@ -0,0 +1,169 @@
+//***************************************************************************************
+// TextureResidency.h
+//
+// Decides which mips of which textures are resident under a memory budget.  Every
+// texture keeps a contiguous run of mips resident, from its finest loaded mip down to
+// a tail of small mips that never leaves.  Each frame the renderer Request()s the mip
+// every visible texture should show, from the screen-space density of its texture
+// coordinates, with a priority such as its screen size; Update() then hands back
+// which mips to load and which to evict:
+//
+//   - textures short of their desired mip load one finer mip at a time, highest
+//     priority and largest shortfall first, so coarse mips arrive before fine ones;
+//   - when a load does not fit the budget, finer-than-desired mips are evicted first,
+//     then mips of textures least recently requested and lowest in priority, but
+//     never for a load that matters less than the mip it would replace.
+//
+// Loads are asynchronous: a mip counts against the budget from the Update() that
+// asks for it, and the caller reports it back with Loaded() or LoadFailed().
+//
+// Mip sizes are whatever the caller pays for them; AsyncTextureLoader is the D3D12
+// front end, backing each texture with a reserved resource.
+//***************************************************************************************
+
+#pragma once
+
+#include "DdsFile.h"
+#include "GeometryGenerator.h"
+#include <cstdint>
+#include <vector>
+
+class TextureResidency
+{
+public:
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+    static const uint32 NoTexture = 0xffffffff;
+
+    struct Config
+    {
+        uint64 Budget = 256ull * 1024 * 1024;
+
+        // Loads started per Update(), by count and by bytes.  At least one load is
+        // started whenever the budget allows, however large.
+        uint32 MaxLoadsPerUpdate = 8;
+        uint64 MaxLoadBytesPerUpdate = 32ull * 1024 * 1024;
+    };
+
+    struct Action
+    {
+        enum Type { Load, Evict };
+
+        Type Kind;
+        uint32 Texture;
+        uint32 Mip;
+    };
+
+    struct Stats
+    {
+        uint64 Budget = 0;
+        uint64 ResidentBytes = 0;   // loading mips included
+        uint64 PeakResidentBytes = 0;
+        uint64 LoadedBytes = 0;
+        uint64 EvictedBytes = 0;
+        uint32 Loads = 0;
+        uint32 Evictions = 0;
+
+        // Loads Update() wanted to start but could not fit in the budget.
+        uint32 DeniedLoads = 0;
+
+        // Textures requested in the last Update() and how many of them were at their
+        // desired mip.
+        uint32 RequestedTextures = 0;
+        uint32 SatisfiedTextures = 0;
+    };
+
+    TextureResidency();
+    explicit TextureResidency(const Config& config);
+
+    ///<summary>
+    /// Registers a texture whose mip m costs mipBytes[m] bytes.  Mips from tailMip on
+    /// are resident from the start, and count against the budget even past it.
+    ///</summary>
+    uint32 AddTexture(const std::vector<uint64>& mipBytes, uint32 tailMip);
+
+    // Same, for a DDS file: mips smaller than tailBytes form the tail.
+    uint32 AddTexture(const DdsFile::Info& info, uint64 tailBytes = 64 * 1024);
+
+    // The caller stops using the texture's memory; loads in flight are forgotten.
+    void RemoveTexture(uint32 texture);
+
+    ///<summary>
+    /// The texture is visible this frame and would like mip desiredMip (rounded down,
+    /// the finer mip) at the given priority.  Several requests for one texture keep
+    /// the finest mip and the highest priority.
+    ///</summary>
+    void Request(uint32 texture, float desiredMip, float priority);
+
+    ///<summary>
+    /// Ends a frame and returns what to load and evict for it.  Evictions in the list
+    /// come before the loads they make room for.
+    ///</summary>
+    const std::vector<Action>& Update();
+
+    void Loaded(uint32 texture, uint32 mip);
+    void LoadFailed(uint32 texture, uint32 mip);
+
+    // Finest mip whose load has completed, and finest asked for.
+    uint32 ResidentMip(uint32 texture)const { return mTextures[texture].ResidentMip; }
+    uint32 RequestedMip(uint32 texture)const { return mTextures[texture].RequestedMip; }
+
+    void SetBudget(uint64 budget) { mConfig.Budget = budget; }
+    const Config& GetConfig()const { return mConfig; }
+    Stats GetStats()const;
+
+    ///<summary>
+    /// Mip at which a texel of a size texel wide texture covers about a pixel, on a
+    /// surface whose texture coordinates change by uvPerUnit per world unit, seen at
+    /// distance with a fovY radian view viewportHeight pixels tall.
+    ///</summary>
+    static float DesiredMip(float uvPerUnit, uint32 size, float distance, float fovY, float viewportHeight);
+
+    ///<summary>
+    /// Texture coordinate units per world unit of a mesh, the square root of its
+    /// total UV area over its total surface area; a material's density is the
+    /// largest over the meshes using it.
+    ///</summary>
+    static float UvDensity(const GeometryGenerator::MeshData& mesh);
+
+private:
+    struct Texture
+    {
+        std::vector<uint64> MipBytes;
+        uint32 TailMip = 0;
+
+        // Finest mip loaded, and finest loaded or loading.
+        uint32 ResidentMip = 0;
+        uint32 RequestedMip = 0;
+
+        // From the requests of the frame being recorded and of the last one.
+        uint32 DesiredMip = 0;
+        float Priority = 0.0f;
+        uint64 LastUsedFrame = 0;
+        bool Requested = false;
+
+        bool Live = false;
+    };
+
+    bool Loading(const Texture& texture)const { return texture.RequestedMip < texture.ResidentMip; }
+
+    // Texture whose finest mip is the cheapest to give up for a load of priority, or
+    // NoTexture if none may be given up.
+    uint32 FindVictim(uint32 loading, float priority)const;
+
+    // Drops the texture's finest mip, and undoes that.
+    void Evict(uint32 texture);
+    void Unevict(uint32 texture);
+
+private:
+    Config mConfig;
+    std::vector<Texture> mTextures;
+    std::vector<uint32> mFreeIds;
+
+    uint64 mFrame = 0;
+    std::vector<Action> mActions;
+    std::vector<uint32> mCandidates;
+
+    Stats mStats;
+};
@@ -0,0 +1,131 @@
+//***************************************************************************************
+// ThreadPool.cpp
+//***************************************************************************************
+
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(unsigned threadCount)
+{
+    if(threadCount == 0)
+    {
+        unsigned hw = std::thread::hardware_concurrency();
+        threadCount = hw > 1 ? hw - 1 : 1;
+    }
+
+    mWorkers.reserve(threadCount);
+    for(unsigned i = 0; i < threadCount; ++i)
+        mWorkers.emplace_back([this]() { WorkerLoop(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mCondition.notify_all();
+
+    for(auto& worker : mWorkers)
+        worker.join();
+}
+
+ThreadPool& ThreadPool::Default()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+unsigned ThreadPool::ThreadCount()const
+{
+    return (unsigned)mWorkers.size();
+}
+
+void ThreadPool::Enqueue(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTasks.push_back(std::move(task));
+    }
+    mCondition.notify_one();
+}
+
+void ThreadPool::WorkerLoop()
+{
+    for(;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait(lock, [this]() { return mStopping || !mTasks.empty(); });
+
+            // Drain the queue before stopping so no future is left unsatisfied.
+            if(mTasks.empty())
+                return;
+
+            task = std::move(mTasks.front());
+            mTasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::ParallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& func)
+{
+    if(count == 0)
+        return;
+
+    grainSize = std::max<size_t>(grainSize, 1);
+    const size_t chunkCount = (count + grainSize - 1)/grainSize;
+
+    if(chunkCount == 1 || mWorkers.empty())
+    {
+        func(0, count);
+        return;
+    }
+
+    // Helpers may still be queued after we return; they only touch the shared state
+    // and find no chunk left, so func is never called once the loop has finished.
+    struct State
+    {
+        std::atomic<size_t> Next;
+        std::atomic<size_t> Done;
+        std::mutex Mutex;
+        std::condition_variable Finished;
+    };
+    auto state = std::make_shared<State>();
+    state->Next = 0;
+    state->Done = 0;
+
+    const std::function<void(size_t, size_t)>* body = &func;
+    auto work = [state, body, count, grainSize, chunkCount]()
+    {
+        size_t finished = 0;
+        for(;;)
+        {
+            size_t chunk = state->Next.fetch_add(1);
+            if(chunk >= chunkCount)
+                break;
+
+            size_t begin = chunk*grainSize;
+            (*body)(begin, std::min(begin + grainSize, count));
+            ++finished;
+        }
+
+        if(finished > 0 && state->Done.fetch_add(finished) + finished == chunkCount)
+        {
+            std::lock_guard<std::mutex> lock(state->Mutex);
+            state->Finished.notify_all();
+        }
+    };
+
+    size_t helpers = std::min<size_t>(mWorkers.size(), chunkCount - 1);
+    for(size_t i = 0; i < helpers; ++i)
+        Enqueue(work);
+
+    work();
+
+    std::unique_lock<std::mutex> lock(state->Mutex);
+    state->Finished.wait(lock, [&state, chunkCount]() { return state->Done.load() == chunkCount; });
+}
@@ -0,0 +1,65 @@
+//***************************************************************************************
+// ThreadPool.h
+//
+// Small fixed-size worker pool for CPU side asset work (geometry packing, mesh
+// processing, loading).  Plain std::thread so it builds and runs anywhere.
+//***************************************************************************************
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    // threadCount == 0 creates one worker per hardware thread, minus the caller.
+    explicit ThreadPool(unsigned threadCount = 0);
+    ThreadPool(const ThreadPool& rhs) = delete;
+    ThreadPool& operator=(const ThreadPool& rhs) = delete;
+    ~ThreadPool();
+
+    // Process-wide pool shared by the Common helpers.
+    static ThreadPool& Default();
+
+    unsigned ThreadCount()const;
+
+    // Queues func on a worker and returns a future for its result.
+    template<typename F>
+    std::future<typename std::result_of<F()>::type> Submit(F&& func)
+    {
+        using R = typename std::result_of<F()>::type;
+
+        // std::function needs a copyable target, packaged_task is move only.
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(func));
+        std::future<R> result = task->get_future();
+        Enqueue([task]() { (*task)(); });
+
+        return result;
+    }
+
+    // Runs func(begin, end) over [0, count) in chunks of grainSize and returns once
+    // every chunk is done.  The calling thread takes chunks too, so ParallelFor may
+    // be nested inside a task without starving the pool.  func must not throw.
+    void ParallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& func);
+
+private:
+    void Enqueue(std::function<void()> task);
+    void WorkerLoop();
+
+private:
+    std::vector<std::thread> mWorkers;
+    std::deque<std::function<void()>> mTasks;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    bool mStopping = false;
+};
@@ -0,0 +1,334 @@
+//***************************************************************************************
+// TlsfAllocator.cpp
+//***************************************************************************************
+
+#include "TlsfAllocator.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+const TlsfAllocator::uint32 TlsfAllocator::NoOffset;
+const TlsfAllocator::uint32 TlsfAllocator::SecondLevelBits;
+const TlsfAllocator::uint32 TlsfAllocator::SecondLevelCount;
+const TlsfAllocator::uint32 TlsfAllocator::FirstLevelCount;
+
+namespace
+{
+    // Index of the highest and the lowest set bit; x must not be 0.
+    std::uint32_t HighestBit(std::uint32_t x)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse(&index, x);
+        return index;
+#else
+        return 31 - __builtin_clz(x);
+#endif
+    }
+
+    std::uint32_t LowestBit(std::uint32_t x)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, x);
+        return index;
+#else
+        return __builtin_ctz(x);
+#endif
+    }
+}
+
+TlsfAllocator::TlsfAllocator(uint32 capacity)
+{
+    Reset(capacity);
+}
+
+void TlsfAllocator::Reset(uint32 capacity)
+{
+    mBlocks.clear();
+    mUnusedBlocks.clear();
+    mFirstLevelBitmap = 0;
+    std::memset(mSecondLevelBitmaps, 0, sizeof(mSecondLevelBitmaps));
+    std::fill(&mFreeHeads[0][0], &mFreeHeads[0][0] + FirstLevelCount*SecondLevelCount, NoOffset);
+
+    mFirstBlock = NoOffset;
+    mLastBlock = NoOffset;
+    mCapacity = 0;
+    mUsedSize = 0;
+    mAllocationCount = 0;
+
+    Grow(capacity);
+}
+
+void TlsfAllocator::Mapping(uint32 size, uint32& firstLevel, uint32& secondLevel)
+{
+    if(size < SecondLevelCount)
+    {
+        firstLevel = 0;
+        secondLevel = size;
+        return;
+    }
+
+    const uint32 highest = HighestBit(size);
+    firstLevel = highest - SecondLevelBits + 1;
+    secondLevel = (size >> (highest - SecondLevelBits)) - SecondLevelCount;
+}
+
+TlsfAllocator::uint32 TlsfAllocator::NewBlock()
+{
+    if(!mUnusedBlocks.empty())
+    {
+        const uint32 block = mUnusedBlocks.back();
+        mUnusedBlocks.pop_back();
+        mBlocks[block] = Block();
+        return block;
+    }
+
+    mBlocks.emplace_back();
+    return (uint32)mBlocks.size() - 1;
+}
+
+void TlsfAllocator::ReleaseBlock(uint32 block)
+{
+    mUnusedBlocks.push_back(block);
+}
+
+void TlsfAllocator::InsertFree(uint32 block)
+{
+    Block& b = mBlocks[block];
+    uint32 fl, sl;
+    Mapping(b.Size, fl, sl);
+
+    b.Free = true;
+    b.PrevFree = NoOffset;
+    b.NextFree = mFreeHeads[fl][sl];
+    if(b.NextFree != NoOffset)
+        mBlocks[b.NextFree].PrevFree = block;
+    mFreeHeads[fl][sl] = block;
+
+    mFirstLevelBitmap |= 1u << fl;
+    mSecondLevelBitmaps[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::RemoveFree(uint32 block)
+{
+    Block& b = mBlocks[block];
+    uint32 fl, sl;
+    Mapping(b.Size, fl, sl);
+
+    if(b.PrevFree != NoOffset)
+        mBlocks[b.PrevFree].NextFree = b.NextFree;
+    else
+        mFreeHeads[fl][sl] = b.NextFree;
+    if(b.NextFree != NoOffset)
+        mBlocks[b.NextFree].PrevFree = b.PrevFree;
+
+    if(mFreeHeads[fl][sl] == NoOffset)
+    {
+        mSecondLevelBitmaps[fl] &= ~(1u << sl);
+        if(mSecondLevelBitmaps[fl] == 0)
+            mFirstLevelBitmap &= ~(1u << fl);
+    }
+
+    b.Free = false;
+    b.PrevFree = NoOffset;
+    b.NextFree = NoOffset;
+}
+
+TlsfAllocator::uint32 TlsfAllocator::FindFree(uint32 size)const
+{
+    // Round up to the next class boundary so that any block of the class found fits.
+    std::uint64_t rounded = size;
+    if(size >= SecondLevelCount)
+        rounded += (1ull << (HighestBit(size) - SecondLevelBits)) - 1;
+
+    uint32 fl, sl;
+    if(rounded <= 0xffffffffull)
+    {
+        Mapping((uint32)rounded, fl, sl);
+        if(fl < FirstLevelCount)
+        {
+            uint32 slMap = mSecondLevelBitmaps[fl] & (~0u << sl);
+            uint32 flMap = mFirstLevelBitmap & (~0u << fl) & ~(1u << fl);
+            if(slMap != 0)
+                return mFreeHeads[fl][LowestBit(slMap)];
+            if(flMap != 0)
+            {
+                fl = LowestBit(flMap);
+                return mFreeHeads[fl][LowestBit(mSecondLevelBitmaps[fl])];
+            }
+        }
+    }
+
+    // Nothing in a larger class; a block in the request's own class may still fit,
+    // e.g. when the request is the whole range.
+    Mapping(size, fl, sl);
+    for(uint32 block = mFreeHeads[fl][sl]; block != NoOffset; block = mBlocks[block].NextFree)
+    {
+        if(mBlocks[block].Size >= size)
+            return block;
+    }
+    return NoOffset;
+}
+
+void TlsfAllocator::SplitTail(uint32 block, uint32 size)
+{
+    if(mBlocks[block].Size == size)
+        return;
+
+    const uint32 tail = NewBlock();
+    Block& b = mBlocks[block];
+    Block& t = mBlocks[tail];
+
+    t.Offset = b.Offset + size;
+    t.Size = b.Size - size;
+    t.PrevPhysical = block;
+    t.NextPhysical = b.NextPhysical;
+    if(t.NextPhysical != NoOffset)
+        mBlocks[t.NextPhysical].PrevPhysical = tail;
+    else
+        mLastBlock = tail;
+
+    b.Size = size;
+    b.NextPhysical = tail;
+
+    InsertFree(tail);
+}
+
+void TlsfAllocator::MergeWithNext(uint32 block)
+{
+    const uint32 next = mBlocks[block].NextPhysical;
+    Block& b = mBlocks[block];
+    const Block& n = mBlocks[next];
+
+    b.Size += n.Size;
+    b.NextPhysical = n.NextPhysical;
+    if(b.NextPhysical != NoOffset)
+        mBlocks[b.NextPhysical].PrevPhysical = block;
+    else
+        mLastBlock = block;
+
+    ReleaseBlock(next);
+}
+
+TlsfAllocator::Allocation TlsfAllocator::Allocate(uint32 size, uint32 alignment)
+{
+    assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+    Allocation allocation;
+    if(size == 0)
+        return allocation;
+
+    // Large enough for size at any alignment of the block's start.
+    const std::uint64_t needed = (std::uint64_t)size + alignment - 1;
+    if(needed > 0xffffffffull)
+        return allocation;
+
+    uint32 block = FindFree((uint32)needed);
+    if(block == NoOffset)
+        return allocation;
+
+    RemoveFree(block);
+
+    // Leave the units in front of the aligned offset free.
+    const uint32 offset = mBlocks[block].Offset;
+    const uint32 padding = ((offset + alignment - 1) & ~(alignment - 1)) - offset;
+    if(padding > 0)
+    {
+        const uint32 front = block;
+        SplitTail(front, padding);
+        block = mBlocks[front].NextPhysical;
+        RemoveFree(block);
+        InsertFree(front);
+    }
+
+    SplitTail(block, size);
+
+    mUsedSize += size;
+    mAllocationCount++;
+
+    allocation.Offset = mBlocks[block].Offset;
+    allocation.Size = size;
+    allocation.Block = block;
+    return allocation;
+}
+
+void TlsfAllocator::Free(const Allocation& allocation)
+{
+    if(!allocation.Valid())
+        return;
+
+    uint32 block = allocation.Block;
+    assert(!mBlocks[block].Free && mBlocks[block].Offset == allocation.Offset);
+
+    mUsedSize -= mBlocks[block].Size;
+    mAllocationCount--;
+
+    const uint32 next = mBlocks[block].NextPhysical;
+    if(next != NoOffset && mBlocks[next].Free)
+    {
+        RemoveFree(next);
+        MergeWithNext(block);
+    }
+
+    const uint32 prev = mBlocks[block].PrevPhysical;
+    if(prev != NoOffset && mBlocks[prev].Free)
+    {
+        RemoveFree(prev);
+        MergeWithNext(prev);
+        block = prev;
+    }
+
+    InsertFree(block);
+}
+
+void TlsfAllocator::Grow(uint32 newCapacity)
+{
+    if(newCapacity <= mCapacity)
+        return;
+
+    const uint32 added = newCapacity - mCapacity;
+    if(mLastBlock != NoOffset && mBlocks[mLastBlock].Free)
+    {
+        RemoveFree(mLastBlock);
+        mBlocks[mLastBlock].Size += added;
+        InsertFree(mLastBlock);
+    }
+    else
+    {
+        const uint32 block = NewBlock();
+        mBlocks[block].Offset = mCapacity;
+        mBlocks[block].Size = added;
+        mBlocks[block].PrevPhysical = mLastBlock;
+        if(mLastBlock != NoOffset)
+            mBlocks[mLastBlock].NextPhysical = block;
+        else
+            mFirstBlock = block;
+        mLastBlock = block;
+        InsertFree(block);
+    }
+
+    mCapacity = newCapacity;
+}
+
+TlsfAllocator::Stats TlsfAllocator::GetStats()const
+{
+    Stats stats;
+    stats.Capacity = mCapacity;
+    stats.UsedSize = mUsedSize;
+    stats.AllocationCount = mAllocationCount;
+
+    for(uint32 b = mFirstBlock; b != NoOffset; b = mBlocks[b].NextPhysical)
+    {
+        if(mBlocks[b].Free)
+        {
+            stats.FreeBlockCount++;
+            stats.LargestFreeBlock = std::max(stats.LargestFreeBlock, mBlocks[b].Size);
+        }
+    }
+    return stats;
+}
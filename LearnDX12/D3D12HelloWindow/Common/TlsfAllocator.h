@@ -0,0 +1,145 @@
+//***************************************************************************************
+// TlsfAllocator.h
+//
+// Two-level segregated fit allocator over an abstract range [0, capacity) of units
+// (descriptors, heap pages, ...).  It never touches the memory it hands out; callers
+// turn offsets into handles or addresses.
+//
+// Free blocks are kept in size classes: the first level is the power of two of the
+// size, the second splits each power of two into SecondLevelCount linear steps.  Two
+// bitmaps find a non-empty class at least as large as a request in constant time,
+// blocks are split on allocation and merged with free neighbours on release, so
+// Allocate() and Free() are O(1) apart from the block record pool growing.  Only when
+// every larger class is empty is the request's own class scanned for a block that fits.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class TlsfAllocator
+{
+public:
+    using uint32 = std::uint32_t;
+
+    static const uint32 NoOffset = 0xffffffff;
+
+    // log2 of the second level subdivisions per power of two.
+    static const uint32 SecondLevelBits = 4;
+    static const uint32 SecondLevelCount = 1 << SecondLevelBits;
+
+    struct Allocation
+    {
+        uint32 Offset = NoOffset;
+        uint32 Size = 0;
+
+        // Block record, for Free().
+        uint32 Block = NoOffset;
+
+        bool Valid()const { return Offset != NoOffset; }
+    };
+
+    struct Stats
+    {
+        uint32 Capacity = 0;
+        uint32 UsedSize = 0;
+        uint32 AllocationCount = 0;
+        uint32 FreeBlockCount = 0;
+        uint32 LargestFreeBlock = 0;
+
+        // 0 with all free space in one block, towards 1 as it splinters.
+        float Fragmentation()const
+        {
+            const uint32 freeSize = Capacity - UsedSize;
+            return freeSize > 0 ? 1.0f - (float)LargestFreeBlock / freeSize : 0.0f;
+        }
+    };
+
+    explicit TlsfAllocator(uint32 capacity = 0);
+
+    ///<summary>
+    /// Frees everything and starts over with capacity units.
+    ///</summary>
+    void Reset(uint32 capacity);
+
+    ///<summary>
+    /// Allocates size units whose offset is a multiple of alignment (a power of two).
+    /// The result is not Valid() if no free block can hold it.
+    ///</summary>
+    Allocation Allocate(uint32 size, uint32 alignment = 1);
+
+    void Free(const Allocation& allocation);
+
+    // Grows the range to newCapacity units; the new tail merges with a free last block.
+    void Grow(uint32 newCapacity);
+
+    uint32 Capacity()const { return mCapacity; }
+    uint32 UsedSize()const { return mUsedSize; }
+    Stats GetStats()const;
+
+    ///<summary>
+    /// Calls visit(allocation) for every allocated block in offset order, e.g. to plan
+    /// a defragmentation pass; the allocations can be handed to Free().
+    ///</summary>
+    template<typename Visit>
+    void ForEachAllocation(Visit visit)const
+    {
+        for(uint32 b = mFirstBlock; b != NoOffset; b = mBlocks[b].NextPhysical)
+        {
+            if(!mBlocks[b].Free)
+            {
+                Allocation allocation;
+                allocation.Offset = mBlocks[b].Offset;
+                allocation.Size = mBlocks[b].Size;
+                allocation.Block = b;
+                visit(allocation);
+            }
+        }
+    }
+
+private:
+    static const uint32 FirstLevelCount = 32 - SecondLevelBits + 1;
+
+    struct Block
+    {
+        uint32 Offset = 0;
+        uint32 Size = 0;
+
+        // Neighbours in the range, and in the free list of the block's class.
+        uint32 PrevPhysical = NoOffset;
+        uint32 NextPhysical = NoOffset;
+        uint32 PrevFree = NoOffset;
+        uint32 NextFree = NoOffset;
+
+        bool Free = false;
+    };
+
+    static void Mapping(uint32 size, uint32& firstLevel, uint32& secondLevel);
+
+    uint32 NewBlock();
+    void ReleaseBlock(uint32 block);
+
+    void InsertFree(uint32 block);
+    void RemoveFree(uint32 block);
+    uint32 FindFree(uint32 size)const;
+
+    // Splits size units off the front of block; the rest becomes a new free block.
+    void SplitTail(uint32 block, uint32 size);
+    void MergeWithNext(uint32 block);
+
+private:
+    std::vector<Block> mBlocks;
+    std::vector<uint32> mUnusedBlocks;
+
+    uint32 mFirstLevelBitmap = 0;
+    uint32 mSecondLevelBitmaps[FirstLevelCount];
+    uint32 mFreeHeads[FirstLevelCount][SecondLevelCount];
+
+    uint32 mFirstBlock = NoOffset;
+    uint32 mLastBlock = NoOffset;
+
+    uint32 mCapacity = 0;
+    uint32 mUsedSize = 0;
+    uint32 mAllocationCount = 0;
+};
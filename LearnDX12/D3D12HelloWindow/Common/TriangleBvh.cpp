@@ -0,0 +1,333 @@
+//***************************************************************************************
+// TriangleBvh.cpp
+//***************************************************************************************
+
+#include "TriangleBvh.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+const TriangleBvh::uint32 TriangleBvh::MaxLeafTriangles;
+
+namespace
+{
+    const int BinCount = 16;
+
+    // Ranges wider than this are split even if the heuristic prefers a leaf.
+    const TriangleBvh::uint32 MaxLeafFallback = 16;
+
+    // Past this depth ranges are halved instead, which bounds the depth (and the
+    // traversal stack) at SahDepth + 32.
+    const int SahDepth = 48;
+    const int StackSize = SahDepth + 40;
+
+    XMFLOAT3 Sub(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z); }
+    XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+    {
+        return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+    }
+    float Dot(const XMFLOAT3& a, const XMFLOAT3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    float Get(const XMFLOAT3& v, int axis) { return axis == 0 ? v.x : (axis == 1 ? v.y : v.z); }
+
+    struct Bounds
+    {
+        XMFLOAT3 Min = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+        XMFLOAT3 Max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+        void Grow(const XMFLOAT3& p)
+        {
+            Min = XMFLOAT3(std::min(Min.x, p.x), std::min(Min.y, p.y), std::min(Min.z, p.z));
+            Max = XMFLOAT3(std::max(Max.x, p.x), std::max(Max.y, p.y), std::max(Max.z, p.z));
+        }
+
+        void Grow(const Bounds& b)
+        {
+            Grow(b.Min);
+            Grow(b.Max);
+        }
+
+        bool Empty()const { return Min.x > Max.x; }
+
+        float HalfArea()const
+        {
+            if(Empty())
+                return 0.0f;
+            const XMFLOAT3 e = Sub(Max, Min);
+            return e.x * e.y + e.y * e.z + e.z * e.x;
+        }
+    };
+
+    // Entry and exit distance of the ray through a box; the box is hit if entry <= exit.
+    inline bool SlabTest(const float* boxMin, const float* boxMax, const float* origin, const float* invDir,
+        float maxDistance, float& entry)
+    {
+        float tMin = 0.0f;
+        float tMax = maxDistance;
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            float t0 = (boxMin[axis] - origin[axis]) * invDir[axis];
+            float t1 = (boxMax[axis] - origin[axis]) * invDir[axis];
+            if(t0 > t1)
+                std::swap(t0, t1);
+            // Written so a NaN (origin on a slab of a flat box) leaves the range alone.
+            tMin = t0 > tMin ? t0 : tMin;
+            tMax = t1 < tMax ? t1 : tMax;
+        }
+        entry = tMin;
+        return tMin <= tMax;
+    }
+}
+
+void TriangleBvh::Build(const std::vector<XMFLOAT3>& positions, const std::vector<uint32>& indices)
+{
+    const uint32 triangleCount = (uint32)(indices.size() / 3);
+
+    mNodes.clear();
+    mTriangles.clear();
+    mTriangleIds.clear();
+    if(triangleCount == 0)
+        return;
+
+    std::vector<Node> bounds(triangleCount);
+    std::vector<XMFLOAT3> centroids(triangleCount);
+    std::vector<uint32> order(triangleCount);
+    for(uint32 t = 0; t < triangleCount; ++t)
+    {
+        Bounds b;
+        for(int k = 0; k < 3; ++k)
+            b.Grow(positions[indices[3 * t + k]]);
+
+        bounds[t].Min = b.Min;
+        bounds[t].Max = b.Max;
+        centroids[t] = XMFLOAT3(0.5f * (b.Min.x + b.Max.x), 0.5f * (b.Min.y + b.Max.y), 0.5f * (b.Min.z + b.Max.z));
+        order[t] = t;
+    }
+
+    mNodes.reserve(2 * triangleCount / MaxLeafTriangles + 1);
+    BuildNode(order, 0, triangleCount, centroids, bounds, 0);
+
+    mTriangles.resize(triangleCount);
+    mTriangleIds = order;
+    for(uint32 i = 0; i < triangleCount; ++i)
+    {
+        const uint32 t = order[i];
+        const XMFLOAT3& v0 = positions[indices[3 * t + 0]];
+        mTriangles[i].V0 = v0;
+        mTriangles[i].Edge1 = Sub(positions[indices[3 * t + 1]], v0);
+        mTriangles[i].Edge2 = Sub(positions[indices[3 * t + 2]], v0);
+    }
+}
+
+TriangleBvh::uint32 TriangleBvh::BuildNode(std::vector<uint32>& order, uint32 begin, uint32 end,
+    const std::vector<XMFLOAT3>& centroids, const std::vector<Node>& bounds, int depth)
+{
+    const uint32 nodeIndex = (uint32)mNodes.size();
+    mNodes.emplace_back();
+
+    Bounds nodeBounds;
+    Bounds centroidBounds;
+    for(uint32 i = begin; i < end; ++i)
+    {
+        nodeBounds.Grow(bounds[order[i]].Min);
+        nodeBounds.Grow(bounds[order[i]].Max);
+        centroidBounds.Grow(centroids[order[i]]);
+    }
+
+    mNodes[nodeIndex].Min = nodeBounds.Min;
+    mNodes[nodeIndex].Max = nodeBounds.Max;
+
+    const uint32 count = end - begin;
+    auto makeLeaf = [&]()
+    {
+        mNodes[nodeIndex].RightOrFirst = begin;
+        mNodes[nodeIndex].Count = count;
+        return nodeIndex;
+    };
+
+    if(count <= MaxLeafTriangles)
+        return makeLeaf();
+
+    // Split along the widest centroid axis.
+    const XMFLOAT3 extent = Sub(centroidBounds.Max, centroidBounds.Min);
+    const int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    const float axisMin = Get(centroidBounds.Min, axis);
+    const float axisExtent = Get(extent, axis);
+
+    uint32 mid = begin;
+    if(axisExtent > 0.0f && depth < SahDepth)
+    {
+        //
+        // Binned SAH: bin the centroids, sweep the bins from both sides and take the
+        // split with the lowest area-weighted triangle count.
+        //
+        Bounds binBounds[BinCount];
+        uint32 binCounts[BinCount] = {};
+        const float binScale = BinCount / axisExtent;
+        auto binOf = [&](uint32 t)
+        {
+            return std::min((int)((Get(centroids[t], axis) - axisMin) * binScale), BinCount - 1);
+        };
+
+        for(uint32 i = begin; i < end; ++i)
+        {
+            const int bin = binOf(order[i]);
+            binCounts[bin]++;
+            binBounds[bin].Grow(bounds[order[i]].Min);
+            binBounds[bin].Grow(bounds[order[i]].Max);
+        }
+
+        float leftCost[BinCount - 1];
+        Bounds sweep;
+        uint32 sweepCount = 0;
+        for(int b = 0; b < BinCount - 1; ++b)
+        {
+            sweep.Grow(binBounds[b]);
+            sweepCount += binCounts[b];
+            leftCost[b] = sweep.HalfArea() * sweepCount;
+        }
+
+        float bestCost = FLT_MAX;
+        int bestSplit = -1;
+        sweep = Bounds();
+        sweepCount = 0;
+        for(int b = BinCount - 1; b > 0; --b)
+        {
+            sweep.Grow(binBounds[b]);
+            sweepCount += binCounts[b];
+            const float cost = leftCost[b - 1] + sweep.HalfArea() * sweepCount;
+            if(cost < bestCost)
+            {
+                bestCost = cost;
+                bestSplit = b;
+            }
+        }
+
+        // Splitting has to beat intersecting every triangle here.
+        const float leafCost = nodeBounds.HalfArea() * count;
+        if(bestSplit > 0 && (bestCost < leafCost || count > MaxLeafFallback))
+        {
+            mid = (uint32)(std::partition(order.begin() + begin, order.begin() + end,
+                [&](uint32 t) { return binOf(t) < bestSplit; }) - order.begin());
+        }
+        else if(count <= MaxLeafFallback)
+        {
+            return makeLeaf();
+        }
+    }
+
+    // Identical centroids, an empty side or too deep: split the range in half.
+    if(mid == begin || mid == end)
+    {
+        mid = begin + count / 2;
+        std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+            [&](uint32 a, uint32 b) { return Get(centroids[a], axis) < Get(centroids[b], axis); });
+    }
+
+    BuildNode(order, begin, mid, centroids, bounds, depth + 1);
+    const uint32 right = BuildNode(order, mid, end, centroids, bounds, depth + 1);
+
+    mNodes[nodeIndex].RightOrFirst = right;
+    mNodes[nodeIndex].Count = 0;
+    return nodeIndex;
+}
+
+bool TriangleBvh::Occluded(const XMFLOAT3& origin, const XMFLOAT3& dir, float maxDistance)const
+{
+    Hit hit;
+    return Traverse<true>(origin, dir, maxDistance, hit);
+}
+
+bool TriangleBvh::Intersect(const XMFLOAT3& origin, const XMFLOAT3& dir, float maxDistance, Hit& hit)const
+{
+    hit = Hit();
+    return Traverse<false>(origin, dir, maxDistance, hit);
+}
+
+template<bool AnyHit>
+bool TriangleBvh::Traverse(const XMFLOAT3& origin, const XMFLOAT3& dir, float maxDistance, Hit& hit)const
+{
+    if(mNodes.empty())
+        return false;
+
+    const float o[3] = { origin.x, origin.y, origin.z };
+    const float invDir[3] = { 1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z };
+
+    float closest = maxDistance;
+    bool found = false;
+
+    uint32 stack[StackSize];
+    int top = 0;
+    stack[top++] = 0;
+
+    while(top > 0)
+    {
+        const Node& node = mNodes[stack[--top]];
+
+        float entry;
+        if(!SlabTest(&node.Min.x, &node.Max.x, o, invDir, closest, entry))
+            continue;
+
+        if(node.Count == 0)
+        {
+            const uint32 left = (uint32)(&node - mNodes.data()) + 1;
+            const uint32 right = node.RightOrFirst;
+
+            // Visit the nearer child first.
+            float leftEntry, rightEntry;
+            const bool hitLeft = SlabTest(&mNodes[left].Min.x, &mNodes[left].Max.x, o, invDir, closest, leftEntry);
+            const bool hitRight = SlabTest(&mNodes[right].Min.x, &mNodes[right].Max.x, o, invDir, closest, rightEntry);
+            if(hitLeft && hitRight)
+            {
+                stack[top++] = leftEntry <= rightEntry ? right : left;
+                stack[top++] = leftEntry <= rightEntry ? left : right;
+            }
+            else if(hitLeft)
+            {
+                stack[top++] = left;
+            }
+            else if(hitRight)
+            {
+                stack[top++] = right;
+            }
+            continue;
+        }
+
+        for(uint32 i = node.RightOrFirst; i < node.RightOrFirst + node.Count; ++i)
+        {
+            // Moller-Trumbore, two sided.
+            const Triangle& tri = mTriangles[i];
+            const XMFLOAT3 p = Cross(dir, tri.Edge2);
+            const float det = Dot(tri.Edge1, p);
+            if(std::abs(det) < 1e-12f)
+                continue;
+
+            const float invDet = 1.0f / det;
+            const XMFLOAT3 s = Sub(origin, tri.V0);
+            const float u = Dot(s, p) * invDet;
+            if(u < 0.0f || u > 1.0f)
+                continue;
+
+            const XMFLOAT3 q = Cross(s, tri.Edge1);
+            const float v = Dot(dir, q) * invDet;
+            if(v < 0.0f || u + v > 1.0f)
+                continue;
+
+            const float t = Dot(tri.Edge2, q) * invDet;
+            if(t <= 0.0f || t > closest)
+                continue;
+
+            if(AnyHit)
+                return true;
+
+            closest = t;
+            found = true;
+            hit.Distance = t;
+            hit.Triangle = mTriangleIds[i];
+            hit.U = u;
+            hit.V = v;
+        }
+    }
+
+    return found;
+}
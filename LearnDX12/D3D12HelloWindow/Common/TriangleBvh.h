@@ -0,0 +1,76 @@
+//***************************************************************************************
+// TriangleBvh.h
+//
+// Bounding volume hierarchy over a triangle soup for CPU ray casts (baking, picking).
+// Built top down with a binned surface area heuristic; nodes are 32 bytes and laid out
+// depth first, so the left child of a node always follows it.  Queries are const and may
+// run on any number of threads at once.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+class TriangleBvh
+{
+public:
+    using uint32 = std::uint32_t;
+
+    // Triangles per leaf the builder aims for.
+    static const uint32 MaxLeafTriangles = 4;
+
+    struct Hit
+    {
+        float Distance = FLT_MAX;
+        uint32 Triangle = UINT32_MAX;
+        float U = 0.0f;     // barycentrics of vertices 1 and 2
+        float V = 0.0f;
+    };
+
+    ///<summary>
+    /// Builds the tree over the triangles (i0, i1, i2) of indices into positions.
+    /// Degenerate triangles are kept; they are simply never hit.
+    ///</summary>
+    void Build(const std::vector<DirectX::XMFLOAT3>& positions, const std::vector<uint32>& indices);
+
+    // True if a triangle is hit within (0, maxDistance] along dir (need not be unit length;
+    // distances are in units of its length).
+    bool Occluded(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& dir, float maxDistance)const;
+
+    // Closest hit within (0, maxDistance], if any.
+    bool Intersect(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& dir, float maxDistance, Hit& hit)const;
+
+    uint32 TriangleCount()const { return (uint32)mTriangles.size(); }
+    uint32 NodeCount()const { return (uint32)mNodes.size(); }
+
+private:
+    struct Node
+    {
+        DirectX::XMFLOAT3 Min;
+        uint32 RightOrFirst;    // right child for inner nodes, first triangle for leaves
+        DirectX::XMFLOAT3 Max;
+        uint32 Count;           // triangles in a leaf, 0 for inner nodes
+    };
+
+    // Edges and origin precomputed for the intersection test.
+    struct Triangle
+    {
+        DirectX::XMFLOAT3 V0;
+        DirectX::XMFLOAT3 Edge1;
+        DirectX::XMFLOAT3 Edge2;
+    };
+
+    uint32 BuildNode(std::vector<uint32>& order, uint32 begin, uint32 end,
+        const std::vector<DirectX::XMFLOAT3>& centroids, const std::vector<Node>& bounds, int depth);
+
+    template<bool AnyHit>
+    bool Traverse(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& dir, float maxDistance, Hit& hit)const;
+
+private:
+    std::vector<Node> mNodes;
+    std::vector<Triangle> mTriangles;       // in leaf order
+    std::vector<uint32> mTriangleIds;       // leaf order to input triangle
+};
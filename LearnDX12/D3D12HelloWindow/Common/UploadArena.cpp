@@ -0,0 +1,173 @@
+//***************************************************************************************
+// UploadArena.cpp
+//***************************************************************************************
+
+#include "UploadArena.h"
+#include <algorithm>
+#include <cstring>
+
+using Microsoft::WRL::ComPtr;
+
+const UINT64 UploadArena::DefaultRingSize;
+
+namespace
+{
+    // Buffer copies have no alignment rules; this only keeps the memcpy sources tidy.
+    const UINT64 StagingAlignment = 16;
+}
+
+UploadArena::UploadArena(ID3D12Device* device, UINT64 ringSize)
+    : mDevice(device),
+    mRing(device, ringSize)
+{
+    D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+    queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+    queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+    ThrowIfFailed(device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&mCopyQueue)));
+
+    ThrowIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mCopyFence)));
+
+    CopyAllocator copyAllocator;
+    ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY,
+        IID_PPV_ARGS(copyAllocator.Allocator.GetAddressOf())));
+    mCopyAllocators.push_back(copyAllocator);
+
+    ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY,
+        copyAllocator.Allocator.Get(), nullptr, IID_PPV_ARGS(mCopyList.GetAddressOf())));
+
+    // BeginBatch() resets the list before recording.
+    mCopyList->Close();
+}
+
+UploadArena::~UploadArena()
+{
+    // Copies recorded but never flushed are dropped; their buffers were never used.
+    WaitForFence(mCopyFenceValue);
+}
+
+ComPtr<ID3D12Resource> UploadArena::CreateBuffer(const void* initData, UINT64 byteSize)
+{
+    ComPtr<ID3D12Resource> buffer;
+    ThrowIfFailed(mDevice->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(byteSize),
+        D3D12_RESOURCE_STATE_COMMON,
+        nullptr,
+        IID_PPV_ARGS(buffer.GetAddressOf())));
+    d3dUtil::TrackMemory(buffer.Get(), MemoryTracker::Buffers, byteSize);
+
+    Upload(buffer.Get(), 0, initData, byteSize);
+    mBufferCount++;
+    return buffer;
+}
+
+void UploadArena::Upload(ID3D12Resource* buffer, UINT64 offset, const void* data, UINT64 byteSize)
+{
+    // Anything larger than the ring goes through it in ring sized pieces.
+    const BYTE* src = static_cast<const BYTE*>(data);
+    for(UINT64 done = 0; done < byteSize;)
+    {
+        const UINT64 chunk = std::min(byteSize - done, mRing.Allocator().Capacity());
+        UploadRing::Allocation staging = Stage(chunk);
+        std::memcpy(staging.CpuAddress, src + done, (size_t)chunk);
+
+        BeginBatch();
+        mCopyList->CopyBufferRegion(buffer, offset + done, staging.Resource, staging.Offset, chunk);
+        done += chunk;
+    }
+    mUploadedBytes += byteSize;
+}
+
+UploadRing::Allocation UploadArena::Stage(UINT64 size)
+{
+    mRing.Reclaim(mCopyFence->GetCompletedValue());
+    UploadRing::Allocation allocation = mRing.Allocate(size, StagingAlignment);
+    if(allocation.Valid())
+        return allocation;
+
+    // The ring is full of copies not yet submitted or not yet executed.  Once they
+    // have all run it is empty, and any size up to its capacity fits.
+    mStallCount++;
+    Flush();
+    WaitForFence(mCopyFenceValue);
+    mRing.Reclaim(mCopyFenceValue);
+
+    allocation = mRing.Allocate(size, StagingAlignment);
+    if(!allocation.Valid())
+        ThrowIfFailed(E_OUTOFMEMORY);
+    return allocation;
+}
+
+void UploadArena::BeginBatch()
+{
+    if(mRecording)
+        return;
+
+    // An allocator can be reset once the copies recorded with it have executed.
+    const UINT64 completedFence = mCopyFence->GetCompletedValue();
+    ID3D12CommandAllocator* allocator = nullptr;
+    for(CopyAllocator& copyAllocator : mCopyAllocators)
+    {
+        if(copyAllocator.Fence <= completedFence)
+        {
+            copyAllocator.Fence = mCopyFenceValue + 1;
+            allocator = copyAllocator.Allocator.Get();
+            break;
+        }
+    }
+    if(allocator == nullptr)
+    {
+        CopyAllocator copyAllocator;
+        ThrowIfFailed(mDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY,
+            IID_PPV_ARGS(copyAllocator.Allocator.GetAddressOf())));
+        copyAllocator.Fence = mCopyFenceValue + 1;
+        mCopyAllocators.push_back(copyAllocator);
+        allocator = mCopyAllocators.back().Allocator.Get();
+    }
+
+    ThrowIfFailed(allocator->Reset());
+    ThrowIfFailed(mCopyList->Reset(allocator, nullptr));
+    mRecording = true;
+}
+
+void UploadArena::Flush()
+{
+    if(!mRecording)
+        return;
+
+    ThrowIfFailed(mCopyList->Close());
+    ID3D12CommandList* cmdsLists[] = { mCopyList.Get() };
+    mCopyQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+
+    ThrowIfFailed(mCopyQueue->Signal(mCopyFence.Get(), ++mCopyFenceValue));
+    mRing.EndFrame(mCopyFenceValue);
+
+    mRecording = false;
+    mSubmitCount++;
+}
+
+void UploadArena::WaitForCopies(ID3D12CommandQueue* queue)
+{
+    Flush();
+    if(mCopyFenceValue > 0)
+        ThrowIfFailed(queue->Wait(mCopyFence.Get(), mCopyFenceValue));
+}
+
+void UploadArena::WaitIdle()
+{
+    Flush();
+    WaitForFence(mCopyFenceValue);
+    mRing.Reclaim(mCopyFenceValue);
+}
+
+void UploadArena::WaitForFence(UINT64 fence)
+{
+    if(mCopyFence->GetCompletedValue() >= fence)
+        return;
+
+    HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
+    ThrowIfFailed(mCopyFence->SetEventOnCompletion(fence, eventHandle));
+    WaitForSingleObject(eventHandle, INFINITE);
+    CloseHandle(eventHandle);
+}
@@ -0,0 +1,99 @@
+//***************************************************************************************
+// UploadArena.h
+//
+// Creates default heap buffers with their initial data without an upload resource
+// per buffer, which is what d3dUtil::CreateDefaultBuffer() costs: every copy is
+// staged in one UploadRing and recorded into one command list on a dedicated copy
+// queue, submitted a batch at a time.  Staging space comes back by itself once the
+// copy fence has passed it, so nothing has to hold on to uploaders.
+//
+// Buffers are created in the COMMON state, which copy queues write to and graphics
+// queues promote from on first use, so no barriers are recorded on either side.
+// Make the graphics queue wait for the copies before it draws with them:
+//
+//     BuildMeshGeometry(*arena, packer, *geo);
+//     ...
+//     arena->WaitForCopies(mCommandQueue.Get());
+//     mCommandQueue->ExecuteCommandLists(...);
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "UploadRing.h"
+
+class UploadArena
+{
+public:
+    static const UINT64 DefaultRingSize = 8 * 1024 * 1024;
+
+    UploadArena(ID3D12Device* device, UINT64 ringSize = DefaultRingSize);
+    UploadArena(const UploadArena& rhs) = delete;
+    UploadArena& operator=(const UploadArena& rhs) = delete;
+
+    // Waits for the copy queue before the ring goes away.
+    ~UploadArena();
+
+    ///<summary>
+    /// A default heap buffer that will hold byteSize bytes of initData, staged now and
+    /// copied when the batch is submitted.  Buffers larger than the ring, or that do
+    /// not fit in what is left of it, submit the batch and wait for ring space.
+    ///</summary>
+    Microsoft::WRL::ComPtr<ID3D12Resource> CreateBuffer(const void* initData, UINT64 byteSize);
+
+    ///<summary>
+    /// Copies byteSize bytes of data to offset of buffer, a buffer in the COMMON state
+    /// that nothing on the GPU uses until the copy is waited for.
+    ///</summary>
+    void Upload(ID3D12Resource* buffer, UINT64 offset, const void* data, UINT64 byteSize);
+
+    // Submits the copies recorded since the last call, if any.
+    void Flush();
+
+    // Flushes, then makes queue wait on the GPU for every copy so far.
+    void WaitForCopies(ID3D12CommandQueue* queue);
+
+    // Flushes, then blocks until every copy has executed.
+    void WaitIdle();
+
+    // Buffers created, bytes copied, and batches submitted; stalls count the times the
+    // ring was full and the CPU had to wait for the copy queue.
+    UINT64 BufferCount()const { return mBufferCount; }
+    UINT64 UploadedBytes()const { return mUploadedBytes; }
+    UINT64 SubmitCount()const { return mSubmitCount; }
+    UINT64 StallCount()const { return mStallCount; }
+
+    const UploadRing& Ring()const { return mRing; }
+
+private:
+    struct CopyAllocator
+    {
+        Microsoft::WRL::ComPtr<ID3D12CommandAllocator> Allocator;
+        UINT64 Fence = 0;
+    };
+
+    // Opens the command list for a new batch unless it is open.
+    void BeginBatch();
+
+    // Ring space for size bytes, submitting and waiting for earlier batches if needed.
+    UploadRing::Allocation Stage(UINT64 size);
+
+    void WaitForFence(UINT64 fence);
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12Device> mDevice;
+
+    Microsoft::WRL::ComPtr<ID3D12CommandQueue> mCopyQueue;
+    Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> mCopyList;
+    std::vector<CopyAllocator> mCopyAllocators;
+    Microsoft::WRL::ComPtr<ID3D12Fence> mCopyFence;
+    UINT64 mCopyFenceValue = 0;
+    bool mRecording = false;
+
+    UploadRing mRing;
+
+    UINT64 mBufferCount = 0;
+    UINT64 mUploadedBytes = 0;
+    UINT64 mSubmitCount = 0;
+    UINT64 mStallCount = 0;
+};
@@ -7,6 +7,7 @@ class UploadBuffer
 {
 public:
     UploadBuffer(ID3D12Device* device, UINT elementCount, bool isConstantBuffer) : 
+        mElementCount(elementCount),
         mIsConstantBuffer(isConstantBuffer)
     {
         mElementByteSize = sizeof(T);
@@ -29,6 +30,10 @@ public:
             nullptr,
             IID_PPV_ARGS(&mUploadBuffer)));
 
+        d3dUtil::TrackMemory(mUploadBuffer.Get(),
+            isConstantBuffer ? MemoryTracker::ConstantBuffers : MemoryTracker::UploadBuffers,
+            (UINT64)mElementByteSize*elementCount);
+
         ThrowIfFailed(mUploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mMappedData)));
 
         // We do not need to unmap until we are done with the resource.  However, we must not write to
@@ -55,10 +60,21 @@ public:
         memcpy(&mMappedData[elementIndex*mElementByteSize], &data, sizeof(T));
     }
 
+    // Copies count consecutive elements with one memcpy; only for buffers that are
+    // not constant buffers, whose elements are tightly packed.  Throws E_INVALIDARG
+    // rather than write past the end, in release builds too.
+    void CopyRange(UINT firstElement, const T* data, UINT count)
+    {
+        if(mIsConstantBuffer || firstElement > mElementCount || count > mElementCount - firstElement)
+            ThrowIfFailed(E_INVALIDARG);
+        memcpy(&mMappedData[(size_t)firstElement*mElementByteSize], data, (size_t)count*sizeof(T));
+    }
+
 private:
     Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
     BYTE* mMappedData = nullptr;
 
     UINT mElementByteSize = 0;
+    UINT mElementCount = 0;
     bool mIsConstantBuffer = false;
 };
\ No newline at end of file
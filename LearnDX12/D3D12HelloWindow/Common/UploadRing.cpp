@@ -0,0 +1,44 @@
+//***************************************************************************************
+// UploadRing.cpp
+//***************************************************************************************
+
+#include "UploadRing.h"
+
+UploadRing::UploadRing(ID3D12Device* device, UINT64 capacity)
+    : mAllocator(capacity)
+{
+    ThrowIfFailed(device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(capacity),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&mBuffer)));
+    d3dUtil::TrackMemory(mBuffer.Get(), MemoryTracker::UploadBuffers, capacity);
+
+    // Upload heaps can stay mapped for their whole life; the fences keep the CPU off
+    // the bytes the GPU is still reading.
+    ThrowIfFailed(mBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mMappedData)));
+}
+
+UploadRing::~UploadRing()
+{
+    if(mBuffer != nullptr)
+        mBuffer->Unmap(0, nullptr);
+
+    mMappedData = nullptr;
+}
+
+UploadRing::Allocation UploadRing::Allocate(UINT64 size, UINT64 alignment)
+{
+    Allocation allocation;
+
+    const UINT64 offset = mAllocator.Allocate(size, alignment);
+    if(offset == FencedRingAllocator::NoOffset)
+        return allocation;
+
+    allocation.Resource = mBuffer.Get();
+    allocation.Offset = offset;
+    allocation.CpuAddress = mMappedData + offset;
+    return allocation;
+}
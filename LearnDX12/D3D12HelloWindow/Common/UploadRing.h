@@ -0,0 +1,52 @@
+//***************************************************************************************
+// UploadRing.h
+//
+// One persistently mapped upload heap buffer shared by every CPU to GPU copy, handed
+// out by a FencedRingAllocator.  Data is written straight into the mapping and copied
+// by the GPU from there, so staging memory is bounded by the ring instead of growing
+// with each texture or buffer loaded.
+//
+// Call Reclaim() once a fence has been waited on and EndFrame() after signalling the
+// fence for the copies just recorded.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "FencedRingAllocator.h"
+
+class UploadRing
+{
+public:
+    struct Allocation
+    {
+        ID3D12Resource* Resource = nullptr;
+        UINT64 Offset = 0;
+        BYTE* CpuAddress = nullptr;
+
+        bool Valid()const { return CpuAddress != nullptr; }
+    };
+
+    UploadRing(ID3D12Device* device, UINT64 capacity);
+    UploadRing(const UploadRing& rhs) = delete;
+    UploadRing& operator=(const UploadRing& rhs) = delete;
+    ~UploadRing();
+
+    ///<summary>
+    /// size bytes at a multiple of alignment (a power of two).  The result is not
+    /// Valid() if the copies still in flight leave no room.
+    ///</summary>
+    Allocation Allocate(UINT64 size, UINT64 alignment);
+
+    void EndFrame(UINT64 fence) { mAllocator.EndFrame(fence); }
+    void Reclaim(UINT64 completedFence) { mAllocator.Reclaim(completedFence); }
+
+    ID3D12Resource* Resource()const { return mBuffer.Get(); }
+    const FencedRingAllocator& Allocator()const { return mAllocator; }
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12Resource> mBuffer;
+    BYTE* mMappedData = nullptr;
+
+    FencedRingAllocator mAllocator;
+};
@@ -0,0 +1,213 @@
+//***************************************************************************************
+// VertexLightBaker.cpp
+//***************************************************************************************
+
+#include "VertexLightBaker.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+const size_t VertexLightBaker::AoGrain;
+
+namespace
+{
+    XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+    {
+        return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+    }
+
+    float Dot(const XMFLOAT3& a, const XMFLOAT3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+    XMFLOAT3 Normalize(const XMFLOAT3& v)
+    {
+        const float length = std::sqrt(Dot(v, v));
+        return length > 0.0f ? XMFLOAT3(v.x / length, v.y / length, v.z / length) : v;
+    }
+
+    XMFLOAT3 TransformPoint(const XMFLOAT3& p, const XMFLOAT4X4& m)
+    {
+        return XMFLOAT3(
+            p.x * m(0, 0) + p.y * m(1, 0) + p.z * m(2, 0) + m(3, 0),
+            p.x * m(0, 1) + p.y * m(1, 1) + p.z * m(2, 1) + m(3, 1),
+            p.x * m(0, 2) + p.y * m(1, 2) + p.z * m(2, 2) + m(3, 2));
+    }
+
+    // Rows of the inverse transpose of the upper 3x3 times |det|: the cross products of
+    // the rows, flipped for mirroring matrices.  Normals only need the direction.
+    void NormalMatrix(const XMFLOAT4X4& m, XMFLOAT3 rows[3])
+    {
+        const XMFLOAT3 r0(m(0, 0), m(0, 1), m(0, 2));
+        const XMFLOAT3 r1(m(1, 0), m(1, 1), m(1, 2));
+        const XMFLOAT3 r2(m(2, 0), m(2, 1), m(2, 2));
+
+        rows[0] = Cross(r1, r2);
+        rows[1] = Cross(r2, r0);
+        rows[2] = Cross(r0, r1);
+
+        if(Dot(r0, rows[0]) < 0.0f)
+        {
+            for(int i = 0; i < 3; ++i)
+                rows[i] = XMFLOAT3(-rows[i].x, -rows[i].y, -rows[i].z);
+        }
+    }
+
+    XMFLOAT3 TransformNormal(const XMFLOAT3& n, const XMFLOAT3 rows[3])
+    {
+        return Normalize(XMFLOAT3(
+            n.x * rows[0].x + n.y * rows[1].x + n.z * rows[2].x,
+            n.x * rows[0].y + n.y * rows[1].y + n.z * rows[2].y,
+            n.x * rows[0].z + n.y * rows[1].z + n.z * rows[2].z));
+    }
+
+    std::uint32_t Hash(std::uint32_t x)
+    {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    float RadicalInverse(std::uint32_t bits)
+    {
+        bits = (bits << 16) | (bits >> 16);
+        bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+        bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+        bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+        bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+        return bits * (1.0f / 4294967296.0f);
+    }
+}
+
+VertexLightBaker::uint32 VertexLightBaker::AddInstance(const MeshData& mesh, const XMFLOAT4X4& world, bool occluder)
+{
+    Instance instance;
+    instance.Mesh = &mesh;
+    instance.World = world;
+    instance.Occluder = occluder;
+
+    mInstances.push_back(instance);
+    return (uint32)mInstances.size() - 1;
+}
+
+void VertexLightBaker::BuildOccluders()
+{
+    std::vector<XMFLOAT3> positions;
+    std::vector<uint32> indices;
+
+    for(const Instance& instance : mInstances)
+    {
+        if(!instance.Occluder)
+            continue;
+
+        const uint32 base = (uint32)positions.size();
+        for(const GeometryGenerator::Vertex& v : instance.Mesh->Vertices)
+            positions.push_back(TransformPoint(v.Position, instance.World));
+        for(uint32 index : instance.Mesh->Indices32)
+            indices.push_back(base + index);
+    }
+
+    mBvh.Build(positions, indices);
+}
+
+void VertexLightBaker::Bake(const LightingModel& lights, const VertexBakeSettings& settings, ThreadPool& pool)
+{
+    if(settings.AmbientOcclusion)
+        BuildOccluders();
+
+    mBakedVertexCount = 0;
+    mRayCount = 0;
+
+    std::vector<XMFLOAT3> positions;
+    std::vector<XMFLOAT3> normals;
+    std::vector<XMFLOAT3> irradiance;
+
+    for(uint32 i = 0; i < (uint32)mInstances.size(); ++i)
+    {
+        Instance& instance = mInstances[i];
+        const auto& vertices = instance.Mesh->Vertices;
+        const size_t count = vertices.size();
+
+        XMFLOAT3 normalMatrix[3];
+        NormalMatrix(instance.World, normalMatrix);
+
+        positions.resize(count);
+        normals.resize(count);
+        irradiance.resize(count);
+        for(size_t v = 0; v < count; ++v)
+        {
+            positions[v] = TransformPoint(vertices[v].Position, instance.World);
+            normals[v] = TransformNormal(vertices[v].Normal, normalMatrix);
+        }
+
+        lights.Irradiance(positions.data(), normals.data(), irradiance.data(), count, pool);
+
+        instance.Colors.resize(count);
+        for(size_t v = 0; v < count; ++v)
+            instance.Colors[v] = XMFLOAT4(irradiance[v].x, irradiance[v].y, irradiance[v].z, 1.0f);
+
+        if(settings.AmbientOcclusion && mBvh.TriangleCount() > 0)
+        {
+            pool.ParallelFor(count, AoGrain, [&, i](size_t begin, size_t end)
+            {
+                for(size_t v = begin; v < end; ++v)
+                {
+                    const uint32 seed = Hash((uint32)v * 9781u + i * 6271u);
+                    instance.Colors[v].w = AmbientVisibility(positions[v], normals[v], seed, settings);
+                }
+            });
+            mRayCount += count * settings.AoRayCount;
+        }
+
+        mBakedVertexCount += count;
+    }
+}
+
+float VertexLightBaker::AmbientVisibility(const XMFLOAT3& position, const XMFLOAT3& normal, uint32 seed,
+    const VertexBakeSettings& settings)const
+{
+    if(settings.AoRayCount == 0)
+        return 1.0f;
+
+    // Orthonormal basis around the normal (Duff et al. 2017).
+    const float sign = std::copysign(1.0f, normal.z);
+    const float a = -1.0f / (sign + normal.z);
+    const float b = normal.x * normal.y * a;
+    const XMFLOAT3 tangent(1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x);
+    const XMFLOAT3 bitangent(b, sign + normal.y * normal.y * a, -normal.y);
+
+    const XMFLOAT3 origin(position.x + normal.x * settings.AoBias, position.y + normal.y * settings.AoBias,
+        position.z + normal.z * settings.AoBias);
+
+    // Hammersley points, shifted per vertex so neighbours do not share a pattern.
+    const float shiftU = (seed & 0xFFFF) * (1.0f / 65536.0f);
+    const float shiftV = (seed >> 16) * (1.0f / 65536.0f);
+
+    uint32 escaped = 0;
+    for(uint32 k = 0; k < settings.AoRayCount; ++k)
+    {
+        float u = (k + 0.5f) / settings.AoRayCount + shiftU;
+        float v = RadicalInverse(k) + shiftV;
+        u -= std::floor(u);
+        v -= std::floor(v);
+
+        // Cosine-weighted direction.
+        const float r = std::sqrt(u);
+        const float phi = 2.0f * XM_PI * v;
+        const float x = r * std::cos(phi);
+        const float y = r * std::sin(phi);
+        const float z = std::sqrt(std::max(1.0f - u, 0.0f));
+
+        const XMFLOAT3 dir(
+            x * tangent.x + y * bitangent.x + z * normal.x,
+            x * tangent.y + y * bitangent.y + z * normal.y,
+            x * tangent.z + y * bitangent.z + z * normal.z);
+
+        if(!mBvh.Occluded(origin, dir, settings.AoDistance))
+            ++escaped;
+    }
+
+    return (float)escaped / settings.AoRayCount;
+}
@@ -0,0 +1,95 @@
+//***************************************************************************************
+// VertexLightBaker.h
+//
+// Bakes static lighting into a per-vertex color stream.  Each instance (a mesh and its
+// world matrix) gets one float4 per vertex:
+//
+//   rgb: direct light reaching the vertex (LightingModel::Irradiance), before the
+//        material is applied;
+//   a:   ambient visibility in [0, 1], the fraction of cosine-weighted hemisphere rays
+//        that leave the scene within AoDistance, or 1 with occlusion off.
+//
+// A shader then lights the vertex with diffuseAlbedo * (ambient * a + rgb).  The values
+// do not depend on the view or the material, so they stay valid while both change; the
+// view dependent specular term is what is given up.
+//
+// Ray casts run against a TriangleBvh of every instance added as an occluder; lighting
+// and rays are spread over the thread pool.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include "LightingModel.h"
+#include "ThreadPool.h"
+#include "TriangleBvh.h"
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+struct VertexBakeSettings
+{
+    bool AmbientOcclusion = true;
+    std::uint32_t AoRayCount = 64;
+
+    // Occluders farther away than this do not darken a vertex.
+    float AoDistance = 4.0f;
+
+    // Ray origins are pushed this far along the normal, off the vertex's own surface.
+    float AoBias = 1e-3f;
+};
+
+class VertexLightBaker
+{
+public:
+    using MeshData = GeometryGenerator::MeshData;
+    using uint32 = std::uint32_t;
+
+    // Vertices per thread pool task in the occlusion pass.
+    static const size_t AoGrain = 64;
+
+    ///<summary>
+    /// Adds mesh placed by world and returns its instance index.  Only a pointer to mesh
+    /// is kept, so it must outlive Bake().  Instances that are not occluders are baked
+    /// but cast no shadow, e.g. the coarser levels of a LOD chain.
+    ///</summary>
+    uint32 AddInstance(const MeshData& mesh, const DirectX::XMFLOAT4X4& world, bool occluder = true);
+
+    uint32 InstanceCount()const { return (uint32)mInstances.size(); }
+
+    ///<summary>
+    /// Bakes every instance added so far.
+    ///</summary>
+    void Bake(const LightingModel& lights, const VertexBakeSettings& settings = VertexBakeSettings(),
+        ThreadPool& pool = ThreadPool::Default());
+
+    // One entry per vertex of the instance's mesh, valid after Bake().
+    const std::vector<DirectX::XMFLOAT4>& Colors(uint32 instance)const { return mInstances[instance].Colors; }
+
+    size_t BakedVertexCount()const { return mBakedVertexCount; }
+    size_t RayCount()const { return mRayCount; }
+    uint32 OccluderTriangleCount()const { return mBvh.TriangleCount(); }
+
+private:
+    struct Instance
+    {
+        const MeshData* Mesh = nullptr;
+        DirectX::XMFLOAT4X4 World;
+        bool Occluder = true;
+
+        std::vector<DirectX::XMFLOAT4> Colors;
+    };
+
+    void BuildOccluders();
+
+    // Fraction of hemisphere rays around normal that escape.
+    float AmbientVisibility(const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT3& normal,
+        uint32 seed, const VertexBakeSettings& settings)const;
+
+private:
+    std::vector<Instance> mInstances;
+    TriangleBvh mBvh;
+
+    size_t mBakedVertexCount = 0;
+    size_t mRayCount = 0;
+};
@@ -93,6 +93,7 @@ int D3DApp::Run()
 				CalculateFrameStats();
 				Update(mTimer);	
                 Draw(mTimer);
+                MemoryTracker::Global().EndFrame();
 			}
 			else
 			{
@@ -127,6 +128,7 @@ void D3DApp::CreateRtvAndDsvDescriptorHeaps()
 	rtvHeapDesc.NodeMask = 0;
     ThrowIfFailed(md3dDevice->CreateDescriptorHeap(
         &rtvHeapDesc, IID_PPV_ARGS(mRtvHeap.GetAddressOf())));
+    d3dUtil::TrackMemory(md3dDevice.Get(), mRtvHeap.Get());
 
 
     D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc;
@@ -136,6 +138,7 @@ void D3DApp::CreateRtvAndDsvDescriptorHeaps()
 	dsvHeapDesc.NodeMask = 0;
     ThrowIfFailed(md3dDevice->CreateDescriptorHeap(
         &dsvHeapDesc, IID_PPV_ARGS(mDsvHeap.GetAddressOf())));
+    d3dUtil::TrackMemory(md3dDevice.Get(), mDsvHeap.Get());
 }
 
 void D3DApp::OnResize()
@@ -167,6 +170,7 @@ void D3DApp::OnResize()
 	for (UINT i = 0; i < SwapChainBufferCount; i++)
 	{
 		ThrowIfFailed(mSwapChain->GetBuffer(i, IID_PPV_ARGS(&mSwapChainBuffer[i])));
+		d3dUtil::TrackMemory(md3dDevice.Get(), mSwapChainBuffer[i].Get(), MemoryTracker::RenderTargets);
 		md3dDevice->CreateRenderTargetView(mSwapChainBuffer[i].Get(), nullptr, rtvHeapHandle);
 		rtvHeapHandle.Offset(1, mRtvDescriptorSize);
 	}
@@ -203,6 +207,7 @@ void D3DApp::OnResize()
 		D3D12_RESOURCE_STATE_COMMON,
         &optClear,
         IID_PPV_ARGS(mDepthStencilBuffer.GetAddressOf())));
+    d3dUtil::TrackMemory(md3dDevice.Get(), mDepthStencilBuffer.Get(), MemoryTracker::RenderTargets);
 
     // Create descriptor to mip level 0 of entire resource using the format of the resource.
 	D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc;
@@ -365,6 +370,12 @@ LRESULT D3DApp::MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
         }
         else if((int)wParam == VK_F2)
             Set4xMsaaState(!m4xMsaaState);
+        else if((int)wParam == VK_F3)
+        {
+            // The frames so far and where every category stands now.
+            MemoryTracker::Global().SaveCsv("MemoryReport.csv");
+            MemoryTracker::Global().SaveJson("MemoryReport.json");
+        }
 
         return 0;
 	}
@@ -593,9 +604,13 @@ void D3DApp::CalculateFrameStats()
         wstring fpsStr = to_wstring(fps);
         wstring mspfStr = to_wstring(mspf);
 
+        const MemoryTracker::uint64 memoryBytes = MemoryTracker::Global().TakeSnapshot().TotalBytes();
+        wstring memoryStr = to_wstring(memoryBytes / (1024 * 1024));
+
         wstring windowText = mMainWndCaption +
             L"    fps: " + fpsStr +
-            L"   mspf: " + mspfStr;
+            L"   mspf: " + mspfStr +
+            L"   mem: " + memoryStr + L" MB";
 
         SetWindowText(mhMainWnd, windowText.c_str());
 		
@@ -1,5 +1,6 @@
 
 #include "d3dUtil.h"
+#include <atomic>
 #include <comdef.h>
 #include <fstream>
 
@@ -82,28 +83,34 @@ Microsoft::WRL::ComPtr<ID3D12Resource> d3dUtil::CreateDefaultBuffer(
     // Note: uploadBuffer has to be kept alive after the above function calls because
     // the command list has not been executed yet that performs the actual copy.
     // The caller can Release the uploadBuffer after it knows the copy has been executed.
-
+    // An uploader kept for good shows up under UploadBuffers.
+    TrackMemory(defaultBuffer.Get(), MemoryTracker::Buffers, byteSize);
+    TrackMemory(uploadBuffer.Get(), MemoryTracker::UploadBuffers, byteSize);
 
     return defaultBuffer;
 }
 
-ComPtr<ID3DBlob> d3dUtil::CompileShader(
-	const std::wstring& filename,
-	const D3D_SHADER_MACRO* defines,
-	const std::string& entrypoint,
-	const std::string& target)
+UINT d3dUtil::ShaderCompileFlags()
 {
 	UINT compileFlags = 0;
 #if defined(DEBUG) || defined(_DEBUG)  
 	compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
 #endif
+	return compileFlags;
+}
 
+ComPtr<ID3DBlob> d3dUtil::CompileShader(
+	const std::wstring& filename,
+	const D3D_SHADER_MACRO* defines,
+	const std::string& entrypoint,
+	const std::string& target)
+{
 	HRESULT hr = S_OK;
 
 	ComPtr<ID3DBlob> byteCode = nullptr;
 	ComPtr<ID3DBlob> errors;
 	hr = D3DCompileFromFile(filename.c_str(), defines, D3D_COMPILE_STANDARD_FILE_INCLUDE,
-		entrypoint.c_str(), target.c_str(), compileFlags, 0, &byteCode, &errors);
+		entrypoint.c_str(), target.c_str(), ShaderCompileFlags(), 0, &byteCode, &errors);
 
 	if(errors != nullptr)
 		OutputDebugStringA((char*)errors->GetBufferPointer());
@@ -113,6 +120,87 @@ ComPtr<ID3DBlob> d3dUtil::CompileShader(
 	return byteCode;
 }
 
+namespace
+{
+    // {6B8B4567-327B-4A3C-9E4F-1D2C3B4A5968}
+    const GUID MemoryReportGuid = { 0x6b8b4567, 0x327b, 0x4a3c, { 0x9e, 0x4f, 0x1d, 0x2c, 0x3b, 0x4a, 0x59, 0x68 } };
+
+    // Attached to an object as private data, so the object releases it, and with it
+    // the bytes it reported, when it is destroyed.
+    class MemoryReport : public IUnknown
+    {
+    public:
+        MemoryReport(MemoryTracker::Category category, UINT64 bytes)
+            : mHandle(category, bytes)
+        {
+        }
+
+        HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override
+        {
+            if(object == nullptr)
+                return E_POINTER;
+            if(riid != __uuidof(IUnknown))
+            {
+                *object = nullptr;
+                return E_NOINTERFACE;
+            }
+
+            *object = static_cast<IUnknown*>(this);
+            AddRef();
+            return S_OK;
+        }
+
+        ULONG STDMETHODCALLTYPE AddRef() override
+        {
+            return ++mRefCount;
+        }
+
+        ULONG STDMETHODCALLTYPE Release() override
+        {
+            const ULONG refCount = --mRefCount;
+            if(refCount == 0)
+                delete this;
+            return refCount;
+        }
+
+    private:
+        ~MemoryReport() = default;
+
+        std::atomic<ULONG> mRefCount{ 1 };
+        MemoryTracker::Handle mHandle;
+    };
+}
+
+void d3dUtil::TrackMemory(ID3D12Object* object, MemoryTracker::Category category, UINT64 bytes)
+{
+    if(object == nullptr)
+        return;
+
+    // The object holds the only reference once this one goes.
+    ComPtr<IUnknown> report;
+    report.Attach(new MemoryReport(category, bytes));
+    ThrowIfFailed(object->SetPrivateDataInterface(MemoryReportGuid, report.Get()));
+}
+
+void d3dUtil::TrackMemory(ID3D12Device* device, ID3D12Resource* resource, MemoryTracker::Category category)
+{
+    if(resource == nullptr)
+        return;
+
+    const D3D12_RESOURCE_DESC desc = resource->GetDesc();
+    TrackMemory(resource, category, device->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes);
+}
+
+void d3dUtil::TrackMemory(ID3D12Device* device, ID3D12DescriptorHeap* heap)
+{
+    if(heap == nullptr)
+        return;
+
+    const D3D12_DESCRIPTOR_HEAP_DESC desc = heap->GetDesc();
+    TrackMemory(heap, MemoryTracker::DescriptorHeaps,
+        (UINT64)desc.NumDescriptors * device->GetDescriptorHandleIncrementSize(desc.Type));
+}
+
 std::wstring DxException::ToString()const
 {
     // Get the string description of the error code.
@@ -28,6 +28,7 @@
 #include "d3dx12.h"
 #include "DDSTextureLoader.h"
 #include "MathHelper.h"
+#include "MemoryTracker.h"
 
 extern const int gNumFrameResources;
 
@@ -121,11 +122,22 @@ public:
         UINT64 byteSize,
         Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer);
 
+    // Reports bytes of object to MemoryTracker::Global() until the object is destroyed.
+    // Reporting the same object again replaces what it reported before.
+    static void TrackMemory(ID3D12Object* object, MemoryTracker::Category category, UINT64 bytes);
+
+    // Same, with the size the device allocates for the resource or the heap.
+    static void TrackMemory(ID3D12Device* device, ID3D12Resource* resource, MemoryTracker::Category category);
+    static void TrackMemory(ID3D12Device* device, ID3D12DescriptorHeap* heap);
+
 	static Microsoft::WRL::ComPtr<ID3DBlob> CompileShader(
 		const std::wstring& filename,
 		const D3D_SHADER_MACRO* defines,
 		const std::string& entrypoint,
 		const std::string& target);
+
+	// D3DCOMPILE flags CompileShader uses for this build configuration.
+	static UINT ShaderCompileFlags();
 };
 
 class DxException
@@ -167,6 +179,9 @@ struct MeshGeometry
 	Microsoft::WRL::ComPtr<ID3DBlob> VertexBufferCPU = nullptr;
 	Microsoft::WRL::ComPtr<ID3DBlob> IndexBufferCPU  = nullptr;
 
+	// Reports the two blobs as MemoryTracker::MeshData.
+	MemoryTracker::Handle CpuMemory;
+
 	Microsoft::WRL::ComPtr<ID3D12Resource> VertexBufferGPU = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12Resource> IndexBufferGPU = nullptr;
 
@@ -1,6 +1,9 @@
 #include "../Common/d3dApp.h"
 #include "../Common/MathHelper.h"
 #include "../Common/GeometryGenerator.h"
+#include "../Common/GeometryCache.h"
+#include "../Common/MeshGeometryBuilder.h"
+#include "../Common/UploadArena.h"
 #include "FrameResource.h"
 
 using Microsoft::WRL::ComPtr;
@@ -86,6 +89,10 @@ private:
 
     // 渲染数据
     std::unordered_map<std::string,std::unique_ptr<MeshGeometry>> mGeometries;
+
+    // Stages the startup vertex and index data; released at the end of Initialize().
+    std::unique_ptr<UploadArena> mUploadArena;
+
     std::unordered_map<std::string,ComPtr<ID3DBlob>> mShaders;
     std::unordered_map<std::string,ComPtr<ID3D12PipelineState>> mPSOs;
 
@@ -129,9 +136,12 @@ bool ShapesApp::Initialize()
         return false;
     // Reset the command list to prep for initialization commands.
     mCommandList->Reset(mDirectCmdListAlloc.Get(),nullptr);
+    mUploadArena = std::make_unique<UploadArena>(md3dDevice.Get());
 
     BuildRootSignature();
     BuildShadersAndInputLayout();
+    // Shapes generated by earlier runs are read back instead of rebuilt.
+    GeometryCache::Default().SetDirectory("GeometryCache");
     BuildShapeGeometry();
     BuildRenderItems();
     BuildFrameResources();
@@ -142,8 +152,10 @@ bool ShapesApp::Initialize()
     // Execute the initialize cmds;
     mCommandList->Close();
     ID3D12CommandList* cmdLists[] = {mCommandList.Get()};
+    mUploadArena->WaitForCopies(mCommandQueue.Get());
     mCommandQueue->ExecuteCommandLists(_countof(cmdLists),cmdLists);
     FlushCommandQueue();
+    mUploadArena.reset();
     return true;
 }
 
@@ -454,138 +466,41 @@ void ShapesApp::BuildShadersAndInputLayout()
 
 void ShapesApp::BuildShapeGeometry()
 {
-    GeometryGenerator geoGen;
-    GeometryGenerator::MeshData box = geoGen.CreateBox(1.5F,0.5F,1.5F,3);
-    GeometryGenerator::MeshData grid = geoGen.CreateGrid(20.0f,30.0f,60,40);
+    GeometryCache& geoCache = GeometryCache::Default();
+    auto box = geoCache.CreateBox(1.5F,0.5F,1.5F,3);
+    auto grid = geoCache.CreateGrid(20.0f,30.0f,60,40);
 
     // Exercise 1
-    GeometryGenerator::MeshData sphere = geoGen.CreateSphere(0.5f,20,20);
-    // GeometryGenerator::MeshData sphere = geoGen.CreateGeosphere(0.5F,3);
+    auto sphere = geoCache.CreateSphere(0.5f,20,20);
+    // auto sphere = geoCache.CreateGeosphere(0.5F,3);
     // Exercise 1 end.
-    GeometryGenerator::MeshData cylinder = geoGen.CreateCylinder(0.5f,0.3f,3.0f,20,20);
+    auto cylinder = geoCache.CreateCylinder(0.5f,0.3f,3.0f,20,20);
 
     //Exercise 3
-    GeometryGenerator::MeshData model = geoGen.LoadModel("Models\\skull.txt");
+    GeometryGenerator geoGen;
+    GeometryGenerator::WeldStats weld;
+    GeometryGenerator::MeshData model = geoGen.LoadModel("Models\\skull.txt", 1e-5f, &weld);
+    ::OutputDebugStringA(("skull.txt: welded " + std::to_string(weld.VerticesBefore) + " -> " +
+        std::to_string(weld.VerticesAfter) + " vertices\n").c_str());
 
     // Combine all the geometry into one big vertex/index buffer.
-    UINT boxVertexOffset = 0 ;
-    UINT gridVertexOffset = (UINT)box.Vertices.size();
-    UINT sphereVertexOffset = gridVertexOffset + (UINT)grid.Vertices.size();
-    UINT cylinderVertexOffset = sphereVertexOffset+(UINT)sphere.Vertices.size();
-    UINT modelVertexOffset = cylinderVertexOffset + (UINT)cylinder.Vertices.size();
-
-    UINT boxIndexOffset = 0 ;
-    UINT gridIndexOffset = (UINT)box.Indices32.size();
-    UINT sphereIndexOffset = gridIndexOffset + (UINT)grid.Indices32.size();
-    UINT cylinderIndexOffset = sphereIndexOffset+(UINT)sphere.Indices32.size();
-    UINT modelIndexOffset = cylinderIndexOffset + (UINT)cylinder.Indices32.size();
-
-    
-    SubmeshGeometry boxSumMesh;
-    boxSumMesh.IndexCount = (UINT)box.Indices32.size();
-    boxSumMesh.StartIndexLocation = boxIndexOffset;
-    boxSumMesh.BaseVertexLocation = boxVertexOffset;
-
-    SubmeshGeometry gridSumMesh;
-    gridSumMesh.IndexCount = (UINT)grid.Indices32.size();
-    gridSumMesh.StartIndexLocation = gridIndexOffset;
-    gridSumMesh.BaseVertexLocation = gridVertexOffset;
-
-    SubmeshGeometry sphereSumMesh;
-    sphereSumMesh.IndexCount = (UINT)sphere.Indices32.size();
-    sphereSumMesh.StartIndexLocation = sphereIndexOffset;
-    sphereSumMesh.BaseVertexLocation = sphereVertexOffset;
-
-    SubmeshGeometry cylinderSumMesh;
-    cylinderSumMesh.IndexCount = (UINT)cylinder.Indices32.size();
-    cylinderSumMesh.StartIndexLocation = cylinderIndexOffset;
-    cylinderSumMesh.BaseVertexLocation = cylinderVertexOffset;
-
-    SubmeshGeometry modelSubMesh;
-    modelSubMesh.IndexCount = (UINT)model.Indices32.size();
-    modelSubMesh.StartIndexLocation = modelIndexOffset;
-    modelSubMesh.BaseVertexLocation = modelVertexOffset;
-    
-
-    auto totalVertexCount =
-        box.Vertices.size() +
-        grid.Vertices.size()+
-        sphere.Vertices.size() +
-        cylinder.Vertices.size() +
-        model.Vertices.size();
-    std::vector<Vertex> vertices(totalVertexCount);
-    UINT k = 0;
-    for(size_t i =0;i<box.Vertices.size();++i,++k)
-    {
-        vertices[k].Pos = box.Vertices[i].Position;
-        vertices[k].Color = XMFLOAT4(DirectX::Colors::DarkGreen);
-    }
-    for(size_t i =0;i<grid.Vertices.size();++i,++k)
-    {
-        vertices[k].Pos = grid.Vertices[i].Position;
-        vertices[k].Color = XMFLOAT4(DirectX::Colors::ForestGreen);
-    }
-    for(size_t i =0;i<sphere.Vertices.size();++i,++k)
+    GeometryPacker packer(
     {
-        vertices[k].Pos = sphere.Vertices[i].Position;
-        vertices[k].Color = XMFLOAT4(DirectX::Colors::Crimson);
-    }
-    for(size_t i =0;i<cylinder.Vertices.size();++i,++k)
-    {
-        vertices[k].Pos = cylinder.Vertices[i].Position;
-        vertices[k].Color = XMFLOAT4(DirectX::Colors::SteelBlue);
-    }
-    for(size_t i = 0;i<model.Vertices.size();++i,++k)
-    {
-        vertices[k].Pos = model.Vertices[i].Position;
-        vertices[k].Color = XMFLOAT4(DirectX::Colors::Red);
-    }
-
-    std::vector<std::uint16_t> indices;
-    indices.insert(indices.end(),box.GetIndices16().begin(),box.GetIndices16().end());
-    indices.insert(indices.end(),grid.GetIndices16().begin(),grid.GetIndices16().end());
-    indices.insert(indices.end(),sphere.GetIndices16().begin(),sphere.GetIndices16().end());
-    indices.insert(indices.end(),cylinder.GetIndices16().begin(),cylinder.GetIndices16().end());
-    indices.insert(indices.end(),model.GetIndices16().begin(),model.GetIndices16().end());
+        {VertexAttribute::Position,offsetof(Vertex,Pos)},
+        {VertexAttribute::Color,offsetof(Vertex,Color)},
+    },sizeof(Vertex));
 
-    const UINT vbByteSize = (UINT) vertices.size()*sizeof(Vertex);
-    const UINT ibByteSize = (UINT) indices.size() * sizeof(std::uint16_t);
+    packer.Add("box",*box,XMFLOAT4(DirectX::Colors::DarkGreen));
+    packer.Add("grid",*grid,XMFLOAT4(DirectX::Colors::ForestGreen));
+    packer.Add("sphere",*sphere,XMFLOAT4(DirectX::Colors::Crimson));
+    packer.Add("cylinder",*cylinder,XMFLOAT4(DirectX::Colors::SteelBlue));
+    packer.Add("model",model,XMFLOAT4(DirectX::Colors::Red));
 
     auto geo = std::make_unique<MeshGeometry>();
     geo->Name = "shapeGeo";
 
-    D3DCreateBlob(vbByteSize,&geo->VertexBufferCPU);
-    CopyMemory(geo->VertexBufferCPU->GetBufferPointer(),vertices.data(),vbByteSize);
-
-    D3DCreateBlob(ibByteSize,&geo->IndexBufferCPU);
-    CopyMemory(geo->IndexBufferCPU->GetBufferPointer(),indices.data(),ibByteSize);
-
     // 创建Buffer
-    geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(
-        md3dDevice.Get(),
-        mCommandList.Get(),
-        vertices.data(),
-        vbByteSize,
-        geo->VertexBufferUploader
-    );
-
-    geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(
-        md3dDevice.Get(),
-        mCommandList.Get(),
-        indices.data(),
-        ibByteSize,
-        geo->IndexBufferUploader
-    );
-    geo->VertexByteStride = sizeof(Vertex);
-    geo->VertexBufferByteSize = vbByteSize;
-    geo->IndexFormat = DXGI_FORMAT_R16_UINT;
-    geo->IndexBufferByteSize = ibByteSize;
-
-    geo->DrawArgs["box"] = boxSumMesh;
-    geo->DrawArgs["grid"] = gridSumMesh;
-    geo->DrawArgs["sphere"] = sphereSumMesh;
-    geo->DrawArgs["cylinder"] = cylinderSumMesh;
-    geo->DrawArgs["model"] = modelSubMesh;
+    BuildMeshGeometry(*mUploadArena,packer,*geo);
 
     mGeometries[geo->Name] = std::move(geo);
 }
@@ -2,6 +2,9 @@
 #include "../Common/MathHelper.h"
 #include "../Common/UploadBuffer.h"
 #include "../Common/GeometryGenerator.h"
+#include "../Common/ChunkedTerrain.h"
+#include "../Common/Heightfield.h"
+#include "../Common/UploadArena.h"
 #include "FrameResource.h"
 #include "Waves.h"
 
@@ -62,18 +65,22 @@ protected:
     void UpdateObjectCBs(const GameTimer& gt);
     void UpdateMainPassCBs(const GameTimer& gt);
     void UpdateWaves(const GameTimer& gt);
+    void UpdateTerrain(const GameTimer& gt);
 
     void BuildRootSignature();
     void BuildShaderAndInputLayout();
+    void BuildHeightfield();
     void BuildLandGeometryBuffers();
     void BuildWavesGeometryBuffers();
     void BuildPSOs();
     void BuildFrameResources();
     void BuildRenderItems();
     void DrawRenderItems(ID3D12GraphicsCommandList* cmdList,const std::vector<RenderItem*>& ritems);
+    void DrawTerrain(ID3D12GraphicsCommandList* cmdList);
 
     float GetHillHeight(float x,float z) const ;
     XMFLOAT3 GetHillsNormal(float x,float z) const;
+    XMFLOAT4 GetHeightColor(float y) const;
 
 private:
     std::vector<std::unique_ptr<FrameResource>> mFrameResources;
@@ -83,12 +90,17 @@ private:
 
     ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
     std::unordered_map<std::string,std::unique_ptr<MeshGeometry>> mGeometries;
+
+    // Stages the startup vertex and index data; released at the end of Initialize().
+    std::unique_ptr<UploadArena> mUploadArena;
+
     std::unordered_map<std::string,ComPtr<ID3DBlob>> mShaders;
     std::unordered_map<std::string,ComPtr<ID3D12PipelineState>> mPSOs;
 
     std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
 
     RenderItem* mWavesRitem = nullptr;
+    RenderItem* mLandRitem = nullptr;
 
     // List of fall items ;
     std::vector<std::unique_ptr<RenderItem>> mAllRitems ;
@@ -97,6 +109,16 @@ private:
 
     std::unique_ptr<Waves> mWaves;
 
+    // Where the land heights come from: a heightmap if one ships with the sample,
+    // the analytic hills otherwise.
+    std::unique_ptr<Heightfield> mHeightfield;
+
+    // The land is drawn chunk by chunk from a single vertex buffer holding every
+    // resident chunk slot.  A slot is only rewritten after the terrain has stopped
+    // drawing it for gNumFrameResources frames, so one buffer serves all frames.
+    std::unique_ptr<ChunkedTerrain> mTerrain;
+    std::unique_ptr<UploadBuffer<Vertex>> mTerrainVB;
+
     PassConstants mMainPassCB;
 
     bool mIsWireframe = false;
@@ -157,7 +179,9 @@ bool LandAndWavesApp::Initialize()
     }
     // Reset the commandlist to prep for initialization commands.
     mCommandList->Reset(mDirectCmdListAlloc.Get(),nullptr);
+    mUploadArena = std::make_unique<UploadArena>(md3dDevice.Get());
     mWaves = std::make_unique<Waves>(128,128,1.0,0.03f,4.f,0.2f);
+    BuildHeightfield();
 
     BuildRootSignature();
     BuildShaderAndInputLayout();
@@ -170,9 +194,11 @@ bool LandAndWavesApp::Initialize()
     // Execute the initialize commands.
     mCommandList->Close();
     ID3D12CommandList* cmdLists[] = {mCommandList.Get()};
+    mUploadArena->WaitForCopies(mCommandQueue.Get());
     mCommandQueue->ExecuteCommandLists(_countof(cmdLists),cmdLists);
 
     FlushCommandQueue();
+    mUploadArena.reset();
     return true;
     
 }
@@ -204,7 +230,7 @@ void LandAndWavesApp::Update(const GameTimer& gt)
     UpdateObjectCBs(gt);
     UpdateMainPassCBs(gt);
     UpdateWaves(gt);
-    
+    UpdateTerrain(gt);
 }
 
 void LandAndWavesApp::Draw(const GameTimer& gt)
@@ -244,6 +270,7 @@ void LandAndWavesApp::Draw(const GameTimer& gt)
     mCommandList->SetGraphicsRootConstantBufferView(1,passCB->GetGPUVirtualAddress());
 
     DrawRenderItems(mCommandList.Get(),mRitemLayer[(int)RenderLayer::Opaque]);
+    DrawTerrain(mCommandList.Get());
 
     // 绘制结束，资源转换
     mCommandList->ResourceBarrier(1,&CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),D3D12_RESOURCE_STATE_RENDER_TARGET,D3D12_RESOURCE_STATE_PRESENT));
@@ -414,6 +441,32 @@ void LandAndWavesApp::UpdateWaves(const GameTimer& gt)
     
 }
 
+void LandAndWavesApp::UpdateTerrain(const GameTimer& gt)
+{
+    XMMATRIX viewProj = XMMatrixMultiply(XMLoadFloat4x4(&mView), XMLoadFloat4x4(&mProj));
+    XMFLOAT4X4 vp;
+    XMStoreFloat4x4(&vp, viewProj);
+
+    mTerrain->Update(mEyePos, vp);
+
+    // Copy the chunks that arrived since the last frame, the root's on the first one,
+    // into their slots.
+    const UINT vertsPerChunk = mTerrain->VerticesPerChunk();
+    for(UINT slot : mTerrain->CompletedSlots())
+    {
+        const TerrainVertex* src = mTerrain->SlotVertices(slot);
+        for(UINT i = 0; i < vertsPerChunk; ++i)
+        {
+            Vertex v;
+            v.Pos = src[i].Pos;
+            v.Color = GetHeightColor(src[i].Pos.y);
+
+            mTerrainVB->CopyData(slot*vertsPerChunk + i, v);
+        }
+    }
+    mTerrain->ClearCompletedSlots();
+}
+
 void LandAndWavesApp::BuildRootSignature()
 {
     // 一组根参数
@@ -451,76 +504,71 @@ void LandAndWavesApp::BuildShaderAndInputLayout()
     };
 }
 
-void LandAndWavesApp::BuildLandGeometryBuffers()
+void LandAndWavesApp::BuildHeightfield()
 {
-    GeometryGenerator geoGen;
-    GeometryGenerator::MeshData grid = geoGen.CreateGrid(160.0f,160.0f,50,50);
+    // The heightmap is only mapped here; tiles are decoded as the terrain samples
+    // them, so startup cost does not depend on the size of the map.
+    HeightmapDesc desc;
+    desc.Path = "Terrain/heightmap.r16";
+    desc.SampleSpacing = 1.0f;
+    desc.HeightOffset = -30.0f;
+    desc.HeightRange = 80.0f;
+
+    auto heightmap = std::make_unique<TiledHeightmap>();
+    if(heightmap->Open(desc))
+        mHeightfield = std::move(heightmap);
+    else
+        mHeightfield = std::make_unique<HillsHeightfield>();
+}
 
+void LandAndWavesApp::BuildLandGeometryBuffers()
+{
     //
-    // Extract the vertex elements we are interested and apply the height function to
-    // each vertex.  In addition, color the vertices based on their height so we have
-    // sandy looking beaches, grassy low hills, and snow mountain peaks.
+    // The hills are a quadtree of chunks generated on demand around the camera
+    // instead of one fixed grid, so the world can be much larger than the old
+    // 160x160 patch while staying detailed up close.
     //
 
-    std::vector<Vertex> vertices(grid.Vertices.size());
-    for(size_t i =0;i<grid.Vertices.size();++i)
+    TerrainDesc desc;
+    desc.WorldSize = mHeightfield->WorldSize() > 0.0f ? mHeightfield->WorldSize() : 512.0f;
+    desc.Resolution = 32;
+    desc.MaxDepth = 5;
+    // Refine big heightmaps until leaf quads match the sample spacing.
+    while(desc.WorldSize / (desc.Resolution << desc.MaxDepth) > mHeightfield->SampleSpacing() && desc.MaxDepth < 12)
+        ++desc.MaxDepth;
+    desc.FramesInFlight = gNumFrameResources;
+    desc.Height = [this](float x, float z) { return GetHillHeight(x, z); };
+    desc.Normal = [this](float x, float z) { return GetHillsNormal(x, z); };
+    desc.Heights = [this](const float* x, const float* z, float* y, size_t count)
+    {
+        mHeightfield->Heights(x, z, y, count);
+    };
+    desc.Normals = [this](const float* x, const float* z, XMFLOAT3* n, size_t count)
     {
-        auto& p =grid.Vertices[i].Position;
-        vertices[i].Pos = p;
-        vertices[i].Pos.y = GetHillHeight(p.x,p.z);
+        mHeightfield->Normals(x, z, n, count);
+    };
 
-        // Color the vertex based on its height.
-        if(vertices[i].Pos.y < -10.0f)
-        {
-            // Sandy beach color.
-            vertices[i].Color = XMFLOAT4(1.0f, 0.96f, 0.62f, 1.0f);
-        }
-        else if(vertices[i].Pos.y < 5.0f)
-        {
-            // Light yellow-green.
-            vertices[i].Color = XMFLOAT4(0.48f, 0.77f, 0.46f, 1.0f);
-        }
-        else if(vertices[i].Pos.y < 12.0f)
-        {
-            // Dark yellow-green.
-            vertices[i].Color = XMFLOAT4(0.1f, 0.48f, 0.19f, 1.0f);
-        }
-        else if(vertices[i].Pos.y < 20.0f)
-        {
-            // Dark brown.
-            vertices[i].Color = XMFLOAT4(0.45f, 0.39f, 0.34f, 1.0f);
-        }
-        else
-        {
-            // White snow.
-            vertices[i].Color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
-        }
-    }
+    mTerrain = std::make_unique<ChunkedTerrain>(desc);
 
-    const UINT vbByteSize = (UINT)vertices.size()*sizeof(Vertex);
+    const UINT vertexCount = mTerrain->SlotCount()*mTerrain->VerticesPerChunk();
+    mTerrainVB = std::make_unique<UploadBuffer<Vertex>>(md3dDevice.Get(), vertexCount, false);
 
-    std::vector<std::uint16_t> indices = grid.GetIndices16();
+    // Every chunk has the same topology, so one index buffer serves them all.
+    const std::vector<std::uint16_t>& indices = mTerrain->Indices();
     const UINT ibByteSize = (UINT)indices.size()*sizeof(std::uint16_t);
 
     auto geo = std::make_unique<MeshGeometry>();
     geo->Name = "landGeo";
 
-    D3DCreateBlob(vbByteSize,&geo->VertexBufferCPU);
-    CopyMemory(geo->VertexBufferCPU->GetBufferPointer(),vertices.data(),vbByteSize);
-
-    D3DCreateBlob(ibByteSize,&geo->IndexBufferCPU);
+    ThrowIfFailed(D3DCreateBlob(ibByteSize,&geo->IndexBufferCPU));
     CopyMemory(geo->IndexBufferCPU->GetBufferPointer(),indices.data(),ibByteSize);
+    geo->CpuMemory.Reset(MemoryTracker::MeshData,ibByteSize);
 
-    geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(
-        md3dDevice.Get(),mCommandList.Get(),vertices.data(),vbByteSize,geo->VertexBufferUploader
-    );
-
-    geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(
-        md3dDevice.Get(),mCommandList.Get(),indices.data(),ibByteSize,geo->IndexBufferUploader
-    );
+    geo->IndexBufferGPU = mUploadArena->CreateBuffer(indices.data(),ibByteSize);
 
+    geo->VertexBufferGPU = mTerrainVB->Resource();
     geo->VertexByteStride = sizeof(Vertex);
-    geo->VertexBufferByteSize = vbByteSize;
+    geo->VertexBufferByteSize = vertexCount*sizeof(Vertex);
     geo->IndexFormat = DXGI_FORMAT_R16_UINT;
     geo->IndexBufferByteSize = ibByteSize;
 
@@ -528,10 +576,8 @@ void LandAndWavesApp::BuildLandGeometryBuffers()
     submesh.IndexCount = (UINT)indices.size();
     submesh.StartIndexLocation = 0;
     submesh.BaseVertexLocation = 0;
-    geo->DrawArgs["grid"] = submesh;
+    geo->DrawArgs["chunk"] = submesh;
     mGeometries["landGeo"] = std::move(geo);
-    
-    
 }
 
 void LandAndWavesApp::BuildWavesGeometryBuffers()
@@ -566,10 +612,9 @@ void LandAndWavesApp::BuildWavesGeometryBuffers()
     geo->VertexBufferGPU = nullptr;
     ThrowIfFailed(D3DCreateBlob(ibByteSize,&geo->IndexBufferCPU));
     CopyMemory(geo->IndexBufferCPU->GetBufferPointer(),indices.data(),ibByteSize);
+    geo->CpuMemory.Reset(MemoryTracker::MeshData,ibByteSize);
 
-    geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(
-        md3dDevice.Get(),mCommandList.Get(),indices.data(),ibByteSize,geo->IndexBufferUploader
-    );
+    geo->IndexBufferGPU = mUploadArena->CreateBuffer(indices.data(),ibByteSize);
 
     // 顶点Buffer动态更新，这里只需初始化IndexBuffer.
     geo->VertexByteStride = sizeof(Vertex);
@@ -650,11 +695,12 @@ void LandAndWavesApp::BuildRenderItems()
     gridRitem->ObjCBIndex = 1;
     gridRitem->Geo = mGeometries["landGeo"].get();
     gridRitem->PrimitiveTopologyType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-    gridRitem->IndexCount = gridRitem->Geo->DrawArgs["grid"].IndexCount;
-    gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs["grid"].StartIndexLocation;
-    gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
+    gridRitem->IndexCount = gridRitem->Geo->DrawArgs["chunk"].IndexCount;
+    gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs["chunk"].StartIndexLocation;
+    gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs["chunk"].BaseVertexLocation;
 
-    mRitemLayer[(int)RenderLayer::Opaque].push_back(gridRitem.get());
+    // Drawn by DrawTerrain, once per visible chunk.
+    mLandRitem = gridRitem.get();
 
     mAllRitems.push_back(std::move(waveRitem));
     mAllRitems.push_back(std::move(gridRitem));
@@ -681,21 +727,61 @@ void LandAndWavesApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const
     
 }
 
+void LandAndWavesApp::DrawTerrain(ID3D12GraphicsCommandList* cmdList)
+{
+    UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+
+    auto ri = mLandRitem;
+    cmdList->IASetVertexBuffers(0,1,&ri->Geo->VertexBufferView());
+    cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
+    cmdList->IASetPrimitiveTopology(ri->PrimitiveTopologyType);
+
+    D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = mCurrentFrameResources->ObjectCB->Resource()->GetGPUVirtualAddress();
+    objCBAddress += ri->ObjCBIndex*objCBByteSize;
+    cmdList->SetGraphicsRootConstantBufferView(0,objCBAddress);
+
+    // All chunks share the index buffer; the slot picks the chunk's vertices.
+    const UINT vertsPerChunk = mTerrain->VerticesPerChunk();
+    for(const auto& chunk : mTerrain->VisibleChunks())
+        cmdList->DrawIndexedInstanced(ri->IndexCount,1,ri->StartIndexLocation,(INT)(chunk.Slot*vertsPerChunk),0);
+}
+
 float LandAndWavesApp::GetHillHeight(float x, float z) const
 {
-    return 0.3f*(z*sinf(0.1f*x)+x*cosf(0.1f*z));
+    return mHeightfield->Height(x, z);
 }
 
 XMFLOAT3 LandAndWavesApp::GetHillsNormal(float x, float z) const
 {
-    // n = (-df/dx, 1, -df/dz)
-    XMFLOAT3 n(
-        -0.03f*z*cosf(0.1f*x) - 0.3f*cosf(0.1f*z),
-        1.0f,
-        -0.3f*sinf(0.1f*x) + 0.03f*x*sinf(0.1f*z));
-
-    XMVECTOR unitNormal = XMVector3Normalize(XMLoadFloat3(&n));
-    XMStoreFloat3(&n, unitNormal);
+    return mHeightfield->Normal(x, z);
+}
 
-    return n;
+XMFLOAT4 LandAndWavesApp::GetHeightColor(float y) const
+{
+    // Sandy beaches, grassy low hills, and snow mountain peaks.
+    if(y < -10.0f)
+    {
+        // Sandy beach color.
+        return XMFLOAT4(1.0f, 0.96f, 0.62f, 1.0f);
+    }
+    else if(y < 5.0f)
+    {
+        // Light yellow-green.
+        return XMFLOAT4(0.48f, 0.77f, 0.46f, 1.0f);
+    }
+    else if(y < 12.0f)
+    {
+        // Dark yellow-green.
+        return XMFLOAT4(0.1f, 0.48f, 0.19f, 1.0f);
+    }
+    else if(y < 20.0f)
+    {
+        // Dark brown.
+        return XMFLOAT4(0.45f, 0.39f, 0.34f, 1.0f);
+    }
+    else
+    {
+        // White snow.
+        return XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+    }
 }
@@ -1,6 +1,10 @@
 #include "../Common/d3dApp.h"
 #include "../Common/MathHelper.h"
 #include "../Common/GeometryGenerator.h"
+#include "../Common/GeometryCache.h"
+#include "../Common/MeshGeometryBuilder.h"
+#include "../Common/DescriptorHeap.h"
+#include "../Common/UploadArena.h"
 #include "FrameResource.h"
 
 using Microsoft::WRL::ComPtr;
@@ -9,6 +13,11 @@ using namespace DirectX::PackedVector;
 
 const int gNumFrameResources = 3;
 
+// Descriptor heap regions (DescriptorHeapManager).  The transient region holds a few
+// frames' pass CBVs.
+const UINT PersistentCbvCapacity = 4096;
+const UINT TransientCbvCapacity = 64;
+
 // Params to draw a shape.This will vary from app-to-app.
 struct RenderItem
 {
@@ -24,6 +33,9 @@ struct RenderItem
     // Index into GPU constant buffer corresponding to the ObjectCB for this render item.
     UINT ObjCBIndex = -1;
 
+    // gNumFrameResources persistent CBVs, one per frame resource.
+    DescriptorAllocator::Allocation Cbvs;
+
     // 渲染数据
     MeshGeometry* Geo = nullptr;
 
@@ -75,12 +87,17 @@ private:
     int mCurrentFrameResourceIndex = 0;
 
     ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
-    ComPtr<ID3D12DescriptorHeap> mCbvHeap = nullptr;
+    // Persistent object CBVs and per-frame pass CBVs, suballocated from one heap.
+    std::unique_ptr<DescriptorHeapManager> mCbvHeap;
 
     ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
 
     // 渲染数据
     std::unordered_map<std::string,std::unique_ptr<MeshGeometry>> mGeometries;
+
+    // Stages the startup vertex and index data; released at the end of Initialize().
+    std::unique_ptr<UploadArena> mUploadArena;
+
     std::unordered_map<std::string,ComPtr<ID3DBlob>> mShaders;
     std::unordered_map<std::string,ComPtr<ID3D12PipelineState>> mPSOs;
 
@@ -94,8 +111,6 @@ private:
 
     PassConstants mMainPassCB;
 
-    UINT mPassCbvOffset = 0;
-
     bool mIsWireframe = false;
 
     // Camera.
@@ -124,9 +139,12 @@ bool ShapesApp::Initialize()
         return false;
     // Reset the command list to prep for initialization commands.
     mCommandList->Reset(mDirectCmdListAlloc.Get(),nullptr);
+    mUploadArena = std::make_unique<UploadArena>(md3dDevice.Get());
 
     BuildRootSignature();
     BuildShadersAndInputLayout();
+    // Shapes generated by earlier runs are read back instead of rebuilt.
+    GeometryCache::Default().SetDirectory("GeometryCache");
     BuildShapeGeometry();
     BuildRenderItems();
     BuildFrameResources();
@@ -137,8 +155,10 @@ bool ShapesApp::Initialize()
     // Execute the initialize cmds;
     mCommandList->Close();
     ID3D12CommandList* cmdLists[] = {mCommandList.Get()};
+    mUploadArena->WaitForCopies(mCommandQueue.Get());
     mCommandQueue->ExecuteCommandLists(_countof(cmdLists),cmdLists);
     FlushCommandQueue();
+    mUploadArena.reset();
     return true;
 }
 
@@ -172,6 +192,8 @@ void ShapesApp::Update(const GameTimer& gt)
         WaitForSingleObject(eventHandle,INFINITE);
         CloseHandle(eventHandle);
     }
+    // Descriptors of the frames the GPU is done with can be reused.
+    mCbvHeap->Reclaim(mFence->GetCompletedValue());
 
     UpdateObjectCBs(gt);
     UpdateMainPassCB(gt);
@@ -207,14 +229,22 @@ void ShapesApp::Draw(const GameTimer& gt)
     mCommandList->OMSetRenderTargets(1,&CurrentBackBufferDescriptor(),true,&DepthStencilDescriptor());
 
     // 常量缓冲区相关
-    ID3D12DescriptorHeap* descriptorHeaps[] = {mCbvHeap.Get()};
+    ID3D12DescriptorHeap* descriptorHeaps[] = {mCbvHeap->Heap()};
     mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps),descriptorHeaps);
     mCommandList->SetGraphicsRootSignature(mRootSignature.Get());
 
-    int passCbvIndex = mPassCbvOffset + mCurrentFrameResourceIndex;
-    auto passCbvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(mCbvHeap->GetGPUDescriptorHandleForHeapStart());
-    passCbvHandle.Offset(passCbvIndex,mCbvSrvUavDescriptorSize);
-    mCommandList->SetGraphicsRootDescriptorTable(1,passCbvHandle);
+    // The pass CBV is written for this frame only.
+    UINT passCbvIndex = mCbvHeap->AllocateTransient(1);
+    if(passCbvIndex == DescriptorAllocator::NoIndex)
+        ThrowIfFailed(E_OUTOFMEMORY);
+    D3D12_CONSTANT_BUFFER_VIEW_DESC passCbvDesc;
+    passCbvDesc.BufferLocation = mCurrentFrameResource->PassCB->Resource()->GetGPUVirtualAddress();
+    passCbvDesc.SizeInBytes = d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstants));
+    md3dDevice->CreateConstantBufferView(&passCbvDesc,mCbvHeap->CpuHandle(passCbvIndex));
+    mCommandList->SetGraphicsRootDescriptorTable(1,mCbvHeap->GpuHandle(passCbvIndex));
+
+    // Object CBVs staged since the last frame.
+    mCbvHeap->FlushCopies();
 
     DrawRenderItems(mCommandList.Get(),mOpaqueRitems);
 
@@ -236,7 +266,7 @@ void ShapesApp::Draw(const GameTimer& gt)
     mCurrentFrameResource->Fence =mCurrentFence;
 
     mCommandQueue->Signal(mFence.Get(),mCurrentFence);
-    
+    mCbvHeap->EndFrame(mCurrentFence);
 }
 
 void ShapesApp::OnMouseDown(WPARAM btnState, int x, int y)
@@ -354,63 +384,34 @@ void ShapesApp::UpdateMainPassCB(const GameTimer& gt)
 
 void ShapesApp::BuildDescriptorHeaps()
 {
-    UINT objCount = (UINT)mOpaqueRitems.size();
-
-    // Need a cbv descriptor for each object for each frame resource.
-    // +1 for the pass cbv for each frame resource.
-    UINT numDescriptors = (objCount+1)*gNumFrameResources;
-    // Save a offset to the start of the pass CBVs.
-    mPassCbvOffset = objCount*gNumFrameResources;
-
-    D3D12_DESCRIPTOR_HEAP_DESC cbvHeapDesc;
-    cbvHeapDesc.NumDescriptors = numDescriptors;
-    cbvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-    cbvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-    cbvHeapDesc.NodeMask = 0;
-    md3dDevice->CreateDescriptorHeap(&cbvHeapDesc,IID_PPV_ARGS(&mCbvHeap));
+    // Sized for the scene to grow, not for the objects that exist now: objects take
+    // gNumFrameResources persistent descriptors each, frames one transient pass CBV.
+    mCbvHeap = std::make_unique<DescriptorHeapManager>(md3dDevice.Get(),
+        D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, PersistentCbvCapacity, TransientCbvCapacity);
 }
 
 void ShapesApp::BuildConstantBufferViews()
 {
     UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
-    UINT objCount = (UINT)mOpaqueRitems.size();
 
     // Need a CBV descriptor for each object for each frame resource.
-    for(int frameIndex = 0; frameIndex<gNumFrameResources;++frameIndex)
+    for(auto& ri : mAllRitems)
     {
-        auto objectCB = mFrameResources[frameIndex]->ObjectCB->Resource();
-        for(UINT i = 0; i<objCount; ++i)
+        ri->Cbvs = mCbvHeap->AllocatePersistent(gNumFrameResources);
+        if(!ri->Cbvs.Valid())
+            throw DxException(E_OUTOFMEMORY, L"DescriptorHeapManager::AllocatePersistent", AnsiToWString(__FILE__), __LINE__);
+
+        for(int frameIndex = 0; frameIndex<gNumFrameResources;++frameIndex)
         {
-            D3D12_GPU_VIRTUAL_ADDRESS cbAddress = objectCB->GetGPUVirtualAddress();
-            // offset to the ith object constant buffer in the buffer.
-            cbAddress += i*objCBByteSize;
-            // offset to the object cbv in the descriptor heap.
-            int heapIndex = frameIndex*objCount + i ;
-            auto handle = CD3DX12_CPU_DESCRIPTOR_HANDLE(mCbvHeap->GetCPUDescriptorHandleForHeapStart());
-            handle.Offset(heapIndex,mCbvSrvUavDescriptorSize);
+            auto objectCB = mFrameResources[frameIndex]->ObjectCB->Resource();
 
             D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc;
-            cbvDesc.BufferLocation = cbAddress;
+            // offset to the ith object constant buffer in the buffer.
+            cbvDesc.BufferLocation = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex*objCBByteSize;
             cbvDesc.SizeInBytes = objCBByteSize;
-            md3dDevice->CreateConstantBufferView(&cbvDesc,handle);      
+            md3dDevice->CreateConstantBufferView(&cbvDesc,mCbvHeap->StagingHandle(ri->Cbvs.Offset + frameIndex));
         }
-    }
-    UINT passCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstants));
-
-    for(int frameIndex = 0;frameIndex<gNumFrameResources;++frameIndex)
-    {
-        auto passCB = mFrameResources[frameIndex]->PassCB->Resource();
-        D3D12_GPU_VIRTUAL_ADDRESS cbAddress = passCB->GetGPUVirtualAddress();
-        // Offset to the pass cbv.
-        int heapIndex = mPassCbvOffset + frameIndex;
-        auto handle = CD3DX12_CPU_DESCRIPTOR_HANDLE(mCbvHeap->GetCPUDescriptorHandleForHeapStart());
-        handle.Offset(heapIndex,mCbvSrvUavDescriptorSize);
-
-        D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc;
-        cbvDesc.BufferLocation = cbAddress;
-        cbvDesc.SizeInBytes = passCBByteSize;
-
-        md3dDevice->CreateConstantBufferView(&cbvDesc,handle);
+        mCbvHeap->Stage(ri->Cbvs);
     }
 }
 
@@ -463,118 +464,33 @@ void ShapesApp::BuildShadersAndInputLayout()
 
 void ShapesApp::BuildShapeGeometry()
 {
-    GeometryGenerator geoGen;
-    GeometryGenerator::MeshData box = geoGen.CreateBox(1.5F,0.5F,1.5F,3);
-    GeometryGenerator::MeshData grid = geoGen.CreateGrid(20.0f,30.0f,60,40);
+    GeometryCache& geoCache = GeometryCache::Default();
+    auto box = geoCache.CreateBox(1.5F,0.5F,1.5F,3);
+    auto grid = geoCache.CreateGrid(20.0f,30.0f,60,40);
 
     // Exercise 1
-    GeometryGenerator::MeshData sphere = geoGen.CreateSphere(0.5f,20,20);
-    // GeometryGenerator::MeshData sphere = geoGen.CreateGeosphere(0.5F,3);
+    auto sphere = geoCache.CreateSphere(0.5f,20,20);
+    // auto sphere = geoCache.CreateGeosphere(0.5F,3);
     // Exercise 1 end.
-    GeometryGenerator::MeshData cylinder = geoGen.CreateCylinder(0.5f,0.3f,3.0f,20,20);
+    auto cylinder = geoCache.CreateCylinder(0.5f,0.3f,3.0f,20,20);
 
     // Combine all the geometry into one big vertex/index buffer.
-    UINT boxVertexOffset = 0 ;
-    UINT gridVertexOffset = (UINT)box.Vertices.size();
-    UINT sphereVertexOffset = gridVertexOffset + (UINT)grid.Vertices.size();
-    UINT cylinderVertexOffset = sphereVertexOffset+(UINT)sphere.Vertices.size();
-
-    UINT boxIndexOffset = 0 ;
-    UINT gridIndexOffset = (UINT)box.Indices32.size();
-    UINT sphereIndexOffset = gridIndexOffset + (UINT)grid.Indices32.size();
-    UINT cylinderIndexOffset = sphereIndexOffset+(UINT)sphere.Indices32.size();
-
-    SubmeshGeometry boxSumMesh;
-    boxSumMesh.IndexCount = (UINT)box.Indices32.size();
-    boxSumMesh.StartIndexLocation = boxIndexOffset;
-    boxSumMesh.BaseVertexLocation = boxVertexOffset;
-
-    SubmeshGeometry gridSumMesh;
-    gridSumMesh.IndexCount = (UINT)grid.Indices32.size();
-    gridSumMesh.StartIndexLocation = gridIndexOffset;
-    gridSumMesh.BaseVertexLocation = gridVertexOffset;
-
-    SubmeshGeometry sphereSumMesh;
-    sphereSumMesh.IndexCount = (UINT)sphere.Indices32.size();
-    sphereSumMesh.StartIndexLocation = sphereIndexOffset;
-    sphereSumMesh.BaseVertexLocation = sphereVertexOffset;
-
-    SubmeshGeometry cylinderSumMesh;
-    cylinderSumMesh.IndexCount = (UINT)cylinder.Indices32.size();
-    cylinderSumMesh.StartIndexLocation = cylinderIndexOffset;
-    cylinderSumMesh.BaseVertexLocation = cylinderVertexOffset;
-
-    auto totalVertexCount =
-        box.Vertices.size() +
-        grid.Vertices.size()+
-        sphere.Vertices.size() +
-        cylinder.Vertices.size();
-    std::vector<Vertex> vertices(totalVertexCount);
-    UINT k = 0;
-    for(size_t i =0;i<box.Vertices.size();++i,++k)
-    {
-        vertices[k].Pos = box.Vertices[i].Position;
-        vertices[k].Color = XMFLOAT4(DirectX::Colors::DarkGreen);
-    }
-    for(size_t i =0;i<grid.Vertices.size();++i,++k)
-    {
-        vertices[k].Pos = grid.Vertices[i].Position;
-        vertices[k].Color = XMFLOAT4(DirectX::Colors::ForestGreen);
-    }
-    for(size_t i =0;i<sphere.Vertices.size();++i,++k)
+    GeometryPacker packer(
     {
-        vertices[k].Pos = sphere.Vertices[i].Position;
-        vertices[k].Color = XMFLOAT4(DirectX::Colors::Crimson);
-    }
-    for(size_t i =0;i<cylinder.Vertices.size();++i,++k)
-    {
-        vertices[k].Pos = cylinder.Vertices[i].Position;
-        vertices[k].Color = XMFLOAT4(DirectX::Colors::SteelBlue);
-    }
-
-    std::vector<std::uint16_t> indices;
-    indices.insert(indices.end(),box.GetIndices16().begin(),box.GetIndices16().end());
-    indices.insert(indices.end(),grid.GetIndices16().begin(),grid.GetIndices16().end());
-    indices.insert(indices.end(),sphere.GetIndices16().begin(),sphere.GetIndices16().end());
-    indices.insert(indices.end(),cylinder.GetIndices16().begin(),cylinder.GetIndices16().end());
+        {VertexAttribute::Position,offsetof(Vertex,Pos)},
+        {VertexAttribute::Color,offsetof(Vertex,Color)},
+    },sizeof(Vertex));
 
-    const UINT vbByteSize = (UINT) vertices.size()*sizeof(Vertex);
-    const UINT ibByteSize = (UINT) indices.size() * sizeof(std::uint16_t);
+    packer.Add("box",*box,XMFLOAT4(DirectX::Colors::DarkGreen));
+    packer.Add("grid",*grid,XMFLOAT4(DirectX::Colors::ForestGreen));
+    packer.Add("sphere",*sphere,XMFLOAT4(DirectX::Colors::Crimson));
+    packer.Add("cylinder",*cylinder,XMFLOAT4(DirectX::Colors::SteelBlue));
 
     auto geo = std::make_unique<MeshGeometry>();
     geo->Name = "shapeGeo";
 
-    D3DCreateBlob(vbByteSize,&geo->VertexBufferCPU);
-    CopyMemory(geo->VertexBufferCPU->GetBufferPointer(),vertices.data(),vbByteSize);
-
-    D3DCreateBlob(ibByteSize,&geo->IndexBufferCPU);
-    CopyMemory(geo->IndexBufferCPU->GetBufferPointer(),indices.data(),ibByteSize);
-
     // 创建Buffer
-    geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(
-        md3dDevice.Get(),
-        mCommandList.Get(),
-        vertices.data(),
-        vbByteSize,
-        geo->VertexBufferUploader
-    );
-
-    geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(
-        md3dDevice.Get(),
-        mCommandList.Get(),
-        indices.data(),
-        ibByteSize,
-        geo->IndexBufferUploader
-    );
-    geo->VertexByteStride = sizeof(Vertex);
-    geo->VertexBufferByteSize = vbByteSize;
-    geo->IndexFormat = DXGI_FORMAT_R16_UINT;
-    geo->IndexBufferByteSize = ibByteSize;
-
-    geo->DrawArgs["box"] = boxSumMesh;
-    geo->DrawArgs["grid"] = gridSumMesh;
-    geo->DrawArgs["sphere"] = sphereSumMesh;
-    geo->DrawArgs["cylinder"] = cylinderSumMesh;
+    BuildMeshGeometry(*mUploadArena,packer,*geo);
 
     mGeometries[geo->Name] = std::move(geo);
 }
@@ -717,12 +633,9 @@ void ShapesApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::v
         cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
         cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
 
-        // Offset to the CBV in the heap for this object
-        UINT cbvIndex = mCurrentFrameResourceIndex*(UINT)mOpaqueRitems.size() + ri->ObjCBIndex;
-        auto cbvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(mCbvHeap->GetGPUDescriptorHandleForHeapStart());
-        cbvHandle.Offset(cbvIndex,mCbvSrvUavDescriptorSize);
-
-        cmdList->SetGraphicsRootDescriptorTable(0,cbvHandle);
+        // This frame's CBV among the object's persistent ones.
+        UINT cbvIndex = ri->Cbvs.Offset + mCurrentFrameResourceIndex;
+        cmdList->SetGraphicsRootDescriptorTable(0,mCbvHeap->GpuHandle(cbvIndex));
         cmdList->DrawIndexedInstanced(ri->IndexCount,1,ri->StartIndexLocation,ri->BaseVertexLocation,0);
     }
     
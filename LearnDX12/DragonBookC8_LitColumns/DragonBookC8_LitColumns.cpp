@@ -2,7 +2,18 @@
 #include "../Common/MathHelper.h"
 #include "../Common/UploadBuffer.h"
 #include "../Common/GeometryGenerator.h"
+#include "../Common/GeometryCache.h"
+#include "../Common/MeshGeometryBuilder.h"
+#include "../Common/MeshSimplifier.h"
+#include "../Common/ShaderCompiler.h"
+#include "../Common/ShaderPermutations.h"
+#include "../Common/PipelineStateManager.h"
+#include "../Common/VertexLightBaker.h"
+#include "../Common/ClusteredLighting.h"
+#include "../Common/MaterialTable.h"
+#include "../Common/UploadArena.h"
 #include "FrameResource.h"
+#include <chrono>
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -35,6 +46,23 @@ struct RenderItem
     UINT IndexCount;
     UINT StartIndexLocation = 0;
     int BaseVertexLocation = 0;
+
+    // Optional LOD chain, finest first.  When set, the draw args above are picked
+    // from it at submit time by projected error.
+    std::vector<SubmeshGeometry> Lods;
+    std::vector<float> LodErrors;
+
+    // Uniform world scale, used to bring LodErrors into world units.
+    float LodScale = 1.0f;
+
+    // Source meshes, for baking: Mesh, or one per entry of Lods.
+    const GeometryGenerator::MeshData* Mesh = nullptr;
+    std::vector<const GeometryGenerator::MeshData*> LodMeshes;
+
+    // Baked light stream (vertex buffer slot 1), offset so that BaseVertexLocation
+    // lands on this item's colors.  One view per LOD level when Lods is set.
+    D3D12_VERTEX_BUFFER_VIEW BakedLightView = {};
+    std::vector<D3D12_VERTEX_BUFFER_VIEW> BakedLightLodViews;
 };
 
 class LitColumnsApp:public D3DApp
@@ -60,17 +88,21 @@ protected:
     void UpdateCamera(const GameTimer& gt);
     void AnimateMaterials(const GameTimer& gt);
     void UpdateObjectCBs(const GameTimer& gt);
-    void UpdateMaterialCBs(const GameTimer& gt);
+    void UpdateMaterialBuffer(const GameTimer& gt);
     void UpdateMainPassCB(const GameTimer& gt);
+    void UpdateLightClusters(const GameTimer& gt);
 
     void BuildRootSignature();
     void BuildShadersAndInputLayout();
     void BuildShaderGeometry();
     void BuildSkullGeometry();
     void BuildPSOs();
+    ID3D12PipelineState* GetOpaquePSO();
     void BuildFrameResources();
     void BuildMaterials();
     void BuildRenderItems();
+    void BuildLights();
+    void BuildBakedLighting();
     void DrawRenderItems(ID3D12GraphicsCommandList* cmdList,const std::vector<RenderItem*>& ritems);
 private:
     std::vector<std::unique_ptr<FrameResource>> mFrameResources;
@@ -82,19 +114,60 @@ private:
     ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
 
     std::unordered_map<std::string,std::unique_ptr<MeshGeometry>> mGeometries;
+
+    // Stages the startup vertex and index data; released at the end of Initialize().
+    std::unique_ptr<UploadArena> mUploadArena;
+
     std::unordered_map<std::string,std::unique_ptr<Material>> mMaterials;
+
+    // Packed copy of mMaterials for the structured buffer; Material::MatCBIndex is the
+    // index the table assigned.
+    std::unique_ptr<MaterialTable> mMaterialTable;
     std::unordered_map<std::string,std::unique_ptr<Texture>> mTextures;
     std::unordered_map<std::string,ComPtr<ID3DBlob>> mShaders;
 
     std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout ;
-
-    ComPtr<ID3D12PipelineState> mOpaquePSO = nullptr;
+    std::vector<D3D12_INPUT_ELEMENT_DESC> mBakedInputLayout;
+
+    // One pixel shader per directional light count, all compiled at startup; the pass
+    // picks the variant that matches its lights and requests its PSO on first use.  The
+    // PSO is created on a worker, and until it is ready the pass keeps drawing with the
+    // last PSO it used.  Keys 0 to 3 change the count.
+    std::unique_ptr<ShaderPermutations> mLightingPS;
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC mOpaquePsoDesc;
+    std::unique_ptr<PipelineStateManager> mPsoManager;
+    std::unordered_map<UINT, PipelineStateManager::Handle> mOpaquePSOs;
+    ID3D12PipelineState* mOpaquePSO = nullptr;
+
+    // Static lighting baked into a per-vertex color stream at startup: diffuse light
+    // and ambient occlusion only, drawn with a shader that does no lighting math.
+    // Holding L draws with the full per-pixel lighting instead.
+    PipelineStateManager::Handle mBakedPSO;
+    Microsoft::WRL::ComPtr<ID3D12Resource> mBakedLightBuffer;
+    bool mDrawBaked = true;
+
+    // Directional lights are in the pass constants.  The point and spot lights, point
+    // lights first, are binned into clusters every frame, and each pixel only shades
+    // the ones whose range reaches its cluster.
+    UINT mNumDirLights = 3;
+    UINT mNumPointLights = 10;
+    UINT mNumSpotLights = 4;
+    std::vector<ShadingLight> mClusterLights;
+    LightClusterBuilder mLightClusters;
 
     // List of the render items.
     std::vector<std::unique_ptr<RenderItem>> mAllRitems;
 
     std::vector<RenderItem*> mOpaqueRitems;
 
+    // Skull LOD chain, finest first, and the object space error of each level.
+    std::vector<SubmeshGeometry> mSkullLods;
+    std::vector<float> mSkullLodErrors;
+
+    // CPU copies of the drawn meshes, kept for the light baker.
+    std::unordered_map<std::string, GeometryCache::MeshPtr> mShapeMeshes;
+    std::vector<MeshLod> mSkullMeshes;
+
     PassConstants mMainPassCB;
 
     XMFLOAT3 mEyePos = {0.f,0.f,0.f};
@@ -119,24 +192,31 @@ bool LitColumnsApp::Initialize()
         return false;
 
     mCommandList->Reset(mDirectCmdListAlloc.Get(),nullptr);
+    mUploadArena = std::make_unique<UploadArena>(md3dDevice.Get());
 
     mCbvSrvDecriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
     BuildRootSignature();
     BuildShadersAndInputLayout();
+    // Shapes generated by earlier runs are read back instead of rebuilt.
+    GeometryCache::Default().SetDirectory("GeometryCache");
     BuildShaderGeometry();
     BuildSkullGeometry();
     BuildMaterials();
     BuildRenderItems();
+    BuildLights();
+    BuildBakedLighting();
     BuildFrameResources();
     BuildPSOs();
 
     mCommandList->Close();
     ID3D12CommandList* cmdLists[] = {mCommandList.Get()};
+    mUploadArena->WaitForCopies(mCommandQueue.Get());
     mCommandQueue->ExecuteCommandLists(_countof(cmdLists),cmdLists);
 
     // Wait until initialization is complete
     FlushCommandQueue();
+    mUploadArena.reset();
 
     return true;
 }
@@ -146,6 +226,14 @@ void LitColumnsApp::OnResize()
     D3DApp::OnResize();
     XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f*MathHelper::Pi,AspectRatio(),1.0f,1000.0f);
     XMStoreFloat4x4(&mProj,P);
+
+    // The clusters split the same frustum.
+    ClusterGridDesc grid = mLightClusters.Grid();
+    grid.FovY = 0.25f*MathHelper::Pi;
+    grid.Aspect = AspectRatio();
+    grid.NearZ = 1.0f;
+    grid.FarZ = 1000.0f;
+    mLightClusters.SetGrid(grid);
 }
 
 void LitColumnsApp::Update(const GameTimer& gt)
@@ -167,15 +255,16 @@ void LitColumnsApp::Update(const GameTimer& gt)
     }
     AnimateMaterials(gt);
     UpdateObjectCBs(gt);
-    UpdateMaterialCBs(gt);
+    UpdateMaterialBuffer(gt);
     UpdateMainPassCB(gt);
+    UpdateLightClusters(gt);
 }
 
 void LitColumnsApp::Draw(const GameTimer& gt)
 {
 	auto CmdListAlloc = mCurrFrameResource->CmdListAlloc;
 	CmdListAlloc->Reset();
-	mCommandList->Reset(CmdListAlloc.Get(),mOpaquePSO.Get());
+	mCommandList->Reset(CmdListAlloc.Get(),mDrawBaked ? mPsoManager->Get(mBakedPSO) : GetOpaquePSO());
 
 	// Render 
 	mCommandList->RSSetViewports(1,&mScreenViewport);
@@ -197,6 +286,15 @@ void LitColumnsApp::Draw(const GameTimer& gt)
 	// 对应Default.hlsl中的register(b2)
 	mCommandList->SetGraphicsRootConstantBufferView(2,passCB->GetGPUVirtualAddress());
 
+	// Every material at once; objects pick theirs by index.
+	auto matBuffer = mCurrFrameResource->MaterialBuffer->Resource();
+	mCommandList->SetGraphicsRootShaderResourceView(1,matBuffer->GetGPUVirtualAddress());
+
+	// The clustered lights; only the per-pixel lighting reads them.
+	mCommandList->SetGraphicsRootShaderResourceView(3,mCurrFrameResource->ClusterLights->Resource()->GetGPUVirtualAddress());
+	mCommandList->SetGraphicsRootShaderResourceView(4,mCurrFrameResource->ClusterRanges->Resource()->GetGPUVirtualAddress());
+	mCommandList->SetGraphicsRootShaderResourceView(5,mCurrFrameResource->ClusterLightIndices->Resource()->GetGPUVirtualAddress());
+
 	DrawRenderItems(mCommandList.Get(),mOpaqueRitems);
 
 	// Indicate a state transition on the resource usage.
@@ -261,6 +359,16 @@ void LitColumnsApp::OnMouseMove(WPARAM btnState, int x, int y)
 
 void LitColumnsApp::OnKeyboardInput(const GameTimer& gt)
 {
+    // Hold L to compare the baked lighting with the per-pixel one.
+    mDrawBaked = (GetAsyncKeyState('L') & 0x8000) == 0;
+
+    // 0 to 3 directional lights in the per-pixel lighting; the baked lighting keeps
+    // the ones it was baked with.
+    for(UINT count = 0; count <= 3; ++count)
+    {
+        if(GetAsyncKeyState('0' + count) & 0x8000)
+            mNumDirLights = count;
+    }
 }
 
 void LitColumnsApp::UpdateCamera(const GameTimer& gt)
@@ -296,6 +404,7 @@ void LitColumnsApp::UpdateObjectCBs(const GameTimer& gt)
             ObjectConstants objConstants;
             XMStoreFloat4x4(&objConstants.World,XMMatrixTranspose(world));
             XMStoreFloat4x4(&objConstants.TexTransform,XMMatrixTranspose(texTransform));
+            objConstants.MaterialIndex = e->Mat->MatCBIndex;
             currObjectCB->CopyData(e->ObjCBIndex,objConstants);
             
             e->NumFrameDirty--;
@@ -303,9 +412,10 @@ void LitColumnsApp::UpdateObjectCBs(const GameTimer& gt)
     }
 }
 
-void LitColumnsApp::UpdateMaterialCBs(const GameTimer& gt)
+void LitColumnsApp::UpdateMaterialBuffer(const GameTimer& gt)
 {
-    auto currMaterialCB = mCurrFrameResource->MaterialCB.get();
+    // The table keeps track of which frame resources still hold an old copy, so a
+    // changed material only needs to reach it once.
     for(auto& e:mMaterials)
     {
         Material* mat = e.second.get();
@@ -313,18 +423,22 @@ void LitColumnsApp::UpdateMaterialCBs(const GameTimer& gt)
         {
             XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
 
-            MaterialConstants matConstants;
-            matConstants.DiffuseAlbedo = mat->DiffuseAlbedo;
-            matConstants.FresnelR0 = mat->FresnelR0;
-            matConstants.Roughness = mat->Roughness;
+            MaterialTable::Entry matData;
+            matData.DiffuseAlbedo = mat->DiffuseAlbedo;
+            matData.FresnelR0 = mat->FresnelR0;
+            matData.Roughness = mat->Roughness;
 
-            XMStoreFloat4x4(&matConstants.MatTransform,XMMatrixTranspose(matTransform));
+            XMStoreFloat4x4(&matData.MatTransform,XMMatrixTranspose(matTransform));
 
-            currMaterialCB->CopyData(mat->MatCBIndex,matConstants);
+            mMaterialTable->Set(mat->MatCBIndex,matData);
 
-            mat->NumFramesDirty --;
+            mat->NumFramesDirty = 0;
         }
     }
+
+    auto currMaterialBuffer = mCurrFrameResource->MaterialBuffer.get();
+    for(const MaterialTable::Range& range:mMaterialTable->TakeDirtyRanges(mCurrentFrameResourceIndex))
+        currMaterialBuffer->CopyRange(range.First,mMaterialTable->Data()+range.First,range.Count);
 }
 
 void LitColumnsApp::UpdateMainPassCB(const GameTimer& gt)
@@ -350,29 +464,46 @@ void LitColumnsApp::UpdateMainPassCB(const GameTimer& gt)
     mMainPassCB.FarZ = 1000.0f;
     mMainPassCB.TotalTime = gt.TotalTime();
     mMainPassCB.DeltaTime = gt.DeltaTime();
-    // Light info.
-    mMainPassCB.AmbientLight = { 0.25f, 0.25f, 0.35f, 1.0f };
-    mMainPassCB.Lights[0].Direction = { 0.57735f, -0.57735f, 0.57735f };
-    mMainPassCB.Lights[0].Strength = { 0.6f, 0.6f, 0.6f };
-    mMainPassCB.Lights[1].Direction = { -0.57735f, -0.57735f, 0.57735f };
-    mMainPassCB.Lights[1].Strength = { 0.3f, 0.3f, 0.3f };
-    mMainPassCB.Lights[2].Direction = { 0.0f, -0.707f, -0.707f };
-    mMainPassCB.Lights[2].Strength = { 0.15f, 0.15f, 0.15f };
+
+    const ClusterGridDesc& grid = mLightClusters.Grid();
+    mMainPassCB.ClusterTilesX = grid.TilesX;
+    mMainPassCB.ClusterTilesY = grid.TilesY;
+    mMainPassCB.ClusterSlices = grid.Slices;
+    mMainPassCB.ClusterLogDepthScale = mLightClusters.LogDepthScale();
+    mMainPassCB.NumClusterPointLights = mNumPointLights;
+    // The lights were set up once by BuildLights().
 
     auto currPassCB = mCurrFrameResource->PassCB.get();
     currPassCB->CopyData(0, mMainPassCB);
 }
 
+void LitColumnsApp::UpdateLightClusters(const GameTimer& gt)
+{
+    // The lights stay put, but the clusters move with the camera.
+    mLightClusters.Build(mView, mClusterLights.data(), mNumPointLights, mNumSpotLights);
+
+    const std::vector<LightClusterBuilder::Range>& ranges = mLightClusters.Ranges();
+    const std::vector<UINT>& indices = mLightClusters.LightIndices();
+    mCurrFrameResource->ClusterRanges->CopyRange(0, ranges.data(), (UINT)ranges.size());
+    if(!indices.empty())
+        mCurrFrameResource->ClusterLightIndices->CopyRange(0, indices.data(), (UINT)indices.size());
+}
+
 void LitColumnsApp::BuildRootSignature()
 {
-    CD3DX12_ROOT_PARAMETER slotRootParameter[3];
+    CD3DX12_ROOT_PARAMETER slotRootParameter[6];
 
-    // Create root CBV.
+    // Object and pass CBVs; the material structured buffer is a root SRV in space1.
     slotRootParameter[0].InitAsConstantBufferView(0);
-    slotRootParameter[1].InitAsConstantBufferView(1);
+    slotRootParameter[1].InitAsShaderResourceView(0,1);
     slotRootParameter[2].InitAsConstantBufferView(2);
 
-    CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(3,slotRootParameter,0,nullptr,D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+    // Clustered lights, ranges and light indices.
+    slotRootParameter[3].InitAsShaderResourceView(0);
+    slotRootParameter[4].InitAsShaderResourceView(1);
+    slotRootParameter[5].InitAsShaderResourceView(2);
+
+    CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(6,slotRootParameter,0,nullptr,D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
     ComPtr<ID3DBlob> serializedRootSig = nullptr;
     ComPtr<ID3DBlob> errorBlob = nullptr;
@@ -385,6 +516,9 @@ void LitColumnsApp::BuildRootSignature()
 
     md3dDevice->CreateRootSignature(0,serializedRootSig->GetBufferPointer(),serializedRootSig->GetBufferSize(),IID_PPV_ARGS(mRootSignature.GetAddressOf()));
 
+    // The PSO cache keys its pipelines by the serialized root signature.
+    PipelineStateManager::SetRootSignatureBlob(mRootSignature.Get(), serializedRootSig.Get());
+
 }
 
 void LitColumnsApp::BuildShadersAndInputLayout()
@@ -393,8 +527,36 @@ void LitColumnsApp::BuildShadersAndInputLayout()
     {
         "ALPHA_TEST","1",NULL,NULL
     };
-    mShaders["standardVS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl",nullptr,"VS","vs_5_1");
-    mShaders["opaquePS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl",nullptr,"PS","ps_5_1");
+    // Timed to compare a cold start (compiling) with a warm one (bytecode from disk).
+    auto compileStart = std::chrono::steady_clock::now();
+    mShaders["standardVS"] = ShaderCompiler::Compile(L"Shaders\\Default.hlsl",nullptr,"VS","vs_5_1");
+
+    // Every directional light count the sample can select; the point and spot lights
+    // always come from the clusters.  shadowFactor is a float3, so at most three
+    // directional lights.  The variants compile in parallel, so Draw() never compiles.
+    ShaderCompileDesc psDesc;
+    psDesc.Path = "Shaders\\Default.hlsl";
+    psDesc.Defines = { { "CLUSTERED_LIGHTS", "1" } };
+    psDesc.EntryPoint = "PS";
+    psDesc.Target = "ps_5_1";
+    psDesc.Flags = d3dUtil::ShaderCompileFlags();
+    mLightingPS = std::make_unique<ShaderPermutations>(psDesc, std::vector<PermutationAxis>
+    {
+        { "NUM_DIR_LIGHTS", { 0, 1, 2, 3 } },
+    });
+
+    std::string messages;
+    bool compiled = mLightingPS->CompileAll(ShaderCompiler::Cache(), ThreadPool::Default(), &messages);
+    if(!messages.empty())
+        ::OutputDebugStringA(messages.c_str());
+    if(!compiled)
+        throw DxException(E_FAIL, L"ShaderPermutations::CompileAll", AnsiToWString(__FILE__), __LINE__);
+
+    double compileMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - compileStart).count();
+
+    const ShaderCache& shaderCache = ShaderCompiler::Cache();
+    ::OutputDebugStringA(("Shaders: " + std::to_string(compileMs) + " ms, compiled " + std::to_string(shaderCache.Compiled()) +
+        ", from disk " + std::to_string(shaderCache.DiskHits()) + "\n").c_str());
 
     // Vertex buffer.
     mInputLayout =
@@ -403,124 +565,51 @@ void LitColumnsApp::BuildShadersAndInputLayout()
         {"NORMAL",0,DXGI_FORMAT_R32G32B32_FLOAT,0,12,D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,0},
         {"TEXCOORD",0,DXGI_FORMAT_R32G32_FLOAT,0,24,D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,0},
     };
+
+    // Baked lighting: positions from the mesh, the light from a second stream.
+    mShaders["bakedVS"] = ShaderCompiler::Compile(L"Shaders\\Default.hlsl",nullptr,"VSBaked","vs_5_1");
+    mShaders["bakedPS"] = ShaderCompiler::Compile(L"Shaders\\Default.hlsl",nullptr,"PSBaked","ps_5_1");
+    mBakedInputLayout =
+    {
+        {"POSITION",0,DXGI_FORMAT_R32G32B32_FLOAT,0,0,D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,0},
+        {"COLOR",0,DXGI_FORMAT_R32G32B32A32_FLOAT,1,0,D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,0},
+    };
 }
 
 void LitColumnsApp::BuildShaderGeometry()
 {
-      GeometryGenerator geoGen;
-	GeometryGenerator::MeshData box = geoGen.CreateBox(1.5f, 0.5f, 1.5f, 3);
-	GeometryGenerator::MeshData grid = geoGen.CreateGrid(20.0f, 30.0f, 60, 40);
-	GeometryGenerator::MeshData sphere = geoGen.CreateSphere(0.5f, 20, 20);
-	GeometryGenerator::MeshData cylinder = geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20);
-
-	//
-	// We are concatenating all the geometry into one big vertex/index buffer.  So
-	// define the regions in the buffer each submesh covers.
-	//
-
-	// Cache the vertex offsets to each object in the concatenated vertex buffer.
-	UINT boxVertexOffset = 0;
-	UINT gridVertexOffset = (UINT)box.Vertices.size();
-	UINT sphereVertexOffset = gridVertexOffset + (UINT)grid.Vertices.size();
-	UINT cylinderVertexOffset = sphereVertexOffset + (UINT)sphere.Vertices.size();
-
-	// Cache the starting index for each object in the concatenated index buffer.
-	UINT boxIndexOffset = 0;
-	UINT gridIndexOffset = (UINT)box.Indices32.size();
-	UINT sphereIndexOffset = gridIndexOffset + (UINT)grid.Indices32.size();
-	UINT cylinderIndexOffset = sphereIndexOffset + (UINT)sphere.Indices32.size();
-
-	SubmeshGeometry boxSubmesh;
-	boxSubmesh.IndexCount = (UINT)box.Indices32.size();
-	boxSubmesh.StartIndexLocation = boxIndexOffset;
-	boxSubmesh.BaseVertexLocation = boxVertexOffset;
-
-	SubmeshGeometry gridSubmesh;
-	gridSubmesh.IndexCount = (UINT)grid.Indices32.size();
-	gridSubmesh.StartIndexLocation = gridIndexOffset;
-	gridSubmesh.BaseVertexLocation = gridVertexOffset;
-
-	SubmeshGeometry sphereSubmesh;
-	sphereSubmesh.IndexCount = (UINT)sphere.Indices32.size();
-	sphereSubmesh.StartIndexLocation = sphereIndexOffset;
-	sphereSubmesh.BaseVertexLocation = sphereVertexOffset;
-
-	SubmeshGeometry cylinderSubmesh;
-	cylinderSubmesh.IndexCount = (UINT)cylinder.Indices32.size();
-	cylinderSubmesh.StartIndexLocation = cylinderIndexOffset;
-	cylinderSubmesh.BaseVertexLocation = cylinderVertexOffset;
+	GeometryCache& geoCache = GeometryCache::Default();
+	auto box = geoCache.CreateBox(1.5f, 0.5f, 1.5f, 3);
+	auto grid = geoCache.CreateGrid(20.0f, 30.0f, 60, 40);
+	auto sphere = geoCache.CreateSphere(0.5f, 20, 20);
+	auto cylinder = geoCache.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20);
 
 	//
-	// Extract the vertex elements we are interested in and pack the
-	// vertices of all the meshes into one vertex buffer.
+	// We are concatenating all the geometry into one big vertex/index buffer.  The
+	// packer computes the region each submesh covers and extracts the vertex
+	// elements we are interested in.
 	//
 
-	auto totalVertexCount =
-		box.Vertices.size() +
-		grid.Vertices.size() +
-		sphere.Vertices.size() +
-		cylinder.Vertices.size();
-
-	std::vector<Vertex> vertices(totalVertexCount);
-
-	UINT k = 0;
-	for(size_t i = 0; i < box.Vertices.size(); ++i, ++k)
-	{
-		vertices[k].Pos = box.Vertices[i].Position;
-		vertices[k].Normal = box.Vertices[i].Normal;
-	}
-
-	for(size_t i = 0; i < grid.Vertices.size(); ++i, ++k)
-	{
-		vertices[k].Pos = grid.Vertices[i].Position;
-		vertices[k].Normal = grid.Vertices[i].Normal;
-	}
-
-	for(size_t i = 0; i < sphere.Vertices.size(); ++i, ++k)
-	{
-		vertices[k].Pos = sphere.Vertices[i].Position;
-		vertices[k].Normal = sphere.Vertices[i].Normal;
-	}
-
-	for(size_t i = 0; i < cylinder.Vertices.size(); ++i, ++k)
+	GeometryPacker packer(
 	{
-		vertices[k].Pos = cylinder.Vertices[i].Position;
-		vertices[k].Normal = cylinder.Vertices[i].Normal;
-	}
+		{VertexAttribute::Position, offsetof(Vertex, Pos)},
+		{VertexAttribute::Normal, offsetof(Vertex, Normal)},
+	}, sizeof(Vertex));
 
-	std::vector<std::uint16_t> indices;
-	indices.insert(indices.end(), std::begin(box.GetIndices16()), std::end(box.GetIndices16()));
-	indices.insert(indices.end(), std::begin(grid.GetIndices16()), std::end(grid.GetIndices16()));
-	indices.insert(indices.end(), std::begin(sphere.GetIndices16()), std::end(sphere.GetIndices16()));
-	indices.insert(indices.end(), std::begin(cylinder.GetIndices16()), std::end(cylinder.GetIndices16()));
+	packer.Add("box", *box);
+	packer.Add("grid", *grid);
+	packer.Add("sphere", *sphere);
+	packer.Add("cylinder", *cylinder);
 
-    const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-    const UINT ibByteSize = (UINT)indices.size()  * sizeof(std::uint16_t);
+	mShapeMeshes["box"] = box;
+	mShapeMeshes["grid"] = grid;
+	mShapeMeshes["sphere"] = sphere;
+	mShapeMeshes["cylinder"] = cylinder;
 
 	auto geo = std::make_unique<MeshGeometry>();
 	geo->Name = "shapeGeo";
 
-	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
-
-	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
-
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
-
-	geo->VertexByteStride = sizeof(Vertex);
-	geo->VertexBufferByteSize = vbByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
-	geo->IndexBufferByteSize = ibByteSize;
-
-	geo->DrawArgs["box"] = boxSubmesh;
-	geo->DrawArgs["grid"] = gridSubmesh;
-	geo->DrawArgs["sphere"] = sphereSubmesh;
-	geo->DrawArgs["cylinder"] = cylinderSubmesh;
+	BuildMeshGeometry(*mUploadArena, packer, *geo);
 
 	mGeometries[geo->Name] = std::move(geo);
 }
@@ -528,54 +617,45 @@ void LitColumnsApp::BuildShaderGeometry()
 void LitColumnsApp::BuildSkullGeometry()
 {
 	GeometryGenerator geoGen;
-	GeometryGenerator::MeshData model = geoGen.LoadModel("Models/skull.txt");
+	GeometryGenerator::WeldStats weld;
+	GeometryGenerator::MeshData model = geoGen.LoadModel("Models/skull.txt", 1e-5f, &weld);
+	::OutputDebugStringA(("skull.txt: welded " + std::to_string(weld.VerticesBefore) + " -> " +
+		std::to_string(weld.VerticesAfter) + " vertices\n").c_str());
 
-	std::vector<Vertex> vertices(model.Vertices.size());
-	for(UINT i=0;i<vertices.size();++i)
-	{
-		vertices[i].Pos = model.Vertices[i].Position;
-		vertices[i].Normal = model.Vertices[i].Normal;
-	}
-	std::vector<std::int32_t> indices(model.Indices32.size());
-	for(UINT i=0;i<indices.size();++i)
-	{
-		indices[i] =(model.Indices32[i]);
-	}
-	
-	const UINT vbByteSize = vertices.size()*sizeof(Vertex);
-	const UINT ibByteSize = indices.size()*sizeof(std::int32_t);
-	
-	auto geo = std::make_unique<MeshGeometry>();
-	geo->Name = "skullGeo";
+	// Each level keeps about half the triangles of the previous one.
+	mSkullMeshes = MeshSimplifier::BuildLodChain(model, 4);
+	const std::vector<MeshLod>& lods = mSkullMeshes;
 
-	D3DCreateBlob(vbByteSize,&geo->VertexBufferCPU);
-	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(),vertices.data(),vbByteSize);
-	D3DCreateBlob(ibByteSize,&geo->IndexBufferCPU);
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(),indices.data(),ibByteSize);
+	// Concatenate every level into one vertex/index buffer.
+	GeometryPacker packer(
+	{
+		{VertexAttribute::Position, offsetof(Vertex, Pos)},
+		{VertexAttribute::Normal, offsetof(Vertex, Normal)},
+	}, sizeof(Vertex));
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),mCommandList.Get(),vertices.data(),vbByteSize,geo->VertexBufferUploader);
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),mCommandList.Get(),indices.data(),ibByteSize,geo->IndexBufferUploader);
+	packer.Add("skull", lods[0].Mesh);
+	for(size_t lod = 1; lod < lods.size(); ++lod)
+		packer.Add("skull_lod" + std::to_string(lod), lods[lod].Mesh);
 
-	geo->VertexByteStride = sizeof(Vertex);
-	geo->VertexBufferByteSize = vbByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R32_UINT;
-	geo->IndexBufferByteSize = ibByteSize;
+	auto geo = std::make_unique<MeshGeometry>();
+	geo->Name = "skullGeo";
 
-	SubmeshGeometry submesh;
-	submesh.IndexCount = (UINT)(indices.size());
-	submesh.BaseVertexLocation = 0;
-	submesh.StartIndexLocation = 0;
+	BuildMeshGeometry(*mUploadArena, packer, *geo);
 
-	geo->DrawArgs["skull"] = submesh;
+	mSkullLods.resize(lods.size());
+	mSkullLodErrors.resize(lods.size());
+	for(size_t lod = 0; lod < lods.size(); ++lod)
+	{
+		mSkullLods[lod] = geo->DrawArgs[packer.Submeshes()[lod].Name];
+		mSkullLodErrors[lod] = lods[lod].Error;
+	}
 
 	mGeometries[geo->Name] = std::move(geo);
-	
-	
 }
 
 void LitColumnsApp::BuildPSOs()
 {
-	D3D12_GRAPHICS_PIPELINE_STATE_DESC opaquePsoDesc;
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC& opaquePsoDesc = mOpaquePsoDesc;
 
 	ZeroMemory(&opaquePsoDesc,sizeof(D3D12_GRAPHICS_PIPELINE_STATE_DESC));
 
@@ -586,11 +666,7 @@ void LitColumnsApp::BuildPSOs()
 		reinterpret_cast<BYTE*>(mShaders["standardVS"]->GetBufferPointer()),
 		mShaders["standardVS"]->GetBufferSize()
 	};
-	opaquePsoDesc.PS=
-	{
-		reinterpret_cast<BYTE*>(mShaders["opaquePS"]->GetBufferPointer()),
-		mShaders["opaquePS"]->GetBufferSize()
-	};
+	// PS is filled in per lighting variant by GetOpaquePSO().
 	opaquePsoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
 	opaquePsoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
 	opaquePsoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
@@ -601,7 +677,51 @@ void LitColumnsApp::BuildPSOs()
 	opaquePsoDesc.SampleDesc.Count = m4xMsaaState ? 4 : 1;
 	opaquePsoDesc.SampleDesc.Quality = m4xMsaaState ? (m4xMsaaQuality - 1) : 0;
 	opaquePsoDesc.DSVFormat = mDepthStencilFormat;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&mOpaquePSO)));
+
+	mPsoManager = std::make_unique<PipelineStateManager>(md3dDevice.Get());
+	mPsoManager->SetDirectory("PipelineCache");
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC bakedPsoDesc = opaquePsoDesc;
+	bakedPsoDesc.InputLayout = {mBakedInputLayout.data(),(UINT)mBakedInputLayout.size()};
+	bakedPsoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["bakedVS"]->GetBufferPointer()),
+		mShaders["bakedVS"]->GetBufferSize()
+	};
+	bakedPsoDesc.PS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["bakedPS"]->GetBufferPointer()),
+		mShaders["bakedPS"]->GetBufferSize()
+	};
+	mBakedPSO = mPsoManager->Request(bakedPsoDesc);
+
+	// The first frame needs a PSO, so wait for the variant of the initial lights.
+	GetOpaquePSO();
+	mPsoManager->WaitAll();
+	ThrowIfFailed(GetOpaquePSO() != nullptr ? S_OK : E_FAIL);
+	ThrowIfFailed(mPsoManager->Get(mBakedPSO) != nullptr ? S_OK : E_FAIL);
+}
+
+ID3D12PipelineState* LitColumnsApp::GetOpaquePSO()
+{
+	UINT variant = mLightingPS->Select({ mNumDirLights });
+	if(variant == ShaderPermutations::NoVariant)
+		throw DxException(E_INVALIDARG, L"ShaderPermutations::Select", AnsiToWString(__FILE__), __LINE__);
+
+	auto it = mOpaquePSOs.find(variant);
+	if(it == mOpaquePSOs.end())
+	{
+		const ShaderByteCode& ps = *mLightingPS->ByteCode(variant);
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = mOpaquePsoDesc;
+		desc.PS = { ps.data(), ps.size() };
+		it = mOpaquePSOs.emplace(variant, mPsoManager->Request(desc)).first;
+	}
+
+	// Still being created: stay on the previous variant meanwhile.
+	if(ID3D12PipelineState* pso = mPsoManager->Get(it->second))
+		mOpaquePSO = pso;
+
+	return mOpaquePSO;
 }
 
 void LitColumnsApp::BuildFrameResources()
@@ -609,7 +729,12 @@ void LitColumnsApp::BuildFrameResources()
 	for(int i = 0; i < gNumFrameResources; ++i)
 	{
 		mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
-			1, (UINT)mAllRitems.size(), (UINT)mMaterials.size()));
+			1, (UINT)mAllRitems.size(), mMaterialTable->Capacity(),
+			(UINT)mClusterLights.size(), mLightClusters.ClusterCount()));
+
+		// The lights never change; only their clusters do.
+		if(!mClusterLights.empty())
+			mFrameResources.back()->ClusterLights->CopyRange(0, mClusterLights.data(), (UINT)mClusterLights.size());
 	}
 }
 
@@ -617,7 +742,6 @@ void LitColumnsApp::BuildMaterials()
 {
 	auto bricks0 = std::make_unique<Material>();
 	bricks0->Name = "bricks0";
-	bricks0->MatCBIndex = 0;
 	bricks0->DiffuseSrvHeapIndex = 0;
 	bricks0->DiffuseAlbedo = XMFLOAT4(Colors::ForestGreen);
 	bricks0->FresnelR0 = XMFLOAT3(0.02f, 0.02f, 0.02f);
@@ -625,7 +749,6 @@ void LitColumnsApp::BuildMaterials()
 
 	auto stone0 = std::make_unique<Material>();
 	stone0->Name = "stone0";
-	stone0->MatCBIndex = 1;
 	stone0->DiffuseSrvHeapIndex = 1;
 	stone0->DiffuseAlbedo = XMFLOAT4(Colors::LightSteelBlue);
 	stone0->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
@@ -633,7 +756,6 @@ void LitColumnsApp::BuildMaterials()
  
 	auto tile0 = std::make_unique<Material>();
 	tile0->Name = "tile0";
-	tile0->MatCBIndex = 2;
 	tile0->DiffuseSrvHeapIndex = 2;
 	tile0->DiffuseAlbedo = XMFLOAT4(Colors::LightGray);
 	tile0->FresnelR0 = XMFLOAT3(0.02f, 0.02f, 0.02f);
@@ -641,7 +763,6 @@ void LitColumnsApp::BuildMaterials()
 
 	auto skullMat = std::make_unique<Material>();
 	skullMat->Name = "skullMat";
-	skullMat->MatCBIndex = 3;
 	skullMat->DiffuseSrvHeapIndex = 3;
 	skullMat->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	skullMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05);
@@ -651,6 +772,12 @@ void LitColumnsApp::BuildMaterials()
 	mMaterials["stone0"] = std::move(stone0);
 	mMaterials["tile0"] = std::move(tile0);
 	mMaterials["skullMat"] = std::move(skullMat);
+
+	// Indices are assigned here; the data is filled in by UpdateMaterialBuffer() as
+	// every material starts out dirty.
+	mMaterialTable = std::make_unique<MaterialTable>(gNumFrameResources, (UINT)mMaterials.size());
+	for(auto& e : mMaterials)
+		e.second->MatCBIndex = mMaterialTable->Add(e.first, MaterialTable::Entry());
 }
 
 void LitColumnsApp::BuildRenderItems()
@@ -665,6 +792,7 @@ void LitColumnsApp::BuildRenderItems()
 	boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
 	boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
 	boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
+	boxRitem->Mesh = mShapeMeshes["box"].get();
 	mAllRitems.push_back(std::move(boxRitem));
 
     auto gridRitem = std::make_unique<RenderItem>();
@@ -677,6 +805,7 @@ void LitColumnsApp::BuildRenderItems()
     gridRitem->IndexCount = gridRitem->Geo->DrawArgs["grid"].IndexCount;
     gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs["grid"].StartIndexLocation;
     gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
+	gridRitem->Mesh = mShapeMeshes["grid"].get();
 	mAllRitems.push_back(std::move(gridRitem));
 
 	auto skullRitem = std::make_unique<RenderItem>();
@@ -689,6 +818,11 @@ void LitColumnsApp::BuildRenderItems()
 	skullRitem->IndexCount = skullRitem->Geo->DrawArgs["skull"].IndexCount;
 	skullRitem->StartIndexLocation = skullRitem->Geo->DrawArgs["skull"].StartIndexLocation;
 	skullRitem->BaseVertexLocation = skullRitem->Geo->DrawArgs["skull"].BaseVertexLocation;
+	skullRitem->Lods = mSkullLods;
+	skullRitem->LodErrors = mSkullLodErrors;
+	skullRitem->LodScale = 0.5f;
+	for(const MeshLod& lod : mSkullMeshes)
+		skullRitem->LodMeshes.push_back(&lod.Mesh);
 	mAllRitems.push_back(std::move(skullRitem));
 
 	XMMATRIX brickTexTransform = XMMatrixScaling(1.0f, 1.0f, 1.0f);
@@ -715,6 +849,7 @@ void LitColumnsApp::BuildRenderItems()
 		leftCylRitem->IndexCount = leftCylRitem->Geo->DrawArgs["cylinder"].IndexCount;
 		leftCylRitem->StartIndexLocation = leftCylRitem->Geo->DrawArgs["cylinder"].StartIndexLocation;
 		leftCylRitem->BaseVertexLocation = leftCylRitem->Geo->DrawArgs["cylinder"].BaseVertexLocation;
+		leftCylRitem->Mesh = mShapeMeshes["cylinder"].get();
 
 		XMStoreFloat4x4(&rightCylRitem->World, leftCylWorld);
 		XMStoreFloat4x4(&rightCylRitem->TexTransform, brickTexTransform);
@@ -725,6 +860,7 @@ void LitColumnsApp::BuildRenderItems()
 		rightCylRitem->IndexCount = rightCylRitem->Geo->DrawArgs["cylinder"].IndexCount;
 		rightCylRitem->StartIndexLocation = rightCylRitem->Geo->DrawArgs["cylinder"].StartIndexLocation;
 		rightCylRitem->BaseVertexLocation = rightCylRitem->Geo->DrawArgs["cylinder"].BaseVertexLocation;
+		rightCylRitem->Mesh = mShapeMeshes["cylinder"].get();
 
 		XMStoreFloat4x4(&leftSphereRitem->World, leftSphereWorld);
 		leftSphereRitem->TexTransform = MathHelper::Identity4x4();
@@ -735,6 +871,7 @@ void LitColumnsApp::BuildRenderItems()
 		leftSphereRitem->IndexCount = leftSphereRitem->Geo->DrawArgs["sphere"].IndexCount;
 		leftSphereRitem->StartIndexLocation = leftSphereRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
 		leftSphereRitem->BaseVertexLocation = leftSphereRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+		leftSphereRitem->Mesh = mShapeMeshes["sphere"].get();
 
 		XMStoreFloat4x4(&rightSphereRitem->World, rightSphereWorld);
 		rightSphereRitem->TexTransform = MathHelper::Identity4x4();
@@ -745,6 +882,7 @@ void LitColumnsApp::BuildRenderItems()
 		rightSphereRitem->IndexCount = rightSphereRitem->Geo->DrawArgs["sphere"].IndexCount;
 		rightSphereRitem->StartIndexLocation = rightSphereRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
 		rightSphereRitem->BaseVertexLocation = rightSphereRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+		rightSphereRitem->Mesh = mShapeMeshes["sphere"].get();
 
 		mAllRitems.push_back(std::move(leftCylRitem));
 		mAllRitems.push_back(std::move(rightCylRitem));
@@ -757,26 +895,159 @@ void LitColumnsApp::BuildRenderItems()
 		mOpaqueRitems.push_back(e.get());
 }
 
+void LitColumnsApp::BuildLights()
+{
+	// Directional lights in the pass constants, the point and then the spot lights for
+	// the clusters.  They do not move, so they are baked as well.
+	mMainPassCB.AmbientLight = { 0.25f, 0.25f, 0.35f, 1.0f };
+	mMainPassCB.Lights[0].Direction = { 0.57735f, -0.57735f, 0.57735f };
+	mMainPassCB.Lights[0].Strength = { 0.6f, 0.6f, 0.6f };
+	mMainPassCB.Lights[1].Direction = { -0.57735f, -0.57735f, 0.57735f };
+	mMainPassCB.Lights[1].Strength = { 0.3f, 0.3f, 0.3f };
+	mMainPassCB.Lights[2].Direction = { 0.0f, -0.707f, -0.707f };
+	mMainPassCB.Lights[2].Strength = { 0.15f, 0.15f, 0.15f };
+
+	// A small warm light above every sphere on the columns.
+	mClusterLights.clear();
+	for(int i = 0; i < 5; ++i)
+	{
+		for(float x : { -5.0f, +5.0f })
+		{
+			ShadingLight L;
+			L.Strength = { 0.8f, 0.6f, 0.3f };
+			L.FalloffStart = 1.0f;
+			L.FalloffEnd = 5.0f;
+			L.Position = { x, 4.5f, -10.0f + i*5.0f };
+			mClusterLights.push_back(L);
+		}
+	}
+
+	// Spot lights on the box and skull in the middle, from the four diagonals.
+	for(float x : { -6.0f, +6.0f })
+	{
+		for(float z : { -6.0f, +6.0f })
+		{
+			ShadingLight L;
+			L.Strength = { 0.5f, 0.5f, 0.7f };
+			L.FalloffStart = 5.0f;
+			L.FalloffEnd = 20.0f;
+			L.Position = { x, 8.0f, z };
+			XMStoreFloat3(&L.Direction, XMVector3Normalize(XMVectorSet(-x, -6.5f, -z, 0.0f)));
+			L.SpotPower = 32.0f;
+			mClusterLights.push_back(L);
+		}
+	}
+	assert(mClusterLights.size() == mNumPointLights + mNumSpotLights);
+}
+
+void LitColumnsApp::BuildBakedLighting()
+{
+	static_assert(sizeof(ShadingLight) == sizeof(Light), "ShadingLight mirrors Light");
+	std::vector<ShadingLight> lights(mNumDirLights);
+	std::memcpy(lights.data(), mMainPassCB.Lights, mNumDirLights*sizeof(ShadingLight));
+	lights.insert(lights.end(), mClusterLights.begin(), mClusterLights.end());
+	LightingModel lighting(lights.data(), mNumDirLights, mNumPointLights, mNumSpotLights);
+
+	//
+	// One baker instance per render item, or per LOD level.  Only the finest skull
+	// level occludes; the coarser ones would shadow it.
+	//
+	struct BakedSlice
+	{
+		D3D12_VERTEX_BUFFER_VIEW* View;
+		UINT Instance;
+		int BaseVertexLocation;
+	};
+
+	VertexLightBaker baker;
+	std::vector<BakedSlice> slices;
+	for(auto& ri : mAllRitems)
+	{
+		if(ri->LodMeshes.empty())
+		{
+			slices.push_back({ &ri->BakedLightView, baker.AddInstance(*ri->Mesh, ri->World), ri->BaseVertexLocation });
+			continue;
+		}
+
+		ri->BakedLightLodViews.resize(ri->LodMeshes.size());
+		for(size_t lod = 0; lod < ri->LodMeshes.size(); ++lod)
+		{
+			slices.push_back({ &ri->BakedLightLodViews[lod], baker.AddInstance(*ri->LodMeshes[lod], ri->World, lod == 0),
+				ri->Lods[lod].BaseVertexLocation });
+		}
+	}
+
+	auto bakeStart = std::chrono::steady_clock::now();
+	baker.Bake(lighting);
+	double bakeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - bakeStart).count();
+	::OutputDebugStringA(("Baked lighting: " + std::to_string(bakeMs) + " ms, " + std::to_string(baker.BakedVertexCount()) +
+		" vertices, " + std::to_string(baker.RayCount()) + " rays, " + std::to_string(baker.OccluderTriangleCount()) +
+		" occluder triangles\n").c_str());
+
+	//
+	// Every slice goes into one buffer.  BaseVertexLocation is added to the index in
+	// both streams, so each view starts BaseVertexLocation colors before its slice;
+	// slices never start before their BaseVertexLocation to keep that in the buffer.
+	//
+	std::vector<XMFLOAT4> colors;
+	std::vector<UINT> sliceStarts;
+	for(const BakedSlice& slice : slices)
+	{
+		const std::vector<XMFLOAT4>& sliceColors = baker.Colors(slice.Instance);
+		const UINT start = std::max((UINT)colors.size(), (UINT)slice.BaseVertexLocation);
+		colors.resize(start);
+		colors.insert(colors.end(), sliceColors.begin(), sliceColors.end());
+		sliceStarts.push_back(start);
+	}
+
+	const UINT byteSize = (UINT)colors.size()*sizeof(XMFLOAT4);
+	mBakedLightBuffer = mUploadArena->CreateBuffer(colors.data(), byteSize);
+
+	for(size_t i = 0; i < slices.size(); ++i)
+	{
+		const UINT offset = (sliceStarts[i] - slices[i].BaseVertexLocation)*sizeof(XMFLOAT4);
+		D3D12_VERTEX_BUFFER_VIEW& view = *slices[i].View;
+		view.BufferLocation = mBakedLightBuffer->GetGPUVirtualAddress() + offset;
+		view.StrideInBytes = sizeof(XMFLOAT4);
+		view.SizeInBytes = byteSize - offset;
+	}
+}
+
 void LitColumnsApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
 {
 	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
-	UINT matCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(MaterialConstants));
 
 	auto objCB = mCurrFrameResource->ObjectCB->Resource();
-	auto matCB = mCurrFrameResource->MaterialCB->Resource();
 
 	for(size_t i =0;i<ritems.size();++i)
 	{
 		auto ri = ritems[i];
+
+		if(!ri->Lods.empty())
+		{
+			// Distance from the eye to the object's origin picks the level.
+			XMVECTOR toObject = XMVectorSubtract(
+				XMVectorSet(ri->World._41, ri->World._42, ri->World._43, 1.0f), XMLoadFloat3(&mEyePos));
+			float distance = XMVectorGetX(XMVector3Length(toObject));
+
+			UINT lod = MeshSimplifier::SelectLod(ri->LodErrors.data(), (UINT)ri->LodErrors.size(),
+				ri->LodScale, distance, mProj._22, (float)mClientHeight);
+
+			ri->IndexCount = ri->Lods[lod].IndexCount;
+			ri->StartIndexLocation = ri->Lods[lod].StartIndexLocation;
+			ri->BaseVertexLocation = ri->Lods[lod].BaseVertexLocation;
+			ri->BakedLightView = ri->BakedLightLodViews[lod];
+		}
+
 		cmdList->IASetVertexBuffers(0,1,&ri->Geo->VertexBufferView());
+		if(mDrawBaked)
+			cmdList->IASetVertexBuffers(1,1,&ri->BakedLightView);
 		cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
 		cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
 
 		D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objCB->GetGPUVirtualAddress()+ri->ObjCBIndex*objCBByteSize;
-		D3D12_GPU_VIRTUAL_ADDRESS matCBAddress = matCB->GetGPUVirtualAddress()+ri->Mat->MatCBIndex*matCBByteSize;
 
 		cmdList->SetGraphicsRootConstantBufferView(0,objCBAddress);
-		cmdList->SetGraphicsRootConstantBufferView(1,matCBAddress);
 
 		cmdList->DrawIndexedInstanced(ri->IndexCount,1,ri->StartIndexLocation,ri->BaseVertexLocation,0);
 	}
@@ -1,7 +1,8 @@
 ﻿#include "FrameResource.h"
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount)
+FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount,
+    UINT clusterLightCount, UINT clusterCount)
 {
     ThrowIfFailed(device->CreateCommandAllocator(
         D3D12_COMMAND_LIST_TYPE_DIRECT,
@@ -9,8 +10,13 @@ FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCo
 
     //  FrameCB = std::make_unique<UploadBuffer<FrameConstants>>(device, 1, true);
     PassCB = std::make_unique<UploadBuffer<PassConstants>>(device, passCount, true);
-    MaterialCB = std::make_unique<UploadBuffer<MaterialConstants>>(device, materialCount, true);
+    MaterialBuffer = std::make_unique<UploadBuffer<MaterialTable::Entry>>(device, materialCount, false);
     ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, true);
+
+    // Never empty, so there is always a buffer to bind.
+    ClusterLights = std::make_unique<UploadBuffer<ShadingLight>>(device, std::max(clusterLightCount, 1u), false);
+    ClusterRanges = std::make_unique<UploadBuffer<LightClusterBuilder::Range>>(device, clusterCount, false);
+    ClusterLightIndices = std::make_unique<UploadBuffer<UINT>>(device, std::max(clusterLightCount*clusterCount, 1u), false);
 }
 
 FrameResource::~FrameResource()
@@ -3,11 +3,19 @@
 #include "../Common/d3dUtil.h"
 #include "../Common/MathHelper.h"
 #include "../Common/UploadBuffer.h"
+#include "../Common/MaterialTable.h"
+#include "../Common/ClusteredLighting.h"
 
 struct ObjectConstants
 {
     DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
     DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
+
+    // Index into the material structured buffer.
+    UINT MaterialIndex = 0;
+    UINT ObjPad0 = 0;
+    UINT ObjPad1 = 0;
+    UINT ObjPad2 = 0;
 };
 
 struct PassConstants
@@ -30,10 +38,22 @@ struct PassConstants
 
     DirectX::XMFLOAT4 AmbientLight = {0.f,0.f,0.f,1.f};
 
+    // Grid of the clustered lights (see LightClusterBuilder); the first
+    // NumClusterPointLights of them are point lights, the rest spot lights.
+    UINT ClusterTilesX = 0;
+    UINT ClusterTilesY = 0;
+    UINT ClusterSlices = 0;
+    float ClusterLogDepthScale = 0.f;
+    UINT NumClusterPointLights = 0;
+    UINT ClusterPad0 = 0;
+    UINT ClusterPad1 = 0;
+    UINT ClusterPad2 = 0;
+
     // Indices [0, NUM_DIR_LIGHTS) are directional lights;
     // indices [NUM_DIR_LIGHTS, NUM_DIR_LIGHTS+NUM_POINT_LIGHTS) are point lights;
     // indices [NUM_DIR_LIGHTS+NUM_POINT_LIGHTS, NUM_DIR_LIGHTS+NUM_POINT_LIGHT+NUM_SPOT_LIGHTS)
-    // are spot lights for a maximum of MaxLights per object.
+    // are spot lights for a maximum of MaxLights per object.  With CLUSTERED_LIGHTS
+    // only the directional lights are in here.
     Light Lights[MaxLights];
 };
 
@@ -45,7 +65,8 @@ struct Vertex
 
 struct FrameResource
 {
-    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount);
+    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount,
+        UINT clusterLightCount, UINT clusterCount);
     FrameResource(const FrameResource& rhs) = delete;
     FrameResource& operator=(const FrameResource& rhs) = delete;
     ~FrameResource();
@@ -58,9 +79,18 @@ struct FrameResource
     // that reference it.  So each frame needs their own cbuffers.
     // std::unique_ptr<UploadBuffer<FrameConstants>> FrameCB = nullptr;
     std::unique_ptr<UploadBuffer<PassConstants>> PassCB = nullptr;
-    std::unique_ptr<UploadBuffer<MaterialConstants>> MaterialCB = nullptr;
+    // Every material, indexed by ObjectConstants::MaterialIndex (see MaterialTable).
+    std::unique_ptr<UploadBuffer<MaterialTable::Entry>> MaterialBuffer = nullptr;
     std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCB = nullptr;
 
+    // Clustered point and spot lights, one (offset, count) range per cluster and the
+    // light indices the ranges point into, as LightClusterBuilder lays them out.  A
+    // cluster lists every light at most once, so the indices never outgrow
+    // clusterLightCount*clusterCount.
+    std::unique_ptr<UploadBuffer<ShadingLight>> ClusterLights = nullptr;
+    std::unique_ptr<UploadBuffer<LightClusterBuilder::Range>> ClusterRanges = nullptr;
+    std::unique_ptr<UploadBuffer<UINT>> ClusterLightIndices = nullptr;
+
     // Fence value to mark commands up to this fence point.  This lets us
     // check if these frame resources are still in use by the GPU.
     UINT64 Fence = 0;
@@ -1,5 +1,5 @@
 #ifndef NUM_DIR_LIGHTS
-    #define NUM_DI_LIGITS 3
+    #define NUM_DIR_LIGHTS 3
 #endif
 
 #ifndef NUM_POINT_LIGHTS
@@ -10,19 +10,32 @@
     #define NUM_SPOT_LIGHTS 0
 #endif
 
+// Point and spot lights from the clusters instead of gLights; see ClusterLighting().
+#ifndef CLUSTERED_LIGHTS
+    #define CLUSTERED_LIGHTS 0
+#endif
+
 #include "LightingUtil.hlsl"
 
-cbuffer cbPerObject:register(b0)
+struct MaterialData
 {
-    float4x4 gWorld;
+    float4 DiffuseAlbedo;
+    float3 FresnelR0;
+    float Roughness;
+    float4x4 MatTransform;
 };
 
-cbuffer cbMaterial:register(b1)
+// Every material; objects select theirs with gMaterialIndex.
+StructuredBuffer<MaterialData> gMaterialData : register(t0, space1);
+
+cbuffer cbPerObject:register(b0)
 {
-    float4 gDiffuseAlbedo;
-    float3 gFresnelR0;
-    float gRoughness;
-    float4x4 gMatTransform;
+    float4x4 gWorld;
+    float4x4 gTexTransform;
+    uint gMaterialIndex;
+    uint gObjPad0;
+    uint gObjPad1;
+    uint gObjPad2;
 };
 
 
@@ -44,9 +57,51 @@ cbuffer cbPass:register(b2)
     float gDeltaTime;
     float4 gAmbientLight;
 
+    uint gClusterTilesX;
+    uint gClusterTilesY;
+    uint gClusterSlices;
+    float gClusterLogDepthScale;
+    uint gNumClusterPointLights;
+    uint gClusterPad0;
+    uint gClusterPad1;
+    uint gClusterPad2;
+
     Light gLights[MaxLights];
 };
 
+#if CLUSTERED_LIGHTS
+// Built by LightClusterBuilder every frame: the lights, point lights first, one
+// (offset, count) range per cluster and the light indices the ranges point into.
+StructuredBuffer<Light> gClusterLights : register(t0);
+StructuredBuffer<uint2> gClusterRanges : register(t1);
+StructuredBuffer<uint> gClusterLightIndices : register(t2);
+
+// The point and spot lights of the pixel's cluster, found as in
+// LightClusterBuilder::ClusterOf(): the tile from the pixel position, the slice from
+// the log of the view space depth.
+float3 ClusterLighting(float4 posH,float3 posW,Material mat,float3 normal,float3 toEye)
+{
+    uint2 tiles = uint2(gClusterTilesX,gClusterTilesY);
+    uint2 tile = min(uint2(posH.xy*gInvRenderTargetSize*float2(tiles)),tiles-1);
+
+    float viewZ = mul(float4(posW,1.0f),gView).z;
+    uint slice = min(uint(max(log(viewZ/gNearZ),0.0f)*gClusterLogDepthScale),gClusterSlices-1);
+
+    uint2 range = gClusterRanges[(slice*tiles.y+tile.y)*tiles.x+tile.x];
+
+    float3 result = 0.0f;
+    for(uint i = 0;i<range.y;++i)
+    {
+        uint index = gClusterLightIndices[range.x+i];
+        if(index<gNumClusterPointLights)
+            result+=ComputePointLight(gClusterLights[index],mat,posW,normal,toEye);
+        else
+            result+=ComputeSpotLight(gClusterLights[index],mat,posW,normal,toEye);
+    }
+    return result;
+}
+#endif
+
 struct VertexIn
 {
     float3 PosL : POSITION;
@@ -79,19 +134,55 @@ float4 PS(VertexOut pIn): SV_TARGET
 
     float3 toEyeW = normalize(gEyePosW-pIn.PosW);
 
+    MaterialData matData = gMaterialData[gMaterialIndex];
+    float4 diffuseAlbedo = matData.DiffuseAlbedo;
+
     // 简介光
-    float4 ambient = gAmbientLight*gDiffuseAlbedo;
+    float4 ambient = gAmbientLight*diffuseAlbedo;
 
-    const float shininess = 1.0f-gRoughness;
-    Material mat = {gDiffuseAlbedo,gFresnelR0,shininess};
+    const float shininess = 1.0f-matData.Roughness;
+    Material mat = {diffuseAlbedo,matData.FresnelR0,shininess};
     float3 shadowFactor = 1.0f;
     float4 directLight = ComputeLighting(gLights,mat,pIn.PosW,pIn.NormalW,toEyeW,shadowFactor);
+#if CLUSTERED_LIGHTS
+    directLight.rgb += ClusterLighting(pIn.PosH,pIn.PosW,mat,pIn.NormalW,toEyeW);
+#endif
     float4 litColor = ambient+directLight;
 
     // common convention to take alpha from diffuse mat.
-    litColor.a = gDiffuseAlbedo.a;
+    litColor.a = diffuseAlbedo.a;
     return litColor;
 
     
     
-}
\ No newline at end of file
+}
+
+// Baked lighting: rgb is the direct light reaching the vertex, a its ambient visibility
+// (VertexLightBaker).  Specular depends on the view and is not baked.
+struct BakedVertexIn
+{
+    float3 PosL : POSITION;
+    float4 Light : COLOR;
+};
+
+struct BakedVertexOut
+{
+    float4 PosH : SV_POSITION;
+    float4 Light : COLOR;
+};
+
+BakedVertexOut VSBaked(BakedVertexIn vIn)
+{
+    BakedVertexOut vOut;
+    vOut.PosH = mul(mul(float4(vIn.PosL,1.0),gWorld),gViewProj);
+    vOut.Light = vIn.Light;
+    return vOut;
+}
+
+float4 PSBaked(BakedVertexOut pIn): SV_TARGET
+{
+    float4 diffuseAlbedo = gMaterialData[gMaterialIndex].DiffuseAlbedo;
+    float4 litColor = diffuseAlbedo*(gAmbientLight*pIn.Light.a+float4(pIn.Light.rgb,0.0f));
+    litColor.a = diffuseAlbedo.a;
+    return litColor;
+}
@@ -102,22 +102,22 @@ float4 ComputeLighting(Light gLights[MaxLights],Material mat,float3 pos,float3 n
     float3 result = 0.0f;
     int i =0;
     
-#if (NUM_DI_LIGITS>0)
-    for( i = 0;i<NUM_DI_LIGITS;++i)
+#if (NUM_DIR_LIGHTS>0)
+    for( i = 0;i<NUM_DIR_LIGHTS;++i)
     {
         result+=shadowFactor[i]*CompmuteDirectionalLight(gLights[i],mat,normal,toEye);    
     }
 #endif
     
 #if (NUM_POINT_LIGHTS>0)
-    for(i = NUM_DI_LIGITS;i<NUM_DI_LIGITS+NUM_POINT_LIGHTS;++i)
+    for(i = NUM_DIR_LIGHTS;i<NUM_DIR_LIGHTS+NUM_POINT_LIGHTS;++i)
     {
         result+=ComputePointLight(gLights[i],mat,pos,normal,toEye);
     }
 #endif
     
-#if (true||NUM_SPOT_LIGHTS>0)
-    for(i=(NUM_DI_LIGITS+NUM_POINT_LIGHTS);i<NUM_DI_LIGITS+NUM_POINT_LIGHTS+NUM_SPOT_LIGHTS;++i)
+#if (NUM_SPOT_LIGHTS>0)
+    for(i=(NUM_DIR_LIGHTS+NUM_POINT_LIGHTS);i<NUM_DIR_LIGHTS+NUM_POINT_LIGHTS+NUM_SPOT_LIGHTS;++i)
     {
         result+=ComputeSpotLight(gLights[i],mat,pos,normal,toEye);
     }